@@ -1,73 +0,0 @@
-#ifndef CERT_H
-#define CERT_H
-
-const char server_cert_pem[] =
-    "-----BEGIN CERTIFICATE-----\n"
-    "MIIFGjCCBAKgAwIBAgISA+jWWpt7B4w+view9+tVX/TrMA0GCSqGSIb3DQEBCwUA\n"
-    "MDMxCzAJBgNVBAYTAlVTMRYwFAYDVQQKEw1MZXQncyBFbmNyeXB0MQwwCgYDVQQD\n"
-    "EwNSMTAwHhcNMjQxMjEzMTMyMjI2WhcNMjUwMzEzMTMyMjI1WjAkMSIwIAYDVQQD\n"
-    "DBkqLmF0aG9tZS5yb2RsYW5kZmFybXMuY29tMIIBIjANBgkqhkiG9w0BAQEFAAOC\n"
-    "AQ8AMIIBCgKCAQEA4rs6md1/YpOyUUXG2Lu5udnLrnwWzsSBlF0ITF+tYlPL192G\n"
-    "EXJ6/ZfiB5RoCGfnvQFzzhLSYOoFAwTJLXkmz5SWlqPHI59IY2IA4nCKGN8QEeFd\n"
-    "ttVVkgvCKXpDg2w/6AWrpvaGkNnz6JA8odhbtwXoayNCzrmBEoshUfBohS1UrOBy\n"
-    "x03Fesgm7tzAm5yWSRp+JnMqsfo8caZgUnIvTu8OvDgp3zoseC/H7mW+cImgr0TZ\n"
-    "aymwargxdksCHi1SIyAq4XelHPDMkRIcnIoAP099n2rOi+amYTYHdRsKDiPhwu3L\n"
-    "MTOsPeqShzPsFjIw7TUYfPe3fSyrgi1mpTq4wwIDAQABo4ICNTCCAjEwDgYDVR0P\n"
-    "AQH/BAQDAgWgMB0GA1UdJQQWMBQGCCsGAQUFBwMBBggrBgEFBQcDAjAMBgNVHRMB\n"
-    "Af8EAjAAMB0GA1UdDgQWBBRsbDsmsorMasRa8S8+FzDtgHVMETAfBgNVHSMEGDAW\n"
-    "gBS7vMNHpeS8qcbDpHIMEI2iNeHI6DBXBggrBgEFBQcBAQRLMEkwIgYIKwYBBQUH\n"
-    "MAGGFmh0dHA6Ly9yMTAuby5sZW5jci5vcmcwIwYIKwYBBQUHMAKGF2h0dHA6Ly9y\n"
-    "MTAuaS5sZW5jci5vcmcvMD0GA1UdEQQ2MDSCGSouYXRob21lLnJvZGxhbmRmYXJt\n"
-    "cy5jb22CF2F0aG9tZS5yb2RsYW5kZmFybXMuY29tMBMGA1UdIAQMMAowCAYGZ4EM\n"
-    "AQIBMIIBAwYKKwYBBAHWeQIEAgSB9ASB8QDvAHYAzPsPaoVxCWX+lZtTzumyfCLp\n"
-    "hVwNl422qX5UwP5MDbAAAAGTwGTgCwAABAMARzBFAiBwRCOMDZE51u92GGSFxukA\n"
-    "U1z1TvSG8GTcvJef32yW4AIhALZlcCoF3W4ZNuZOfTICBN4jREwBbS8gl0I+6pjW\n"
-    "Q/MCAHUAzxFW7tUufK/zh1vZaS6b6RpxZ0qwF+ysAdJbd87MOwgAAAGTwGTgLwAA\n"
-    "BAMARjBEAiAWXJGvXkNHH+QKrl2hktX5a5zRl7cC6ggNdQzcmziInQIgGvDNJV1t\n"
-    "mTEXpgnp/FrSQ8qiHxCq6/Z5Depp9V3pvxEwDQYJKoZIhvcNAQELBQADggEBAGg4\n"
-    "atYFzlJJuXPM3hhVD8eZ7SJJ3JGfb0D6whaQW0MhcrfX+E3DdgR9STBb1C1CQFPS\n"
-    "YxI/DU7GAXsfqC+a2VTqkb7kUUwLvWQcm+sRSL93OTy+heuC1lU01E6EUEIYS6h6\n"
-    "x6d6GJ2ofOmrlNREJMnF34xZJQ30AErSukFjpEtaLCunWOmkgNvnnno4f5vSLOp0\n"
-    "VnItMfMpV796/2YIOT9KDSvqbv1AJZqtrJrdljKQGyATWgxAxMCrW0OzSdcDDpPj\n"
-    "lQx/MM6TSZS2JCZUgRaS9zOuQiqLSAgZ6CjLm+0YdGDYVWZOetGDT90hhGhq+DIk\n"
-    "HSxwIayMt37Qs8roi0o=\n"
-    "-----END CERTIFICATE-----\n";
-
-    const char cert_pem[] =
-    "-----BEGIN CERTIFICATE-----\n"
-    "MIIFFjCCAv6gAwIBAgIRAJErCErPDBinU/bWLiWnX1owDQYJKoZIhvcNAQELBQAw\n"
-    "TzELMAkGA1UEBhMCVVMxKTAnBgNVBAoTIEludGVybmV0IFNlY3VyaXR5IFJlc2Vh\n"
-    "cmNoIEdyb3VwMRUwEwYDVQQDEwxJU1JHIFJvb3QgWDEwHhcNMjAwOTA0MDAwMDAw\n"
-    "WhcNMjUwOTE1MTYwMDAwWjAyMQswCQYDVQQGEwJVUzEWMBQGA1UEChMNTGV0J3Mg\n"
-    "RW5jcnlwdDELMAkGA1UEAxMCUjMwggEiMA0GCSqGSIb3DQEBAQUAA4IBDwAwggEK\n"
-    "AoIBAQC7AhUozPaglNMPEuyNVZLD+ILxmaZ6QoinXSaqtSu5xUyxr45r+XXIo9cP\n"
-    "R5QUVTVXjJ6oojkZ9YI8QqlObvU7wy7bjcCwXPNZOOftz2nwWgsbvsCUJCWH+jdx\n"
-    "sxPnHKzhm+/b5DtFUkWWqcFTzjTIUu61ru2P3mBw4qVUq7ZtDpelQDRrK9O8Zutm\n"
-    "NHz6a4uPVymZ+DAXXbpyb/uBxa3Shlg9F8fnCbvxK/eG3MHacV3URuPMrSXBiLxg\n"
-    "Z3Vms/EY96Jc5lP/Ooi2R6X/ExjqmAl3P51T+c8B5fWmcBcUr2Ok/5mzk53cU6cG\n"
-    "/kiFHaFpriV1uxPMUgP17VGhi9sVAgMBAAGjggEIMIIBBDAOBgNVHQ8BAf8EBAMC\n"
-    "AYYwHQYDVR0lBBYwFAYIKwYBBQUHAwIGCCsGAQUFBwMBMBIGA1UdEwEB/wQIMAYB\n"
-    "Af8CAQAwHQYDVR0OBBYEFBQusxe3WFbLrlAJQOYfr52LFMLGMB8GA1UdIwQYMBaA\n"
-    "FHm0WeZ7tuXkAXOACIjIGlj26ZtuMDIGCCsGAQUFBwEBBCYwJDAiBggrBgEFBQcw\n"
-    "AoYWaHR0cDovL3gxLmkubGVuY3Iub3JnLzAnBgNVHR8EIDAeMBygGqAYhhZodHRw\n"
-    "Oi8veDEuYy5sZW5jci5vcmcvMCIGA1UdIAQbMBkwCAYGZ4EMAQIBMA0GCysGAQQB\n"
-    "gt8TAQEBMA0GCSqGSIb3DQEBCwUAA4ICAQCFyk5HPqP3hUSFvNVneLKYY611TR6W\n"
-    "PTNlclQtgaDqw+34IL9fzLdwALduO/ZelN7kIJ+m74uyA+eitRY8kc607TkC53wl\n"
-    "ikfmZW4/RvTZ8M6UK+5UzhK8jCdLuMGYL6KvzXGRSgi3yLgjewQtCPkIVz6D2QQz\n"
-    "CkcheAmCJ8MqyJu5zlzyZMjAvnnAT45tRAxekrsu94sQ4egdRCnbWSDtY7kh+BIm\n"
-    "lJNXoB1lBMEKIq4QDUOXoRgffuDghje1WrG9ML+Hbisq/yFOGwXD9RiX8F6sw6W4\n"
-    "avAuvDszue5L3sz85K+EC4Y/wFVDNvZo4TYXao6Z0f+lQKc0t8DQYzk1OXVu8rp2\n"
-    "yJMC6alLbBfODALZvYH7n7do1AZls4I9d1P4jnkDrQoxB3UqQ9hVl3LEKQ73xF1O\n"
-    "yK5GhDDX8oVfGKF5u+decIsH4YaTw7mP3GFxJSqv3+0lUFJoi5Lc5da149p90Ids\n"
-    "hCExroL1+7mryIkXPeFM5TgO9r0rvZaBFOvV2z0gp35Z0+L4WPlbuEjN/lxPFin+\n"
-    "HlUjr8gRsI3qfJOQFy/9rKIJR0Y/8Omwt/8oTWgy1mdeHmmjk7j1nYsvC9JSQ6Zv\n"
-    "MldlTTKB3zhThV1+XWYp6rjd5JW1zbVWEkLNxE7GJThEUG3szgBVGP7pSWTUTsqX\n"
-    "nLRbwHOoq7hHwg==\n"
-    "-----END CERTIFICATE-----\n";
-
-const char cert_pem2[] =
-"-----BEGIN CERTIFICATE-----\n"
-"MIIFBTCCAu2gAwIBAgIQS6hSk/eaL6JzBkuoBI110DANBgkqhkiG9w0BAQsFADBPMQswCQYDVQQGEwJVUzEpMCcGA1UEChMgSW50ZXJuZXQgU2VjdXJpdHkgUmVzZWFyY2ggR3JvdXAxFTATBgNVBAMTDElTUkcgUm9vdCBYMTAeFw0yNDAzMTMwMDAwMDBaFw0yNzAzMTIyMzU5NTlaMDMxCzAJBgNVBAYTAlVTMRYwFAYDVQQKEw1MZXQncyBFbmNyeXB0MQwwCgYDVQQDEwNSMTAwggEiMA0GCSqGSIb3DQEBAQUAA4IBDwAwggEKAoIBAQDPV+XmxFQS7bRH/sknWHZGUCiMHT6I3wWd1bUYKb3dtVq/+vbOo76vACFLYlpaPAEvxVgD9on/jhFD68G14BQHlo9vH9fnuoE5CXVlt8KvGFs3Jijno/QHK20a/6tYvJWuQP/py1fEtVt/eA0YYbwX51TGu0mRzW4Y0YCF7qZlNrx06rxQTOr8IfM4FpOUurDTazgGzRYSespSdcitdrLCnF2YRVxvYXvGLe48E1KGAdlX5jgc3421H5KRmudKHMxFqHJV8LDmowfs/acbZp4/SItxhHFYyTr6717yW0QrPHTnj7JHwQdqzZq3DZb3EoEmUVQK7GH29/Xi8orIlQ2NAgMBAAGjgfgwgfUwDgYDVR0PAQH/BAQDAgGGMB0GA1UdJQQWMBQGCCsGAQUFBwMCBggrBgEFBQcDATASBgNVHRMBAf8ECDAGAQH/AgEAMB0GA1UdDgQWBBS7vMNHpeS8qcbDpHIMEI2iNeHI6DAfBgNVHSMEGDAWgBR5tFnme7bl5AFzgAiIyBpY9umbbjAyBggrBgEFBQcBAQQmMCQwIgYIKwYBBQUHMAKGFmh0dHA6Ly94MS5pLmxlbmNyLm9yZy8wEwYDVR0gBAwwCjAIBgZngQwBAgEwJwYDVR0fBCAwHjAcoBqgGIYWaHR0cDovL3gxLmMubGVuY3Iub3JnLzANBgkqhkiG9w0BAQsFAAOCAgEAkrHnQTfreZ2B5s3iJeE6IOmQRJWjgVzPw139vaBw1bGWKCIL0vIozwzn1OZDjCQiHcFCktEJr59L9MhwTyAWsVrdAfYf+B9haxQnsHKNY67u4s5Lzzfdu6PUzeetUK29v+PsPmI2cJkxp+iN3epi4hKu9ZzUPSwMqtCceb7qPVxEbpYxY1p91n5PJKBLBX9eb9LU6l8zSxPWV7bK3lG4XaMJgnT9x3ies7msFtpKK5bDtotij/l0GaKeA97pb5uwD9KgWvaFXMIEt8jVTjLEvwRdvCn294GPDF08U8lAkIv7tghluaQh1QnlE4SEN4LOECj8dsIGJXpGUk3aU3KkJz9icKy+aUgA+2cP21uh6NcDIS3XyfaZQjmDQ993ChII8SXWupQZVBiIpcWO4RqZk3lr7Bz5MUCwzDIA359e57SSq5CCkY0N4B6Vulk7LktfwrdGNVI5BsC9qqxSwSKgRJeZ9wygIaehbHFHFhcBaMDKpiZlBHyzrsnnlFXCb5s8HKn5LsUgGvB24L7sGNZP2CX7dhHov+YhD+jozLW2p9W4959Bz2EiRmqDtmiXLnzqTpXbI+suyCsohKRg6Un0RC47+cpiVwHiXZAW+cn8eiNIjqbVgXLxKPpdzvvtTnOPlC7SQZSYmdunr3Bf9b77AiC/ZidstK36dRILKz7OA54=\n"
-"-----END CERTIFICATE-----\n";
-
-#endif // CERT_H
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef _DATA_H_
 #define _DATA_H_
 #include <stdbool.h>  // Add this to use 'bool' in C
+#include <stddef.h>
+#include <stdint.h>
 
 
 //void getBattery();
@@ -14,11 +16,50 @@ typedef struct {
     float crate;
 } BatteryStatus;
 
+// One sample of everything the device reports. Filled by take_reading() and shared by
+// every uplink (HTTPS POST, BLE beacon) so they all see the same values.
+typedef struct {
+    int moisture;            // %, 0-100
+    BatteryStatus battery;
+    bool usb_present;        // USB_DETECT (GPIO13) high
+    bool charging;           // MCP73831 STAT (GPIO14) low
+} SensorReading;
+
+// Register-unit form of a SensorReading for compact binary frames (BLE beacon, ESP-NOW).
+typedef struct {
+    uint8_t  moisture;       // %, clamped 0-100
+    uint8_t  power;          // READING_PWR_* flags
+    uint16_t soc_raw;        // MAX17048 SOC register, 1/256 %
+    int16_t  crate_raw;      // MAX17048 CRATE register, signed, 0.208 %/hr per LSB
+} PackedReading;
+
+#define READING_PWR_USB         0x01
+#define READING_PWR_CHARGING    0x02
+#define READING_PWR_BATT_STATUS 0x04
+
+void pack_reading(const SensorReading *reading, PackedReading *packed);
+void unpack_reading(const PackedReading *packed, SensorReading *reading);
+
+// The form fields the backend expects at /api/esp/data, escaped, into a streaming body
+// (body_writer.h). A NULL hostname or apiToken leaves that field out.
+struct body_writer;
+void write_reading_form(struct body_writer *w, const SensorReading *reading,
+                        const char *hostname, const char *sensorName,
+                        const char *sensorLocation, const char *apiToken);
+bool uploadReadings(const SensorReading *reading, const char *hostname,
+                    const char *sensorName, const char *sensorLocation, const char *apiToken);
+
 BatteryStatus getBattery();  // Declaration of getBattery function
 int readMoisture();  // Declaration of readMoisture function
 void check_update();
-void take_reading();  // Declaration of take_reading function
-void monitor();  // Declaration of battery_monitor function
-void monitor_task(void *pvParameters);  // runs monitor() in a task with a TLS-safe stack
+void take_reading(SensorReading *reading);  // I2C init (once) + fuel gauge + probe + power pins
+bool deliver_reading(const SensorReading *reading);  // upload + backlog; releases or defers the held reading
+
+// USB streaming mode (usb_stream.c): readings on one kept-alive upload connection.
+struct post_session;
+bool usb_power_present(void);   // USB_DETECT (GPIO13) high
+void soil_power_hold_off(void);  // sleep_mgr: probe load switch latched OFF for deep sleep
+bool upload_session_open(struct post_session *session);
+int  upload_session_send(struct post_session *session, const PackedReading *reading, uint32_t taken_at);
 
 #endif
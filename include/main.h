@@ -1,6 +1,9 @@
 #ifndef MAIN_H_
 #define MAIN_H_
+#include <stdbool.h>
 #include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 typedef struct __attribute__((aligned(4))) {
     uint8_t isProvisioned;
@@ -12,9 +15,12 @@ typedef struct __attribute__((aligned(4))) {
     char hostname[32];
     char apiToken[64];
     float battery_data;
+    uint8_t transport;          // uplink_transport_t from NVS, read once at boot
 } main_struct_t;
 
 
+#define BUTTON_GPIO 3   // V5: SW1 is on IO3 (RTC-capable, used for ext0 wake). Was GPIO6 (V4/legacy).
+
 typedef enum {
     ONE_MIN_SLEEP = 60,             // 1 minute
     FIVE_MIN_SLEEP = 300,           // 5 minutes
@@ -27,9 +33,18 @@ typedef enum {
 extern main_struct_t main_struct;
 
 void ble_advert(void);
-void enter_deep_sleep(uint32_t seconds);  // seconds; SleepDuration enum gives named constants
+void enter_deep_sleep(uint32_t seconds);     // 0 = no timer, button wake only
+void enter_micro_sleep(uint32_t seconds);   // sampler micro-wakes: no Wi-Fi/governor teardown
+// The one task that drives a wake (wake cycle, beacon, espnow node or gateway). They are
+// mutually exclusive per boot, so they share one slot whose stack is allocated once, at
+// the size of the role that runs. The sizes are what each role ran with as a dynamic
+// task; retune them from MEM_DIAG worst_hwm (mem_diag.h, MEM_DIAG_STACK_MARGIN).
+#define WAKE_STACK_CYCLE    16384   // HTTPS/MQTT/CoAP: TLS handshake + OTA
+#define WAKE_STACK_GATEWAY  8192    // Wi-Fi + batched HTTPS forward
+#define WAKE_STACK_NODE     6144    // ESP-NOW + CCM
+#define WAKE_STACK_BEACON   4096
+TaskHandle_t start_wake_task(TaskFunction_t fn, const char *name, uint32_t stack_bytes);
 void initialize_sntp();
-void wait_for_time_sync();
 
 
 #endif
\ No newline at end of file
@@ -1,7 +1,33 @@
 #ifndef _REST_METHODS_H
 #define _REST_METHODS_H
 
-    // Function declaration for POST
+#include "body_writer.h"
+
+    // POST a body produced by `emit` (see body_writer.h): exact Content-Length, streamed
+    // into the connection, no assembled copy. Returns the HTTP status, -1 on failure.
+    int POST_stream(const char* server_uri, const char* content_type, body_emit_fn emit, void *ctx);
+
+    // Function declaration for POST: an already-encoded form body
     int POST(const char* server_uri, const char* to_send);
 
+    // POST `count` form bodies, emit(ctxs[i]), to the same URI over ONE connection (HTTP
+    // keep-alive), so a batch pays for a single TCP+TLS handshake. Returns how many
+    // leading bodies the server answered (any status; codes in status_codes[] if
+    // non-NULL). Stops at the first transport error — the caller keeps the unanswered
+    // tail for the next batch.
+    int POST_batch(const char* server_uri, body_emit_fn emit, void *const *ctxs, int count, int* status_codes);
+
+    // A keep-alive connection held across requests for as long as the caller likes
+    // (POST_batch() uses one per batch; USB streaming keeps one for hours). A request
+    // that fails on a handle that already carried one is retried once on a fresh
+    // connection, since the server may simply have closed it while idle.
+    typedef struct post_session {
+        esp_http_client_handle_t client;
+        int requests;
+    } post_session_t;
+
+    bool POST_session_open(post_session_t *session, const char* server_uri, const char* content_type);
+    int  POST_session(post_session_t *session, body_emit_fn emit, void *ctx);   // HTTP status, -1 on failure
+    void POST_session_close(post_session_t *session);
+
 #endif // _REST_METHODS_H
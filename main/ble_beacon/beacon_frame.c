@@ -0,0 +1,158 @@
+#include <string.h>
+#include "beacon_frame.h"
+
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+static uint64_t load_le64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void store_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store_le32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint16_t load_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t load_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#define SIPROUND                                                        \
+    do {                                                                \
+        v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32);   \
+        v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2;                        \
+        v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0;                        \
+        v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32);   \
+    } while (0)
+
+uint64_t beacon_siphash(const uint8_t key[16], const uint8_t *data, size_t len) {
+    uint64_t k0 = load_le64(key);
+    uint64_t k1 = load_le64(key + 8);
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    const uint8_t *end = data + (len - (len % 8));
+    for (const uint8_t *p = data; p != end; p += 8) {
+        uint64_t m = load_le64(p);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    // Last block: remaining bytes plus the message length in the top byte.
+    uint64_t b = ((uint64_t)len) << 56;
+    for (size_t i = 0; i < len % 8; i++) {
+        b |= ((uint64_t)end[i]) << (8 * i);
+    }
+    v3 ^= b;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+void beacon_derive_key(const char *api_token, uint8_t key[BEACON_KEY_LEN]) {
+    // Two SipHash passes under fixed, distinct domain keys give the 128-bit device key.
+    static const uint8_t domain_lo[16] = "PlantPulseBcnK0";
+    static const uint8_t domain_hi[16] = "PlantPulseBcnK1";
+    size_t len = strlen(api_token);
+    uint64_t lo = beacon_siphash(domain_lo, (const uint8_t *)api_token, len);
+    uint64_t hi = beacon_siphash(domain_hi, (const uint8_t *)api_token, len);
+    for (int i = 0; i < 8; i++) {
+        key[i]     = (uint8_t)(lo >> (8 * i));
+        key[8 + i] = (uint8_t)(hi >> (8 * i));
+    }
+}
+
+size_t beacon_encode(const beacon_reading_t *reading, const uint8_t key[BEACON_KEY_LEN],
+                     uint8_t *out, size_t out_len) {
+    if (out_len < BEACON_MFG_LEN) {
+        return 0;
+    }
+    store_le16(&out[0], BEACON_COMPANY_ID);
+    out[2] = BEACON_FRAME_VERSION;
+    out[3] = reading->power;
+    memcpy(&out[4], reading->device_id, 4);
+    store_le32(&out[8], reading->seq);
+    out[12] = reading->moisture;
+    store_le16(&out[13], reading->soc_raw);
+    store_le16(&out[15], (uint16_t)reading->crate_raw);
+
+    uint64_t tag = beacon_siphash(key, out, BEACON_SIGNED_LEN);
+    for (int i = 0; i < BEACON_TAG_LEN; i++) {
+        out[BEACON_SIGNED_LEN + i] = (uint8_t)(tag >> (8 * i));
+    }
+    return BEACON_MFG_LEN;
+}
+
+beacon_status_t beacon_parse(const uint8_t *mfg, size_t len, beacon_reading_t *reading) {
+    if (len != BEACON_MFG_LEN) {
+        return BEACON_ERR_LEN;
+    }
+    if (load_le16(&mfg[0]) != BEACON_COMPANY_ID) {
+        return BEACON_ERR_COMPANY;
+    }
+    if (mfg[2] != BEACON_FRAME_VERSION) {
+        return BEACON_ERR_VERSION;
+    }
+    reading->power = mfg[3];
+    memcpy(reading->device_id, &mfg[4], 4);
+    reading->seq = load_le32(&mfg[8]);
+    reading->moisture = mfg[12];
+    reading->soc_raw = load_le16(&mfg[13]);
+    reading->crate_raw = (int16_t)load_le16(&mfg[15]);
+    return BEACON_OK;
+}
+
+beacon_status_t beacon_verify(const uint8_t *mfg, size_t len, const uint8_t key[BEACON_KEY_LEN]) {
+    if (len != BEACON_MFG_LEN) {
+        return BEACON_ERR_LEN;
+    }
+    uint64_t tag = beacon_siphash(key, mfg, BEACON_SIGNED_LEN);
+    uint8_t diff = 0;  // constant-time compare
+    for (int i = 0; i < BEACON_TAG_LEN; i++) {
+        diff |= mfg[BEACON_SIGNED_LEN + i] ^ (uint8_t)(tag >> (8 * i));
+    }
+    return diff == 0 ? BEACON_OK : BEACON_ERR_TAG;
+}
+
+const uint8_t *beacon_find_mfg_data(const uint8_t *adv, size_t adv_len, size_t *mfg_len) {
+    size_t pos = 0;
+    while (pos < adv_len) {
+        uint8_t field_len = adv[pos];          // covers the type byte + data
+        if (field_len == 0 || pos + 1 + field_len > adv_len) {
+            break;                             // padding or truncated structure
+        }
+        uint8_t type = adv[pos + 1];
+        const uint8_t *data = &adv[pos + 2];
+        size_t data_len = field_len - 1;
+        if (type == 0xFF && data_len >= 2 && load_le16(data) == BEACON_COMPANY_ID) {
+            *mfg_len = data_len;
+            return data;
+        }
+        pos += 1 + field_len;
+    }
+    return NULL;
+}
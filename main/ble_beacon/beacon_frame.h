@@ -0,0 +1,79 @@
+#ifndef BEACON_FRAME_H
+#define BEACON_FRAME_H
+
+// Wire format of the connectionless BLE telemetry beacon (TRANSPORT_BLE_BEACON).
+//
+// Pure C, no ESP-IDF headers: the firmware encodes with it and the host-side gateway
+// (tools/beacon_gateway) decodes with the very same file, so the two can't drift.
+//
+// Manufacturer-specific AD payload (type 0xFF), all multi-byte fields little-endian:
+//
+//   off len field
+//    0   2  company id          BEACON_COMPANY_ID
+//    2   1  version             BEACON_FRAME_VERSION
+//    3   1  power flags         BEACON_PWR_*
+//    4   4  device id           last 4 bytes of the Wi-Fi STA MAC (hostname suffix)
+//    8   4  sequence number     strictly increasing per device, survives deep sleep
+//   12   1  moisture            %, 0-100
+//   13   2  SoC                 MAX17048 SOC register, 1/256 %
+//   15   2  CRATE               MAX17048 CRATE register, signed, 0.208 %/hr per LSB
+//   17   8  tag                 SipHash-2-4 over bytes 0..16 with the device key
+//
+// 25 bytes + 2 (AD length/type) + 3 (flags AD) = 30 of the 31 legacy advertising bytes.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BEACON_COMPANY_ID      0xFFFF   // Bluetooth SIG "no company" id, for internal/test use
+#define BEACON_FRAME_VERSION   1
+#define BEACON_KEY_LEN         16
+#define BEACON_TAG_LEN         8
+#define BEACON_SIGNED_LEN      17       // bytes covered by the tag
+#define BEACON_MFG_LEN         (BEACON_SIGNED_LEN + BEACON_TAG_LEN)
+
+// Same bits as READING_PWR_* in data.h (this header stays free of firmware includes).
+#define BEACON_PWR_USB         0x01     // USB (VBUS) present
+#define BEACON_PWR_CHARGING    0x02     // charger STAT active
+#define BEACON_PWR_BATT_STATUS 0x04     // BatteryStatus.status as reported by getBattery()
+
+typedef struct {
+    uint8_t  power;          // BEACON_PWR_* flags
+    uint8_t  device_id[4];
+    uint32_t seq;
+    uint8_t  moisture;
+    uint16_t soc_raw;
+    int16_t  crate_raw;
+} beacon_reading_t;
+
+typedef enum {
+    BEACON_OK = 0,
+    BEACON_ERR_LEN = -1,       // not a PlantPulse frame (wrong length)
+    BEACON_ERR_COMPANY = -2,   // different manufacturer
+    BEACON_ERR_VERSION = -3,   // newer/older frame layout
+    BEACON_ERR_TAG = -4,       // signature mismatch (wrong key or tampered)
+} beacon_status_t;
+
+// Per-device 128-bit signing key, derived from the api_token the device was provisioned
+// with. The gateway holds the same token, so no extra secret has to be distributed.
+void beacon_derive_key(const char *api_token, uint8_t key[BEACON_KEY_LEN]);
+
+// Builds the manufacturer data (company id first) into out. Returns the number of bytes
+// written, or 0 if out_len is smaller than BEACON_MFG_LEN.
+size_t beacon_encode(const beacon_reading_t *reading, const uint8_t key[BEACON_KEY_LEN],
+                     uint8_t *out, size_t out_len);
+
+// Parses manufacturer data without checking the tag, so a gateway can read device_id
+// and look up the right key first. Then call beacon_verify().
+beacon_status_t beacon_parse(const uint8_t *mfg, size_t len, beacon_reading_t *reading);
+beacon_status_t beacon_verify(const uint8_t *mfg, size_t len, const uint8_t key[BEACON_KEY_LEN]);
+
+// Finds the PlantPulse manufacturer data inside a complete advertising payload (a run
+// of AD structures). Returns a pointer into adv and sets *mfg_len, or NULL.
+const uint8_t *beacon_find_mfg_data(const uint8_t *adv, size_t adv_len, size_t *mfg_len);
+
+// SipHash-2-4 (Aumasson & Bernstein). Short-input keyed PRF, a good fit for a MAC over
+// a 17-byte frame where a full HMAC-SHA256 tag would not fit in the advert.
+uint64_t beacon_siphash(const uint8_t key[16], const uint8_t *data, size_t len);
+
+#endif // BEACON_FRAME_H
@@ -0,0 +1,138 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_attr.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "main.h"
+#include "wake_governor.h"
+#include "data.h"
+#include "nvs_drv.h"
+#include "beacon_frame.h"
+#include "ble_beacon.h"
+
+static const char *TAG = "BEACON";
+
+#define BEACON_BURST_MS      1500   // how long each reading is on air before we sleep
+#define BEACON_ADV_ITVL_MS   100    // ~15 advertising events (x3 channels) per burst
+
+// The gateway rejects any seq <= the last one it accepted, so the counter must never
+// go backwards — see sequence_next().
+static RTC_DATA_ATTR rtc_sequence_t beacon_seq;
+
+static uint8_t adv_data[31];
+static uint8_t adv_len = 0;
+static uint8_t own_addr_type;
+static SemaphoreHandle_t burst_done;
+
+static void build_frame(const SensorReading *r, beacon_reading_t *frame) {
+    // Device id = last 4 bytes of the Wi-Fi STA MAC, i.e. the tail of the hostname the
+    // backend already knows (and of the "Plant Pulse XXXXXXXX" BLE name). Reading the
+    // efuse MAC doesn't need the Wi-Fi driver.
+    uint8_t mac[6] = {0};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    memcpy(frame->device_id, &mac[2], 4);
+
+    PackedReading packed;
+    pack_reading(r, &packed);
+    frame->moisture = packed.moisture;
+    frame->soc_raw = packed.soc_raw;
+    frame->crate_raw = packed.crate_raw;
+    frame->power = packed.power;   // READING_PWR_* == BEACON_PWR_*
+    // NVS_SEQUENCE_NAMESPACE: a factory reset doesn't restart it, so a gateway's saved
+    // replay state keeps accepting this device after re-provisioning.
+    frame->seq = sequence_next(&beacon_seq, "beacon_seq");
+}
+
+static int beacon_gap_event(struct ble_gap_event *event, void *arg) {
+    if (event->type == BLE_GAP_EVENT_ADV_COMPLETE) {
+        ESP_LOGI(TAG, "Burst complete (reason=%d)", event->adv_complete.reason);
+        xSemaphoreGive(burst_done);
+    }
+    return 0;
+}
+
+static void beacon_on_sync(void) {
+    ble_hs_id_infer_auto(0, &own_addr_type);
+
+    int rc = ble_gap_adv_set_data(adv_data, adv_len);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to set advertising data, error code %d", rc);
+        xSemaphoreGive(burst_done);
+        return;
+    }
+
+    // Broadcaster only: non-connectable, non-discoverable, fixed duration.
+    struct ble_gap_adv_params adv_params;
+    memset(&adv_params, 0, sizeof(adv_params));
+    adv_params.conn_mode = BLE_GAP_CONN_MODE_NON;
+    adv_params.disc_mode = BLE_GAP_DISC_MODE_NON;
+    adv_params.itvl_min = BLE_GAP_ADV_ITVL_MS(BEACON_ADV_ITVL_MS);
+    adv_params.itvl_max = BLE_GAP_ADV_ITVL_MS(BEACON_ADV_ITVL_MS);
+
+    rc = ble_gap_adv_start(own_addr_type, NULL, BEACON_BURST_MS, &adv_params, beacon_gap_event, NULL);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Failed to start advertising, error code %d", rc);
+        xSemaphoreGive(burst_done);
+    }
+}
+
+static void beacon_host_task(void *param) {
+    nimble_port_run();   // returns after nimble_port_stop()
+    nimble_port_freertos_deinit();
+}
+
+void beacon_task(void *pvParameters) {
+    SensorReading reading;
+    governor_enter(WAKE_PHASE_SENSE);
+    take_reading(&reading);
+    governor_enter(WAKE_PHASE_UPLOAD);
+
+    beacon_reading_t frame;
+    build_frame(&reading, &frame);
+    if (frame.seq == 0) {
+        // No reserved seq: a repeat of an earlier one would be dropped as a replay anyway.
+        ESP_LOGE(TAG, "No sequence number reserved — reading dropped");
+        enter_deep_sleep(nvs_get_sleep_seconds());
+    }
+
+    uint8_t key[BEACON_KEY_LEN];
+    beacon_derive_key(main_struct.apiToken, key);
+
+    uint8_t mfg[BEACON_MFG_LEN];
+    beacon_encode(&frame, key, mfg, sizeof(mfg));
+
+    adv_len = 0;
+    adv_data[adv_len++] = 2;                    // Flags AD
+    adv_data[adv_len++] = 0x01;
+    adv_data[adv_len++] = 0x04;                 // BR/EDR not supported (not discoverable)
+    adv_data[adv_len++] = 1 + sizeof(mfg);      // Manufacturer-specific AD
+    adv_data[adv_len++] = 0xFF;
+    memcpy(&adv_data[adv_len], mfg, sizeof(mfg));
+    adv_len += sizeof(mfg);
+
+    ESP_LOGI(TAG, "seq=%lu moisture=%u soc_raw=%u crate_raw=%d power=0x%02x",
+             (unsigned long)frame.seq, frame.moisture, frame.soc_raw, frame.crate_raw, frame.power);
+
+    burst_done = xSemaphoreCreateBinary();
+    esp_err_t err = nimble_port_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nimble_port_init failed: %s", esp_err_to_name(err));
+    } else {
+        ble_hs_cfg.sync_cb = beacon_on_sync;
+        nimble_port_freertos_init(beacon_host_task);
+
+        // Bounded wait: if the controller never syncs we still go back to sleep rather
+        // than sit awake with the radio on.
+        if (xSemaphoreTake(burst_done, pdMS_TO_TICKS(BEACON_BURST_MS + 3000)) != pdTRUE) {
+            ESP_LOGW(TAG, "Burst did not complete in time");
+        }
+    }
+
+    enter_deep_sleep(nvs_get_sleep_seconds());
+    vTaskDelete(NULL);
+}
@@ -0,0 +1,9 @@
+#ifndef BLE_BEACON_H
+#define BLE_BEACON_H
+
+// Connectionless telemetry (TRANSPORT_BLE_BEACON): take one reading, broadcast it as a
+// signed manufacturer-data advert for a short burst, then deep-sleep. Wi-Fi is never
+// started. Frame layout lives in beacon_frame.h.
+void beacon_task(void *pvParameters);
+
+#endif // BLE_BEACON_H
@@ -0,0 +1,146 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host/ble_hs.h"
+#include "host/ble_gap.h"
+#include "reading_backlog.h"
+#include "bulk_stream.h"
+#include "ble_bulk.h"
+
+static const char *TAG = "BLE_BULK";
+
+#define BULK_MTU_MAX     256    // what ble_advert() asks for; caps the frame buffers below
+#define BULK_TX_OCTETS   251    // data length extension: one LL PDU per 251 bytes
+#define BULK_TX_TIME_US  2120   // max for 251 octets on 1M; the controller scales it for 2M
+
+uint16_t ble_bulk_attr_handle;
+
+static bulk_tx_t tx;
+static uint16_t conn = BLE_HS_CONN_HANDLE_NONE;
+static int64_t started_us;
+static uint32_t started_seq;
+
+// A transfer is mostly airtime: ask for the 2M PHY and long LL packets. Both are
+// requests; the phone may refuse either and the stream still works, just slower.
+static void tune_link(uint16_t conn_handle) {
+    int rc = ble_gap_set_prefered_le_phy(conn_handle, BLE_GAP_LE_PHY_2M_MASK,
+                                         BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_CODED_ANY);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "2M PHY request failed: %d", rc);
+    }
+    rc = ble_gap_set_data_len(conn_handle, BULK_TX_OCTETS, BULK_TX_TIME_US);
+    if (rc != 0) {
+        ESP_LOGW(TAG, "Data length request failed: %d", rc);
+    }
+}
+
+// Sends frames until the window is full or NimBLE runs out of mbufs; the NOTIFY_TX
+// event for each sent frame calls this again.
+static void pump(void) {
+    uint32_t first;
+    size_t count;
+    bulk_tx_action_t action;
+    while ((action = bulk_tx_poll(&tx, &first, &count)) != BULK_TX_IDLE) {
+        uint8_t frame[BULK_MTU_MAX];
+        size_t len;
+        if (action == BULK_TX_DATA) {
+            BacklogEntry entries[(BULK_MTU_MAX - 3 - BULK_DATA_HDR_LEN) / BULK_RECORD_LEN];
+            bulk_record_t records[sizeof(entries) / sizeof(entries[0])];
+            count = backlog_peek_seq(first, entries, count);
+            if (count == 0) {
+                ESP_LOGW(TAG, "Reading %lu left the backlog mid-transfer", (unsigned long)first);
+                tx.active = false;
+                return;
+            }
+            for (size_t i = 0; i < count; i++) {
+                records[i] = (bulk_record_t){
+                    .taken_at = entries[i].taken_at,
+                    .moisture = entries[i].reading.moisture,
+                    .power = entries[i].reading.power,
+                    .soc_raw = entries[i].reading.soc_raw,
+                    .crate_raw = entries[i].reading.crate_raw,
+                };
+            }
+            len = bulk_encode_data(first, records, count, frame, sizeof(frame));
+        } else {
+            len = bulk_encode_end(first, backlog_overwritten(), frame, sizeof(frame));
+        }
+
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(frame, len);
+        if (om == NULL) {
+            return;                       // mbuf pool empty: retried on the next NOTIFY_TX
+        }
+        if (ble_gattc_notify_custom(conn, ble_bulk_attr_handle, om) != 0) {
+            return;                       // consumed om either way
+        }
+        bulk_tx_sent(&tx, action, count);
+
+        if (action == BULK_TX_END) {
+            uint32_t n = first - started_seq;
+            uint32_t ms = (uint32_t)((esp_timer_get_time() - started_us) / 1000);
+            ESP_LOGI(TAG, "Sent %lu readings in %lu ms (%lu/s), MTU %u", (unsigned long)n,
+                     (unsigned long)ms, (unsigned long)(ms ? n * 1000 / ms : n),
+                     ble_att_mtu(conn));
+        }
+    }
+}
+
+int ble_bulk_access(uint16_t conn_handle, uint16_t attr_handle,
+                    struct ble_gatt_access_ctxt *ctxt, void *arg) {
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+    uint8_t buf[8];
+    uint16_t len = 0;
+    bulk_ctrl_t ctrl;
+    if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0 ||
+        !bulk_decode_ctrl(buf, len, &ctrl)) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+
+    switch (ctrl.op) {
+    case BULK_OP_START: {
+        uint16_t mtu = ble_att_mtu(conn_handle);
+        uint32_t first = backlog_first_seq();
+        conn = conn_handle;
+        tune_link(conn_handle);
+        bulk_tx_start(&tx, &ctrl, first, first + (uint32_t)backlog_count(),
+                      mtu < BULK_MTU_MAX ? mtu : BULK_MTU_MAX);
+        started_us = esp_timer_get_time();
+        started_seq = tx.next_seq;
+        ESP_LOGI(TAG, "Transfer of %lu..%lu, window %u x %u readings",
+                 (unsigned long)tx.next_seq, (unsigned long)tx.end_seq, tx.window, tx.per_frame);
+        break;
+    }
+    case BULK_OP_ACK:
+        bulk_tx_ack(&tx, ctrl.seq);
+        break;
+    case BULK_OP_COMMIT:
+        // Only what the app acknowledged: it may not claim readings it never got.
+        if (ctrl.seq > tx.acked_seq) {
+            ctrl.seq = tx.acked_seq;
+        }
+        backlog_drop_before(ctrl.seq);
+        ESP_LOGI(TAG, "App stored readings before %lu; %u left in the backlog",
+                 (unsigned long)ctrl.seq, (unsigned)backlog_count());
+        break;
+    case BULK_OP_STOP:
+        tx.active = false;
+        break;
+    }
+    pump();
+    return 0;
+}
+
+void ble_bulk_on_notify_tx(const struct ble_gap_event *event) {
+    if (event->notify_tx.attr_handle == ble_bulk_attr_handle &&
+        event->notify_tx.conn_handle == conn) {
+        pump();
+    }
+}
+
+void ble_bulk_on_disconnect(void) {
+    // Unacknowledged frames are simply sent again after the app's next START.
+    tx.active = false;
+    conn = BLE_HS_CONN_HANDLE_NONE;
+}
@@ -0,0 +1,22 @@
+#ifndef BLE_BULK_H
+#define BLE_BULK_H
+
+// Bulk backlog transfer to the phone app on the provisioning GATT service. When Wi-Fi
+// has been down long enough for the re-provisioning window to open, the app can pull
+// the buffered readings and forward them to the backend itself. Protocol and flow
+// control are in bulk_stream.h; this file is the NimBLE side. It runs entirely on the
+// NimBLE host task (access callback and GAP events), so it needs no locking.
+
+#include <stdint.h>
+#include "host/ble_hs.h"
+
+#define BULK_CHR_UUID 0xFEF4
+
+extern uint16_t ble_bulk_attr_handle;
+
+int  ble_bulk_access(uint16_t conn_handle, uint16_t attr_handle,
+                     struct ble_gatt_access_ctxt *ctxt, void *arg);
+void ble_bulk_on_notify_tx(const struct ble_gap_event *event);   // BLE_GAP_EVENT_NOTIFY_TX
+void ble_bulk_on_disconnect(void);
+
+#endif // BLE_BULK_H
@@ -0,0 +1,214 @@
+#include <string.h>
+#include "bulk_stream.h"
+
+#define ATT_NOTIFY_OVERHEAD 3   // opcode + attribute handle
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+size_t bulk_records_per_frame(uint16_t mtu) {
+    if (mtu < ATT_NOTIFY_OVERHEAD + BULK_DATA_HDR_LEN + BULK_RECORD_LEN) {
+        return 0;
+    }
+    size_t n = (mtu - ATT_NOTIFY_OVERHEAD - BULK_DATA_HDR_LEN) / BULK_RECORD_LEN;
+    return n > 255 ? 255 : n;   // count is one byte
+}
+
+size_t bulk_encode_data(uint32_t first_seq, const bulk_record_t *records, size_t count,
+                        uint8_t *out, size_t out_len) {
+    size_t len = BULK_DATA_HDR_LEN + count * BULK_RECORD_LEN;
+    if (count == 0 || count > 255 || len > out_len) {
+        return 0;
+    }
+    out[0] = BULK_OP_DATA;
+    put_le32(out + 1, first_seq);
+    out[5] = (uint8_t)count;
+    uint8_t *p = out + BULK_DATA_HDR_LEN;
+    for (size_t i = 0; i < count; i++, p += BULK_RECORD_LEN) {
+        put_le32(p, records[i].taken_at);
+        p[4] = records[i].moisture;
+        p[5] = records[i].power;
+        put_le16(p + 6, records[i].soc_raw);
+        put_le16(p + 8, (uint16_t)records[i].crate_raw);
+    }
+    return len;
+}
+
+size_t bulk_encode_end(uint32_t end_seq, uint32_t lost, uint8_t *out, size_t out_len) {
+    if (out_len < BULK_END_LEN) {
+        return 0;
+    }
+    out[0] = BULK_OP_END;
+    put_le32(out + 1, end_seq);
+    put_le32(out + 5, lost);
+    return BULK_END_LEN;
+}
+
+size_t bulk_encode_ctrl(const bulk_ctrl_t *ctrl, uint8_t *out, size_t out_len) {
+    size_t len = ctrl->op == BULK_OP_STOP ? 1 : ctrl->op == BULK_OP_START ? 6 : 5;
+    if (out_len < len) {
+        return 0;
+    }
+    out[0] = ctrl->op;
+    if (len > 1) {
+        put_le32(out + 1, ctrl->seq);
+    }
+    if (len > 5) {
+        out[5] = ctrl->window;
+    }
+    return len;
+}
+
+bool bulk_decode_ctrl(const uint8_t *in, size_t len, bulk_ctrl_t *ctrl) {
+    if (len < 1) {
+        return false;
+    }
+    memset(ctrl, 0, sizeof(*ctrl));
+    ctrl->op = in[0];
+    switch (ctrl->op) {
+    case BULK_OP_START:
+        if (len != 6) {
+            return false;
+        }
+        ctrl->seq = get_le32(in + 1);
+        ctrl->window = in[5];
+        return true;
+    case BULK_OP_ACK:
+    case BULK_OP_COMMIT:
+        if (len != 5) {
+            return false;
+        }
+        ctrl->seq = get_le32(in + 1);
+        return true;
+    case BULK_OP_STOP:
+        return len == 1;
+    default:
+        return false;
+    }
+}
+
+void bulk_tx_start(bulk_tx_t *tx, const bulk_ctrl_t *start, uint32_t first_seq, uint32_t end_seq,
+                   uint16_t mtu) {
+    uint32_t seq = start->seq;
+    if (seq < first_seq) {
+        seq = first_seq;         // 0, or readings that were dropped meanwhile
+    } else if (seq > end_seq) {
+        seq = end_seq;
+    }
+    uint8_t window = start->window;
+    if (window == 0) {
+        window = 1;
+    } else if (window > BULK_MAX_WINDOW) {
+        window = BULK_MAX_WINDOW;
+    }
+    tx->active = true;
+    tx->end_sent = false;
+    tx->next_seq = seq;
+    tx->acked_seq = seq;
+    tx->end_seq = end_seq;
+    tx->window = window;
+    tx->per_frame = (uint16_t)bulk_records_per_frame(mtu);
+}
+
+void bulk_tx_ack(bulk_tx_t *tx, uint32_t seq) {
+    if (tx->active && seq > tx->acked_seq && seq <= tx->next_seq) {
+        tx->acked_seq = seq;
+    }
+}
+
+bulk_tx_action_t bulk_tx_poll(const bulk_tx_t *tx, uint32_t *first_seq, size_t *count) {
+    if (!tx->active || tx->per_frame == 0) {
+        return BULK_TX_IDLE;
+    }
+    if (tx->next_seq < tx->end_seq) {
+        uint32_t limit = (uint32_t)tx->window * tx->per_frame;
+        uint32_t in_flight = tx->next_seq - tx->acked_seq;
+        if (in_flight >= limit) {
+            return BULK_TX_IDLE;
+        }
+        uint32_t n = tx->end_seq - tx->next_seq;
+        if (n > tx->per_frame) {
+            n = tx->per_frame;
+        }
+        if (n > limit - in_flight) {
+            n = limit - in_flight;
+        }
+        *first_seq = tx->next_seq;
+        *count = n;
+        return BULK_TX_DATA;
+    }
+    if (tx->acked_seq == tx->end_seq && !tx->end_sent) {
+        *first_seq = tx->end_seq;
+        *count = 0;
+        return BULK_TX_END;
+    }
+    return BULK_TX_IDLE;
+}
+
+void bulk_tx_sent(bulk_tx_t *tx, bulk_tx_action_t action, size_t count) {
+    if (action == BULK_TX_DATA) {
+        tx->next_seq += (uint32_t)count;
+    } else if (action == BULK_TX_END) {
+        tx->end_sent = true;
+    }
+}
+
+bulk_rx_status_t bulk_rx_frame(bulk_rx_t *rx, const uint8_t *in, size_t len,
+                               bulk_record_t *records, size_t max, size_t *count) {
+    *count = 0;
+    if (!rx->synced && len >= 5 && (in[0] == BULK_OP_DATA || in[0] == BULK_OP_END)) {
+        rx->expected_seq = get_le32(in + 1);
+        rx->synced = true;
+    }
+    if (len == BULK_END_LEN && in[0] == BULK_OP_END) {
+        if (get_le32(in + 1) != rx->expected_seq) {
+            return BULK_RX_GAP;
+        }
+        rx->lost = get_le32(in + 5);
+        return BULK_RX_END;
+    }
+    if (len < BULK_DATA_HDR_LEN || in[0] != BULK_OP_DATA ||
+        len != BULK_DATA_HDR_LEN + (size_t)in[5] * BULK_RECORD_LEN) {
+        return BULK_RX_BAD;
+    }
+    uint32_t first = get_le32(in + 1);
+    size_t n = in[5];
+    if (first > rx->expected_seq) {
+        return BULK_RX_GAP;
+    }
+    // After a rewind the sender may repeat records we already have: keep the new tail.
+    size_t skip = rx->expected_seq - first;
+    if (skip >= n) {
+        return BULK_RX_OK;
+    }
+    const uint8_t *p = in + BULK_DATA_HDR_LEN + skip * BULK_RECORD_LEN;
+    size_t take = n - skip;
+    if (take > max) {
+        return BULK_RX_BAD;
+    }
+    for (size_t i = 0; i < take; i++, p += BULK_RECORD_LEN) {
+        records[i].taken_at = get_le32(p);
+        records[i].moisture = p[4];
+        records[i].power = p[5];
+        records[i].soc_raw = get_le16(p + 6);
+        records[i].crate_raw = (int16_t)get_le16(p + 8);
+    }
+    rx->expected_seq += (uint32_t)take;
+    *count = take;
+    return BULK_RX_OK;
+}
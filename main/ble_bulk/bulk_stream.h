@@ -0,0 +1,107 @@
+#ifndef BULK_STREAM_H
+#define BULK_STREAM_H
+
+// Wire format and flow control for the bulk backlog transfer on the provisioning GATT
+// service (0xFEF3, characteristic BULK_CHR_UUID in ble_bulk.h).
+//
+// Pure C, no ESP-IDF headers: ble_bulk.c sends with it and tools/ble_bulk_sim runs the
+// same sender against the reference receiver below, so the two can't drift.
+//
+// Every backlog entry has a sequence number that keeps naming the same reading while
+// older ones are dropped (reading_backlog.h), so a transfer can resume after a
+// disconnect from the first number the app doesn't have yet.
+//
+// App -> device (write to the characteristic), all integers little-endian:
+//   START  01 seq(4) window(1)   stream from seq (0 = oldest); window = frames in flight
+//   ACK    02 seq(4)             app holds everything before seq
+//   COMMIT 03 seq(4)             app stored everything before seq; device may drop it
+//   STOP   04
+//
+// Device -> app (notifications):
+//   DATA   81 first_seq(4) count(1) then count records of BULK_RECORD_LEN:
+//          taken_at(4) moisture(1) power(1) soc_raw(2) crate_raw(2)
+//   END    82 end_seq(4) lost(4)   all records before end_seq sent and acked; lost =
+//                                  readings overwritten by backlog overflow since power-on
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BULK_OP_START   0x01
+#define BULK_OP_ACK     0x02
+#define BULK_OP_COMMIT  0x03
+#define BULK_OP_STOP    0x04
+#define BULK_OP_DATA    0x81
+#define BULK_OP_END     0x82
+
+#define BULK_DATA_HDR_LEN  6
+#define BULK_END_LEN       9
+#define BULK_RECORD_LEN    10
+#define BULK_MAX_WINDOW    16
+
+typedef struct {
+    uint32_t taken_at;       // unix seconds, 0 if the clock wasn't set
+    uint8_t  moisture;       // %
+    uint8_t  power;          // READING_PWR_* flags
+    uint16_t soc_raw;        // MAX17048 SOC register
+    int16_t  crate_raw;      // MAX17048 CRATE register
+} bulk_record_t;
+
+typedef struct {
+    uint8_t  op;
+    uint32_t seq;
+    uint8_t  window;
+} bulk_ctrl_t;
+
+// Records that fit in one notification for a given ATT MTU (payload = MTU - 3).
+size_t bulk_records_per_frame(uint16_t mtu);
+
+size_t bulk_encode_data(uint32_t first_seq, const bulk_record_t *records, size_t count,
+                        uint8_t *out, size_t out_len);
+size_t bulk_encode_end(uint32_t end_seq, uint32_t lost, uint8_t *out, size_t out_len);
+size_t bulk_encode_ctrl(const bulk_ctrl_t *ctrl, uint8_t *out, size_t out_len);
+bool   bulk_decode_ctrl(const uint8_t *in, size_t len, bulk_ctrl_t *ctrl);
+
+// Sender. Go-back-N with cumulative acks: at most window * per_frame records are
+// unacknowledged, and a START rewinds to wherever the app says it is.
+typedef struct {
+    bool     active;
+    bool     end_sent;
+    uint32_t next_seq;       // next record to send
+    uint32_t acked_seq;      // everything before this is confirmed
+    uint32_t end_seq;        // one past the newest record when the transfer started
+    uint8_t  window;         // frames
+    uint16_t per_frame;      // records
+} bulk_tx_t;
+
+typedef enum {
+    BULK_TX_IDLE = 0,        // nothing to send until an ACK/START arrives
+    BULK_TX_DATA,            // send *count records from *first_seq
+    BULK_TX_END,             // send the END frame
+} bulk_tx_action_t;
+
+// first_seq/end_seq: what the backlog holds right now.
+void bulk_tx_start(bulk_tx_t *tx, const bulk_ctrl_t *start, uint32_t first_seq, uint32_t end_seq,
+                   uint16_t mtu);
+void bulk_tx_ack(bulk_tx_t *tx, uint32_t seq);
+bulk_tx_action_t bulk_tx_poll(const bulk_tx_t *tx, uint32_t *first_seq, size_t *count);
+void bulk_tx_sent(bulk_tx_t *tx, bulk_tx_action_t action, size_t count);   // after a successful notify
+
+// Reference receiver (the app's side; used by the host simulator).
+typedef enum {
+    BULK_RX_OK = 0,          // *count new records (possibly 0: a repeat), in order
+    BULK_RX_END,             // transfer complete
+    BULK_RX_GAP,             // frame doesn't start where expected: send START(expected)
+    BULK_RX_BAD,             // malformed
+} bulk_rx_status_t;
+
+typedef struct {
+    bool     synced;         // false: take the first frame's seq (after START with seq 0)
+    uint32_t expected_seq;
+    uint32_t lost;           // from the END frame
+} bulk_rx_t;
+
+bulk_rx_status_t bulk_rx_frame(bulk_rx_t *rx, const uint8_t *in, size_t len,
+                               bulk_record_t *records, size_t max, size_t *count);
+
+#endif // BULK_STREAM_H
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <string.h>
+#include <netdb.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/md.h"
+#include "coap3/coap.h"
+#include "main.h"
+#include "nvs_drv.h"
+#include "body_writer.h"
+#include "fuel_gauge.h"
+#include "sleep_mgr.h"
+#include "mem_diag.h"
+#include "reading_backlog.h"
+#include "report_filter.h"
+#include "sampler.h"
+#include "ts_codec.h"
+#include "wake_governor.h"
+#include "coap_link.h"
+
+static const char *TAG = "COAP";
+
+#define COAP_PSK_LEN            16
+#define COAP_PSK_LABEL          "plantpulse-coap-psk-v1"
+#define COAP_MIN_ATTEMPT_MS     3000    // don't start an exchange the wake governor would cut off
+#define COAP_MAX_RETRANSMIT     2       // 2 s, 4 s, 8 s (x1-1.5): the budget ends it sooner anyway
+#define COAP_BLOCK_BYTES        256     // a lost block costs one short retransmit, not the whole body
+#define COAP_BODY_MAX           1536    // form body at its worst case, see emit_reading()
+#define COAP_FORMAT_FORM        65000   // x-www-form-urlencoded (experimental-use number)
+#define COAP_POLL_MS            100
+
+// Outcome of the exchange in flight: 0 while waiting, the response code as class*100 +
+// detail (204 = 2.04), or -1 if it was given up (no ACK, DTLS failure). Written by the
+// handlers, which coap_io_process() runs in this task.
+static int exchange_result;
+static int64_t dtls_up_us;
+
+static coap_response_t on_response(coap_session_t *session, const coap_pdu_t *sent,
+                                   const coap_pdu_t *received, const coap_mid_t mid) {
+    coap_pdu_code_t code = coap_pdu_get_code(received);
+    exchange_result = COAP_RESPONSE_CLASS(code) * 100 + (code & 0x1F);
+    return COAP_RESPONSE_OK;
+}
+
+static void on_nack(coap_session_t *session, const coap_pdu_t *sent,
+                    const coap_nack_reason_t reason, const coap_mid_t mid) {
+    ESP_LOGW(TAG, "Request given up (reason %d)", (int)reason);
+    exchange_result = -1;
+}
+
+static int on_event(coap_session_t *session, const coap_event_t event) {
+    switch (event) {
+    case COAP_EVENT_DTLS_CONNECTED:
+        dtls_up_us = esp_timer_get_time();
+        break;
+    case COAP_EVENT_DTLS_ERROR:
+    case COAP_EVENT_DTLS_CLOSED:
+    case COAP_EVENT_SESSION_FAILED:
+        ESP_LOGE(TAG, "Session failed (event 0x%x)", (unsigned)event);
+        exchange_result = -1;
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static uint32_t budget_left_ms(void) {
+    uint32_t left = governor_remaining_ms();
+    return left == UINT32_MAX ? 30000 : left;
+}
+
+static bool derive_psk(uint8_t key[COAP_PSK_LEN]) {
+    uint8_t mac[32];
+    const mbedtls_md_info_t *sha256 = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    if (mbedtls_md_hmac(sha256, (const uint8_t *)main_struct.apiToken, strlen(main_struct.apiToken),
+                        (const uint8_t *)COAP_PSK_LABEL, strlen(COAP_PSK_LABEL), mac) != 0) {
+        return false;
+    }
+    memcpy(key, mac, COAP_PSK_LEN);
+    return true;
+}
+
+static bool resolve(const coap_uri_t *uri, coap_address_t *dst) {
+    char host[64];
+    if (uri->host.length >= sizeof(host)) {
+        return false;
+    }
+    memcpy(host, uri->host.s, uri->host.length);
+    host[uri->host.length] = '\0';
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_DGRAM }, *res;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0 || res == NULL) {
+        ESP_LOGE(TAG, "DNS lookup for %s failed", host);
+        return false;
+    }
+    coap_address_init(dst);
+    dst->size = sizeof(dst->addr.sin);
+    memcpy(&dst->addr.sin, res->ai_addr, sizeof(dst->addr.sin));
+    freeaddrinfo(res);
+    coap_address_set_port(dst, uri->port);
+    return true;
+}
+
+typedef struct {
+    const SensorReading *reading;
+    bool secured;             // DTLS identity stands in for hostname and token
+    bool extras;              // aggregates, skip count, alerts, sleep totals, mem figures
+} coap_body_t;
+
+// The same fields as emit_reading() in data.c builds for this wake's reading. Worst case,
+// every user-text byte percent-encoded: token, hostname, name and location ~700 bytes
+// with the fixed fields, aggregates 2 x ~85, skipped ~20, batt_alert ~60, sleep ~200,
+// mem ~280 (its separators escape too) - about 1430, hence COAP_BODY_MAX.
+static void emit_reading(body_writer_t *w, void *ctx) {
+    const coap_body_t *b = ctx;
+    write_reading_form(w, b->reading, b->secured ? NULL : main_struct.hostname, main_struct.name,
+                       main_struct.location, b->secured ? NULL : main_struct.apiToken);
+    if (!b->extras) {
+        return;
+    }
+    sampler_write(w);
+    report_filter_write(w);
+    fuel_gauge_write(w);
+    sleep_mgr_write(w);
+    char mem[192];
+    if (mem_diag_format(mem, sizeof(mem)) > 0) {
+        bw_form(w, "mem", mem);
+    }
+}
+
+// One confirmable POST to /api/esp/<leaf>[?query]; libcoap adds Block1 when data is
+// larger than COAP_BLOCK_BYTES. Returns the response code (see exchange_result) or 0 on
+// timeout.
+static int post(coap_context_t *ctx, coap_session_t *session, const char *leaf, const char *query,
+                uint16_t format, const uint8_t *data, size_t len, int64_t deadline_us) {
+    coap_pdu_t *pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_POST, session);
+    if (pdu == NULL) {
+        return -1;
+    }
+    uint8_t token[8];
+    size_t token_len;
+    coap_session_new_token(session, &token_len, token);
+    coap_add_token(pdu, token_len, token);
+    coap_add_option(pdu, COAP_OPTION_URI_PATH, 3, (const uint8_t *)"api");
+    coap_add_option(pdu, COAP_OPTION_URI_PATH, 3, (const uint8_t *)"esp");
+    coap_add_option(pdu, COAP_OPTION_URI_PATH, strlen(leaf), (const uint8_t *)leaf);
+    uint8_t buf[4];
+    coap_add_option(pdu, COAP_OPTION_CONTENT_FORMAT, coap_encode_var_safe(buf, sizeof(buf), format), buf);
+    if (query) {
+        coap_add_option(pdu, COAP_OPTION_URI_QUERY, strlen(query), (const uint8_t *)query);
+    }
+    if (!coap_add_data_large_request(session, pdu, len, data, NULL, NULL)) {
+        coap_delete_pdu(pdu);
+        return -1;
+    }
+
+    exchange_result = 0;
+    if (coap_send(session, pdu) == COAP_INVALID_MID) {
+        return -1;
+    }
+    while (exchange_result == 0) {
+        int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        if (left_ms <= 0) {
+            break;
+        }
+        coap_io_process(ctx, left_ms < COAP_POLL_MS ? (uint32_t)left_ms : COAP_POLL_MS);
+    }
+    return exchange_result;
+}
+
+static bool success(int code) {
+    return code == 201 || code == 204;
+}
+
+// The backlog as one ts_codec series, as upload_backlog_series() in data.c sends it.
+// The body is the bare series; without DTLS the hostname goes in a Uri-Query. Buffers
+// live on the wake task's stack; the exchange finishes (or is abandoned with the context)
+// before they go out of scope.
+static size_t send_backlog(coap_context_t *ctx, coap_session_t *session, bool secured,
+                           int64_t deadline_us) {
+    BacklogEntry entries[READING_BACKLOG_CAPACITY];
+    ts_sample_t samples[READING_BACKLOG_CAPACITY];
+    uint8_t packed[TS_CODEC_MAX_BYTES(READING_BACKLOG_CAPACITY)];
+
+    size_t n = backlog_peek_many(entries, READING_BACKLOG_CAPACITY);
+    for (size_t i = 0; i < n; i++) {
+        samples[i].taken_at  = entries[i].taken_at;
+        samples[i].moisture  = entries[i].reading.moisture;
+        samples[i].power     = entries[i].reading.power;
+        samples[i].soc_raw   = entries[i].reading.soc_raw;
+        samples[i].crate_raw = entries[i].reading.crate_raw;
+    }
+    int len = n > 0 ? ts_encode(samples, n, packed, sizeof(packed)) : -1;
+    if (len < 0) {
+        return 0;
+    }
+    char query[48];
+    snprintf(query, sizeof(query), "hostname=%s", main_struct.hostname);
+    int code = post(ctx, session, "series", secured ? NULL : query,
+                    COAP_MEDIATYPE_APPLICATION_OCTET_STREAM, packed, (size_t)len, deadline_us);
+    if (!success(code)) {
+        ESP_LOGW(TAG, "Backlog series not accepted (%d)", code);
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        backlog_drop();
+    }
+    ESP_LOGI(TAG, "backlog: %u readings in one %d-byte series (%d block(s))", (unsigned)n, len,
+             (len + COAP_BLOCK_BYTES - 1) / COAP_BLOCK_BYTES);
+    return n;
+}
+
+bool coap_deliver_reading(const SensorReading *reading) {
+    static bool started = false;
+    if (budget_left_ms() < COAP_MIN_ATTEMPT_MS) {
+        governor_defer_reading();
+        return false;
+    }
+    if (!started) {
+        coap_startup();
+        started = true;
+    }
+
+    char uri_text[COAP_URI_MAX];
+    nvs_get_coap_uri(uri_text, sizeof(uri_text));
+    coap_uri_t uri;
+    coap_address_t dst;
+    if (coap_split_uri((const uint8_t *)uri_text, strlen(uri_text), &uri) != 0 || !resolve(&uri, &dst)) {
+        ESP_LOGE(TAG, "Bad or unresolvable coap_uri '%s'", uri_text);
+        governor_defer_reading();
+        return false;
+    }
+    bool secured = uri.scheme == COAP_URI_SCHEME_COAPS;
+
+    coap_context_t *ctx = coap_new_context(NULL);
+    coap_session_t *session = NULL;
+    if (ctx != NULL) {
+        coap_context_set_block_mode(ctx, COAP_BLOCK_USE_LIBCOAP | COAP_BLOCK_SINGLE_BODY);
+        coap_context_set_max_block_size(ctx, COAP_BLOCK_BYTES);
+        coap_register_response_handler(ctx, on_response);
+        coap_register_nack_handler(ctx, on_nack);
+        coap_register_event_handler(ctx, on_event);
+        if (secured) {
+            uint8_t key[COAP_PSK_LEN];
+            coap_dtls_cpsk_t psk = {
+                .version = COAP_DTLS_CPSK_SETUP_VERSION,
+                .psk_info.identity = { strlen(main_struct.hostname), (const uint8_t *)main_struct.hostname },
+                .psk_info.key = { sizeof(key), key },
+            };
+            // libcoap copies identity and key into the session.
+            if (derive_psk(key)) {
+                session = coap_new_client_session_psk2(ctx, NULL, &dst, COAP_PROTO_DTLS, &psk);
+            }
+            memset(key, 0, sizeof(key));
+        } else {
+            session = coap_new_client_session(ctx, NULL, &dst, COAP_PROTO_UDP);
+        }
+    }
+    if (session == NULL) {
+        ESP_LOGE(TAG, "No CoAP session for %s", uri_text);
+        if (ctx) {
+            coap_free_context(ctx);
+        }
+        governor_defer_reading();
+        return false;
+    }
+    coap_session_set_max_retransmit(session, COAP_MAX_RETRANSMIT);
+
+    int64_t t0 = esp_timer_get_time();
+    int64_t deadline_us = t0 + (int64_t)budget_left_ms() * 1000;
+    dtls_up_us = 0;
+    static char body[COAP_BODY_MAX];   // static: WAKE_STACK_CYCLE was sized around a 1 KB body
+    coap_body_t fields = { .reading = reading, .secured = secured, .extras = true };
+    size_t len = body_writer_render(emit_reading, &fields, body, sizeof(body));
+    if (len == 0) {
+        // Deferring would fail the same way on every wake and hold the backlog behind
+        // it, so send the reading without the extras. Aggregates, alerts and sleep totals
+        // wait for the next upload; only the skip count starts over.
+        ESP_LOGE(TAG, "Body needs %u bytes, COAP_BODY_MAX is %u: sending the reading alone",
+                 (unsigned)body_writer_measure(emit_reading, &fields), (unsigned)COAP_BODY_MAX);
+        fields.extras = false;
+        len = body_writer_render(emit_reading, &fields, body, sizeof(body));
+    }
+    int code = -1;
+    if (len > 0) {
+        code = post(ctx, session, "data", NULL, COAP_FORMAT_FORM, (const uint8_t *)body, len, deadline_us);
+    }
+    bool delivered = success(code);
+    int64_t t_ack = esp_timer_get_time();
+
+    size_t sent = 0;
+    if (delivered && backlog_count() > 0 &&
+        (deadline_us - esp_timer_get_time()) / 1000 >= COAP_MIN_ATTEMPT_MS) {
+        sent = send_backlog(ctx, session, secured, deadline_us);
+    }
+
+    coap_session_release(session);
+    coap_free_context(ctx);
+
+    ESP_LOGI(TAG, "%s (code %d): handshake %lld ms, ack %lld ms, %u body bytes, backlog %u sent",
+             delivered ? "delivered" : "NOT acknowledged", code,
+             dtls_up_us ? (dtls_up_us - t0) / 1000 : 0, (t_ack - t0) / 1000, (unsigned)len,
+             (unsigned)sent);
+    if (delivered) {
+        governor_release_reading();
+        report_filter_uploaded(reading);
+        if (fields.extras) {
+            sampler_reset();   // the extras emit_reading() sent, as in deliver_reading()
+            fuel_gauge_reported();
+            sleep_mgr_reported();
+        }
+    } else if (len == 0) {
+        ESP_LOGE(TAG, "Reading alone does not fit COAP_BODY_MAX: dropped");
+        governor_release_reading();
+    } else {
+        governor_defer_reading();
+    }
+    return delivered;
+}
@@ -0,0 +1,31 @@
+#ifndef COAP_LINK_H
+#define COAP_LINK_H
+
+// TRANSPORT_COAP: the upload step of the wake cycle as one confirmable CoAP POST
+// (RFC 7252) over DTLS 1.2 instead of TCP + TLS + HTTP. Wi-Fi, SNTP, the update check
+// and the wake governor are unchanged. Only wake_cycle's UPLOAD state calls in here.
+//
+// Security is a pre-shared key, so there is no certificate chain to send or verify:
+//   identity = hostname
+//   key      = first 16 bytes of HMAC-SHA256(key = api token, "plantpulse-coap-psk-v1")
+// The server derives the same key from the token it already stores for the device.
+// Because the identity is authenticated, the form body leaves out api_token and
+// hostname; over plain coap:// (local test server only) they are sent as usual.
+//
+// Requests (Uri-Path as in the HTTPS API):
+//   POST /api/esp/data    Content-Format 65000 (x-www-form-urlencoded, experimental
+//                         range: CoAP has no registered number for it). The same fields
+//                         uploadReadings() sends.
+//   POST /api/esp/series  Content-Format 42 (octet-stream). The backlog as one ts_codec
+//                         block, split into Block1 transfers by libcoap when it is
+//                         larger than COAP_BLOCK_BYTES.
+// 2.01 or 2.04 is success.
+
+#include <stdbool.h>
+#include "data.h"
+
+// Sends this wake's reading, then the backlog if the budget allows. Releases the reading
+// (acknowledged) or defers it to the backlog (not), like deliver_reading().
+bool coap_deliver_reading(const SensorReading *reading);
+
+#endif // COAP_LINK_H
@@ -0,0 +1,335 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/adc.h"
+#include "esp_console.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "data.h"
+#include "fuel_gauge.h"
+#include "sleep_mgr.h"
+#include "tls_profile.h"
+#include "wake_governor.h"
+#include "diag_console.h"
+
+static const char *TAG = "DIAG";
+
+#define DIAG_STACK_BYTES        8192      // bench tls runs the handshake on this task
+#define DIAG_COMMAND_GRANT_MS   120000    // wake budget added per command
+#define DIAG_FIRST_COMMAND_MS   30000     // linger this long for a first command...
+#define DIAG_IDLE_MS            300000    // ...and this long after the last one
+#define DIAG_MAX_SAMPLES        512
+#define DIAG_FLASH_SECTOR       4096
+#define DIAG_FLASH_MAX_SECTORS  64        // 256 KB of a 2 MB slot
+
+static esp_console_repl_t *repl;
+static volatile int64_t last_command_us;
+static volatile bool sleep_requested;
+static uint32_t samples[DIAG_MAX_SAMPLES];
+
+static void command_begin(void) {
+    last_command_us = esp_timer_get_time();
+    governor_grant_ms(DIAG_COMMAND_GRANT_MS);
+}
+
+static int count_arg(int argc, char **argv, int index, int def, int max) {
+    int n = argc > index ? atoi(argv[index]) : def;
+    return n < 1 ? 1 : n > max ? max : n;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// One "BENCH op=... n=... ok=... min_us=... p50_us=..." line over samples[0..ok).
+static void print_distribution(const char *op, int n, int ok, const char *extra) {
+    if (ok == 0) {
+        printf("BENCH op=%s n=%d ok=0%s%s\n", op, n, extra ? " " : "", extra ? extra : "");
+        return;
+    }
+    qsort(samples, ok, sizeof(samples[0]), cmp_u32);
+    uint64_t sum = 0;
+    for (int i = 0; i < ok; i++) {
+        sum += samples[i];
+    }
+    printf("BENCH op=%s n=%d ok=%d min_us=%lu p50_us=%lu p90_us=%lu p99_us=%lu max_us=%lu mean_us=%lu%s%s\n",
+           op, n, ok, (unsigned long)samples[0], (unsigned long)samples[ok / 2],
+           (unsigned long)samples[ok * 9 / 10], (unsigned long)samples[ok * 99 / 100],
+           (unsigned long)samples[ok - 1], (unsigned long)(sum / ok), extra ? " " : "", extra ? extra : "");
+}
+
+static void bench_adc(int n) {
+    int64_t total = 0;
+    int raw = 0;
+    for (int i = 0; i < n; i++) {
+        int64_t t0 = esp_timer_get_time();
+        raw = adc1_get_raw(ADC1_CHANNEL_4);   // the probe, as readMoisture() reads it
+        samples[i] = (uint32_t)(esp_timer_get_time() - t0);
+        total += samples[i];
+    }
+    char extra[48];
+    snprintf(extra, sizeof(extra), "burst_us=%lld last_raw=%d", (long long)total, raw);
+    print_distribution("adc", n, n, extra);
+}
+
+static void bench_i2c(int n) {
+    const max17048_bus_t *bus = fuel_gauge_bus();
+    int ok = 0;
+    for (int i = 0; i < n; i++) {
+        uint16_t value;
+        int64_t t0 = esp_timer_get_time();
+        int err = bus->read(bus->ctx, MAX17048_REG_VCELL, &value);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+        if (err == 0) {
+            samples[ok++] = us;
+        }
+    }
+    print_distribution("i2c_read16", n, ok, "reg=vcell");
+}
+
+static void bench_tls(int n) {
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        printf("BENCH op=tls error=no_wifi\n");
+        return;
+    }
+    tls_profile_benchmark(TLS_ATHOME_HOST, n);   // TLS_BENCH lines, one per profile
+}
+
+// True when the idle slot holds nothing to roll back to: no valid app image, or one the
+// bootloader has already marked invalid or aborted.
+static bool idle_slot_disposable(const esp_partition_t *part) {
+    esp_app_desc_t desc;
+    if (esp_ota_get_partition_description(part, &desc) != ESP_OK) {
+        return true;
+    }
+    esp_ota_img_states_t state;
+    return esp_ota_get_state_partition(part, &state) == ESP_OK &&
+           (state == ESP_OTA_IMG_INVALID || state == ESP_OTA_IMG_ABORTED);
+}
+
+// The idle OTA slot is the only flash an app may scribble on, and the running image is
+// never in it. It may still hold the previous firmware, the rollback target, so that
+// is only erased when asked for by name.
+static void bench_flash(int n, bool destroy_rollback) {
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    if (part == NULL || part == esp_ota_get_running_partition()) {
+        printf("BENCH op=flash error=no_idle_slot\n");
+        return;
+    }
+    if (!destroy_rollback && !idle_slot_disposable(part)) {
+        printf("BENCH op=flash error=rollback_image part=%s hint=--destroy-rollback\n", part->label);
+        return;
+    }
+    uint8_t *buf = malloc(DIAG_FLASH_SECTOR);
+    if (buf == NULL) {
+        printf("BENCH op=flash error=no_mem\n");
+        return;
+    }
+    for (int i = 0; i < DIAG_FLASH_SECTOR; i++) {
+        buf[i] = (uint8_t)(i * 7);
+    }
+    static const char *const ops[] = { "flash_erase4k", "flash_write4k", "flash_read4k" };
+    static uint32_t times[3][DIAG_FLASH_MAX_SECTORS];
+    int ok = 0;
+    for (; ok < n; ok++) {
+        size_t off = (size_t)ok * DIAG_FLASH_SECTOR;
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t err = esp_partition_erase_range(part, off, DIAG_FLASH_SECTOR);
+        int64_t t1 = esp_timer_get_time();
+        if (err == ESP_OK) {
+            err = esp_partition_write(part, off, buf, DIAG_FLASH_SECTOR);
+        }
+        int64_t t2 = esp_timer_get_time();
+        if (err == ESP_OK) {
+            err = esp_partition_read(part, off, buf, DIAG_FLASH_SECTOR);
+        }
+        int64_t t3 = esp_timer_get_time();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "flash bench stopped at sector %d: %s", ok, esp_err_to_name(err));
+            break;
+        }
+        times[0][ok] = (uint32_t)(t1 - t0);
+        times[1][ok] = (uint32_t)(t2 - t1);
+        times[2][ok] = (uint32_t)(t3 - t2);
+    }
+    free(buf);
+    for (int op = 0; op < 3; op++) {
+        uint64_t sum = 0;
+        for (int i = 0; i < ok; i++) {
+            samples[i] = times[op][i];
+            sum += times[op][i];
+        }
+        char extra[64];
+        snprintf(extra, sizeof(extra), "kb_s=%lu part=%s",
+                 sum ? (unsigned long)((uint64_t)ok * DIAG_FLASH_SECTOR * 1000000 / 1024 / sum) : 0UL,
+                 part->label);
+        print_distribution(ops[op], n, ok, extra);
+    }
+}
+
+static int cmd_bench(int argc, char **argv) {
+    command_begin();
+    const char *what = argc > 1 ? argv[1] : "";
+    if (strcmp(what, "adc") == 0) {
+        bench_adc(count_arg(argc, argv, 2, 200, DIAG_MAX_SAMPLES));
+    } else if (strcmp(what, "i2c") == 0) {
+        bench_i2c(count_arg(argc, argv, 2, 100, DIAG_MAX_SAMPLES));
+    } else if (strcmp(what, "tls") == 0) {
+        bench_tls(count_arg(argc, argv, 2, 3, 20));
+    } else if (strcmp(what, "flash") == 0) {
+        bool destroy = argc > 2 && strcmp(argv[argc - 1], "--destroy-rollback") == 0;
+        bench_flash(count_arg(destroy ? argc - 1 : argc, argv, 2, 16, DIAG_FLASH_MAX_SECTORS), destroy);
+    } else {
+        printf("usage: bench adc|i2c|tls [n] | bench flash [n] [--destroy-rollback]\n");
+        return 1;
+    }
+    return 0;
+}
+
+static void print_heap(const char *name, uint32_t caps) {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    printf("HEAP caps=%s free=%u min_free=%u largest=%u alloc_blocks=%u free_blocks=%u\n", name,
+           (unsigned)info.total_free_bytes, (unsigned)info.minimum_free_bytes,
+           (unsigned)info.largest_free_block, (unsigned)info.allocated_blocks,
+           (unsigned)info.free_blocks);
+}
+
+static int cmd_heap(int argc, char **argv) {
+    command_begin();
+    print_heap("8bit", MALLOC_CAP_8BIT);
+    print_heap("internal", MALLOC_CAP_INTERNAL);
+    print_heap("dma", MALLOC_CAP_DMA);
+    print_heap("exec", MALLOC_CAP_EXEC);
+    return 0;
+}
+
+static int cmd_tasks(int argc, char **argv) {
+    command_begin();
+    static const char *const states[] = { "running", "ready", "blocked", "suspended", "deleted", "invalid" };
+    UBaseType_t max = uxTaskGetNumberOfTasks() + 4;   // room for tasks created meanwhile
+    TaskStatus_t *list = malloc(max * sizeof(*list));
+    if (list == NULL) {
+        printf("TASK error=no_mem\n");
+        return 1;
+    }
+    uint32_t total_runtime = 0;
+    UBaseType_t n = uxTaskGetSystemState(list, max, &total_runtime);
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *t = &list[i];
+        unsigned state = t->eCurrentState < 5 ? t->eCurrentState : 5;
+        // Run-time counter is per core, so with two cores the shares add up to 200 %.
+        unsigned long pct10 = total_runtime ? (unsigned long)((uint64_t)t->ulRunTimeCounter * 1000 / total_runtime) : 0;
+        printf("TASK name=%s state=%s prio=%u hwm=%lu cpu_pct=%lu.%lu\n", t->pcTaskName,
+               states[state], (unsigned)t->uxCurrentPriority,
+               (unsigned long)t->usStackHighWaterMark, pct10 / 10, pct10 % 10);
+    }
+    free(list);
+    return 0;
+}
+
+static int cmd_wake_profile(int argc, char **argv) {
+    command_begin();
+    wake_profile_t profiles[WAKE_PROFILE_DEPTH];
+    int n = governor_get_profiles(profiles, WAKE_PROFILE_DEPTH);
+    for (int i = 0; i < n; i++) {
+        printf("WAKE_PROFILE ago=%d total_ms=%lu", i, (unsigned long)profiles[i].total_ms);
+        for (int p = 0; p < WAKE_PHASE_COUNT; p++) {
+            printf(" %s_ms=%lu", wake_phase_name((wake_phase_t)p), (unsigned long)profiles[i].phase_ms[p]);
+        }
+        printf("\n");
+    }
+    // Same distribution line as the benchmarks, per phase, over the kept wakes.
+    for (int p = 0; p < WAKE_PHASE_COUNT && n > 0; p++) {
+        for (int i = 0; i < n; i++) {
+            samples[i] = profiles[i].phase_ms[p] * 1000;
+        }
+        char op[24];
+        snprintf(op, sizeof(op), "wake_%s", wake_phase_name((wake_phase_t)p));
+        print_distribution(op, n, n, NULL);
+    }
+    wake_overrun_record_t rec;
+    governor_get_record(&rec);
+    printf("WAKE_OVERRUN last_phase=%s last_cause=%u last_elapsed_ms=%lu watchdog_resets=%lu\n",
+           wake_phase_name((wake_phase_t)rec.last_phase), rec.last_cause,
+           (unsigned long)rec.last_elapsed_ms, (unsigned long)rec.watchdog_resets);
+    return 0;
+}
+
+static int cmd_sleep_log(int argc, char **argv) {
+    command_begin();
+    sleep_cycle_t log[SLEEP_LOG_DEPTH];
+    int n = sleep_mgr_get_log(log, SLEEP_LOG_DEPTH);
+    for (int i = 0; i < n; i++) {
+        printf("SLEEP_CYCLE ago=%d cause=%s slept_s=%lu awake_ms=%lu soc=%.2f\n", i,
+               sleep_wake_name((sleep_wake_t)log[i].cause), (unsigned long)log[i].slept_s,
+               (unsigned long)log[i].awake_ms, log[i].soc_raw / 256.0f);
+    }
+    return 0;
+}
+
+static int cmd_sleep(int argc, char **argv) {
+    sleep_requested = true;
+    printf("DIAG sleep=requested\n");
+    return 0;
+}
+
+void diag_console_start(void) {
+    if (repl != NULL) {
+        return;
+    }
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "plantpulse>";
+    repl_config.task_stack_size = DIAG_STACK_BYTES;
+    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    esp_err_t err = esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Console not started: %s", esp_err_to_name(err));
+        repl = NULL;
+        return;
+    }
+
+    static const esp_console_cmd_t cmds[] = {
+        { .command = "bench", .help = "bench adc|i2c|tls|flash [n] [--destroy-rollback]: timing distribution", .func = cmd_bench },
+        { .command = "heap", .help = "free/min/largest per heap capability", .func = cmd_heap },
+        { .command = "tasks", .help = "state, priority, stack high-water mark, CPU share", .func = cmd_tasks },
+        { .command = "wake-profile", .help = "per-phase time of the last wakes", .func = cmd_wake_profile },
+        { .command = "sleep-log", .help = "wake cause, time asleep and awake, SoC of the last cycles", .func = cmd_sleep_log },
+        { .command = "sleep", .help = "let the device deep-sleep now", .func = cmd_sleep },
+    };
+    esp_console_register_help_command();
+    for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+        esp_console_cmd_register(&cmds[i]);
+    }
+    esp_console_start_repl(repl);
+    ESP_LOGI(TAG, "Console on USB; 'help' lists the commands");
+}
+
+void diag_console_linger(void) {
+    if (repl == NULL || sleep_requested || !usb_power_present()) {
+        return;
+    }
+    // On USB power: no budget to protect, and a bench session outlasts any of them.
+    governor_stop();
+    int64_t since = last_command_us ? last_command_us : esp_timer_get_time();
+    ESP_LOGI(TAG, "Wake done; console stays up until 'sleep', USB unplug or %d s idle",
+             (last_command_us ? DIAG_IDLE_MS : DIAG_FIRST_COMMAND_MS) / 1000);
+    while (!sleep_requested && usb_power_present()) {
+        int64_t limit_ms = last_command_us ? DIAG_IDLE_MS : DIAG_FIRST_COMMAND_MS;
+        if (last_command_us > since) {
+            since = last_command_us;
+        }
+        if ((esp_timer_get_time() - since) / 1000 >= limit_ms) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+}
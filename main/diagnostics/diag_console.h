@@ -0,0 +1,31 @@
+#ifndef DIAG_CONSOLE_H
+#define DIAG_CONSOLE_H
+
+// Bench console on the native USB port (USB-Serial-JTAG, /dev/ttyACM0), started only on
+// boots that find USB power. It measures this board's own code paths, not a model:
+//
+//   bench adc [n]      probe ADC reads (adc1_get_raw, as readMoisture() does)
+//   bench i2c [n]      MAX17048 register reads over the fuel gauge's bus
+//   bench tls [n]      TLS handshakes per profile (tls_profile_benchmark), needs Wi-Fi up
+//   bench flash [n] [--destroy-rollback]
+//                      erase/write/read of n 4 KB sectors at the start of the idle OTA
+//                      slot; refused while that slot holds a valid rollback image unless
+//                      --destroy-rollback is given
+//   heap               free / minimum / largest block per capability
+//   tasks              every task's state, priority, stack high-water mark, CPU share
+//   wake-profile       per-phase time of the last WAKE_PROFILE_DEPTH wakes (governor)
+//   sleep-log          wake cause, time asleep and awake, SoC of the last SLEEP_LOG_DEPTH cycles
+//   sleep              stop waiting and let the device deep-sleep
+//
+// Output is one line per result, "<KIND> key=value ...", like TLS_BENCH and MEM_DIAG,
+// so a capture can be grepped and diffed between boards. Timings are distributions:
+// n, min, p50, p90, p99, max, mean.
+//
+// Each command grants the wake governor time, so a long benchmark doesn't abort the
+// wake. When the wake is over, enter_deep_sleep() waits in diag_console_linger() while
+// the console is in use.
+
+void diag_console_start(void);   // app_main; no-op if already running
+void diag_console_linger(void);  // enter_deep_sleep(): returns once sleep is due
+
+#endif // DIAG_CONSOLE_H
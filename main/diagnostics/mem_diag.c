@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "mem_diag.h"
+
+static const char *TAG = "MEM_DIAG";
+
+static static_task_t *slots[MEM_DIAG_MAX_TASKS];
+static size_t slot_count = 0;
+
+static struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_size;
+    uint32_t hwm;
+} noted[MEM_DIAG_MAX_TASKS];
+static size_t noted_count = 0;
+
+static RTC_DATA_ATTR mem_diag_t last;
+static RTC_DATA_ATTR bool last_valid = false;
+
+// Called from the idle task once it has freed the TCB of a slot's task; only then may
+// xTaskCreateStatic() hand the same TCB and stack to the next task.
+static void slot_released(int index, void *pv) {
+    (void)index;
+    ((static_task_t *)pv)->busy = false;
+}
+
+static void slot_entry(void *pv) {
+    static_task_t *slot = pv;
+    vTaskSetThreadLocalStoragePointerAndDelCallback(NULL, MEM_DIAG_TLS_INDEX, slot, slot_released);
+    slot->fn(slot->arg);
+    vTaskDelete(NULL);   // for a fn that returns instead of deleting itself
+}
+
+// Bytes at the low end of the stack the task never wrote; FreeRTOS fills a new stack
+// with tskSTACK_FILL_BYTE and the stack grows down. Reads only the slot's own buffer,
+// so it stays valid after the task and its handle are gone.
+static uint32_t slot_hwm(const static_task_t *slot) {
+    uint32_t n = 0;
+    while (n < slot->stack_size && slot->stack[n] == (StackType_t)0xA5) {
+        n++;
+    }
+    return n;
+}
+
+TaskHandle_t static_task_start(static_task_t *slot, TaskFunction_t fn, const char *name,
+                               void *arg, UBaseType_t priority) {
+    if (slot->busy) {
+        ESP_LOGW(TAG, "%s: slot still in use by '%s'", name, slot->name);
+        return NULL;
+    }
+    slot->busy = true;
+    slot->fn = fn;
+    slot->arg = arg;
+    snprintf(slot->name, sizeof(slot->name), "%s", name);
+    slot->handle = xTaskCreateStatic(slot_entry, name, slot->stack_size, slot, priority,
+                                     slot->stack, &slot->tcb);
+
+    bool known = false;
+    for (size_t i = 0; i < slot_count; i++) {
+        known |= slots[i] == slot;
+    }
+    if (!known && slot_count < MEM_DIAG_MAX_TASKS) {
+        slots[slot_count++] = slot;
+    }
+    return slot->handle;
+}
+
+TaskHandle_t static_task_start_sized(static_task_t *slot, uint32_t stack_bytes, TaskFunction_t fn,
+                                     const char *name, void *arg, UBaseType_t priority) {
+    if (slot->stack == NULL) {
+        slot->stack = heap_caps_malloc(stack_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (slot->stack == NULL) {
+            ESP_LOGE(TAG, "%s: no %lu-byte stack", name, (unsigned long)stack_bytes);
+            return NULL;
+        }
+        slot->stack_size = stack_bytes;
+    } else if (stack_bytes > slot->stack_size) {
+        ESP_LOGE(TAG, "%s: needs %lu bytes, slot has %lu", name, (unsigned long)stack_bytes,
+                 (unsigned long)slot->stack_size);
+        return NULL;
+    }
+    return static_task_start(slot, fn, name, arg, priority);
+}
+
+void mem_diag_note_self(uint32_t stack_size) {
+    if (noted_count >= MEM_DIAG_MAX_TASKS) {
+        return;
+    }
+    snprintf(noted[noted_count].name, sizeof(noted[0].name), "%s", pcTaskGetName(NULL));
+    noted[noted_count].stack_size = stack_size;
+    noted[noted_count].hwm = uxTaskGetStackHighWaterMark(NULL);
+    noted_count++;
+}
+
+static void add_task(mem_diag_t *d, const char *name, uint32_t stack_size, uint32_t hwm) {
+    if (d->task_count >= MEM_DIAG_MAX_TASKS) {
+        return;
+    }
+    task_mem_t *t = &d->tasks[d->task_count++];
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->stack_size = stack_size;
+    t->hwm = hwm;
+    t->worst_hwm = hwm;
+    // Carry the worst case forward by name; a slot can host different tasks per boot.
+    if (last_valid) {
+        for (int i = 0; i < last.task_count; i++) {
+            if (strcmp(last.tasks[i].name, t->name) == 0 && last.tasks[i].worst_hwm < t->worst_hwm) {
+                t->worst_hwm = last.tasks[i].worst_hwm;
+            }
+        }
+    }
+}
+
+void mem_diag_capture(void) {
+    mem_diag_t d = {
+        .heap_free = esp_get_free_heap_size(),
+        .heap_min_free = esp_get_minimum_free_heap_size(),
+        .largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+    };
+    d.worst_heap_min_free = last_valid && last.worst_heap_min_free < d.heap_min_free
+                                ? last.worst_heap_min_free : d.heap_min_free;
+
+    for (size_t i = 0; i < slot_count; i++) {
+        // From the slot's own copy and buffer, never the handle: the task may have
+        // exited and its TCB been reused or cleaned up by now.
+        add_task(&d, slots[i]->name, slots[i]->stack_size, slot_hwm(slots[i]));
+    }
+    for (size_t i = 0; i < noted_count; i++) {
+        add_task(&d, noted[i].name, noted[i].stack_size, noted[i].hwm);
+    }
+
+    // One key=value line per item, so serial logs can be grepped across a fleet.
+    printf("MEM_DIAG heap_free=%lu heap_min=%lu largest_block=%lu worst_heap_min=%lu\n",
+           (unsigned long)d.heap_free, (unsigned long)d.heap_min_free,
+           (unsigned long)d.largest_block, (unsigned long)d.worst_heap_min_free);
+    for (int i = 0; i < d.task_count; i++) {
+        printf("MEM_DIAG task=%s stack=%lu hwm=%lu worst_hwm=%lu\n", d.tasks[i].name,
+               (unsigned long)d.tasks[i].stack_size, (unsigned long)d.tasks[i].hwm,
+               (unsigned long)d.tasks[i].worst_hwm);
+        if (d.tasks[i].worst_hwm < MEM_DIAG_STACK_MARGIN) {
+            ESP_LOGW(TAG, "%s: worst_hwm %lu below the %d-byte margin; grow its stack",
+                     d.tasks[i].name, (unsigned long)d.tasks[i].worst_hwm, MEM_DIAG_STACK_MARGIN);
+        }
+    }
+
+    last = d;
+    last_valid = true;
+}
+
+bool mem_diag_last(mem_diag_t *out) {
+    if (last_valid) {
+        *out = last;
+    }
+    return last_valid;
+}
+
+int mem_diag_format(char *buf, size_t len) {
+    if (!last_valid || len == 0) {
+        return 0;
+    }
+    // e.g. "hmin:41234,blk:31744,wake:2210/16384,button:812/2048"
+    int n = snprintf(buf, len, "hmin:%lu,blk:%lu", (unsigned long)last.heap_min_free,
+                     (unsigned long)last.largest_block);
+    for (int i = 0; i < last.task_count && n > 0 && (size_t)n < len; i++) {
+        n += snprintf(buf + n, len - n, ",%s:%lu/%lu", last.tasks[i].name,
+                      (unsigned long)last.tasks[i].hwm, (unsigned long)last.tasks[i].stack_size);
+    }
+    return n;
+}
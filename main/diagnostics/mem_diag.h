@@ -0,0 +1,89 @@
+#ifndef MEM_DIAG_H
+#define MEM_DIAG_H
+
+// Memory instrumentation and statically allocated tasks.
+//
+// Long-lived tasks run from static_task_t slots (stack + TCB in .bss; the shared wake
+// slot's stack is taken once per boot) rather than xTaskCreate, so they can't fail
+// mid-wake or fragment the heap that cJSON, esp_http_client and mbedTLS allocate
+// from. Every slot, plus any dynamic task that
+// calls mem_diag_note_self() before exiting, is sampled by mem_diag_capture() at the
+// end of the wake: stack high-water mark per task, minimum free heap, largest free
+// block. The result is logged as MEM_DIAG lines, kept in RTC memory (including the
+// worst high-water mark seen per task since power-on) and sent with the next upload.
+// Slot stack sizes are the ones to retune from those numbers.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef struct {
+    uint32_t stack_size;            // bytes (ESP-IDF StackType_t is a byte)
+    StackType_t *stack;             // NULL in a STATIC_TASK_DEFINE_SHARED slot until first start
+    StaticTask_t tcb;
+    TaskHandle_t handle;            // only valid while busy
+    TaskFunction_t fn;
+    void *arg;
+    char name[configMAX_TASK_NAME_LEN];   // kept for mem_diag_capture() after the task is gone
+    volatile bool busy;             // start .. idle task has freed the TCB (TLS callback)
+} static_task_t;
+
+#define STATIC_TASK_DEFINE(var, bytes) \
+    static StackType_t var##_stack[bytes]; \
+    static static_task_t var = { .stack_size = (bytes), .stack = var##_stack }
+
+// A slot whose task, and so its stack size, is chosen per boot (the wake task: HTTPS
+// cycle, beacon, ESP-NOW node or gateway). Its stack comes from the heap on the first
+// static_task_start_sized() of the boot, right after app start while the heap is still
+// unfragmented, and stays until the next reset; nothing is reserved in .bss.
+#define STATIC_TASK_DEFINE_SHARED(var) static static_task_t var
+
+// The FreeRTOS thread-local storage index the slots use for their deletion callback
+// (CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS must be above it; 0 is pthread's).
+#define MEM_DIAG_TLS_INDEX 1
+
+// Starts fn in the slot. Returns NULL (and starts nothing) if the slot's previous task
+// hasn't been cleaned up by the idle task yet: FreeRTOS reports eDeleted as soon as a
+// task deletes itself, while its TCB is still on the termination list, so the slot is
+// only reused once the TLS deletion callback has released it.
+TaskHandle_t static_task_start(static_task_t *slot, TaskFunction_t fn, const char *name,
+                               void *arg, UBaseType_t priority);
+
+// For STATIC_TASK_DEFINE_SHARED slots: allocates stack_bytes on the first start of the
+// boot. A later task that needs more than the first one got is refused (NULL).
+TaskHandle_t static_task_start_sized(static_task_t *slot, uint32_t stack_bytes, TaskFunction_t fn,
+                                     const char *name, void *arg, UBaseType_t priority);
+
+// For short-lived dynamic tasks: record this task's high-water mark before it deletes
+// itself, so it still shows up in the end-of-wake snapshot.
+void mem_diag_note_self(uint32_t stack_size);
+
+#define MEM_DIAG_MAX_TASKS 10
+
+// mem_diag_capture() warns about any task whose worst_hwm is below this; the stack
+// sizes are chosen so the field's worst_hwm stays at or above it.
+#define MEM_DIAG_STACK_MARGIN 1024
+
+typedef struct {
+    char     name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_size;
+    uint32_t hwm;                   // bytes never touched this wake
+    uint32_t worst_hwm;             // lowest hwm over all wakes since power-on
+} task_mem_t;
+
+typedef struct {
+    uint32_t heap_free;
+    uint32_t heap_min_free;         // esp_get_minimum_free_heap_size(): low point of this wake
+    uint32_t largest_block;         // largest allocatable 8-bit block at capture time
+    uint32_t worst_heap_min_free;
+    uint8_t  task_count;
+    task_mem_t tasks[MEM_DIAG_MAX_TASKS];
+} mem_diag_t;
+
+void mem_diag_capture(void);                     // enter_deep_sleep(): snapshot + log + keep
+bool mem_diag_last(mem_diag_t *out);             // previous wake's snapshot, false if none
+int  mem_diag_format(char *buf, size_t len);     // previous wake, compact form value
+
+#endif // MEM_DIAG_H
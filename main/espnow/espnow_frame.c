@@ -0,0 +1,120 @@
+#include <string.h>
+#include "mbedtls/ccm.h"
+#include "espnow_frame.h"
+
+#define BODY_MAX_LEN (ESPNOW_FRAME_MAX_LEN - ESPNOW_FRAME_HDR_LEN - ESPNOW_FRAME_TAG_LEN)
+
+static void make_nonce(const uint8_t sender_mac[6], const uint8_t *header, uint8_t nonce[13]) {
+    memcpy(nonce, sender_mac, 6);
+    memcpy(nonce + 6, header + 2, 4);   // seq, already little-endian in the header
+    nonce[10] = nonce[11] = nonce[12] = 0;
+}
+
+static size_t put_string(uint8_t *p, const char *s, size_t max) {
+    size_t n = strnlen(s, max - 1);
+    p[0] = (uint8_t)n;
+    memcpy(p + 1, s, n);
+    return 1 + n;
+}
+
+static bool get_string(const uint8_t *body, size_t len, size_t *pos, char *out, size_t out_size) {
+    if (*pos >= len) {
+        return false;
+    }
+    size_t n = body[*pos];
+    if (n >= out_size || *pos + 1 + n > len) {
+        return false;
+    }
+    memcpy(out, body + *pos + 1, n);
+    out[n] = '\0';
+    *pos += 1 + n;
+    return true;
+}
+
+size_t espnow_frame_seal(const espnow_reading_t *reading, const uint8_t sender_mac[6],
+                         const uint8_t key[ESPNOW_KEY_LEN], uint8_t *out, size_t out_len) {
+    uint8_t body[BODY_MAX_LEN];
+    size_t n = 0;
+    body[n++] = reading->power;
+    body[n++] = reading->moisture;
+    body[n++] = (uint8_t)reading->soc_raw;
+    body[n++] = (uint8_t)(reading->soc_raw >> 8);
+    body[n++] = (uint8_t)reading->crate_raw;
+    body[n++] = (uint8_t)((uint16_t)reading->crate_raw >> 8);
+    n += put_string(&body[n], reading->name, sizeof(reading->name));
+    n += put_string(&body[n], reading->location, sizeof(reading->location));
+    n += put_string(&body[n], reading->api_token, sizeof(reading->api_token));
+
+    size_t frame_len = ESPNOW_FRAME_HDR_LEN + n + ESPNOW_FRAME_TAG_LEN;
+    if (out_len < frame_len) {
+        return 0;
+    }
+
+    out[0] = ESPNOW_FRAME_MAGIC;
+    out[1] = ESPNOW_FRAME_VERSION;
+    for (int i = 0; i < 4; i++) {
+        out[2 + i] = (uint8_t)(reading->seq >> (8 * i));
+    }
+
+    uint8_t nonce[13];
+    make_nonce(sender_mac, out, nonce);
+
+    mbedtls_ccm_context ccm;
+    mbedtls_ccm_init(&ccm);
+    int rc = mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, ESPNOW_KEY_LEN * 8);
+    if (rc == 0) {
+        rc = mbedtls_ccm_encrypt_and_tag(&ccm, n, nonce, sizeof(nonce), out, ESPNOW_FRAME_HDR_LEN,
+                                         body, out + ESPNOW_FRAME_HDR_LEN,
+                                         out + ESPNOW_FRAME_HDR_LEN + n, ESPNOW_FRAME_TAG_LEN);
+    }
+    mbedtls_ccm_free(&ccm);
+    return rc == 0 ? frame_len : 0;
+}
+
+espnow_frame_status_t espnow_frame_open(const uint8_t *frame, size_t len, const uint8_t sender_mac[6],
+                                        const uint8_t key[ESPNOW_KEY_LEN], espnow_reading_t *reading) {
+    if (len < ESPNOW_FRAME_HDR_LEN + ESPNOW_FRAME_TAG_LEN || len > ESPNOW_FRAME_MAX_LEN) {
+        return ESPNOW_FRAME_ERR_LEN;
+    }
+    if (frame[0] != ESPNOW_FRAME_MAGIC || frame[1] != ESPNOW_FRAME_VERSION) {
+        return ESPNOW_FRAME_ERR_HEADER;
+    }
+
+    size_t n = len - ESPNOW_FRAME_HDR_LEN - ESPNOW_FRAME_TAG_LEN;
+    uint8_t body[BODY_MAX_LEN];
+    uint8_t nonce[13];
+    make_nonce(sender_mac, frame, nonce);
+
+    mbedtls_ccm_context ccm;
+    mbedtls_ccm_init(&ccm);
+    int rc = mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, ESPNOW_KEY_LEN * 8);
+    if (rc == 0) {
+        rc = mbedtls_ccm_auth_decrypt(&ccm, n, nonce, sizeof(nonce), frame, ESPNOW_FRAME_HDR_LEN,
+                                      frame + ESPNOW_FRAME_HDR_LEN, body,
+                                      frame + ESPNOW_FRAME_HDR_LEN + n, ESPNOW_FRAME_TAG_LEN);
+    }
+    mbedtls_ccm_free(&ccm);
+    if (rc != 0) {
+        return ESPNOW_FRAME_ERR_AUTH;
+    }
+
+    if (n < 6) {
+        return ESPNOW_FRAME_ERR_BODY;
+    }
+    memset(reading, 0, sizeof(*reading));
+    reading->seq = (uint32_t)frame[2] | ((uint32_t)frame[3] << 8) |
+                   ((uint32_t)frame[4] << 16) | ((uint32_t)frame[5] << 24);
+    reading->power = body[0];
+    reading->moisture = body[1];
+    reading->soc_raw = (uint16_t)(body[2] | (body[3] << 8));
+    reading->crate_raw = (int16_t)(body[4] | (body[5] << 8));
+
+    size_t pos = 6;
+    if (!get_string(body, n, &pos, reading->name, sizeof(reading->name)) ||
+        !get_string(body, n, &pos, reading->location, sizeof(reading->location)) ||
+        !get_string(body, n, &pos, reading->api_token, sizeof(reading->api_token)) ||
+        pos != n) {
+        return ESPNOW_FRAME_ERR_BODY;
+    }
+    return ESPNOW_FRAME_OK;
+}
@@ -0,0 +1,60 @@
+#ifndef ESPNOW_FRAME_H
+#define ESPNOW_FRAME_H
+
+// Encrypted reading frame sent by an ESP-NOW node to its gateway (TRANSPORT_ESPNOW).
+//
+// No ESP-IDF driver headers — only mbedTLS for AES-CCM — so the codec builds and runs
+// on a host exactly as on the device.
+//
+//   off len  field
+//    0   1   magic              ESPNOW_FRAME_MAGIC
+//    1   1   version            ESPNOW_FRAME_VERSION
+//    2   4   seq (LE)           per-node, never reused (nonce input)
+//    6   n   ciphertext         AES-128-CCM of the body below
+//   6+n  8   tag                CCM tag, header bytes 0..5 authenticated as AAD
+//
+// Body: power(1) moisture(1) soc_raw(2 LE) crate_raw(2 LE) then three length-prefixed
+// strings: sensor name, location, api_token. Nonce = sender MAC(6) | seq(4 LE) | 0 0 0,
+// so the gateway can't decrypt a frame re-sent from a different MAC.
+//
+// ESP-NOW's own per-peer encryption is not used: the gateway would have to register
+// every node as an encrypted peer and the driver caps that at a handful.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESPNOW_FRAME_MAGIC     0x50     // 'P'
+#define ESPNOW_FRAME_VERSION   1
+#define ESPNOW_FRAME_HDR_LEN   6
+#define ESPNOW_FRAME_TAG_LEN   8
+#define ESPNOW_FRAME_MAX_LEN   250      // ESP_NOW_MAX_DATA_LEN
+#define ESPNOW_KEY_LEN         16
+
+typedef struct {
+    uint32_t seq;
+    uint8_t  power;          // READING_PWR_* flags
+    uint8_t  moisture;
+    uint16_t soc_raw;
+    int16_t  crate_raw;
+    char     name[32];
+    char     location[64];
+    char     api_token[64];
+} espnow_reading_t;
+
+typedef enum {
+    ESPNOW_FRAME_OK = 0,
+    ESPNOW_FRAME_ERR_LEN = -1,      // too short / too long for the buffer
+    ESPNOW_FRAME_ERR_HEADER = -2,   // not ours, or another version
+    ESPNOW_FRAME_ERR_AUTH = -3,     // wrong key, wrong sender or tampered
+    ESPNOW_FRAME_ERR_BODY = -4,     // decrypted but malformed
+} espnow_frame_status_t;
+
+// Encrypts reading into out. Returns the frame length, or 0 on error.
+size_t espnow_frame_seal(const espnow_reading_t *reading, const uint8_t sender_mac[6],
+                         const uint8_t key[ESPNOW_KEY_LEN], uint8_t *out, size_t out_len);
+
+espnow_frame_status_t espnow_frame_open(const uint8_t *frame, size_t len, const uint8_t sender_mac[6],
+                                        const uint8_t key[ESPNOW_KEY_LEN], espnow_reading_t *reading);
+
+#endif // ESPNOW_FRAME_H
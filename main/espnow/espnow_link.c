@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_attr.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_now.h"
+#include "esp_random.h"
+#include "main.h"
+#include "wake_governor.h"
+#include "data.h"
+#include "nvs_drv.h"
+#include "rest_methods.h"
+#include "espnow_frame.h"
+#include "espnow_queue.h"
+#include "espnow_link.h"
+
+static const char *TAG = "ESPNOW";
+
+#define ESPNOW_MAX_ATTEMPTS     5      // app-level resends on top of the driver's MAC retries
+#define ESPNOW_ACK_TIMEOUT_MS   100    // send callback normally fires within a few ms
+
+#define GW_BATCH_SIZE           16     // forward as soon as this many readings are queued...
+#define GW_FLUSH_MS             30000  // ...or when the oldest has waited this long
+#define GW_RX_DEPTH             16     // raw frames buffered between Wi-Fi task and decoder
+
+#define DATA_URI "https://athome.rodlandfarms.com/api/esp/data?"
+
+// ---- Node ------------------------------------------------------------------------
+
+static RTC_DATA_ATTR rtc_sequence_t espnow_seq;   // nonce input: must never repeat
+static QueueHandle_t send_status_q;
+
+static void on_send(const uint8_t *mac_addr, esp_now_send_status_t status) {
+    xQueueOverwrite(send_status_q, &status);
+}
+
+// Bare STA bring-up: enough for ESP-NOW, no association and no netif/DHCP traffic.
+static esp_err_t radio_start(uint8_t channel) {
+    esp_err_t err = esp_netif_init();
+    if (err == ESP_OK) err = esp_event_loop_create_default();
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    if (err == ESP_OK) err = esp_wifi_init(&cfg);
+    if (err == ESP_OK) err = esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    if (err == ESP_OK) err = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (err == ESP_OK) err = esp_wifi_start();
+    if (err == ESP_OK) err = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    if (err == ESP_OK) err = esp_now_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "radio start failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static bool send_with_ack(const espnow_config_t *cfg, const uint8_t *frame, size_t len) {
+    send_status_q = xQueueCreate(1, sizeof(esp_now_send_status_t));
+    esp_now_register_send_cb(on_send);
+
+    esp_now_peer_info_t peer = {
+        .channel = cfg->channel,
+        .ifidx = WIFI_IF_STA,
+        .encrypt = false,          // frame is already AES-CCM sealed
+    };
+    memcpy(peer.peer_addr, cfg->gateway_mac, 6);
+    esp_err_t err = esp_now_add_peer(&peer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_now_add_peer failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    for (int attempt = 1; attempt <= ESPNOW_MAX_ATTEMPTS; attempt++) {
+        esp_now_send_status_t status = ESP_NOW_SEND_FAIL;
+        xQueueReset(send_status_q);
+        err = esp_now_send(cfg->gateway_mac, frame, len);
+        if (err == ESP_OK &&
+            xQueueReceive(send_status_q, &status, pdMS_TO_TICKS(ESPNOW_ACK_TIMEOUT_MS)) == pdTRUE &&
+            status == ESP_NOW_SEND_SUCCESS) {
+            ESP_LOGI(TAG, "frame acked (attempt %d/%d)", attempt, ESPNOW_MAX_ATTEMPTS);
+            return true;
+        }
+        ESP_LOGW(TAG, "no ack (attempt %d/%d, err=%s)", attempt, ESPNOW_MAX_ATTEMPTS, esp_err_to_name(err));
+        vTaskDelay(pdMS_TO_TICKS(10 + esp_random() % 40));   // de-correlate from other nodes
+    }
+    return false;
+}
+
+void espnow_node_task(void *pvParameters) {
+    SensorReading reading;
+    governor_enter(WAKE_PHASE_SENSE);
+    take_reading(&reading);
+    governor_enter(WAKE_PHASE_UPLOAD);
+
+    espnow_config_t cfg;
+    if (nvs_get_espnow_config(&cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "No ESP-NOW config in NVS (espnow_channel/gateway/key) — reading dropped");
+        enter_deep_sleep(nvs_get_sleep_seconds());
+    }
+
+    // The seq is the CCM nonce: without a committed reservation, don't send at all.
+    uint32_t seq = sequence_next(&espnow_seq, "espnow_seq");
+    if (seq == 0) {
+        ESP_LOGE(TAG, "No sequence number reserved — reading dropped");
+        enter_deep_sleep(nvs_get_sleep_seconds());
+    }
+
+    PackedReading packed;
+    pack_reading(&reading, &packed);
+    espnow_reading_t out = {
+        .seq = seq,
+        .power = packed.power,
+        .moisture = packed.moisture,
+        .soc_raw = packed.soc_raw,
+        .crate_raw = packed.crate_raw,
+    };
+    snprintf(out.name, sizeof(out.name), "%s", main_struct.name);
+    snprintf(out.location, sizeof(out.location), "%s", main_struct.location);
+    snprintf(out.api_token, sizeof(out.api_token), "%s", main_struct.apiToken);
+
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    uint8_t frame[ESPNOW_FRAME_MAX_LEN];
+    size_t len = espnow_frame_seal(&out, mac, cfg.key, frame, sizeof(frame));
+
+    bool sent = len > 0 && radio_start(cfg.channel) == ESP_OK && send_with_ack(&cfg, frame, len);
+    ESP_LOGI(TAG, "seq=%lu (%u bytes) %s", (unsigned long)out.seq, (unsigned)len,
+             sent ? "delivered to gateway" : "NOT delivered (reading lost)");
+
+    enter_deep_sleep(nvs_get_sleep_seconds());
+    vTaskDelete(NULL);
+}
+
+// ---- Gateway ---------------------------------------------------------------------
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t len;
+    uint8_t data[ESPNOW_FRAME_MAX_LEN];
+} rx_frame_t;
+
+static espnow_queue_t gw_queue;
+static SemaphoreHandle_t gw_lock;
+static QueueHandle_t gw_rx;
+static espnow_config_t gw_cfg;
+static espnow_entry_t gw_batch[GW_BATCH_SIZE];   // copied out so the lock isn't held across I/O
+static uint32_t gw_rx_overflow = 0;
+
+// Runs in the Wi-Fi task: copy and hand off, nothing else.
+static void on_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+    if (len <= 0 || len > ESPNOW_FRAME_MAX_LEN) {
+        return;
+    }
+    rx_frame_t f;
+    memcpy(f.mac, info->src_addr, 6);
+    f.len = (uint8_t)len;
+    memcpy(f.data, data, len);
+    if (xQueueSend(gw_rx, &f, 0) != pdTRUE) {
+        gw_rx_overflow++;
+    }
+}
+
+static void gateway_rx_task(void *pvParameters) {
+    rx_frame_t f;
+    while (1) {
+        if (xQueueReceive(gw_rx, &f, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        espnow_reading_t r;
+        espnow_frame_status_t st = espnow_frame_open(f.data, f.len, f.mac, gw_cfg.key, &r);
+        if (st != ESPNOW_FRAME_OK) {
+            ESP_LOGW(TAG, "frame from " MACSTR " rejected (%d)", MAC2STR(f.mac), st);
+            continue;
+        }
+        xSemaphoreTake(gw_lock, portMAX_DELAY);
+        bool queued = espnow_queue_push(&gw_queue, f.mac, &r);
+        size_t pending = espnow_queue_count(&gw_queue);
+        xSemaphoreGive(gw_lock);
+        ESP_LOGI(TAG, MACSTR " seq=%lu %s (%u pending)", MAC2STR(f.mac), (unsigned long)r.seq,
+                 queued ? "queued" : "duplicate", (unsigned)pending);
+    }
+}
+
+static void emit_entry(body_writer_t *w, void *ctx) {
+    const espnow_entry_t *e = ctx;
+    PackedReading packed = {
+        .moisture = e->reading.moisture,
+        .power = e->reading.power,
+        .soc_raw = e->reading.soc_raw,
+        .crate_raw = e->reading.crate_raw,
+    };
+    SensorReading reading;
+    unpack_reading(&packed, &reading);
+    char hostname[13];
+    snprintf(hostname, sizeof(hostname), "%02X%02X%02X%02X%02X%02X",
+             e->mac[0], e->mac[1], e->mac[2], e->mac[3], e->mac[4], e->mac[5]);
+    write_reading_form(w, &reading, hostname, e->reading.name, e->reading.location,
+                       e->reading.api_token);
+}
+
+// Copies up to GW_BATCH_SIZE queued readings, POSTs them over one connection, then
+// drops the ones the server accepted (the leading run of 200s; see
+// espnow_batch_delivered()). The lock is not held across the network I/O.
+static void gateway_flush(void) {
+    xSemaphoreTake(gw_lock, portMAX_DELAY);
+    size_t n = espnow_queue_count(&gw_queue);
+    if (n > GW_BATCH_SIZE) {
+        n = GW_BATCH_SIZE;
+    }
+    void *bodies[GW_BATCH_SIZE];
+    for (size_t i = 0; i < n; i++) {
+        gw_batch[i] = *espnow_queue_peek(&gw_queue, i);
+        bodies[i] = &gw_batch[i];
+    }
+    uint32_t evicted_before = gw_queue.evicted;
+    xSemaphoreGive(gw_lock);
+
+    if (n == 0) {
+        return;
+    }
+    int status_codes[GW_BATCH_SIZE];
+    int answered = POST_batch(DATA_URI, emit_entry, bodies, (int)n, status_codes);
+    size_t delivered = espnow_batch_delivered(status_codes, answered);
+
+    // Readings evicted while we were posting came off the front, i.e. out of this batch.
+    xSemaphoreTake(gw_lock, portMAX_DELAY);
+    espnow_queue_settle(&gw_queue, delivered, gw_queue.evicted - evicted_before);
+    ESP_LOGI(TAG, "forwarded %u/%u, %d answered (%u still queued, %lu evicted, %lu dup, %lu rx overflow)",
+             (unsigned)delivered, (unsigned)n, answered, (unsigned)espnow_queue_count(&gw_queue),
+             (unsigned long)gw_queue.evicted, (unsigned long)gw_queue.duplicates,
+             (unsigned long)gw_rx_overflow);
+    xSemaphoreGive(gw_lock);
+}
+
+void espnow_gateway_task(void *pvParameters) {
+    if (nvs_get_espnow_config(&gw_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "No ESP-NOW config in NVS (espnow_key) — gateway disabled");
+        vTaskDelete(NULL);
+    }
+
+    // Nodes transmit on the configured channel; an associated STA can only listen on
+    // its AP's channel, so the two must match.
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK && ap.primary != gw_cfg.channel) {
+        ESP_LOGW(TAG, "AP is on channel %u but nodes are configured for %u",
+                 ap.primary, gw_cfg.channel);
+    }
+    esp_wifi_set_ps(WIFI_PS_NONE);   // modem sleep would miss node frames
+
+    espnow_queue_init(&gw_queue);
+    gw_lock = xSemaphoreCreateMutex();
+    gw_rx = xQueueCreate(GW_RX_DEPTH, sizeof(rx_frame_t));
+    ESP_ERROR_CHECK(esp_now_init());
+    ESP_ERROR_CHECK(esp_now_register_recv_cb(on_recv));
+    // Dynamic on purpose: only gateways need it, so it shouldn't cost every node .bss.
+    xTaskCreate(gateway_rx_task, "espnow_rx", 4096, NULL, 6, NULL);
+    ESP_LOGI(TAG, "Gateway listening on channel %u", gw_cfg.channel);
+
+    TickType_t last_flush = xTaskGetTickCount();
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        xSemaphoreTake(gw_lock, portMAX_DELAY);
+        size_t pending = espnow_queue_count(&gw_queue);
+        xSemaphoreGive(gw_lock);
+
+        bool full = pending >= GW_BATCH_SIZE;
+        bool stale = pending > 0 && (xTaskGetTickCount() - last_flush) >= pdMS_TO_TICKS(GW_FLUSH_MS);
+        if (full || stale) {
+            gateway_flush();
+            last_flush = xTaskGetTickCount();
+        }
+    }
+}
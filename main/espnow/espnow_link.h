@@ -0,0 +1,14 @@
+#ifndef ESPNOW_LINK_H
+#define ESPNOW_LINK_H
+
+// Node (TRANSPORT_ESPNOW): read, send one encrypted frame to the gateway on the
+// configured channel, wait for the link-layer ack, deep-sleep. No association, DHCP,
+// TLS or HTTP on the battery unit.
+void espnow_node_task(void *pvParameters);
+
+// Gateway (TRANSPORT_ESPNOW_GATEWAY): USB-powered unit that stays associated to the AP,
+// receives node frames and forwards them to /api/esp/data in keep-alive batches. Started
+// from the IP event handler once Wi-Fi is up; never sleeps.
+void espnow_gateway_task(void *pvParameters);
+
+#endif // ESPNOW_LINK_H
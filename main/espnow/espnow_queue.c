@@ -0,0 +1,93 @@
+#include <string.h>
+#include "espnow_queue.h"
+
+void espnow_queue_init(espnow_queue_t *q) {
+    memset(q, 0, sizeof(*q));
+}
+
+static espnow_node_seen_t *node_slot(espnow_queue_t *q, const uint8_t mac[6], bool *is_new) {
+    for (size_t i = 0; i < q->node_count; i++) {
+        if (memcmp(q->nodes[i].mac, mac, 6) == 0) {
+            *is_new = false;
+            return &q->nodes[i];
+        }
+    }
+    *is_new = true;
+    espnow_node_seen_t *slot;
+    if (q->node_count < ESPNOW_MAX_NODES) {
+        slot = &q->nodes[q->node_count++];
+    } else {
+        // Table full: forget the node we heard from least recently. Worst case it can
+        // replay one stale frame before its seq is tracked again.
+        slot = &q->nodes[0];
+        for (size_t i = 1; i < ESPNOW_MAX_NODES; i++) {
+            if (q->nodes[i].last_used < slot->last_used) {
+                slot = &q->nodes[i];
+            }
+        }
+    }
+    memcpy(slot->mac, mac, 6);
+    slot->last_seq = 0;
+    return slot;
+}
+
+bool espnow_queue_push(espnow_queue_t *q, const uint8_t mac[6], const espnow_reading_t *reading) {
+    bool is_new;
+    espnow_node_seen_t *node = node_slot(q, mac, &is_new);
+    if (!is_new && reading->seq <= node->last_seq) {
+        q->duplicates++;
+        return false;
+    }
+    node->last_seq = reading->seq;
+    node->last_used = ++q->pushes;
+
+    if (q->count == ESPNOW_QUEUE_CAPACITY) {
+        q->head = (q->head + 1) % ESPNOW_QUEUE_CAPACITY;
+        q->count--;
+        q->evicted++;
+    }
+    espnow_entry_t *e = &q->entries[(q->head + q->count) % ESPNOW_QUEUE_CAPACITY];
+    memcpy(e->mac, mac, 6);
+    e->reading = *reading;
+    q->count++;
+    return true;
+}
+
+size_t espnow_queue_count(const espnow_queue_t *q) {
+    return q->count;
+}
+
+const espnow_entry_t *espnow_queue_peek(const espnow_queue_t *q, size_t index) {
+    if (index >= q->count) {
+        return NULL;
+    }
+    return &q->entries[(q->head + index) % ESPNOW_QUEUE_CAPACITY];
+}
+
+void espnow_queue_drop(espnow_queue_t *q, size_t n) {
+    if (n > q->count) {
+        n = q->count;
+    }
+    q->head = (q->head + n) % ESPNOW_QUEUE_CAPACITY;
+    q->count -= n;
+}
+
+size_t espnow_batch_delivered(const int *status_codes, int answered) {
+    size_t n = 0;
+    while ((int)n < answered && status_codes[n] == 200) {
+        n++;
+    }
+    return n;
+}
+
+size_t espnow_queue_settle(espnow_queue_t *q, size_t delivered, uint32_t evicted_since) {
+    if (delivered <= evicted_since) {
+        return 0;   // eviction already took every delivered entry off the front
+    }
+    size_t n = delivered - evicted_since;
+    if (n > q->count) {
+        n = q->count;
+    }
+    espnow_queue_drop(q, n);
+    return n;
+}
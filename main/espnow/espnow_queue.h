@@ -0,0 +1,59 @@
+#ifndef ESPNOW_QUEUE_H
+#define ESPNOW_QUEUE_H
+
+// Gateway-side aggregation queue: decoded node readings wait here until the forwarder
+// ships them to /api/esp/data in one keep-alive batch. Pure C, no locking — the
+// gateway wraps every call in its own mutex — so it runs unchanged on a host.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "espnow_frame.h"
+
+#define ESPNOW_QUEUE_CAPACITY  64    // readings held while the backend is unreachable
+#define ESPNOW_MAX_NODES       64    // nodes tracked for duplicate/replay rejection
+
+typedef struct {
+    uint8_t mac[6];
+    espnow_reading_t reading;
+} espnow_entry_t;
+
+typedef struct {
+    uint8_t  mac[6];
+    uint32_t last_seq;
+    uint32_t last_used;     // push counter value, for evicting the stalest node
+} espnow_node_seen_t;
+
+typedef struct {
+    espnow_entry_t entries[ESPNOW_QUEUE_CAPACITY];
+    size_t head;             // oldest entry
+    size_t count;
+    espnow_node_seen_t nodes[ESPNOW_MAX_NODES];
+    size_t node_count;
+    uint32_t pushes;
+    uint32_t evicted;        // oldest readings dropped because the queue was full
+    uint32_t duplicates;     // frames whose seq we had already accepted (retries, replays)
+} espnow_queue_t;
+
+void espnow_queue_init(espnow_queue_t *q);
+
+// Queues a reading unless its seq is not newer than the last one accepted from that
+// MAC (a node re-sends when the link-layer ack is lost). When full, the oldest reading
+// is evicted so the freshest data wins. Returns false for duplicates.
+bool espnow_queue_push(espnow_queue_t *q, const uint8_t mac[6], const espnow_reading_t *reading);
+
+size_t espnow_queue_count(const espnow_queue_t *q);
+const espnow_entry_t *espnow_queue_peek(const espnow_queue_t *q, size_t index);   // 0 = oldest
+void espnow_queue_drop(espnow_queue_t *q, size_t n);                             // remove n oldest
+
+// How many of a batch's bodies reached the backend: the leading run answered with 200.
+// A rejected body and everything after it stay queued for the next flush, in order, so
+// a 4xx/5xx never loses a reading (only eviction of a full queue does).
+size_t espnow_batch_delivered(const int *status_codes, int answered);
+
+// After POSTing the oldest entries: drops the first `delivered` of them, less the
+// `evicted_since` that the queue evicted from the front while the batch was in flight.
+// Returns the number dropped.
+size_t espnow_queue_settle(espnow_queue_t *q, size_t delivered, uint32_t evicted_since);
+
+#endif // ESPNOW_QUEUE_H
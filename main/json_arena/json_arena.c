@@ -0,0 +1,50 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "cJSON.h"
+#include "json_arena.h"
+
+#define ARENA_ALIGN 8u   // cJSON nodes hold a double
+
+static uint8_t block[JSON_ARENA_BYTES] __attribute__((aligned(ARENA_ALIGN)));
+static json_arena_stats_t stats_now;
+static atomic_flag busy = ATOMIC_FLAG_INIT;
+
+static void *arena_malloc(size_t size) {
+    size_t start = (stats_now.used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size > sizeof(block) || start > sizeof(block) - size) {
+        stats_now.failed++;
+        return NULL;
+    }
+    stats_now.allocs++;
+    stats_now.used = start + size;
+    return block + start;
+}
+
+static void arena_free(void *ptr) {
+    if (ptr != NULL) {
+        stats_now.frees++;
+    }
+}
+
+bool json_arena_begin(void) {
+    if (atomic_flag_test_and_set(&busy)) {
+        return false;
+    }
+    memset(&stats_now, 0, sizeof(stats_now));
+    cJSON_Hooks hooks = { .malloc_fn = arena_malloc, .free_fn = arena_free };
+    cJSON_InitHooks(&hooks);
+    return true;
+}
+
+void json_arena_end(json_arena_stats_t *stats) {
+    cJSON_InitHooks(NULL);   // back to malloc/free
+    if (stats) {
+        *stats = stats_now;
+    }
+    stats_now.used = 0;
+    atomic_flag_clear(&busy);
+}
+
+bool json_arena_exhausted(void) {
+    return stats_now.failed > 0;
+}
@@ -0,0 +1,41 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+// Bump allocator for cJSON. A parse builds its tree out of dozens of small mallocs
+// (one per node, key and string value), and freeing them leaves holes in the heap right
+// before the TLS handshake needs its large contiguous buffers. Between json_arena_begin()
+// and json_arena_end(), cJSON allocates from one static block instead. Each allocation
+// moves a pointer forward, free() does nothing, and end() drops the whole tree at once
+// and puts malloc/free back.
+//
+// Running out is not silent: the failing allocation returns NULL, so cJSON_Parse() fails
+// cleanly and json_arena_exhausted() tells the caller why. cJSON's hooks are global, so
+// only one scope can be open at a time. The callers, firmware.json and BLE provisioning,
+// never run together. Pure C, so tools/json_arena runs it on a host.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef JSON_ARENA_BYTES
+#define JSON_ARENA_BYTES 6144   // a full 4 KB provisioning object with room to spare
+#endif
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;      // calls only; nothing is reclaimed before end()
+    uint32_t failed;     // allocations refused because the block was full
+    size_t   used;       // bytes handed out, alignment included
+} json_arena_stats_t;
+
+// Installs the arena hooks over an empty block. False if a scope is already open.
+bool json_arena_begin(void);
+
+// Restores malloc/free and empties the block. Every cJSON pointer obtained inside the
+// scope is invalid afterwards (cJSON_Delete() is optional). stats may be NULL.
+void json_arena_end(json_arena_stats_t *stats);
+
+// True once an allocation in the current scope has been refused.
+bool json_arena_exhausted(void);
+
+#endif // JSON_ARENA_H
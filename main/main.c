@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
@@ -7,9 +9,9 @@
 #include "esp_event.h"
 #include "esp_ota_ops.h"
 #include "esp_http_client.h"
-#include "driver/rtc_io.h"
 #include "nvs_flash.h"
 #include "esp_log.h"
+#include "esp_bt.h"
 #include "esp_nimble_hci.h"
 #include "nimble/nimble_port.h"
 #include "nimble/nimble_port_freertos.h"
@@ -19,19 +21,33 @@
 #include "store/config/ble_store_config.h"   // key/bond store for BLE pairing
 #include "sdkconfig.h"
 #include "cJSON.h"
+#include "json_arena.h"
 #include "main.h"
 #include "wifi_drv.h"
 #include "nvs_drv.h"
 #include "driver/adc.h"
 #include "data.h"
 #include "rest_methods.h"
+#include "ble_beacon.h"
+#include "ble_bulk.h"
+#include "espnow_link.h"
+#include "wake_governor.h"
+#include "mem_diag.h"
+#include "sampler.h"
+#include "link_policy.h"
+#include "wake_cycle.h"
+#include "usb_stream.h"
+#include "wake_stub.h"
+#include "diag_console.h"
+#include "sleep_mgr.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 #include "esp_rom_gpio.h" 
 #include "esp_sleep.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_mac.h"  // Include the correct header for esp_read_mac
-#include "cert.h"
 #include "esp_sntp.h"
 #include "esp_wifi.h"
 
@@ -41,7 +57,6 @@
 #define HOSTNAME_UUID 0xFEF9
 #define MANUFACTURER_NAME "Rodland Farms"
 // Define GPIO pin for the button
-#define BUTTON_GPIO 3   // V5: SW1 is on IO3 (RTC-capable, used for ext0 wake). Was GPIO6 (V4/legacy).
 #define OTA_URL "https://athome.rodlandfarms.com/firmware.bin"
 #define SERVER_URL "https://athome.rodlandfarms.com/firmware.json"
 #define CURRENT_VERSION "1.0.0"  // Define the current version number of your firmware
@@ -57,11 +72,9 @@ uint16_t hostname_attr_handle;
 main_struct_t main_struct = {.credentials_recv = 0, .isProvisioned = false};
 
 // NTP Sync Callback
-static bool time_is_set = false;
-
 void time_sync_notification_cb(struct timeval *tv) {
     ESP_LOGI("NTP", "Time synchronized with NTP server");
-    time_is_set = true;
+    wake_post(WAKE_EV_TIME_SYNCED);
 }
 
 // Initialize SNTP and sync time
@@ -75,13 +88,6 @@ void initialize_sntp() {
     esp_sntp_restart();
 }
 
-// Wait for time synchronization
-void wait_for_time_sync() {
-    while (!time_is_set) {
-        vTaskDelay(1000 / portTICK_PERIOD_MS);  // Wait for 1 second
-    }
-}
-
 // Notification function for PROV_STATUS_UUID
 void notify_prov_status(uint8_t status_data)
 {
@@ -131,24 +137,73 @@ void get_wifi_mac_address()
 }
 #define MAX_JSON_SIZE 4096  // Adjust buffer size as needed
 
-// Global buffer to store incoming JSON
-static char json_buffer[MAX_JSON_SIZE] = {0};
+// Reassembly buffer for incoming provisioning JSON. Allocated by ble_advert(): a
+// provisioned wake never opens BLE, so it shouldn't carry 4 KB of .bss for it.
+static char *json_buffer = NULL;
 static int json_index = 0;  // Track buffer position
 
+// Provisioned wakes hand the BT controller and NimBLE memory back to the heap (see
+// release_bt_memory()); that can't be undone without a reset. If such a wake later needs
+// BLE re-provisioning it restarts with this set, and the next boot goes straight to
+// provisioning. RTC_NOINIT, like the backlog, so it survives esp_restart().
+#define PROVISION_REQUEST_MAGIC 0x50524f56u   // "PROV"
+static RTC_NOINIT_ATTR uint32_t provision_request;
+static bool bt_released = false;
+
 static void send_hostname(void);  // forward decl: notify hostname on 0xFEF9
 void ble_app_advertise(void);     // forward decl: (re)start BLE advertising
 extern void ble_store_config_init(void);  // NimBLE key/bond store init (ESP-IDF provides it)
 
 
+// Statically allocated long-lived tasks; see mem_diag.h. Sizes in bytes.
+STATIC_TASK_DEFINE(button_task, 2048);
+STATIC_TASK_DEFINE(blink_task, 4096);   // also ends an expired provisioning window in deep sleep
+STATIC_TASK_DEFINE_SHARED(wake_task);   // sized per role: WAKE_STACK_* in main.h
+
+TaskHandle_t start_wake_task(TaskFunction_t fn, const char *name, uint32_t stack_bytes) {
+    return static_task_start_sized(&wake_task, stack_bytes, fn, name, NULL, 5);
+}
+
+// Decodes exactly 2*len hex digits (no separators) into out. Used for MAC/key fields.
+static bool parse_hex(const char *hex, uint8_t *out, size_t len) {
+    if (strlen(hex) != len * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned int byte;
+        if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1]) ||
+            sscanf(&hex[2 * i], "%2x", &byte) != 1) {
+            return false;
+        }
+        out[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
 // Try to parse the accumulated provisioning JSON.
 // Returns true once a COMPLETE JSON object has been received (so the caller resets the
 // reassembly buffer), false if it isn't complete yet (keep accumulating BLE chunks).
 // Using cJSON_Parse success as the "complete" signal — instead of the old "buffer ends
 // in '}'" heuristic — is string-aware, so a '}' inside a value (e.g. a WiFi password)
 // landing on a chunk boundary can no longer trigger an early/failed parse.
+//
+// The tree lives in the JSON arena (json_arena.h) for the duration of the call.
 static bool parse_json(void) {
+    if (!json_arena_begin()) {
+        ESP_LOGE(TAG, "JSON arena in use; chunk kept for the next attempt");
+        return false;
+    }
     cJSON *root = cJSON_Parse(json_buffer);
     if (!root) {
+        if (json_arena_exhausted()) {
+            // More nodes than the arena holds: it will never parse, so drop it rather
+            // than wait for chunks that can't help.
+            ESP_LOGE(TAG, "Provisioning JSON needs more than the %d-byte JSON arena; dropped",
+                     JSON_ARENA_BYTES);
+            json_index = 0;
+            memset(json_buffer, 0, MAX_JSON_SIZE);
+        }
+        json_arena_end(NULL);
         return false;  // not a complete JSON object yet; wait for more chunks
     }
 
@@ -174,6 +229,116 @@ static bool parse_json(void) {
             nvs_set_sleep_seconds((uint32_t)sleep->valueint);
         }
 
+        // Optional: per-wake awake-time budget (ms) for the wake governor.
+        cJSON *budget = cJSON_GetObjectItem(root, "wake_budget_ms");
+        if (cJSON_IsNumber(budget) && budget->valueint >= 5000) {
+            nvs_set_wake_budget_ms((uint32_t)budget->valueint);
+        }
+
+        // Optional: consecutive failed Wi-Fi wakes before BLE re-provisioning opens by
+        // itself (0 = only on a button wake).
+        cJSON *reprov = cJSON_GetObjectItem(root, "reprovision_after");
+        if (cJSON_IsNumber(reprov) && reprov->valueint >= 0) {
+            nvs_set_reprovision_after((uint32_t)reprov->valueint);
+        }
+
+        // Optional: radio-free sampling interval between uploads (seconds, 0 = off).
+        cJSON *sample = cJSON_GetObjectItem(root, "sample_seconds");
+        if (cJSON_IsNumber(sample) && (sample->valueint == 0 || sample->valueint >= (int)SAMPLER_MIN_SECONDS)) {
+            nvs_set_sample_seconds((uint32_t)sample->valueint);
+        }
+
+        // Optional: reading interval while on USB power; 0 turns streaming off.
+        cJSON *stream = cJSON_GetObjectItem(root, "stream_seconds");
+        if (cJSON_IsNumber(stream) && (stream->valueint == 0 || stream->valueint >= (int)STREAM_MIN_SECONDS)) {
+            nvs_set_stream_seconds((uint32_t)stream->valueint);
+        }
+
+        // Optional: wake-stub USB checks while streaming is configured; 0 (default) = off.
+        cJSON *usb_check = cJSON_GetObjectItem(root, "usb_check_seconds");
+        if (cJSON_IsNumber(usb_check) &&
+            (usb_check->valueint == 0 || usb_check->valueint >= (int)WAKE_STUB_MIN_SLICE_S)) {
+            nvs_set_usb_check_seconds((uint32_t)usb_check->valueint);
+        }
+
+        // Optional: report-by-exception deadbands (whole percent) and heartbeat (skipped
+        // wakes before a forced upload; 0 uploads every wake).
+        cJSON *rbe_moisture = cJSON_GetObjectItem(root, "rbe_moisture");
+        cJSON *rbe_soc = cJSON_GetObjectItem(root, "rbe_soc");
+        cJSON *rbe_heartbeat = cJSON_GetObjectItem(root, "rbe_heartbeat");
+        if (rbe_moisture || rbe_soc || rbe_heartbeat) {
+            report_config_t cfg;
+            nvs_get_report_config(&cfg);   // start from what's stored, or the defaults
+            if (cJSON_IsNumber(rbe_moisture) && rbe_moisture->valueint >= 0 && rbe_moisture->valueint <= 100) {
+                cfg.moisture_pct = (uint8_t)rbe_moisture->valueint;
+            }
+            if (cJSON_IsNumber(rbe_soc) && rbe_soc->valueint >= 0 && rbe_soc->valueint <= 100) {
+                cfg.soc_pct = (uint8_t)rbe_soc->valueint;
+            }
+            if (cJSON_IsNumber(rbe_heartbeat) && rbe_heartbeat->valueint >= 0 && rbe_heartbeat->valueint <= 0xFFFF) {
+                cfg.heartbeat = (uint16_t)rbe_heartbeat->valueint;
+            }
+            nvs_set_report_config(&cfg);
+        }
+
+        // Optional: uplink transport ("https" default, "ble_beacon"). Unknown names are
+        // ignored so an older firmware doesn't brick itself on a newer app's value.
+        cJSON *transport = cJSON_GetObjectItem(root, "transport");
+        if (cJSON_IsString(transport)) {
+            int t = transport_from_name(transport->valuestring);
+            if (t >= 0) {
+                nvs_set_transport((uplink_transport_t)t);
+            } else {
+                ESP_LOGW(TAG, "Unknown transport '%s' ignored", transport->valuestring);
+            }
+        }
+
+        // Optional: MQTT broker for the "mqtt" transport (mqtts://host:port).
+        cJSON *mqtt_uri = cJSON_GetObjectItem(root, "mqtt_uri");
+        if (cJSON_IsString(mqtt_uri)) {
+            if (strlen(mqtt_uri->valuestring) < MQTT_URI_MAX &&
+                (strncmp(mqtt_uri->valuestring, "mqtts://", 8) == 0 ||
+                 strncmp(mqtt_uri->valuestring, "mqtt://", 7) == 0)) {
+                nvs_set_mqtt_uri(mqtt_uri->valuestring);
+            } else {
+                ESP_LOGW(TAG, "mqtt_uri must be mqtt(s)://host:port; ignored");
+            }
+        }
+
+        // Optional: CoAP server for the "coap" transport (coaps://host:port).
+        cJSON *coap_uri = cJSON_GetObjectItem(root, "coap_uri");
+        if (cJSON_IsString(coap_uri)) {
+            if (strlen(coap_uri->valuestring) < COAP_URI_MAX &&
+                (strncmp(coap_uri->valuestring, "coaps://", 8) == 0 ||
+                 strncmp(coap_uri->valuestring, "coap://", 7) == 0)) {
+                nvs_set_coap_uri(coap_uri->valuestring);
+            } else {
+                ESP_LOGW(TAG, "coap_uri must be coap(s)://host:port; ignored");
+            }
+        }
+
+        // Optional: ESP-NOW link settings, needed by both "espnow" nodes and the
+        // "espnow_gateway". Any subset may be sent; missing fields keep their NVS value.
+        cJSON *en_channel = cJSON_GetObjectItem(root, "espnow_channel");
+        cJSON *en_gateway = cJSON_GetObjectItem(root, "espnow_gateway");
+        cJSON *en_key = cJSON_GetObjectItem(root, "espnow_key");
+        if (en_channel || en_gateway || en_key) {
+            espnow_config_t cfg = {0};
+            nvs_get_espnow_config(&cfg);   // start from what's stored, if anything
+            if (cJSON_IsNumber(en_channel) && en_channel->valueint >= 1 && en_channel->valueint <= 13) {
+                cfg.channel = (uint8_t)en_channel->valueint;
+            }
+            if (en_gateway && !(cJSON_IsString(en_gateway) &&
+                                parse_hex(en_gateway->valuestring, cfg.gateway_mac, sizeof(cfg.gateway_mac)))) {
+                ESP_LOGW(TAG, "espnow_gateway must be 12 hex digits; ignored");
+            }
+            if (en_key && !(cJSON_IsString(en_key) &&
+                            parse_hex(en_key->valuestring, cfg.key, sizeof(cfg.key)))) {
+                ESP_LOGW(TAG, "espnow_key must be 32 hex digits; ignored");
+            }
+            nvs_set_espnow_config(&cfg);
+        }
+
         ESP_LOGI(TAG, "Parsed Data: SSID=%s, Name=%s, Location=%s", main_struct.ssid, main_struct.name, main_struct.location);
 
         // Save to NVS
@@ -183,6 +348,7 @@ static bool parse_json(void) {
     }
 
     cJSON_Delete(root);  // Free JSON object
+    json_arena_end(NULL);
     return true;  // a complete object was consumed -> caller resets the buffer
 }
 
@@ -270,6 +436,15 @@ static const struct ble_gatt_svc_def gatt_svcs[] = {
                 .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC,
                 .access_cb = device_write,
             },
+            {
+                // Backlog download (ble_bulk.h): control writes in, readings notified
+                // out. Same encrypted link as config.
+                .uuid = BLE_UUID16_DECLARE(BULK_CHR_UUID),
+                .access_cb = ble_bulk_access,
+                .val_handle = &ble_bulk_attr_handle,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP |
+                         BLE_GATT_CHR_F_WRITE_ENC | BLE_GATT_CHR_F_NOTIFY,
+            },
             {0} // Terminating the characteristics array
         }
     },
@@ -327,7 +502,7 @@ static int ble_gap_event(struct ble_gap_event *event, void *arg){
             // No connect-time notify: the app READs 0xFEF9 (which pairs), then writes
             // config; the confirmation notify is sent from device_write after save.
         } else {
-            ble_advert();
+            ble_app_advertise();   // the stack is already up; just advertise again
         }
 
         break;
@@ -335,6 +510,7 @@ static int ble_gap_event(struct ble_gap_event *event, void *arg){
     case BLE_GAP_EVENT_DISCONNECT:
         ESP_LOGI("GAP", "BLE GAP EVENT DISCONNECT (reason=%d)", event->disconnect.reason);
         g_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+        ble_bulk_on_disconnect();
         if (main_struct.isProvisioned) {
             // Config was saved (set in device_write after parse_json). Reboot to join WiFi.
             ESP_LOGI("GAP", "Provisioned -> rebooting to join WiFi.");
@@ -349,6 +525,10 @@ static int ble_gap_event(struct ble_gap_event *event, void *arg){
         }
         break;
 
+    case BLE_GAP_EVENT_NOTIFY_TX:
+        ble_bulk_on_notify_tx(event);   // keeps a backlog transfer's window full
+        break;
+
     case BLE_GAP_EVENT_ENC_CHANGE:
         // Link encryption (pairing) completed or changed.
         ESP_LOGI("GAP", "Encryption change; status=%d", event->enc_change.status);
@@ -366,10 +546,10 @@ static int ble_gap_event(struct ble_gap_event *event, void *arg){
             return BLE_GAP_REPEAT_PAIRING_RETRY;
         }
     // Advertise again after completion of the event/advertisement
+    // Advertising window over (reason BLE_HS_ETIMEOUT). blink_led() restarts it after
+    // the pause, or ends the provisioning window.
     case BLE_GAP_EVENT_ADV_COMPLETE:
-        ESP_LOGI("GAP", "BLE GAP EVENT CONNECT %s", event->connect.status == 0 ? "OK!" : "FAILED!");
-        ble_advert();
-
+        ESP_LOGI("GAP", "BLE GAP EVENT ADV COMPLETE (reason=%d)", event->adv_complete.reason);
         break;
     default:
         break;
@@ -379,15 +559,51 @@ static int ble_gap_event(struct ble_gap_event *event, void *arg){
 
 #define LED_GPIO 34   // V5: status LED (LED2) is on IO34. Was GPIO2 (V4/legacy).
 
+// Provisioning is a bounded window, not a state the device can get stuck in: a battery
+// node waiting on an app that never comes used to advertise (and blink) until flat.
+#define PROV_SESSION_S      600     // window ends after 10 min without a connection
+#define PROV_CONNECTED_S    120     // an open connection keeps it alive this much longer
+#define PROV_ADV_WINDOW_MS  30000   // advertise this long...
+#define PROV_ADV_PAUSE_MS   30000   // ...then stay silent this long
+#define PROV_ADV_ITVL_MS    250     // advertising interval while on
+
+// Status LED and advertising duty cycle for one provisioning window. When it expires a
+// provisioned device goes back to its (backed-off) sleep; an unprovisioned one sleeps
+// until the button is pressed.
 void blink_led(void *arg) {
     esp_rom_gpio_pad_select_gpio(LED_GPIO);
     gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
     gpio_set_level(LED_GPIO, 0);  // Initially turn off the LED
-    while (!main_struct.credentials_recv) {
+
+    int64_t session_end = esp_timer_get_time() + (int64_t)PROV_SESSION_S * 1000000;
+    int64_t paused_at = 0;
+    while (!main_struct.isProvisioned) {
+        // Short blip once a second instead of 500/500 ms: same cue, a tenth of the current.
         gpio_set_level(LED_GPIO, 1); // Turn LED on
-        vTaskDelay(pdMS_TO_TICKS(500)); // Wait for 500ms
+        vTaskDelay(pdMS_TO_TICKS(50));
         gpio_set_level(LED_GPIO, 0); // Turn LED off
-        vTaskDelay(pdMS_TO_TICKS(500)); // Wait for 500ms
+        vTaskDelay(pdMS_TO_TICKS(950));
+
+        int64_t now = esp_timer_get_time();
+        bool connected = g_conn_handle != BLE_HS_CONN_HANDLE_NONE;
+        if (connected) {
+            int64_t hold = now + (int64_t)PROV_CONNECTED_S * 1000000;
+            session_end = hold > session_end ? hold : session_end;
+            paused_at = 0;
+        } else if (!ble_gap_adv_active()) {
+            if (paused_at == 0) {
+                paused_at = now;
+            } else if (now - paused_at >= (int64_t)PROV_ADV_PAUSE_MS * 1000 && now < session_end) {
+                paused_at = 0;
+                ble_app_advertise();
+            }
+        }
+
+        if (!connected && now >= session_end) {
+            ESP_LOGW("BLE", "Provisioning window closed without a configuration.");
+            ble_gap_adv_stop();
+            enter_deep_sleep(main_struct.credentials_recv ? nvs_get_sleep_seconds() : 0);
+        }
     }
 
     // Once the configuration is successful, turn off the LED
@@ -439,14 +655,17 @@ void ble_app_advertise(void) {
     memset(&adv_params, 0, sizeof(adv_params));
     adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;  // Connectable
     adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN; // Discoverable
+    adv_params.itvl_min = BLE_GAP_ADV_ITVL_MS(PROV_ADV_ITVL_MS);
+    adv_params.itvl_max = BLE_GAP_ADV_ITVL_MS(PROV_ADV_ITVL_MS + 50);
 
-    // Start advertising
-    rc = ble_gap_adv_start(ble_addr_type, NULL, BLE_HS_FOREVER, &adv_params, ble_gap_event, NULL);
+    // Start advertising for one window; blink_led() paces the next one.
+    rc = ble_gap_adv_start(ble_addr_type, NULL, PROV_ADV_WINDOW_MS, &adv_params, ble_gap_event, NULL);
     if (rc != 0) {
         ESP_LOGE(TAG, "Failed to start advertising, error code %d", rc);
     }
     // Start the task to blink the LED while waiting for configuration
-    xTaskCreate(blink_led, "Blink LED", 2048, NULL, 5, NULL);
+    // Static slot: re-advertising after a disconnect or pause no longer stacks up tasks.
+    static_task_start(&blink_task, blink_led, "blink_led", NULL, 5);
 }
 
 static void nimble_host_task(void *param){
@@ -476,23 +695,6 @@ void disable_ble(void)
     nimble_port_stop(); // Uncomment if you want to disable all BLE functionality
 }
 
-void check_credentials(void *arg)
-{
-    char *TAG = "CHECK_CREDS";
-    while (1)
-    {
-        //if (main_struct.credentials_recv)
-        //{
-            ESP_LOGI(TAG, "Checking WiFi Credentials");
-            wifi_init();
-            //disable_ble();
-            vTaskDelete(NULL);
-        //}
-
-        vTaskDelay(pdMS_TO_TICKS(500));
-    }
-}
-
 void nvs_init(void)
 {
     // Initialize NVS
@@ -516,7 +718,8 @@ void erase_nvs_data() {
         return;
     }
 
-    // Erase all data stored in NVS
+    // Erase all settings. Frame sequence reservations are in NVS_SEQUENCE_NAMESPACE and
+    // survive this, so a re-provisioned node never repeats a nonce under the same key.
     err = nvs_erase_all(my_handle);
     if (err != ESP_OK) {
         ESP_LOGE("NVS", "Error erasing NVS: %s", esp_err_to_name(err));
@@ -534,9 +737,8 @@ void erase_nvs_data() {
 
 // Function to configure GPIO for the button
 void configure_button_gpio() {
-    // Release any RTC hold left on the pin by enter_deep_sleep() so the button is usable
-    // while awake (the hold keeps IO3 pulled high across deep sleep for ext0 wake).
-    rtc_gpio_hold_dis(BUTTON_GPIO);
+    // sleep_mgr_boot() has already released the RTC hold that kept IO3 pulled high
+    // across deep sleep for the ext0 wake.
     esp_rom_gpio_pad_select_gpio(BUTTON_GPIO);
     gpio_set_direction(BUTTON_GPIO, GPIO_MODE_INPUT);
     gpio_set_pull_mode(BUTTON_GPIO, GPIO_PULLUP_ONLY);  // Pull-up to avoid floating state
@@ -581,24 +783,6 @@ void monitor_button_press(void *pvParameter) {
     }
 }
 
-void notify_status(void *arg)
-{
-    char *TAG = "NOTIFY_STATUS";
-    // The BLE stack is now synchronized and ready to run BLE operations
-    ESP_LOGI(TAG, "BLE sync completed.");
-
-    while (1)
-    {
-        if (main_struct.isProvisioned)
-        {
-            notify_prov_status(main_struct.isProvisioned); // Send notification
-            main_struct.isProvisioned = 0;
-
-            vTaskDelete(NULL);
-        }
-        vTaskDelay(pdMS_TO_TICKS(500)); // Check every second
-    }
-}
 // Helper function to convert the MAC address to a string
 void mac_to_string(uint8_t *mac, char *mac_str) {
     // Format only the last 4 bytes of the MAC address into the string
@@ -646,6 +830,19 @@ void ble_app_on_sync(void){
 
 void ble_advert(void){
     char *TAG = "BLE_ADVERT";
+    if (bt_released) {
+        // The wake governor already parked any held reading in the backlog (RTC_NOINIT).
+        ESP_LOGW(TAG, "BT memory was released this boot; restarting into provisioning");
+        provision_request = PROVISION_REQUEST_MAGIC;
+        esp_restart();
+    }
+    if (json_buffer == NULL) {
+        json_buffer = calloc(1, MAX_JSON_SIZE);
+        if (json_buffer == NULL) {
+            ESP_LOGE(TAG, "No heap for the provisioning buffer");
+            return;
+        }
+    }
     ESP_LOGI(TAG, "Starting BLE advertising for provisioning...");
     // Initialize NimBLE host stack
     nimble_port_init();                        // 3 - Initialize the host stack
@@ -679,12 +876,58 @@ void ble_advert(void){
 }
 
 
+// Gives the BT controller's and the NimBLE host's static memory to the heap, where TLS
+// and the HTTP buffers can use it. esp_bt_mem_release() covers the controller too (it
+// calls esp_bt_controller_mem_release() first). Only valid before the controller is
+// initialised, and BLE can't start again until the next reset.
+static void release_bt_memory(void) {
+    char *TAG = "BT_MEM";
+    size_t free_before = esp_get_free_heap_size();
+    size_t largest_before = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    esp_err_t err = esp_bt_mem_release(ESP_BT_MODE_BLE);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_bt_mem_release failed: %s", esp_err_to_name(err));
+        return;
+    }
+    bt_released = true;
+    size_t free_after = esp_get_free_heap_size();
+    ESP_LOGI(TAG, "Released BT memory: free heap %u -> %u (+%u), largest block %u -> %u",
+             (unsigned)free_before, (unsigned)free_after, (unsigned)(free_after - free_before),
+             (unsigned)largest_before, (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
 // Function to enter deep sleep based on the selected duration
+// Timer, then the other wake sources, pin holds and power domains (sleep_mgr.h), then
+// sleep. Shared by the full and the micro-wake path.
+static void sleep_now(uint32_t seconds) {
+    // First timer interval: the whole sleep, or its first slice when the wake stub
+    // checks USB in between (wake_stub.h).
+    uint64_t sleep_duration_us = wake_stub_arm(seconds);
+
+    // Configure the RTC timer to wake up after the specified sleep duration.
+    // 0 = no timer: only the button wakes us (unprovisioned, provisioning window over).
+    if (seconds > 0) {
+        esp_sleep_enable_timer_wakeup(sleep_duration_us);
+    }
+
+    // Button (ext0) and ALRT (ext1), pin holds, power domains, wake accounting.
+    sleep_mgr_prepare(seconds);
+
+    // Enter deep sleep
+    esp_deep_sleep_start();
+}
+
 void enter_deep_sleep(uint32_t seconds){
     static const char *TAG = "SLEEP";
-    uint64_t sleep_duration_us = (uint64_t)seconds * (uint64_t)1000000; // Convert seconds to microseconds
 
+    // Longer while Wi-Fi keeps failing; with micro-wakes enabled the sleep until the
+    // next upload is then taken in slices.
+    seconds = link_policy_sleep_seconds(seconds);
+    seconds = sampler_plan_sleep(seconds);
     ESP_LOGI(TAG, "Entering deep sleep mode for %lu seconds...", (unsigned long)seconds);
+    mem_diag_capture();
+    governor_finish();
+    diag_console_linger();   // on USB with the console in use: not yet
     
     // Disable Wi-Fi before sleeping
     esp_wifi_set_ps(WIFI_PS_MIN_MODEM);  // Enable Wi-Fi power saving
@@ -697,65 +940,219 @@ void enter_deep_sleep(uint32_t seconds){
     // (sdkconfig "Configure to isolate all GPIO pins in sleep state"), so no manual
     // isolation is needed for leakage.
 
-    // Configure the RTC timer to wake up after the specified sleep duration
-    esp_sleep_enable_timer_wakeup(sleep_duration_us);
-
-    // Wake on button press (SW1 on IO3, active low). IO3 has only a 100nF debounce cap
-    // and no external pull-up, so enable the RTC pull-up and hold it across deep sleep so
-    // the pin doesn't float low and wake us spuriously.
-    rtc_gpio_pullup_en(BUTTON_GPIO);
-    rtc_gpio_pulldown_dis(BUTTON_GPIO);
-    rtc_gpio_hold_en(BUTTON_GPIO);
-    esp_sleep_enable_ext0_wakeup(BUTTON_GPIO, 0);  // 0 = wake on active-low (button pressed)
+    sleep_now(seconds);
+}
 
-    // Enter deep sleep
-    esp_deep_sleep_start();
+void enter_micro_sleep(uint32_t seconds){
+    // Radio was never started and the governor never ran: nothing to tear down.
+    sleep_now(seconds);
 }
 
 
 #include <string.h>
 #include <stdlib.h>
 #include "esp_https_ota.h"
-#include "esp_crt_bundle.h"   // trust the ESP-IDF root-CA bundle instead of pinning a cert
+#include "mbedtls/sha256.h"
+#include "tls_profile.h"   // athome roots, CA bundle only as fallback
+#include "ota_inflate.h"
+#include "ota_pipeline.h"
 
 #define OTA_URL "https://athome.rodlandfarms.com/firmware.bin"
 #define JSON_URL "https://athome.rodlandfarms.com/firmware.json"
+#define OTA_MANIFEST_MAX 512   // firmware.json incl. url + sha256
 
 static char current_version_number[] = "1781375990";  // bump for the synchronous-upload fix (0e26e1c)
 
-void perform_ota_update(void);  // forward declaration
+// What firmware.json announces. Only "version" is required; "compression":"zlib" plus
+// "url", "size" and "sha256" (of the decompressed image) are written by tools/ota_pack.
+// Older firmware ignores the extra keys and keeps downloading OTA_URL uncompressed.
+typedef struct {
+    bool compressed;
+    char url[160];
+    uint32_t size;
+    uint8_t sha256[32];
+} ota_manifest_t;
+
+typedef struct {
+    ota_inflate_t *z;
+    mbedtls_sha256_context sha;
+} ota_stream_t;
+
+void perform_ota_update(const ota_manifest_t *manifest);  // forward declaration
 
 // Versions are unix timestamps, so a newer build is numerically larger. Only update
 // when the server version is STRICTLY greater than ours — this makes OTA monotonic
 // (no accidental downgrade if an older firmware.json is ever served).
-static void maybe_apply_update(const char *server_version) {
+static void maybe_apply_update(const char *server_version, const ota_manifest_t *manifest) {
     char *TAG = "OTA_CHECK";
     long long sv  = strtoll(server_version, NULL, 10);
     long long cur = strtoll(current_version_number, NULL, 10);
     ESP_LOGI(TAG, "Server version: %s, current: %s", server_version, current_version_number);
     if (sv > cur) {
         ESP_LOGI(TAG, "Newer firmware available -> starting OTA");
-        perform_ota_update();
+        perform_ota_update(manifest);
     } else {
         ESP_LOGI(TAG, "No update required (server <= current).");
     }
 }
 
-void perform_ota_update(){
+// A compressed entry is only used when it is complete; anything else falls back to the
+// plain image, which every server keeps publishing for older devices anyway.
+static void parse_manifest(const cJSON *json, ota_manifest_t *m) {
+    char *TAG = "OTA_CHECK";
+    memset(m, 0, sizeof(*m));
+    const cJSON *compression = cJSON_GetObjectItemCaseSensitive(json, "compression");
+    if (!cJSON_IsString(compression) || strcmp(compression->valuestring, "zlib") != 0) {
+        return;
+    }
+    const cJSON *url    = cJSON_GetObjectItemCaseSensitive(json, "url");
+    const cJSON *size   = cJSON_GetObjectItemCaseSensitive(json, "size");
+    const cJSON *sha256 = cJSON_GetObjectItemCaseSensitive(json, "sha256");
+    const cJSON *window = cJSON_GetObjectItemCaseSensitive(json, "window_bits");
+    if (!cJSON_IsString(url) || strlen(url->valuestring) >= sizeof(m->url) ||
+        !cJSON_IsNumber(size) || size->valuedouble <= 0 ||
+        !cJSON_IsString(sha256) || strlen(sha256->valuestring) != 2 * sizeof(m->sha256) ||
+        !parse_hex(sha256->valuestring, m->sha256, sizeof(m->sha256))) {
+        ESP_LOGW(TAG, "Incomplete compressed entry in firmware.json; using plain image");
+        return;
+    }
+    if (cJSON_IsNumber(window) && window->valueint > OTA_INFLATE_WINDOW_BITS) {
+        ESP_LOGW(TAG, "Compressed image needs a %d-bit window (max %d); using plain image",
+                 window->valueint, OTA_INFLATE_WINDOW_BITS);
+        return;
+    }
+    strcpy(m->url, url->valuestring);
+    m->size = (uint32_t)size->valuedouble;
+    m->compressed = true;
+}
+
+// esp_https_ota's decrypt hook is the one place that sees the downloaded bytes before
+// they are written, so decompression runs there and the writes and image validation
+// stay in esp_https_ota (or ota_pipeline, which calls the same hook from its flash
+// task). Both free data_out.
+static esp_err_t ota_inflate_cb(decrypt_cb_arg_t *args, void *user_ctx) {
+    ota_stream_t *stream = user_ctx;
+    uint8_t *out;
+    size_t out_len;
+    esp_err_t err = ota_inflate_feed(stream->z, (const uint8_t *)args->data_in, args->data_in_len,
+                                     &out, &out_len);
+    if (err != ESP_OK) {
+        ESP_LOGE("OTA_UPDATE", "Inflate failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    mbedtls_sha256_update(&stream->sha, out, out_len);
+    args->data_out = (char *)out;
+    args->data_out_len = out_len;
+    return ESP_OK;
+}
+
+static bool ota_stream_verify(ota_stream_t *stream, const ota_manifest_t *m) {
     char *TAG = "OTA_UPDATE";
-    ESP_LOGI(TAG, "Starting OTA update...");
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&stream->sha, digest);
+    uint32_t total = ota_inflate_total_out(stream->z);
+    if (!ota_inflate_done(stream->z)) {
+        ESP_LOGE(TAG, "Compressed stream ended early (%lu bytes out)", (unsigned long)total);
+        return false;
+    }
+    if (total != m->size) {
+        ESP_LOGE(TAG, "Decompressed size %lu, manifest says %lu", (unsigned long)total,
+                 (unsigned long)m->size);
+        return false;
+    }
+    if (memcmp(digest, m->sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Decompressed image SHA-256 does not match manifest");
+        return false;
+    }
+    return true;
+}
+
+// The esp_https_ota path, kept for when the pipeline's buffers don't fit in the heap.
+// begin/perform/finish instead of esp_https_ota() so the decompressed image can be
+// checked against the manifest before it is marked bootable.
+static esp_err_t perform_serial_ota(const esp_https_ota_config_t *ota_config,
+                                    const ota_manifest_t *manifest, ota_stream_t *stream) {
+    esp_https_ota_handle_t handle = NULL;
+    esp_err_t ret = esp_https_ota_begin(ota_config, &handle);
+    if (ret == ESP_OK) {
+        while ((ret = esp_https_ota_perform(handle)) == ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+        }
+        if (ret == ESP_OK) {
+            if (manifest->compressed) {
+                // Content-Length is the compressed size, so esp_https_ota's own
+                // completeness check doesn't apply; the manifest does.
+                if (!ota_stream_verify(stream, manifest)) {
+                    ret = ESP_ERR_INVALID_CRC;
+                }
+            } else if (!esp_https_ota_is_complete_data_received(handle)) {
+                ret = ESP_ERR_INVALID_SIZE;
+            }
+        }
+        if (ret == ESP_OK) {
+            ret = esp_https_ota_finish(handle);
+        } else {
+            esp_https_ota_abort(handle);
+        }
+    }
+    return ret;
+}
+
+void perform_ota_update(const ota_manifest_t *manifest){
+    char *TAG = "OTA_UPDATE";
+    ESP_LOGI(TAG, "Starting OTA update (%s)...", manifest->compressed ? manifest->url : OTA_URL);
     
     esp_http_client_config_t config = {
-        .url = OTA_URL,
-        .crt_bundle_attach = esp_crt_bundle_attach,
+        .url = manifest->compressed ? manifest->url : OTA_URL,
         .timeout_ms = 5000,
     };
+    tls_profile_apply(&config);
 
     esp_https_ota_config_t ota_config = {
         .http_config = &config,
     };
 
-    esp_err_t ret = esp_https_ota(&ota_config);
+    ota_stream_t stream = {0};
+    if (manifest->compressed) {
+        stream.z = ota_inflate_new();
+        if (stream.z == NULL) {
+            ESP_LOGE(TAG, "No heap for the inflater; skipping update this wake");
+            return;
+        }
+        mbedtls_sha256_init(&stream.sha);
+        mbedtls_sha256_starts(&stream.sha, 0);
+        ota_config.decrypt_cb = ota_inflate_cb;
+        ota_config.decrypt_user_ctx = &stream;
+    }
+
+    // A real download doesn't fit the OTA check's share of the wake budget.
+    governor_grant_ms(WAKE_OTA_GRANT_MS);
+
+    // Pipelined path first: reads and flash writes overlap instead of taking turns.
+    // The decompressed image is checked against the manifest before it is marked bootable.
+    ota_pipeline_config_t pipe_config = {
+        .http_config = &config,
+        .decrypt_cb = ota_config.decrypt_cb,
+        .decrypt_user_ctx = ota_config.decrypt_user_ctx,
+        .image_size = manifest->compressed ? manifest->size : 0,
+    };
+    esp_err_t ret = ota_pipeline_download(&pipe_config);
+    if (ret == ESP_OK) {
+        if (manifest->compressed && !ota_stream_verify(&stream, manifest)) {
+            ret = ESP_ERR_INVALID_CRC;
+        } else {
+            ret = ota_pipeline_commit();
+        }
+    } else if (ret == ESP_ERR_NO_MEM) {
+        // The ring didn't fit; nothing was downloaded yet, so take the serial path.
+        ESP_LOGW(TAG, "No heap for the OTA pipeline; using esp_https_ota");
+        ret = perform_serial_ota(&ota_config, manifest, &stream);
+    }
+
+    if (manifest->compressed) {
+        ESP_LOGI(TAG, "Inflated %lu bytes", (unsigned long)ota_inflate_total_out(stream.z));
+        mbedtls_sha256_free(&stream.sha);
+        ota_inflate_free(stream.z);
+    }
     
     if (ret == ESP_OK)
     {
@@ -764,7 +1161,7 @@ void perform_ota_update(){
     }
     else
     {
-        ESP_LOGE(TAG, "OTA update failed!");
+        ESP_LOGE(TAG, "OTA update failed: %s", esp_err_to_name(ret));
     }
 }
 
@@ -775,10 +1172,10 @@ void check_update(void *pvParameters) {
 
     esp_http_client_config_t http_config = {
         .url = JSON_URL,
-        .crt_bundle_attach = esp_crt_bundle_attach,
         .timeout_ms = 3000,
         .transport_type = HTTP_TRANSPORT_OVER_SSL,
     };
+    tls_profile_apply(&http_config);
 
     esp_http_client_handle_t client = esp_http_client_init(&http_config);
     esp_http_client_set_method(client, HTTP_METHOD_GET);
@@ -789,6 +1186,7 @@ void check_update(void *pvParameters) {
     // "Empty firmware.json response", so OTA never fired even though the server sent a
     // valid manifest). open()+fetch_headers() leaves the body for us to read().
     esp_err_t err = esp_http_client_open(client, 0);  // 0 = no request body (GET)
+    tls_profile_check_result(client, err);
 
     if (err == ESP_OK) {
         esp_http_client_fetch_headers(client);   // must run before read() / get_status_code()
@@ -797,7 +1195,7 @@ void check_update(void *pvParameters) {
         ESP_LOGI(TAG, "HTTP Response Code: %d", status_code);
 
         // firmware.json is tiny; a small fixed buffer is plenty. Loop until EOF.
-        char buffer[256] = {0};
+        char buffer[OTA_MANIFEST_MAX] = {0};
         int total_read = 0, bytes_read = 0;
         while (total_read < (int)sizeof(buffer) - 1 &&
                (bytes_read = esp_http_client_read(client, buffer + total_read,
@@ -808,17 +1206,34 @@ void check_update(void *pvParameters) {
 
         if (status_code == 200 && total_read > 0) {
             ESP_LOGI(TAG, "Received JSON: %s", buffer);
-            cJSON *json = cJSON_Parse(buffer);
-            if (json) {
-                const cJSON *version = cJSON_GetObjectItemCaseSensitive(json, "version");
-                if (version && cJSON_IsString(version) && version->valuestring) {
-                    maybe_apply_update(version->valuestring);
+            // Parse in the JSON arena and copy out what's needed, so the tree is gone
+            // (and never touched the heap) before the OTA download's TLS session.
+            char server_version[32] = "";
+            ota_manifest_t manifest;
+            if (json_arena_begin()) {
+                cJSON *json = cJSON_Parse(buffer);
+                if (json) {
+                    const cJSON *version = cJSON_GetObjectItemCaseSensitive(json, "version");
+                    if (version && cJSON_IsString(version) && version->valuestring) {
+                        strlcpy(server_version, version->valuestring, sizeof(server_version));
+                        parse_manifest(json, &manifest);
+                    } else {
+                        ESP_LOGE(TAG, "firmware.json missing string 'version'");
+                    }
+                } else if (json_arena_exhausted()) {
+                    ESP_LOGE(TAG, "firmware.json needs more than the %d-byte JSON arena", JSON_ARENA_BYTES);
                 } else {
-                    ESP_LOGE(TAG, "firmware.json missing string 'version'");
+                    ESP_LOGE(TAG, "JSON Parsing Error");
                 }
-                cJSON_Delete(json);
+                json_arena_stats_t st;
+                json_arena_end(&st);
+                ESP_LOGD(TAG, "manifest parse: %lu allocations, %u arena bytes",
+                         (unsigned long)st.allocs, (unsigned)st.used);
             } else {
-                ESP_LOGE(TAG, "JSON Parsing Error");
+                ESP_LOGE(TAG, "JSON arena in use; update check skipped");
+            }
+            if (server_version[0]) {
+                maybe_apply_update(server_version, &manifest);
             }
         } else {
             ESP_LOGE(TAG, "Empty/failed firmware.json response (status=%d, read=%d)", status_code, total_read);
@@ -839,6 +1254,8 @@ void check_update(void *pvParameters) {
 void app_main() {
     char *TAG = "MAIN";
 
+    // Wake cause and time asleep, and the pin holds from the last sleep released.
+    sleep_mgr_boot();
 
     // Configure GPIO for button
     configure_button_gpio();
@@ -846,7 +1263,7 @@ void app_main() {
     adc1_config_width(ADC_WIDTH_BIT_12);  // Set ADC width to 12 bits (0-4095 range)
     adc1_config_channel_atten(ADC1_CHANNEL_4, ADC_ATTEN_DB_11);  // Set ADC attenuation to 11dB (0-3.6V range)
     // Start a task to monitor the button press
-    xTaskCreate(monitor_button_press, "monitor_button_press", 2 * 1024, NULL, 5, NULL);
+    static_task_start(&button_task, monitor_button_press, "button", NULL, 5);
 
     nvs_init();
     read_from_nvs(main_struct.ssid, main_struct.password, main_struct.name, main_struct.location, main_struct.apiToken, &main_struct.credentials_recv);
@@ -857,15 +1274,60 @@ void app_main() {
     ESP_LOGI("NVS", "Location: %s", main_struct.location);
     ESP_LOGI("NVS", "API key: %s", main_struct.apiToken);
     ESP_LOGI("NVS", "Credentials Received: %d", main_struct.credentials_recv);
+    main_struct.transport = (uint8_t)nvs_get_transport();
+
+    // A wake that had already released the BT memory asked for re-provisioning.
+    bool reprovision = provision_request == PROVISION_REQUEST_MAGIC;
+    provision_request = 0;
+
+    // Micro-wake between uploads: sample, fold into the RTC aggregates, sleep again.
+    // Returns only when this wake should run the full cycle.
+    if (main_struct.credentials_recv && !reprovision && !wake_stub_usb_boot()) {
+        sampler_micro_wake();
+    }
+
+    // Every battery wake runs under the wake governor. Not while waiting to be
+    // provisioned (the user sets the pace) or on the mains-powered ESP-NOW gateway.
+    if (main_struct.credentials_recv && !reprovision &&
+        main_struct.transport != TRANSPORT_ESPNOW_GATEWAY) {
+        governor_start();
+    }
+
+    // On the bench (USB power), a REPL for timing this board's own code paths.
+    if (usb_power_present()) {
+        diag_console_start();
+    }
+
+    // Provisioned and not a beacon: BLE is at most needed for re-provisioning, which
+    // then costs one restart. Everything else gets the memory.
+    if (main_struct.credentials_recv && !reprovision &&
+        main_struct.transport != TRANSPORT_BLE_BEACON) {
+        release_bt_memory();
+    }
 
     // Only initialize BLE if credentials are NOT set
     if (!main_struct.credentials_recv) {
         ble_advert();
+    } else if (reprovision) {
+        ESP_LOGW(TAG, "Re-provisioning requested by the previous boot");
+        ble_advert();
+    } else if (main_struct.transport == TRANSPORT_BLE_BEACON) {
+        // Beacon telemetry: no Wi-Fi at all — read, broadcast a signed advert, sleep.
+        ESP_LOGI(TAG, "Transport: BLE beacon. Skipping Wi-Fi.");
+        start_wake_task(beacon_task, "beacon", WAKE_STACK_BEACON);
+    } else if (main_struct.transport == TRANSPORT_ESPNOW) {
+        // ESP-NOW node: one encrypted frame to the gateway, no association.
+        ESP_LOGI(TAG, "Transport: ESP-NOW node. Skipping Wi-Fi association.");
+        start_wake_task(espnow_node_task, "espnow_node", WAKE_STACK_NODE);
+    } else if (main_struct.transport == TRANSPORT_ESPNOW_GATEWAY) {
+        // Mains-powered gateway: join Wi-Fi and forward; the IP handler starts it.
+        ESP_LOGI(TAG, "Transport: ESP-NOW gateway.");
+        wifi_init();
     } else {
-    ESP_LOGI(TAG, "Wi-Fi credentials already set. Skipping BLE provisioning.");
-    xTaskCreate(check_credentials, "check_credentials", 4 * 1024, NULL, 5, NULL);
-
-    //xTaskCreate(notify_status, "notify_status", 2 * 1024, NULL, 5, NULL);
+        // HTTPS, MQTT or CoAP node: the whole wake (sense, connect, sync, update check, upload,
+        // sleep) is one state machine in the wake task; only the upload step differs.
+        ESP_LOGI(TAG, "Wi-Fi credentials already set. Skipping BLE provisioning.");
+        start_wake_task(wake_cycle_task, "wake", WAKE_STACK_CYCLE);
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_attr.h"
+#include "esp_crt_bundle.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_client.h"
+#include "cJSON.h"
+#include "main.h"
+#include "nvs_drv.h"
+#include "json_arena.h"
+#include "reading_backlog.h"
+#include "sampler.h"
+#include "tls_profile.h"
+#include "wake_governor.h"
+#include "mqtt_msg.h"
+#include "mqtt_link.h"
+
+static const char *TAG = "MQTT";
+
+#define MQTT_KEEPALIVE_S        120     // only matters while connected; the session outlives it
+#define MQTT_NETWORK_TIMEOUT_MS 8000    // same as the HTTPS upload
+#define MQTT_MIN_ATTEMPT_MS     3000    // don't start a connection the wake governor would cut off
+#define MQTT_CMD_LINGER_MS      400     // quiet time after the last message before disconnecting
+#define MQTT_BACKLOG_BATCH      16      // backlog readings published per wake
+#define MQTT_META_MAX           192
+#define MQTT_MAX_IDS            (MQTT_BACKLOG_BATCH + 2)   // reading, meta, backlog
+
+#define BIT_CONNECTED   BIT0
+#define BIT_FAILED      BIT1
+#define BIT_COMMAND     BIT2
+#define BIT_ACKED       BIT3    // acked_ids[] grew
+
+// Survive deep sleep, reset on power-on: a power cycle re-subscribes (harmless if the
+// broker still has the session). meta_hash is of the name/location last acked, so a
+// rename through re-provisioning is re-published without any hook into main.c.
+static RTC_DATA_ATTR bool subscribed = false;
+static RTC_DATA_ATTR uint32_t meta_hash = 0;
+
+static StaticEventGroup_t bits_storage;
+static EventGroupHandle_t bits;
+// Every PUBACK of this connection, as a set the publisher checks its ids against. A
+// set rather than a queue of acks: an ack may arrive before its publish call returns,
+// and one waiter must see all of them.
+static portMUX_TYPE acked_lock = portMUX_INITIALIZER_UNLOCKED;
+static int acked_ids[MQTT_MAX_IDS];
+static int acked_count;
+static char cmd_topic[MQTT_TOPIC_MAX];
+static bool session_present;
+
+static void apply_command(const char *payload, size_t len) {
+    uint32_t v = 0;
+    bool applied = true;
+    // Same limits as the provisioning JSON (parse_json() in main.c).
+    switch (mqtt_msg_parse_cmd(payload, len, &v)) {
+    case MQTT_CMD_SLEEP_SECONDS:
+        applied = v > 0 && nvs_set_sleep_seconds(v) == ESP_OK;
+        break;
+    case MQTT_CMD_SAMPLE_SECONDS:
+        applied = (v == 0 || v >= SAMPLER_MIN_SECONDS) && nvs_set_sample_seconds(v) == ESP_OK;
+        break;
+    case MQTT_CMD_REPROVISION_AFTER:
+        applied = nvs_set_reprovision_after(v) == ESP_OK;
+        break;
+    case MQTT_CMD_WAKE_BUDGET_MS:
+        applied = v >= 5000 && nvs_set_wake_budget_ms(v) == ESP_OK;
+        break;
+    default:
+        applied = false;
+        break;
+    }
+    if (applied) {
+        ESP_LOGI(TAG, "Command '%.*s' applied (from next wake)", (int)len, payload);
+    } else {
+        ESP_LOGW(TAG, "Command '%.*s' ignored", (int)len, payload);
+    }
+}
+
+// Runs in the esp-mqtt task.
+static void on_event(void *arg, esp_event_base_t base, int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t event = event_data;
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        session_present = event->session_present;
+        xEventGroupSetBits(bits, BIT_CONNECTED);
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        // At most MQTT_MAX_IDS QoS 1 publishes per connection, so the set can't overflow.
+        taskENTER_CRITICAL(&acked_lock);
+        if (acked_count < MQTT_MAX_IDS) {
+            acked_ids[acked_count++] = event->msg_id;
+        }
+        taskEXIT_CRITICAL(&acked_lock);
+        xEventGroupSetBits(bits, BIT_ACKED);
+        break;
+    case MQTT_EVENT_SUBSCRIBED:
+        subscribed = true;
+        break;
+    case MQTT_EVENT_DATA:
+        // Commands are a few bytes; anything fragmented isn't one of ours.
+        if (event->topic_len == (int)strlen(cmd_topic) &&
+            strncmp(event->topic, cmd_topic, event->topic_len) == 0 &&
+            event->current_data_offset == 0 && event->data_len == event->total_data_len) {
+            apply_command(event->data, event->data_len);
+        }
+        xEventGroupSetBits(bits, BIT_COMMAND);
+        break;
+    case MQTT_EVENT_ERROR:
+        if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
+            tls_profile_note_verify_failure(event->error_handle->esp_tls_cert_verify_flags);
+        } else if (event->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
+            ESP_LOGE(TAG, "Broker refused the connection (code %d)",
+                     event->error_handle->connect_return_code);
+        }
+        xEventGroupSetBits(bits, BIT_FAILED);
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        xEventGroupSetBits(bits, BIT_FAILED);   // ends wait_acks(): nothing more will be acked
+        break;
+    default:
+        break;
+    }
+}
+
+static uint32_t budget_left_ms(void) {
+    uint32_t left = governor_remaining_ms();
+    return left == UINT32_MAX ? 30000 : left;
+}
+
+static uint32_t fnv1a(uint32_t h, const char *s) {
+    for (; *s; s++) {
+        h = (h ^ (uint8_t)*s) * 16777619u;
+    }
+    return h;
+}
+
+// {"sensor":"...","location":"..."}, escaped by cJSON, built in the JSON arena.
+static int format_meta(char *buf, int len) {
+    if (!json_arena_begin()) {
+        return -1;
+    }
+    int n = -1;
+    cJSON *root = cJSON_CreateObject();
+    if (root && cJSON_AddStringToObject(root, "sensor", main_struct.name) &&
+        cJSON_AddStringToObject(root, "location", main_struct.location) &&
+        cJSON_PrintPreallocated(root, buf, len, false)) {
+        n = (int)strlen(buf);
+    }
+    json_arena_end(NULL);
+    return n;
+}
+
+static bool acked(int id) {
+    bool found = false;
+    taskENTER_CRITICAL(&acked_lock);
+    for (int i = 0; i < acked_count && !found; i++) {
+        found = acked_ids[i] == id;
+    }
+    taskEXIT_CRITICAL(&acked_lock);
+    return found;
+}
+
+// Waits until every id in ids[0..count) is acked, the connection fails, or the deadline.
+// Marks acked ones by setting them to 0; returns how many are still outstanding.
+static int wait_acks(int *ids, int count, int64_t deadline_us) {
+    bool failed = false;
+    for (;;) {
+        xEventGroupClearBits(bits, BIT_ACKED);   // before the scan, so no ack slips between
+        int outstanding = 0;
+        for (int i = 0; i < count; i++) {
+            if (ids[i] > 0 && acked(ids[i])) {
+                ids[i] = 0;
+            }
+            outstanding += ids[i] > 0;
+        }
+        int64_t left_us = deadline_us - esp_timer_get_time();
+        if (outstanding == 0 || failed || left_us <= 0) {
+            return outstanding;
+        }
+        // After a failure, one more scan picks up the acks that came in before it.
+        EventBits_t b = xEventGroupWaitBits(bits, BIT_ACKED | BIT_FAILED, pdFALSE, pdFALSE,
+                                            pdMS_TO_TICKS(left_us / 1000) + 1);
+        failed = b & BIT_FAILED;
+    }
+}
+
+bool mqtt_deliver_reading(const SensorReading *reading) {
+    if (budget_left_ms() < MQTT_MIN_ATTEMPT_MS) {
+        governor_defer_reading();
+        return false;
+    }
+    if (bits == NULL) {
+        bits = xEventGroupCreateStatic(&bits_storage);
+    }
+    xEventGroupClearBits(bits, BIT_CONNECTED | BIT_FAILED | BIT_COMMAND | BIT_ACKED);
+    taskENTER_CRITICAL(&acked_lock);
+    acked_count = 0;
+    taskEXIT_CRITICAL(&acked_lock);
+
+    char uri[MQTT_URI_MAX];
+    nvs_get_mqtt_uri(uri, sizeof(uri));
+    mqtt_topic(cmd_topic, sizeof(cmd_topic), main_struct.hostname, "cmd");
+    esp_mqtt_client_config_t config = {
+        .broker.address.uri = uri,
+        .credentials.client_id = main_struct.hostname,
+        .credentials.username = main_struct.hostname,
+        .credentials.authentication.password = main_struct.apiToken,
+        .session.disable_clean_session = true,
+        .session.keepalive = MQTT_KEEPALIVE_S,
+        .network.timeout_ms = MQTT_NETWORK_TIMEOUT_MS,
+        .network.disable_auto_reconnect = true,   // one attempt per wake; the backlog covers the rest
+    };
+    const char *pem = tls_profile_ca_pem();
+    if (pem) {
+        config.broker.verification.certificate = pem;
+    } else {
+        config.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "esp_mqtt_client_init failed (uri='%s')", uri);
+        governor_defer_reading();
+        return false;
+    }
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, on_event, NULL);
+
+    int64_t t0 = esp_timer_get_time();
+    int64_t deadline_us = t0 + (int64_t)budget_left_ms() * 1000;
+    esp_mqtt_client_start(client);
+    EventBits_t got = xEventGroupWaitBits(bits, BIT_CONNECTED | BIT_FAILED, pdFALSE, pdFALSE,
+                                          pdMS_TO_TICKS(budget_left_ms()));
+    if (!(got & BIT_CONNECTED)) {
+        ESP_LOGE(TAG, "No connection to %s", uri);
+        esp_mqtt_client_destroy(client);
+        governor_defer_reading();
+        return false;
+    }
+    int64_t t_conn = esp_timer_get_time();
+    if (!session_present || !subscribed) {
+        esp_mqtt_client_subscribe(client, cmd_topic, 1);
+    }
+
+    char topic[MQTT_TOPIC_MAX];
+    char payload[MQTT_META_MAX];
+    size_t payload_bytes = 0;
+    int meta_id = 0;
+    uint32_t hash = fnv1a(fnv1a(2166136261u, main_struct.name), main_struct.location) | 1;
+    if (hash != meta_hash) {
+        mqtt_topic(topic, sizeof(topic), main_struct.hostname, "meta");
+        int n = format_meta(payload, sizeof(payload));
+        if (n > 0) {
+            meta_id = esp_mqtt_client_publish(client, topic, payload, n, 1, 1);
+            payload_bytes += n;
+        }
+    }
+
+    // This wake's reading first, then the oldest backlog entries.
+    mqtt_topic(topic, sizeof(topic), main_struct.hostname, "reading");
+    PackedReading packed;
+    pack_reading(reading, &packed);
+    time_t now = time(NULL);
+    int n = mqtt_msg_reading(payload, sizeof(payload), &packed, now > 1600000000 ? (uint32_t)now : 0);
+    int reading_id = esp_mqtt_client_publish(client, topic, payload, n, 1, 0);
+    payload_bytes += n;
+
+    // ids[0] this wake's reading, ids[1] the meta (0: not sent), then the backlog.
+    int ids[MQTT_MAX_IDS] = { reading_id, meta_id };
+    int *backlog_ids = &ids[2];
+    BacklogEntry backlog[MQTT_BACKLOG_BATCH];
+    size_t queued = backlog_peek_many(backlog, MQTT_BACKLOG_BATCH);
+    for (size_t i = 0; i < queued; i++) {
+        n = mqtt_msg_reading(payload, sizeof(payload), &backlog[i].reading, backlog[i].taken_at);
+        backlog_ids[i] = esp_mqtt_client_publish(client, topic, payload, n, 1, 0);
+        payload_bytes += n;
+    }
+
+    // One wait for all of them: the acks come back in any order.
+    wait_acks(ids, 2 + (int)queued, deadline_us);
+    int64_t t_ack = esp_timer_get_time();
+    bool delivered = reading_id > 0 && ids[0] == 0;
+    if (meta_id > 0 && ids[1] == 0) {
+        meta_hash = hash;
+    }
+
+    // The backlog only drops from the front: stop at the first reading not acked.
+    size_t dropped = 0;
+    while (dropped < queued && backlog_ids[dropped] == 0) {
+        backlog_drop();
+        dropped++;
+    }
+
+    // Queued commands follow CONNACK straight away; give them a moment to finish.
+    while (esp_timer_get_time() + MQTT_CMD_LINGER_MS * 1000 < deadline_us) {
+        EventBits_t b = xEventGroupWaitBits(bits, BIT_COMMAND | BIT_FAILED, pdFALSE, pdFALSE,
+                                            pdMS_TO_TICKS(MQTT_CMD_LINGER_MS));
+        if (!(b & BIT_COMMAND) || (b & BIT_FAILED)) {
+            break;
+        }
+        xEventGroupClearBits(bits, BIT_COMMAND);
+    }
+
+    esp_mqtt_client_disconnect(client);
+    esp_mqtt_client_stop(client);
+    esp_mqtt_client_destroy(client);
+
+    ESP_LOGI(TAG, "%s: connect %lld ms, acks +%lld ms, %u payload bytes, backlog %u/%u sent (session %s)",
+             delivered ? "delivered" : "NOT acked", (t_conn - t0) / 1000, (t_ack - t_conn) / 1000,
+             (unsigned)payload_bytes, (unsigned)dropped, (unsigned)queued,
+             session_present ? "resumed" : "new");
+    if (delivered) {
+        governor_release_reading();
+    } else {
+        governor_defer_reading();
+    }
+    return delivered;
+}
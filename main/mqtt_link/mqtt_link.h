@@ -0,0 +1,22 @@
+#ifndef MQTT_LINK_H
+#define MQTT_LINK_H
+
+// TRANSPORT_MQTT: the upload step of the wake cycle over esp-mqtt instead of an HTTPS
+// POST. Wi-Fi, SNTP, the update check and the wake governor are unchanged. Only
+// wake_cycle's UPLOAD state calls in here.
+//
+// The session is persistent (clean session off, client id = hostname). The broker keeps
+// the command subscription and queues QoS 1 commands while the device sleeps. The
+// device subscribes only when the broker reports no stored session, and the queued
+// commands arrive right after CONNACK on the same connection. Topics and payloads are
+// in mqtt_msg.h.
+
+#include <stdbool.h>
+#include "data.h"
+
+// Publishes this wake's reading and as much of the backlog as the budget allows, waits
+// for the PUBACKs, applies any queued commands, then disconnects. Releases the reading
+// (acked) or defers it to the backlog (not acked), like deliver_reading().
+bool mqtt_deliver_reading(const SensorReading *reading);
+
+#endif // MQTT_LINK_H
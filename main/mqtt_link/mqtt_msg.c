@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <string.h>
+#include "mqtt_msg.h"
+
+static const struct {
+    const char *key;
+    mqtt_cmd_t cmd;
+} cmd_keys[] = {
+    { "sleep_seconds",     MQTT_CMD_SLEEP_SECONDS },
+    { "sample_seconds",    MQTT_CMD_SAMPLE_SECONDS },
+    { "reprovision_after", MQTT_CMD_REPROVISION_AFTER },
+    { "wake_budget_ms",    MQTT_CMD_WAKE_BUDGET_MS },
+};
+
+int mqtt_topic(char *buf, size_t len, const char *hostname, const char *leaf) {
+    return snprintf(buf, len, MQTT_TOPIC_ROOT "/%s/%s", hostname, leaf);
+}
+
+int mqtt_msg_reading(char *buf, size_t len, const PackedReading *r, uint32_t taken_at) {
+    int n = snprintf(buf, len, "%d,%lu,%u,%u,%d,%u", MQTT_MSG_VERSION, (unsigned long)taken_at,
+                     r->moisture, r->soc_raw, r->crate_raw, r->power);
+    return n > 0 && (size_t)n < len ? n : -1;
+}
+
+// Payloads aren't NUL-terminated, so parse from a bounded copy.
+static bool terminated_copy(char *dst, size_t dst_len, const char *src, size_t len) {
+    if (len >= dst_len) {
+        return false;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return true;
+}
+
+bool mqtt_msg_parse_reading(const char *payload, size_t len, PackedReading *r, uint32_t *taken_at) {
+    char text[MQTT_READING_MAX];
+    if (!terminated_copy(text, sizeof(text), payload, len)) {
+        return false;
+    }
+    int version, crate;
+    unsigned long at;
+    unsigned moisture, soc, power;
+    int used = 0;
+    if (sscanf(text, "%d,%lu,%u,%u,%d,%u%n", &version, &at, &moisture, &soc, &crate, &power, &used) != 6 ||
+        (size_t)used != len || version != MQTT_MSG_VERSION || moisture > 100 || soc > 0xFFFF ||
+        crate < INT16_MIN || crate > INT16_MAX || power > 0xFF || at > UINT32_MAX) {
+        return false;
+    }
+    r->moisture = (uint8_t)moisture;
+    r->soc_raw = (uint16_t)soc;
+    r->crate_raw = (int16_t)crate;
+    r->power = (uint8_t)power;
+    *taken_at = (uint32_t)at;
+    return true;
+}
+
+mqtt_cmd_t mqtt_msg_parse_cmd(const char *payload, size_t len, uint32_t *value) {
+    char text[48];
+    if (!terminated_copy(text, sizeof(text), payload, len)) {
+        return MQTT_CMD_UNKNOWN;
+    }
+    char *eq = strchr(text, '=');
+    if (eq == NULL || eq[1] == '\0') {
+        return MQTT_CMD_UNKNOWN;
+    }
+    *eq = '\0';
+    uint64_t v = 0;
+    for (const char *c = eq + 1; *c; c++) {
+        if (*c < '0' || *c > '9' || (v = v * 10 + (uint64_t)(*c - '0')) > UINT32_MAX) {
+            return MQTT_CMD_UNKNOWN;
+        }
+    }
+    for (size_t i = 0; i < sizeof(cmd_keys) / sizeof(cmd_keys[0]); i++) {
+        if (strcmp(text, cmd_keys[i].key) == 0) {
+            *value = (uint32_t)v;
+            return cmd_keys[i].cmd;
+        }
+    }
+    return MQTT_CMD_UNKNOWN;
+}
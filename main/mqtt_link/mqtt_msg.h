@@ -0,0 +1,52 @@
+#ifndef MQTT_MSG_H
+#define MQTT_MSG_H
+
+// Wire format of the MQTT transport, shared with tools/mqtt_compare. Pure C.
+//
+// Topics, with <host> the device hostname (also its client id and username):
+//   plantpulse/<host>/reading   device -> server, QoS 1. One reading per message:
+//                               "1,<taken_at>,<moisture>,<soc_raw>,<crate_raw>,<power>"
+//                               i.e. version, unix seconds (0 = clock not set), then the
+//                               PackedReading fields in register units (data.h).
+//   plantpulse/<host>/meta      device -> server, QoS 1, retained. {"sensor":..,"location":..}
+//                               re-sent after power-on or when either value changes.
+//   plantpulse/<host>/cmd       server -> device, QoS 1. "<key>=<unsigned value>", with
+//                               the same keys and limits as the provisioning JSON.
+//                               The broker queues them in the device's persistent
+//                               session until its next wake.
+//
+// Identity and auth live in the connection (username/password = hostname/api_token),
+// so a reading is ~20 bytes of payload instead of a form body with every field name.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "data.h"
+
+#define MQTT_TOPIC_ROOT     "plantpulse"
+#define MQTT_TOPIC_MAX      64
+#define MQTT_READING_MAX    48
+#define MQTT_MSG_VERSION    1
+
+typedef enum {
+    MQTT_CMD_UNKNOWN = 0,
+    MQTT_CMD_SLEEP_SECONDS,        // > 0
+    MQTT_CMD_SAMPLE_SECONDS,       // 0, or >= SAMPLER_MIN_SECONDS (checked by the caller)
+    MQTT_CMD_REPROVISION_AFTER,    // >= 0
+    MQTT_CMD_WAKE_BUDGET_MS,       // >= 5000
+} mqtt_cmd_t;
+
+// "plantpulse/<host>/<leaf>". Returns the snprintf length (>= len means truncated).
+int mqtt_topic(char *buf, size_t len, const char *hostname, const char *leaf);
+
+// The reading payload. Returns its length, or -1 if buf is too small.
+int mqtt_msg_reading(char *buf, size_t len, const PackedReading *reading, uint32_t taken_at);
+
+// Inverse of mqtt_msg_reading(), for the host tools. False on anything malformed.
+bool mqtt_msg_parse_reading(const char *payload, size_t len, PackedReading *reading, uint32_t *taken_at);
+
+// Splits a command payload. Returns MQTT_CMD_UNKNOWN for unknown keys or a value that
+// isn't a plain unsigned number; range checks are left to the caller.
+mqtt_cmd_t mqtt_msg_parse_cmd(const char *payload, size_t len, uint32_t *value);
+
+#endif // MQTT_MSG_H
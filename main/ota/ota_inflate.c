@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rom/miniz.h"
+#include "ota_inflate.h"
+
+#define WINDOW_SIZE (1u << OTA_INFLATE_WINDOW_BITS)
+
+struct ota_inflate {
+    tinfl_decompressor tinfl;
+    uint8_t window[WINDOW_SIZE];   // circular: tinfl wraps writes and back-references
+    size_t window_pos;
+    uint32_t total_out;
+    bool done;
+};
+
+ota_inflate_t *ota_inflate_new(void) {
+    ota_inflate_t *z = malloc(sizeof(*z));
+    if (z) {
+        tinfl_init(&z->tinfl);
+        z->window_pos = 0;
+        z->total_out = 0;
+        z->done = false;
+    }
+    return z;
+}
+
+void ota_inflate_free(ota_inflate_t *z) {
+    free(z);
+}
+
+static bool append(uint8_t **buf, size_t *len, size_t *cap, const uint8_t *src, size_t n) {
+    if (*len + n > *cap) {
+        size_t new_cap = *cap ? *cap : 2048;
+        while (new_cap < *len + n) {
+            new_cap *= 2;
+        }
+        uint8_t *grown = realloc(*buf, new_cap);
+        if (!grown) {
+            return false;
+        }
+        *buf = grown;
+        *cap = new_cap;
+    }
+    memcpy(*buf + *len, src, n);
+    *len += n;
+    return true;
+}
+
+esp_err_t ota_inflate_feed(ota_inflate_t *z, const uint8_t *in, size_t in_len,
+                           uint8_t **out, size_t *out_len) {
+    uint8_t *buf = NULL;
+    size_t len = 0, cap = 0;
+    size_t in_pos = 0;
+    esp_err_t err = ESP_OK;
+
+    while (!z->done) {
+        size_t in_bytes = in_len - in_pos;
+        size_t out_bytes = WINDOW_SIZE - z->window_pos;
+        tinfl_status st = tinfl_decompress(&z->tinfl, in + in_pos, &in_bytes, z->window,
+                                           z->window + z->window_pos, &out_bytes,
+                                           TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        in_pos += in_bytes;
+        if (out_bytes > 0 && !append(&buf, &len, &cap, z->window + z->window_pos, out_bytes)) {
+            err = ESP_ERR_NO_MEM;
+            break;
+        }
+        z->window_pos = (z->window_pos + out_bytes) & (WINDOW_SIZE - 1);
+        z->total_out += out_bytes;
+
+        if (st == TINFL_STATUS_DONE) {
+            z->done = true;          // adler-32 already checked by tinfl
+        } else if (st < 0) {
+            err = ESP_ERR_INVALID_RESPONSE;
+            break;
+        } else if (st == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            break;                   // this chunk is used up
+        }
+        // TINFL_STATUS_HAS_MORE_OUTPUT: the ring filled up, go round again
+    }
+
+    if (err == ESP_OK && buf == NULL) {
+        buf = malloc(1);             // callers expect a buffer even for 0 bytes
+        if (!buf) {
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+    if (err != ESP_OK) {
+        free(buf);
+        return err;
+    }
+    *out = buf;
+    *out_len = len;
+    return ESP_OK;
+}
+
+bool ota_inflate_done(const ota_inflate_t *z) {
+    return z->done;
+}
+
+uint32_t ota_inflate_total_out(const ota_inflate_t *z) {
+    return z->total_out;
+}
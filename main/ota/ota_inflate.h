@@ -0,0 +1,31 @@
+#ifndef OTA_INFLATE_H
+#define OTA_INFLATE_H
+
+// Streaming zlib inflater for compressed OTA images, on the miniz tinfl that ships in
+// the ESP32-S3 ROM (no code added to flash). The dictionary is a fixed 4 KB ring, so
+// images must be compressed with a window of at most 2^OTA_INFLATE_WINDOW_BITS —
+// tools/ota_pack does that; tinfl rejects a zlib header announcing a larger window.
+// Total heap while an update runs: ~15 KB (window + decoder tables).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define OTA_INFLATE_WINDOW_BITS 12
+
+typedef struct ota_inflate ota_inflate_t;
+
+ota_inflate_t *ota_inflate_new(void);
+void ota_inflate_free(ota_inflate_t *z);
+
+// Consumes all of `in`, returning the bytes it decompressed to in a malloc'd buffer
+// (*out, never NULL on success; caller frees). ESP_ERR_INVALID_RESPONSE on corrupt
+// data, bad window size or adler-32 mismatch.
+esp_err_t ota_inflate_feed(ota_inflate_t *z, const uint8_t *in, size_t in_len,
+                           uint8_t **out, size_t *out_len);
+
+bool ota_inflate_done(const ota_inflate_t *z);    // zlib end-of-stream seen and verified
+uint32_t ota_inflate_total_out(const ota_inflate_t *z);
+
+#endif // OTA_INFLATE_H
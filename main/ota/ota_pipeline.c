@@ -0,0 +1,363 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "spi_flash_mmap.h"   // SPI_FLASH_SEC_SIZE
+#include "tls_profile.h"
+#include "mem_diag.h"
+#include "ota_pipeline.h"
+
+static const char *TAG = "OTA_PIPE";
+
+#define ERASE_STEP          (64 * 1024)    // one block erase costs far less than 16 sector erases
+#define ERASE_AHEAD_UNKNOWN (128 * 1024)   // size not known yet: don't run further ahead than this
+#define FLASH_ALIGN         16             // encrypted partitions are written in 16-byte units
+#define PROGRESS_STEP       (128 * 1024)
+
+typedef struct {
+    uint8_t *data;          // NULL: end of stream
+    uint32_t len;
+} chunk_t;
+
+typedef struct {
+    uint32_t bytes_in;       // downloaded (compressed size for zlib images)
+    uint32_t net_read_ms;    // inside esp_http_client_read
+    uint32_t net_stall_ms;   // waiting for a free buffer: flash is behind
+    uint32_t erase_ms;
+    uint32_t write_ms;
+    uint32_t flash_stall_ms; // waiting for a full buffer with nothing left to erase: network is behind
+} pipe_stats_t;
+
+STATIC_TASK_DEFINE(ota_flash, 4096);
+
+static StaticQueue_t free_q_buf, full_q_buf;
+static uint8_t free_q_store[OTA_PIPE_BUFS * sizeof(uint8_t *)];
+static uint8_t full_q_store[(OTA_PIPE_BUFS + 1) * sizeof(chunk_t)];   // + end marker
+static QueueHandle_t free_q, full_q;
+static StaticSemaphore_t done_buf;
+static SemaphoreHandle_t done;
+
+static ota_pipeline_config_t cfg;
+static const esp_partition_t *part;
+static atomic_uint image_end;     // sector-rounded image size, 0 while unknown
+static atomic_bool failed;        // either side gave up; the other stops early
+static uint8_t *stage;            // one sector, so flash is always written whole sectors
+static size_t staged;
+static uint32_t erased, written;
+static esp_err_t flash_err;
+static pipe_stats_t stats;
+
+static uint32_t ms_since(int64_t t0_us) {
+    return (uint32_t)((esp_timer_get_time() - t0_us) / 1000);
+}
+
+static uint32_t kb_per_s(uint32_t bytes, uint32_t ms) {
+    return ms ? (uint32_t)((uint64_t)bytes * 1000 / 1024 / ms) : 0;
+}
+
+// How far the flash task may erase before there is anything to write there.
+static uint32_t erase_target(void) {
+    uint32_t end = atomic_load(&image_end);
+    uint32_t target = end ? end : written + ERASE_AHEAD_UNKNOWN;
+    return target < part->size ? target : part->size;
+}
+
+static esp_err_t erase_step(void) {
+    uint32_t len = ERASE_STEP - erased % ERASE_STEP;   // first step realigns to a block
+    if (len > part->size - erased) {
+        len = part->size - erased;
+    }
+    if (len == 0) {
+        return ESP_ERR_INVALID_SIZE;                    // image larger than the partition
+    }
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(part, erased, len);
+    stats.erase_ms += ms_since(t0);
+    if (err == ESP_OK) {
+        erased += len;
+    }
+    return err;
+}
+
+static esp_err_t flush_stage(bool last) {
+    size_t len = staged;
+    if (last && len % FLASH_ALIGN) {
+        size_t pad = FLASH_ALIGN - len % FLASH_ALIGN;  // past the image end, never read
+        memset(stage + len, 0xff, pad);
+        len += pad;
+    }
+    if (len == 0) {
+        return ESP_OK;
+    }
+    while (erased < written + len) {                   // write caught up with erase
+        esp_err_t err = erase_step();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_partition_write(part, written, stage, len);
+    stats.write_ms += ms_since(t0);
+    written += len;
+    staged = 0;
+    return err;
+}
+
+static esp_err_t flash_put(const uint8_t *data, size_t len) {
+    if (written == 0 && staged == 0 && len > 0 && data[0] != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "Not an app image (first byte 0x%02x)", data[0]);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    while (len > 0) {
+        size_t n = SPI_FLASH_SEC_SIZE - staged;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(stage + staged, data, n);
+        staged += n;
+        data += n;
+        len -= n;
+        if (staged == SPI_FLASH_SEC_SIZE) {
+            esp_err_t err = flush_stage(false);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t consume(const chunk_t *c) {
+    if (cfg.decrypt_cb == NULL) {
+        return flash_put(c->data, c->len);
+    }
+    decrypt_cb_arg_t args = { .data_in = (const char *)c->data, .data_in_len = c->len };
+    esp_err_t err = cfg.decrypt_cb(&args, cfg.decrypt_user_ctx);
+    if (err == ESP_OK) {
+        err = flash_put((const uint8_t *)args.data_out, args.data_out_len);
+        free(args.data_out);
+    }
+    return err;
+}
+
+// Consumer. Writing always wins over erasing ahead; erasing ahead wins over waiting.
+// After a failure it keeps handing buffers back until the end marker so the network
+// side can never block on a full ring.
+static void flash_task(void *arg) {
+    esp_err_t err = ESP_OK;
+    for (;;) {
+        chunk_t c;
+        if (err == ESP_OK && !atomic_load(&failed) && erased < erase_target()) {
+            if (xQueueReceive(full_q, &c, 0) != pdTRUE) {
+                err = erase_step();
+                if (err != ESP_OK) {
+                    atomic_store(&failed, true);
+                }
+                continue;
+            }
+        } else {
+            int64_t t0 = esp_timer_get_time();
+            xQueueReceive(full_q, &c, portMAX_DELAY);
+            if (err == ESP_OK) {
+                stats.flash_stall_ms += ms_since(t0);
+            }
+        }
+        if (c.data == NULL) {
+            break;
+        }
+        if (err == ESP_OK && (err = consume(&c)) != ESP_OK) {
+            atomic_store(&failed, true);
+        }
+        xQueueSend(free_q, &c.data, portMAX_DELAY);
+    }
+    if (err == ESP_OK && !atomic_load(&failed)) {
+        err = flush_stage(true);
+    }
+    flash_err = err;
+    xSemaphoreGive(done);
+    vTaskDelete(NULL);
+}
+
+// Producer, on the calling task. Each buffer is filled completely before it is handed
+// over, so the flash task sees few, large chunks.
+static esp_err_t download(esp_http_client_handle_t client, uint32_t content_length) {
+    uint32_t next_progress = PROGRESS_STEP;
+    int64_t start = esp_timer_get_time();
+    while (!atomic_load(&failed)) {
+        uint8_t *buf;
+        int64_t t0 = esp_timer_get_time();
+        xQueueReceive(free_q, &buf, portMAX_DELAY);
+        stats.net_stall_ms += ms_since(t0);
+
+        t0 = esp_timer_get_time();
+        uint32_t len = 0;
+        while (len < OTA_PIPE_BUF_BYTES) {
+            int n = esp_http_client_read(client, (char *)buf + len, OTA_PIPE_BUF_BYTES - len);
+            if (n < 0) {
+                ESP_LOGE(TAG, "Read failed after %lu bytes", (unsigned long)(stats.bytes_in + len));
+                xQueueSend(free_q, &buf, portMAX_DELAY);
+                return ESP_FAIL;
+            }
+            if (n == 0) {
+                break;
+            }
+            len += n;
+        }
+        stats.net_read_ms += ms_since(t0);
+
+        if (len == 0) {
+            xQueueSend(free_q, &buf, portMAX_DELAY);
+            break;
+        }
+        chunk_t c = { .data = buf, .len = len };
+        xQueueSend(full_q, &c, portMAX_DELAY);
+        stats.bytes_in += len;
+        if (stats.bytes_in >= next_progress) {
+            next_progress += PROGRESS_STEP;
+            uint32_t ms = ms_since(start);
+            if (content_length) {
+                ESP_LOGI(TAG, "%lu / %lu KB, %lu KB/s", (unsigned long)(stats.bytes_in / 1024),
+                         (unsigned long)(content_length / 1024),
+                         (unsigned long)kb_per_s(stats.bytes_in, ms));
+            } else {
+                ESP_LOGI(TAG, "%lu KB, %lu KB/s", (unsigned long)(stats.bytes_in / 1024),
+                         (unsigned long)kb_per_s(stats.bytes_in, ms));
+            }
+        }
+        if (len < OTA_PIPE_BUF_BYTES) {
+            break;                       // read returned 0: end of body
+        }
+    }
+    if (!atomic_load(&failed) && !esp_http_client_is_complete_data_received(client)) {
+        ESP_LOGE(TAG, "Body ended early (%lu bytes)", (unsigned long)stats.bytes_in);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_pipeline_download(const ota_pipeline_config_t *config) {
+    part = esp_ota_get_next_update_partition(NULL);
+    if (part == NULL) {
+        ESP_LOGE(TAG, "No OTA partition to write to");
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint8_t *ring = malloc(OTA_PIPE_BUFS * OTA_PIPE_BUF_BYTES + SPI_FLASH_SEC_SIZE);
+    if (ring == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (free_q == NULL) {
+        free_q = xQueueCreateStatic(OTA_PIPE_BUFS, sizeof(uint8_t *), free_q_store, &free_q_buf);
+        full_q = xQueueCreateStatic(OTA_PIPE_BUFS + 1, sizeof(chunk_t), full_q_store, &full_q_buf);
+        done = xSemaphoreCreateBinaryStatic(&done_buf);
+    }
+    xQueueReset(free_q);
+    xQueueReset(full_q);
+    for (int i = 0; i < OTA_PIPE_BUFS; i++) {
+        uint8_t *buf = ring + i * OTA_PIPE_BUF_BYTES;
+        xQueueSend(free_q, &buf, 0);
+    }
+    stage = ring + OTA_PIPE_BUFS * OTA_PIPE_BUF_BYTES;
+    cfg = *config;
+    staged = 0;
+    erased = written = 0;
+    memset(&stats, 0, sizeof(stats));
+    atomic_store(&failed, false);
+    atomic_store(&image_end, 0);
+    if (cfg.image_size) {
+        if (cfg.image_size > part->size) {
+            ESP_LOGE(TAG, "Image (%lu bytes) larger than %s", (unsigned long)cfg.image_size, part->label);
+            free(ring);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        atomic_store(&image_end, (cfg.image_size + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1));
+    }
+
+    // Started before the connection, so the TLS handshake already overlaps erasing.
+    int64_t start = esp_timer_get_time();
+    if (static_task_start(&ota_flash, flash_task, "ota_flash", NULL, 5) == NULL) {
+        ESP_LOGE(TAG, "Flash task slot busy");
+        free(ring);
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_LOGI(TAG, "Writing %s at 0x%lx, %d x %d KB buffers", part->label,
+             (unsigned long)part->address, OTA_PIPE_BUFS, OTA_PIPE_BUF_BYTES / 1024);
+
+    esp_http_client_handle_t client = esp_http_client_init(cfg.http_config);
+    esp_err_t err = client ? esp_http_client_open(client, 0) : ESP_FAIL;
+    if (client) {
+        tls_profile_check_result(client, err);
+    }
+    uint32_t content_length = 0;
+    if (err == ESP_OK) {
+        int64_t len = esp_http_client_fetch_headers(client);
+        int status = esp_http_client_get_status_code(client);
+        if (status != 200) {
+            ESP_LOGE(TAG, "HTTP %d", status);
+            err = ESP_FAIL;
+        } else if (len > 0) {
+            content_length = (uint32_t)len;
+            if (cfg.image_size == 0 && cfg.decrypt_cb == NULL) {
+                if (content_length > part->size) {
+                    ESP_LOGE(TAG, "Image (%lu bytes) larger than %s", (unsigned long)content_length,
+                             part->label);
+                    err = ESP_ERR_INVALID_SIZE;
+                } else {
+                    atomic_store(&image_end, (content_length + SPI_FLASH_SEC_SIZE - 1) &
+                                             ~(SPI_FLASH_SEC_SIZE - 1));
+                }
+            }
+        }
+    }
+    if (err == ESP_OK) {
+        err = download(client, content_length);
+    }
+    if (err != ESP_OK) {
+        atomic_store(&failed, true);
+    }
+    chunk_t end = { 0 };
+    xQueueSend(full_q, &end, portMAX_DELAY);
+    xSemaphoreTake(done, portMAX_DELAY);
+    if (err == ESP_OK) {
+        err = flash_err;
+    }
+    if (client) {
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+    }
+    free(ring);
+
+    uint32_t total_ms = ms_since(start);
+    ESP_LOGI(TAG, "%lu KB in %lu ms = %lu KB/s, %lu KB written", (unsigned long)(stats.bytes_in / 1024),
+             (unsigned long)total_ms, (unsigned long)kb_per_s(stats.bytes_in, total_ms),
+             (unsigned long)(written / 1024));
+    ESP_LOGI(TAG, "network: read %lu ms, stalled %lu ms on flash", (unsigned long)stats.net_read_ms,
+             (unsigned long)stats.net_stall_ms);
+    ESP_LOGI(TAG, "flash: erase %lu ms, write %lu ms, stalled %lu ms on network",
+             (unsigned long)stats.erase_ms, (unsigned long)stats.write_ms,
+             (unsigned long)stats.flash_stall_ms);
+    if (err != ESP_OK) {
+        written = 0;
+    }
+    return err;
+}
+
+esp_err_t ota_pipeline_commit(void) {
+    if (part == NULL || written == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_partition_pos_t pos = { .offset = part->address, .size = part->size };
+    esp_image_metadata_t meta;
+    if (esp_image_verify(ESP_IMAGE_VERIFY, &pos, &meta) != ESP_OK) {
+        ESP_LOGE(TAG, "Written image failed verification");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return esp_ota_set_boot_partition(part);
+}
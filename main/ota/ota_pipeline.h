@@ -0,0 +1,38 @@
+#ifndef OTA_PIPELINE_H
+#define OTA_PIPELINE_H
+
+// Pipelined OTA download. esp_https_ota reads one small chunk, then blocks on the flash
+// erase/write for it before reading the next, so radio and flash take turns idling.
+// Here the calling task only reads: it fills a ring of OTA_PIPE_BUFS buffers while a
+// flash task drains them — running the decrypt hook (inflate + SHA-256 for compressed
+// images), erasing the partition ahead of the write position whenever it has nothing
+// to write, and writing behind in whole sectors. Throughput and the time each side
+// spent stalled on the other are logged when the download ends.
+//
+// The image lands in the next OTA partition but is not bootable until
+// ota_pipeline_commit(), so the caller can check it against the manifest first.
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "esp_https_ota.h"   // decrypt_cb_arg_t: the hook is shared with the esp_https_ota path
+
+#define OTA_PIPE_BUFS       4
+#define OTA_PIPE_BUF_BYTES  (16 * 1024)   // one full TLS record per read
+
+typedef struct {
+    const esp_http_client_config_t *http_config;
+    // Optional, same contract as esp_https_ota's decrypt_cb; data_out is freed here.
+    esp_err_t (*decrypt_cb)(decrypt_cb_arg_t *args, void *user_ctx);
+    void *decrypt_user_ctx;
+    uint32_t image_size;   // bytes that will be written, 0 = take Content-Length (no decrypt_cb)
+} ota_pipeline_config_t;
+
+// ESP_ERR_NO_MEM before anything was downloaded means the ring didn't fit in the heap;
+// the caller can fall back to esp_https_ota.
+esp_err_t ota_pipeline_download(const ota_pipeline_config_t *cfg);
+
+// Verifies the written image (esp_image_verify, as esp_ota_end does) and marks it bootable.
+esp_err_t ota_pipeline_commit(void);
+
+#endif // OTA_PIPELINE_H
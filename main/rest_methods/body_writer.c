@@ -0,0 +1,171 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "body_writer.h"
+
+static const char *TAG = "BODY";
+
+static const char hex_digits[] = "0123456789ABCDEF";
+static const char b64url_digits[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static void flush(body_writer_t *w) {
+    size_t off = 0;
+    while (off < w->fill && !w->failed) {
+        int n = esp_http_client_write(w->client, w->buf + off, w->fill - off);
+        if (n <= 0) {
+            ESP_LOGE(TAG, "write failed after %u bytes", (unsigned)(w->total - w->fill + off));
+            w->failed = true;
+        } else {
+            off += n;
+        }
+    }
+    w->fill = 0;
+}
+
+// Only the send and render passes copy; the counting pass just adds up lengths.
+static void put(body_writer_t *w, const char *s, size_t len) {
+    w->total += len;
+    if (w->out != NULL) {
+        if (w->total <= w->out_cap) {
+            memcpy(w->out + w->total - len, s, len);
+        }
+        return;
+    }
+    if (w->client == NULL || w->failed) {
+        return;
+    }
+    while (len > 0) {
+        size_t room = sizeof(w->buf) - w->fill;
+        size_t n = len < room ? len : room;
+        memcpy(w->buf + w->fill, s, n);
+        w->fill += n;
+        s += n;
+        len -= n;
+        if (w->fill == sizeof(w->buf)) {
+            flush(w);
+        }
+    }
+}
+
+static void put_char(body_writer_t *w, char c) {
+    put(w, &c, 1);
+}
+
+void bw_raw(body_writer_t *w, const char *s, size_t len) {
+    put(w, s, len);
+}
+
+static void form_key(body_writer_t *w, const char *key) {
+    if (w->fields) {
+        put_char(w, '&');
+    }
+    w->fields = true;
+    put(w, key, strlen(key));
+    put_char(w, '=');
+}
+
+static void form_value(body_writer_t *w, const char *s) {
+    // Runs of safe characters go out in one put() rather than byte by byte.
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == '~') {
+            continue;
+        }
+        put(w, run, s - run);
+        char esc[3] = { '%', hex_digits[c >> 4], hex_digits[c & 0x0F] };
+        put(w, esc, sizeof(esc));
+        run = s + 1;
+    }
+    put(w, run, s - run);
+}
+
+void bw_form(body_writer_t *w, const char *key, const char *value) {
+    form_key(w, key);
+    form_value(w, value ? value : "");
+}
+
+void bw_form_fmt(body_writer_t *w, const char *key, const char *fmt, ...) {
+    char value[BODY_WRITER_FMT_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(value, sizeof(value), fmt, ap);
+    va_end(ap);
+    bw_form(w, key, value);
+}
+
+void bw_form_b64url(body_writer_t *w, const char *key, const uint8_t *data, size_t len) {
+    form_key(w, key);
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        size_t n = len - i < 3 ? len - i : 3;
+        if (n > 1) v |= (uint32_t)data[i + 1] << 8;
+        if (n > 2) v |= data[i + 2];
+        char out[4] = {
+            b64url_digits[(v >> 18) & 0x3F], b64url_digits[(v >> 12) & 0x3F],
+            b64url_digits[(v >> 6) & 0x3F],  b64url_digits[v & 0x3F],
+        };
+        put(w, out, n + 1);   // unpadded: 1 byte -> 2 chars, 2 -> 3, 3 -> 4
+    }
+}
+
+void bw_json_str(body_writer_t *w, const char *s) {
+    if (s == NULL) {
+        s = "";
+    }
+    put_char(w, '"');
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        put(w, run, s - run);
+        char esc[6] = { '\\', (char)c };
+        size_t n = 2;
+        switch (c) {
+        case '"': case '\\': break;
+        case '\n': esc[1] = 'n'; break;
+        case '\r': esc[1] = 'r'; break;
+        case '\t': esc[1] = 't'; break;
+        default:
+            esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+            esc[4] = hex_digits[c >> 4]; esc[5] = hex_digits[c & 0x0F];
+            n = 6;
+            break;
+        }
+        put(w, esc, n);
+        run = s + 1;
+    }
+    put(w, run, s - run);
+    put_char(w, '"');
+}
+
+// ---- Used by rest_methods.c ----------------------------------------------------------
+
+size_t body_writer_measure(body_emit_fn emit, void *ctx) {
+    body_writer_t w = { 0 };
+    emit(&w, ctx);
+    return w.total;
+}
+
+bool body_writer_send(esp_http_client_handle_t client, size_t expected, body_emit_fn emit, void *ctx) {
+    body_writer_t w = { .client = client };
+    emit(&w, ctx);
+    flush(&w);
+    if (!w.failed && w.total != expected) {
+        ESP_LOGE(TAG, "body changed between passes (%u != %u bytes)", (unsigned)w.total,
+                 (unsigned)expected);
+        return false;
+    }
+    return !w.failed;
+}
+
+size_t body_writer_render(body_emit_fn emit, void *ctx, char *buf, size_t cap) {
+    body_writer_t w = { .out = buf, .out_cap = cap };
+    emit(&w, ctx);
+    return w.total <= cap ? w.total : 0;
+}
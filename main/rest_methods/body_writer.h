@@ -0,0 +1,62 @@
+#ifndef BODY_WRITER_H
+#define BODY_WRITER_H
+
+// Request bodies streamed straight into an open esp_http_client connection.
+//
+// A body is described by an emit function that calls the bw_* writers below. POST_stream()
+// runs it twice: once with no connection, which only counts bytes and gives the exact
+// Content-Length, and once after esp_http_client_open(), which escapes into a small
+// fixed buffer and hands it to esp_http_client_write() whenever it fills. Nothing is
+// assembled in RAM, so neither a long sensor name nor a backlog of any length can be
+// truncated, and every value goes through the escaping its content type needs.
+//
+// An emit function must therefore produce the same bytes on both passes: read state,
+// don't consume it. A mismatch is caught and the request fails instead of going out
+// with a wrong Content-Length.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_http_client.h"
+
+#define BODY_WRITER_BUF      128    // bytes per esp_http_client_write()
+#define BODY_WRITER_FMT_MAX  64     // longest bw_form_fmt() value; longer ones: own buffer + bw_form()
+
+typedef struct body_writer {
+    esp_http_client_handle_t client;   // NULL on the counting pass
+    char *out;                         // body_writer_render(): copy here instead
+    size_t out_cap;
+    size_t total;                      // bytes emitted so far
+    bool failed;                       // a write to the connection failed
+    bool fields;                       // a form field was written: next one needs '&'
+    uint16_t fill;
+    char buf[BODY_WRITER_BUF];
+} body_writer_t;
+
+typedef void (*body_emit_fn)(body_writer_t *w, void *ctx);
+
+// Verbatim bytes: literals and already-encoded text only.
+void bw_raw(body_writer_t *w, const char *s, size_t len);
+
+// x-www-form-urlencoded "key=value" pairs, '&'-separated. Keys are written as given;
+// values are percent-encoded (everything but ALPHA / DIGIT / "-._~").
+void bw_form(body_writer_t *w, const char *key, const char *value);
+void bw_form_fmt(body_writer_t *w, const char *key, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+// Binary value as unpadded base64url (which needs no percent-encoding).
+void bw_form_b64url(body_writer_t *w, const char *key, const uint8_t *data, size_t len);
+
+// A quoted JSON string: '"', '\\' and control characters escaped, UTF-8 passed through.
+void bw_json_str(body_writer_t *w, const char *s);
+
+// The two passes, for rest_methods.c. send() returns false if a write failed or the
+// body came out a different length than measure() said.
+size_t body_writer_measure(body_emit_fn emit, void *ctx);
+bool body_writer_send(esp_http_client_handle_t client, size_t expected, body_emit_fn emit, void *ctx);
+
+// The send pass into memory, for transports that need the body in one piece (CoAP hands
+// it to libcoap to split into blocks). Returns the length, or 0 if it needs more than
+// cap bytes; nothing past cap is written either way.
+size_t body_writer_render(body_emit_fn emit, void *ctx, char *buf, size_t cap);
+
+#endif // BODY_WRITER_H
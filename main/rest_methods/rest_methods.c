@@ -13,7 +13,7 @@
 #include "esp_netif.h"
 #include "esp_tls.h"
 #include "esp_http_client.h"
-#include "esp_crt_bundle.h"   // root-CA bundle, so https:// uploads validate (same path OTA uses)
+#include "tls_profile.h"     // athome trust store (CA bundle as fallback), same as OTA
 #include "rest_methods.h"
 
 // The telemetry upload only needs the HTTP status code, not the response body. The
@@ -34,51 +34,139 @@ esp_err_t _http_event_handler_post(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
-// Ensure no other blocking operations occur before sending HTTP request
-int POST(const char* server_uri, const char* to_send)
+// One request on `client`: measure, open with that Content-Length, stream the body,
+// read the status. The response body is drained and dropped (see the handler above) so
+// a keep-alive connection is left ready for the next request. Returns the HTTP status,
+// or -1 if the request never completed (the connection is closed in that case).
+static int stream_request(esp_http_client_handle_t client, body_emit_fn emit, void *ctx)
 {
     const char *TAG = "POST";
-    ESP_LOGI(TAG, "Sending POST request to: %s", server_uri);
-
-    esp_http_client_handle_t http_client_post;
+    size_t len = body_writer_measure(emit, ctx);
+    esp_err_t err = esp_http_client_open(client, len);
+    tls_profile_check_result(client, err);
+    if (err == ESP_OK && !body_writer_send(client, len, emit, ctx)) {
+        err = ESP_FAIL;
+    }
+    int status_code = -1;
+    if (err == ESP_OK) {
+        esp_http_client_fetch_headers(client);
+        status_code = esp_http_client_get_status_code(client);
+        if (status_code <= 0) {
+            err = ESP_FAIL;
+            status_code = -1;
+        } else {
+            esp_http_client_flush_response(client, NULL);
+        }
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "request failed (%u-byte body): %s", (unsigned)len, esp_err_to_name(err));
+        esp_http_client_close(client);
+    }
+    return status_code;
+}
 
+static esp_http_client_handle_t post_client(const char* server_uri, const char* content_type, bool keep_alive)
+{
     esp_http_client_config_t config = {
         .url = server_uri,                           // REQUIRED at init time: without a URL
                                                      // (or host+path) esp_http_client_init()
                                                      // returns NULL and the set_* calls below
                                                      // dereference it -> StoreProhibited panic.
         .event_handler = _http_event_handler_post,
-        .crt_bundle_attach = esp_crt_bundle_attach,  // validate TLS for https:// uploads
         .timeout_ms = 8000,
+        .keep_alive_enable = keep_alive,
     };
+    tls_profile_apply(&config);   // validate TLS for https:// uploads
 
-    http_client_post = esp_http_client_init(&config);
-    if (http_client_post == NULL) {
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
         // Don't crash-loop the whole device on a bad/empty URL — skip this upload.
-        ESP_LOGE(TAG, "esp_http_client_init failed (uri='%s')", server_uri ? server_uri : "(null)");
+        ESP_LOGE("POST", "esp_http_client_init failed (uri='%s')", server_uri ? server_uri : "(null)");
+        return NULL;
+    }
+    esp_http_client_set_method(client, HTTP_METHOD_POST);
+    esp_http_client_set_header(client, "Content-Type", content_type);
+    return client;
+}
+
+int POST_stream(const char* server_uri, const char* content_type, body_emit_fn emit, void *ctx)
+{
+    const char *TAG = "POST";
+    ESP_LOGI(TAG, "Sending POST request to: %s", server_uri);
+
+    esp_http_client_handle_t client = post_client(server_uri, content_type, false);
+    if (client == NULL) {
         return -1;
     }
+    int status_code = stream_request(client, emit, ctx);
+    esp_http_client_cleanup(client);
+    if (status_code > 0) {
+        ESP_LOGI(TAG, "HTTP Status Code: %d", status_code);
+    }
+    return status_code;
+}
 
-    // Ensure no mutex is held before performing this
-    esp_http_client_set_method(http_client_post, HTTP_METHOD_POST);
-    esp_http_client_set_header(http_client_post, "Content-Type", "application/x-www-form-urlencoded");
-    esp_http_client_set_post_field(http_client_post, to_send, strlen(to_send));
+static void emit_string(body_writer_t *w, void *ctx)
+{
+    bw_raw(w, ctx, strlen(ctx));
+}
 
-    esp_err_t err = esp_http_client_perform(http_client_post);
+int POST(const char* server_uri, const char* to_send)
+{
+    return POST_stream(server_uri, "application/x-www-form-urlencoded", emit_string, (void *)to_send);
+}
 
-    int status_code = esp_http_client_get_status_code(http_client_post);
-    esp_http_client_cleanup(http_client_post);
+bool POST_session_open(post_session_t *session, const char* server_uri, const char* content_type)
+{
+    session->client = post_client(server_uri, content_type, true);
+    session->requests = 0;
+    return session->client != NULL;
+}
 
-    if (err == ESP_OK)
-    {
-        ESP_LOGI(TAG, "POST Request Successful\n");
-        ESP_LOGI(TAG, "HTTP Status Code: %d\n", status_code);
-        return status_code;
+int POST_session(post_session_t *session, body_emit_fn emit, void *ctx)
+{
+    int status_code = stream_request(session->client, emit, ctx);
+    if (status_code < 0 && session->requests > 0) {
+        status_code = stream_request(session->client, emit, ctx);
     }
-    else
-    {
-        ESP_LOGI(TAG, "HTTP POST request failed with error: %s\n", esp_err_to_name(err));
-        return status_code; // Return the HTTP status code even on error
+    session->requests++;
+    return status_code;
+}
+
+void POST_session_close(post_session_t *session)
+{
+    if (session->client != NULL) {
+        esp_http_client_cleanup(session->client);
+        session->client = NULL;
     }
 }
 
+int POST_batch(const char* server_uri, body_emit_fn emit, void *const *ctxs, int count, int* status_codes)
+{
+    const char *TAG = "POST_BATCH";
+    post_session_t session;
+    if (!POST_session_open(&session, server_uri, "application/x-www-form-urlencoded")) {
+        return 0;
+    }
+
+    // One handle for the whole batch keeps the TLS session open as long as the server
+    // honours keep-alive.
+    int answered = 0;
+    for (; answered < count; answered++) {
+        int status_code = POST_session(&session, emit, ctxs[answered]);
+        if (status_code < 0) {
+            ESP_LOGE(TAG, "request %d/%d failed", answered + 1, count);
+            break;
+        }
+        if (status_codes) {
+            status_codes[answered] = status_code;
+        }
+        if (status_code != 200) {
+            ESP_LOGW(TAG, "request %d/%d: HTTP %d", answered + 1, count, status_code);
+        }
+    }
+
+    POST_session_close(&session);
+    ESP_LOGI(TAG, "%d/%d bodies answered on one connection", answered, count);
+    return answered;
+}
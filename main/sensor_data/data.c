@@ -10,20 +10,24 @@
 #include "cJSON.h"
 #include "driver/i2c.h"
 #include "rest_methods.h"
+#include "reading_backlog.h"
+#include "wake_governor.h"
+#include "mem_diag.h"
+#include "sampler.h"
+#include "report_filter.h"
+#include "ts_codec.h"
+#include "reading_logic.h"
+#include "fuel_gauge.h"
+#include "sleep_mgr.h"
+#include "esp_attr.h"
 #include "time.h"      // For time manipulation (including time-related functions like local time)
 #include "sntp.h" 
 #include <stdio.h>
+#include <math.h>
 #include "driver/i2c.h"
 
 static const char *TAG = "DATA";
 
-// Map function (equivalent to Arduino's map function)
-int map(int x, int in_min, int in_max, int out_min, int out_max) {
-    if (in_min == in_max) return out_min; // Avoid division by zero
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
-}
-
-
 #define I2C_MASTER_SCL_IO  17    // SCL pin
 #define I2C_MASTER_SDA_IO  16    // SDA pin
 #define I2C_MASTER_FREQ_HZ 400000 // I2C frequency
@@ -87,6 +91,39 @@ esp_err_t read_register(uint8_t reg_addr, uint8_t *data, size_t len) {
     i2c_cmd_link_delete(cmd);
     return ESP_OK;
 }
+// The bus for the alert/hibernate logic in max17048.c: same transactions as above,
+// but with the I2C result passed back so a missing gauge doesn't read as zeros.
+static int gauge_bus_read(void *ctx, uint8_t reg, uint16_t *value) {
+    uint8_t data[2];
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (MAX17048_ADDR << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, reg, true);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (MAX17048_ADDR << 1) | I2C_MASTER_READ, true);
+    i2c_master_read(cmd, data, 2, I2C_MASTER_LAST_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(100));
+    i2c_cmd_link_delete(cmd);
+    *value = (uint16_t)(data[0] << 8 | data[1]);
+    return err;
+}
+
+static int gauge_bus_write(void *ctx, uint8_t reg, uint16_t value) {
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (MAX17048_ADDR << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, reg, true);
+    i2c_master_write_byte(cmd, (uint8_t)(value >> 8), true);
+    i2c_master_write_byte(cmd, (uint8_t)value, true);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(100));
+    i2c_cmd_link_delete(cmd);
+    return err;
+}
+
+static const max17048_bus_t gauge_bus = { gauge_bus_read, gauge_bus_write, NULL };
+
 // structure to store battery data
 struct BatteryStatus {
     float soc;
@@ -103,19 +140,14 @@ BatteryStatus getBattery() {
 
     // Read VCELL register (battery voltage)
     uint16_t vcell_raw = max17048_read_register(REG_VCELL);
-    float voltage_actual = (vcell_raw >> 4) * 1.25 / 1000; // Convert to volts
+    float voltage_actual = max17048_vcell_volts(vcell_raw);
 
     // Read SOC register (State of Charge)
     uint16_t soc_raw = max17048_read_register(REG_SOC);
-    float soc_actual = soc_raw / 256.0; // Convert to percentage
-    batteryStatus.soc = soc_actual ;
+    batteryStatus.soc = max17048_soc_percent(soc_raw);
 
-    // Read CRATE register (Charge/Discharge rate). CRATE is SIGNED two's-complement:
-    // positive = charging, negative = discharging; LSB = 0.208 %/hr. (Reading it as
-    // unsigned/256 made discharge show as garbage like "13620 %/hr".)
-    int16_t crate_raw = (int16_t)max17048_read_register(REG_CRATE);
-    float crate_actual = crate_raw * 0.208f;
-    batteryStatus.crate = crate_actual;
+    // Read CRATE register (Charge/Discharge rate), signed: see max17048_crate_percent().
+    batteryStatus.crate = max17048_crate_percent(max17048_read_register(REG_CRATE));
 
     // Read STATE register (Battery state)
     ESP_ERROR_CHECK(read_register(REG_STATUS, data, 2));  // STATE address
@@ -157,7 +189,9 @@ int readMoisture() {
     int reading = 0;
 
 #if SOIL_PWR_GPIO >= 0
-    // Power the probe only for this measurement.
+    // Power the probe only for this measurement. Until now the pin was still latched
+    // OFF by soil_power_hold_off() from the last sleep.
+    gpio_hold_dis((gpio_num_t)SOIL_PWR_GPIO);
     gpio_reset_pin((gpio_num_t)SOIL_PWR_GPIO);
     gpio_set_direction((gpio_num_t)SOIL_PWR_GPIO, GPIO_MODE_OUTPUT);
     gpio_set_level((gpio_num_t)SOIL_PWR_GPIO, SOIL_PWR_ACTIVE_LEVEL);
@@ -168,55 +202,80 @@ int readMoisture() {
     reading = adc1_get_raw(ADC1_CHANNEL_4);  // Get the raw ADC value
 
     // Map the ADC raw value to a percentage (0-100)
-    int moisture = map(reading, 3600, 2130, 0, 100);
+    int moisture = moisture_percent(reading);
 
     // Log the raw ADC reading and calculated moisture percentage
     ESP_LOGI(TAG, "Raw ADC Reading: %d, Moisture %%: %d%%", reading, moisture);
 
 #if SOIL_PWR_GPIO >= 0
-    // Cut probe power. In deep sleep IDF tristates the pin; the gate pull (HW) then
-    // holds the load switch OFF until the next wake.
+    // Cut probe power. soil_power_hold_off() keeps it cut through deep sleep.
     gpio_set_level((gpio_num_t)SOIL_PWR_GPIO, !SOIL_PWR_ACTIVE_LEVEL);
 #endif
 
     return moisture;
 }
 
-// Build the form-encoded body and POST it, with a small bounded retry so one flaky
-// connection or server blip doesn't permanently lose an 8-hourly reading.
+// sleep_mgr_prepare(): latch the gate at its OFF level for the sleep. Left to the gate
+// pull-up alone, the switch depends on the tristated pad not pulling against it; the
+// hold costs nothing and also covers wakes that never read the probe.
+void soil_power_hold_off(void) {
+#if SOIL_PWR_GPIO >= 0
+    gpio_set_direction((gpio_num_t)SOIL_PWR_GPIO, GPIO_MODE_OUTPUT);
+    gpio_set_level((gpio_num_t)SOIL_PWR_GPIO, !SOIL_PWR_ACTIVE_LEVEL);
+    gpio_hold_en((gpio_num_t)SOIL_PWR_GPIO);
+#endif
+}
+
+// The POST body is streamed by POST_stream() (rest_methods.c), with a small bounded retry
+// so one flaky connection or server blip doesn't permanently lose an 8-hourly reading.
 //
-// SYNCHRONOUS: monitor() runs this in monitor_task (large stack) and only deep-sleeps
+// SYNCHRONOUS: the wake cycle runs this in the wake task (large stack) and only deep-sleeps
 // AFTER it returns, so deep sleep can no longer cut off an in-flight upload. (The old
 // design spawned a detached task and slept after a fixed 3 s delay — shorter than the
 // 8 s HTTP timeout — so a slow TLS upload on weak WiFi was killed mid-flight and the
 // reading was lost, which read as "device offline" in the app.) Returns true on HTTP 200.
-bool uploadReadings(int moisture, float battery, bool battery_status, float crate,
-                    bool usb_present, bool charging, const char* hostname,
-                    const char* sensorName, const char* sensorLocation, const char* apiToken)
+#define UPLOAD_URI "https://athome.rodlandfarms.com/api/esp/data?"   // TLS (root-CA bundle in POST())
+#define UPLOAD_MIN_ATTEMPT_MS 3000   // don't start a POST the wake governor would cut off
+#define FORM_TYPE "application/x-www-form-urlencoded"
+
+typedef struct {
+    const SensorReading *reading;
+    const char *hostname, *name, *location, *token;
+    uint32_t taken_at;        // backlog entries only; 0 = not sent
+    bool with_extras;         // this wake's reading: sampler aggregates + memory figures
+} reading_body_t;
+
+static void emit_reading(body_writer_t *w, void *ctx) {
+    const reading_body_t *b = ctx;
+    write_reading_form(w, b->reading, b->hostname, b->name, b->location, b->token);
+    if (b->taken_at) {
+        bw_form_fmt(w, "taken_at", "%lu", (unsigned long)b->taken_at);
+    }
+    if (b->with_extras) {
+        // Aggregates of the micro-wake samples since the last delivered upload, if any.
+        sampler_write(w);
+        report_filter_write(w);   // wakes since the last upload that sent nothing
+        fuel_gauge_write(w);
+        sleep_mgr_write(w);       // wake causes, time awake and asleep since the last upload
+        // Previous wake's stack/heap figures ride along as one extra form field.
+        char mem[192];
+        if (mem_diag_format(mem, sizeof(mem)) > 0) {
+            bw_form(w, "mem", mem);
+        }
+    }
+}
+
+bool uploadReadings(const SensorReading *reading, const char *hostname,
+                    const char *sensorName, const char *sensorLocation, const char *apiToken)
 {
-    // Clamp the moisture and battery value to the range [0, 100]
-    if (moisture > 100) moisture = 100;
-    if (battery  > 100) battery  = 100;
-
-    // charge_status keys off the charger STAT line (reliable), with charge rate as the
-    // discharge/idle tiebreaker. power_source is inferred (no solar-sense line on V5).
-    const char *charge_status = charging       ? "charging"
-                              : (crate < -0.5f) ? "discharging"
-                              : "idle";
-    const char *power_source  = usb_present ? "USB" : (charging ? "Solar" : "Battery");
-
-    char server_uri[256];
-    snprintf(server_uri, sizeof(server_uri),
-             "https://athome.rodlandfarms.com/api/esp/data?");  // TLS (root-CA bundle in POST())
-
-    char httpRequestData[512];
-    snprintf(httpRequestData, sizeof(httpRequestData),
-             "api_token=%s&hostname=%s&sensor=%s&location=%s&moisture=%d&batt=%.2f&battery_status=%d&charge_status=%s&power_source=%s",
-             apiToken, hostname, sensorName, sensorLocation, moisture, battery, battery_status, charge_status, power_source);
+    reading_body_t body = {
+        .reading = reading, .hostname = hostname, .name = sensorName,
+        .location = sensorLocation, .token = apiToken, .with_extras = true,
+    };
 
     const int MAX_ATTEMPTS = 3;
     for (int attempt = 1; attempt <= MAX_ATTEMPTS; attempt++) {
-        int httpResponseCode = POST(server_uri, httpRequestData);
+        int httpResponseCode = POST_stream(UPLOAD_URI, FORM_TYPE, emit_reading, &body);
         if (httpResponseCode == 200) {
             ESP_LOGI("UploadReadings", "POST ok (attempt %d/%d)", attempt, MAX_ATTEMPTS);
             return true;
@@ -224,20 +283,122 @@ bool uploadReadings(int moisture, float battery, bool battery_status, float crat
         ESP_LOGE("UploadReadings", "POST failed code=%d (attempt %d/%d)",
                  httpResponseCode, attempt, MAX_ATTEMPTS);
         if (attempt < MAX_ATTEMPTS) {
-            vTaskDelay(pdMS_TO_TICKS(1500 * attempt));  // linear backoff: 1.5 s, then 3 s
+            uint32_t backoff_ms = 1500 * attempt;   // linear backoff: 1.5 s, then 3 s
+            if (governor_remaining_ms() < backoff_ms + UPLOAD_MIN_ATTEMPT_MS) {
+                ESP_LOGW("UploadReadings", "no wake budget left for attempt %d", attempt + 1);
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(backoff_ms));
         }
     }
-    ESP_LOGE("UploadReadings", "giving up after %d attempts — reading lost", MAX_ATTEMPTS);
+    ESP_LOGE("UploadReadings", "giving up — reading goes to the backlog");
     return false;
 }
 
-// Runs monitor() in its own task. monitor() does a TLS OTA check + uploads, which
-// need a large stack; the WiFi event-handler task it used to run in is only 2304 B
-// (CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE) and overflowed on the cert-bundle TLS
-// handshake. monitor() normally ends in deep sleep and never returns.
-void monitor_task(void *pvParameters){
-    monitor();
-    vTaskDelete(NULL);
+#define SERIES_URI "https://athome.rodlandfarms.com/api/esp/series?"
+#define SERIES_MIN_READINGS 2
+
+// Set when the backend answers the series endpoint with 404 (not deployed there yet);
+// until the next power cycle the backlog goes out one reading per POST as before.
+static RTC_DATA_ATTR bool series_unsupported = false;
+
+typedef struct {
+    const uint8_t *packed;
+    size_t len;
+} series_body_t;
+
+static void emit_series(body_writer_t *w, void *ctx) {
+    const series_body_t *b = ctx;
+    bw_form(w, "api_token", main_struct.apiToken);
+    bw_form(w, "hostname", main_struct.hostname);
+    bw_form(w, "sensor", main_struct.name);
+    bw_form(w, "location", main_struct.location);
+    bw_form_b64url(w, "series", b->packed, b->len);
+}
+
+// The whole backlog in one POST: readings encoded column-wise by ts_codec (~3-7 bytes
+// each instead of ~110 as form text), base64url in a "series" field next to the usual
+// identity fields. tools/ts_codec has the reference decoder. The encoded block lives on
+// the wake task's stack; its base64 text is produced as it is written out.
+static bool upload_backlog_series(int *sent) {
+    BacklogEntry entries[READING_BACKLOG_CAPACITY];
+    ts_sample_t samples[READING_BACKLOG_CAPACITY];
+    uint8_t packed[TS_CODEC_MAX_BYTES(READING_BACKLOG_CAPACITY)];
+
+    size_t n = backlog_peek_many(entries, READING_BACKLOG_CAPACITY);
+    for (size_t i = 0; i < n; i++) {
+        samples[i].taken_at  = entries[i].taken_at;
+        samples[i].moisture  = entries[i].reading.moisture;
+        samples[i].power     = entries[i].reading.power;
+        samples[i].soc_raw   = entries[i].reading.soc_raw;
+        samples[i].crate_raw = entries[i].reading.crate_raw;
+    }
+    int len = ts_encode(samples, n, packed, sizeof(packed));
+    if (len < 0) {
+        return false;
+    }
+
+    series_body_t body = { .packed = packed, .len = (size_t)len };
+    int code = POST_stream(SERIES_URI, FORM_TYPE, emit_series, &body);
+    if (code == 404) {
+        ESP_LOGW("MONITOR", "series endpoint not available; sending backlog per reading");
+        series_unsupported = true;
+        return false;
+    }
+    if (code != 200) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        backlog_drop();
+    }
+    *sent = (int)n;
+    ESP_LOGI("MONITOR", "backlog: %u readings in one %d-byte series", (unsigned)n, len);
+    return true;
+}
+
+// Readings earlier wakes couldn't deliver, oldest first. Several go out as one series
+// POST; otherwise one attempt each while the upload budget lasts. taken_at lets the
+// backend file them under the right time.
+static void upload_backlog(void) {
+    BacklogEntry entry;
+    int sent = 0;
+    if (!series_unsupported && backlog_count() >= SERIES_MIN_READINGS &&
+        governor_remaining_ms() >= UPLOAD_MIN_ATTEMPT_MS) {
+        upload_backlog_series(&sent);
+    }
+    while (backlog_peek(&entry) && governor_remaining_ms() >= UPLOAD_MIN_ATTEMPT_MS) {
+        SensorReading reading;
+        unpack_reading(&entry.reading, &reading);
+        reading_body_t body = {
+            .reading = &reading, .hostname = main_struct.hostname, .name = main_struct.name,
+            .location = main_struct.location, .token = main_struct.apiToken,
+            .taken_at = entry.taken_at,
+        };
+        if (POST_stream(UPLOAD_URI, FORM_TYPE, emit_reading, &body) != 200) {
+            break;
+        }
+        backlog_drop();
+        sent++;
+    }
+    if (sent > 0 || backlog_count() > 0) {
+        ESP_LOGI("MONITOR", "backlog: sent %d, %u left (%lu overwritten)", sent,
+                 (unsigned)backlog_count(), (unsigned long)backlog_overwritten());
+    }
+}
+
+bool upload_session_open(post_session_t *session) {
+    return POST_session_open(session, UPLOAD_URI, FORM_TYPE);
+}
+
+// A streamed reading: the same body a backlog entry gets, taken_at included.
+int upload_session_send(post_session_t *session, const PackedReading *packed, uint32_t taken_at) {
+    SensorReading reading;
+    unpack_reading(packed, &reading);
+    reading_body_t body = {
+        .reading = &reading, .hostname = main_struct.hostname, .name = main_struct.name,
+        .location = main_struct.location, .token = main_struct.apiToken, .taken_at = taken_at,
+    };
+    return POST_session(session, emit_reading, &body);
 }
 
 // --- Power-source sensing (board V5 / Schematic.png: USB_DETECT=GPIO13, STAT=GPIO14) ---
@@ -263,28 +424,55 @@ static void read_power_state(bool *usb_present, bool *charging) {
     *charging    = gpio_get_level(STAT_GPIO) == 0;  // active-low
 }
 
-void monitor(){
-    // Check for firmwareupdate
-    check_update();
-    //xTaskCreate(check_update, "check_update", 8192, NULL, 5, NULL);
-    
-    i2c_master_init();
-
-    // Read battery and moisture data
-    BatteryStatus battery = getBattery();
-    int moisture = readMoisture();
-    bool usb_present = false, charging = false;
+bool usb_power_present(void) {
+    bool usb_present, charging;
     read_power_state(&usb_present, &charging);
+    return usb_present;
+}
+
+// The I2C driver is only installed the first time (a second i2c_driver_install() on the
+// same port fails).
+const max17048_bus_t *fuel_gauge_bus(void) {
+    static bool i2c_ready = false;
+    if (!i2c_ready) {
+        i2c_master_init();
+        i2c_ready = true;
+    }
+    return &gauge_bus;
+}
+
+// Take one full sample. Safe to call more than once per wake.
+void take_reading(SensorReading *reading) {
+    fuel_gauge_service(fuel_gauge_bus());
+
+    reading->battery = getBattery();
+    reading->moisture = readMoisture();
+    read_power_state(&reading->usb_present, &reading->charging);
 
-    // Upload data — synchronous + retried; returns only after success or all attempts,
-    // so no fixed post-upload delay is needed (the old vTaskDelay(3000) raced the 8 s
-    // HTTP timeout and could sleep through an in-flight upload).
-    bool uploaded = uploadReadings(moisture, battery.soc, battery.status, battery.crate,
-                                   usb_present, charging, main_struct.hostname,
-                                   main_struct.name, main_struct.location, main_struct.apiToken);
-    ESP_LOGI("MONITOR", "upload %s", uploaded ? "succeeded" : "FAILED (reading lost)");
-
-    // Sleep duration comes from NVS (set at provisioning via optional "sleep_seconds"
-    // JSON key); defaults to 8 h. No more compile-time comment toggling.
-    enter_deep_sleep(nvs_get_sleep_seconds());
-}
\ No newline at end of file
+    PackedReading packed;
+    pack_reading(reading, &packed);
+    sleep_mgr_note_soc(packed.soc_raw);
+}
+
+// The upload step of a connected wake (wake_cycle.c, UPLOAD state). Synchronous and
+// retried; returns only after success or all attempts, so no fixed post-upload delay is
+// needed (the old vTaskDelay(3000) raced the 8 s HTTP timeout and could sleep through an
+// in-flight upload). The reading must already be held by the governor.
+bool deliver_reading(const SensorReading *reading){
+    bool uploaded = uploadReadings(reading, main_struct.hostname, main_struct.name,
+                                   main_struct.location, main_struct.apiToken);
+    ESP_LOGI("MONITOR", "upload %s", uploaded ? "succeeded" : "FAILED (kept for next wake)");
+    if (uploaded) {
+        governor_release_reading();
+        // Only the transports whose body carried the extras reset them (coap_link too);
+        // MQTT's fixed payload has none, so they wait for an upload that does.
+        sampler_reset();
+        report_filter_uploaded(reading);
+        fuel_gauge_reported();
+        sleep_mgr_reported();
+        upload_backlog();
+    } else {
+        governor_defer_reading();
+    }
+    return uploaded;
+}
@@ -0,0 +1,113 @@
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "body_writer.h"
+#include "fuel_gauge.h"
+
+static const char *TAG = "FUEL_GAUGE";
+
+// Empty alert at 10 %: with the 8 h default interval that leaves days, not hours, to
+// get the device on a charger. Low voltage at 3.4 V sits just above where the 3.3 V
+// LDO drops out and Wi-Fi bursts start browning out the radio.
+#define FG_EMPTY_PCT    10
+#define FG_LOW_MV       3400
+#define FG_REARM_MV     3600
+// Hibernate (about 3 uA instead of 23 uA, ADC every 45 s) below 10 %/hr instead of the
+// default 26.6 %/hr; the asleep board stays far under either. ActThr 300 mV instead of
+// the default 60 mV, so a wake's Wi-Fi sag doesn't pull the gauge out of hibernate only
+// to spend the next six minutes qualifying for it again.
+#define FG_HIB_THR      0x30    // 0.208 %/hr per LSB
+#define FG_ACT_THR      0xF0    // 1.25 mV per LSB
+
+static const max17048_alert_cfg_t alert_cfg = {
+    .empty_pct = FG_EMPTY_PCT,
+    .low_mv = FG_LOW_MV,
+    .rearm_mv = FG_REARM_MV,
+    .hib_thr = FG_HIB_THR,
+    .act_thr = FG_ACT_THR,
+};
+
+// RTC_DATA_ATTR: an alert taken in a micro-wake or a wake whose upload failed is still
+// reported by a later one. A reset loses it, but the condition is usually still there.
+static RTC_DATA_ATTR uint8_t pending;
+
+static bool alerts_taken;     // once per boot
+
+void fuel_gauge_service(const max17048_bus_t *bus) {
+    // Configure first: a VL alert disarms its own threshold, so the clear below sticks.
+    int writes = max17048_configure(bus, &alert_cfg);
+    if (writes < 0) {
+        ESP_LOGW(TAG, "Threshold setup failed (I2C)");
+    } else if (writes > 0) {
+        ESP_LOGI(TAG, "Programmed %d register(s): empty < %d %%, low < %d mV",
+                 writes, FG_EMPTY_PCT, FG_LOW_MV);
+    }
+    if (alerts_taken) {
+        return;
+    }
+    alerts_taken = true;
+
+    uint8_t alerts;
+    if (max17048_take_alerts(bus, &alerts) != 0) {
+        ESP_LOGW(TAG, "Alert read failed (I2C)");
+        return;
+    }
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT1) {
+        ESP_LOGW(TAG, "Woken by ALRT (status 0x%02x)", alerts);
+    }
+    // RI only means the registers were at their defaults, which configure just fixed.
+    alerts &= (uint8_t)~MAX17048_ALERT_RESET;
+    if (alerts) {
+        ESP_LOGW(TAG, "Battery alert 0x%02x", alerts);
+        pending |= alerts;
+    }
+    ESP_LOGD(TAG, "Gauge %s", max17048_hibernating(bus) ? "hibernating" : "active");
+}
+
+bool fuel_gauge_alert_pending(void) {
+    return pending != 0;
+}
+
+void fuel_gauge_write(body_writer_t *w) {
+    static const struct { uint8_t bit; const char *name; } names[] = {
+        { MAX17048_ALERT_EMPTY,  "empty" },
+        { MAX17048_ALERT_VLOW,   "low_v" },
+        { MAX17048_ALERT_VHIGH,  "high_v" },
+        { MAX17048_ALERT_VRESET, "v_reset" },
+    };
+    char list[40] = "";
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (pending & names[i].bit) {
+            if (list[0]) {
+                strlcat(list, ",", sizeof(list));
+            }
+            strlcat(list, names[i].name, sizeof(list));
+        }
+    }
+    if (list[0]) {
+        bw_form(w, "batt_alert", list);
+    }
+}
+
+void fuel_gauge_reported(void) {
+    pending = 0;
+}
+
+void fuel_gauge_arm_wake(void) {
+#if FUEL_GAUGE_ALRT_GPIO >= 0
+    // A latch that couldn't be cleared would wake us straight back up, all night.
+    gpio_num_t pin = (gpio_num_t)FUEL_GAUGE_ALRT_GPIO;
+    rtc_gpio_init(pin);
+    rtc_gpio_set_direction(pin, RTC_GPIO_MODE_INPUT_ONLY);
+    rtc_gpio_pullup_dis(pin);      // 100 k to the always-on 3V3 on the board
+    rtc_gpio_pulldown_dis(pin);
+    if (rtc_gpio_get_level(pin) == 0) {
+        ESP_LOGW(TAG, "ALRT still low; not a wake source this sleep");
+        return;
+    }
+    esp_sleep_enable_ext1_wakeup(1ULL << FUEL_GAUGE_ALRT_GPIO, ESP_EXT1_WAKEUP_ANY_LOW);
+#endif
+}
@@ -0,0 +1,34 @@
+#ifndef FUEL_GAUGE_H
+#define FUEL_GAUGE_H
+
+// Fuel-gauge alert management. Every wake that reads the MAX17048 first keeps its
+// alert thresholds (low SoC, low cell voltage) and hibernate thresholds programmed
+// (max17048.h), then collects and clears any latched alert. On V6 the gauge's ALRT line
+// (IO18, active-low, external pull-up) is an ext1 deep-sleep wake source, so a failing
+// battery wakes the device for an upload instead of waiting out the sleep. A wake that
+// found an alert always runs the full cycle: micro-wakes and report-by-exception don't
+// skip it. The upload then carries "batt_alert=<names>".
+//
+// FUEL_GAUGE_ALRT_GPIO is -1 on V5 boards (ALRT not routed). Thresholds and alerts still
+// work there, they are just noticed at the next scheduled wake.
+
+#include <stdbool.h>
+#include "max17048.h"
+
+#define FUEL_GAUGE_ALRT_GPIO (-1)   // V6: 18 (ALRT_INT). -1 = not routed (V5 fleet)
+
+struct body_writer;
+
+// The gauge's I2C bus (data.c), with the driver installed on first use.
+const max17048_bus_t *fuel_gauge_bus(void);
+
+// take_reading(), before the battery registers are read. Alerts are collected once per
+// boot; the thresholds are checked on every call.
+void fuel_gauge_service(const max17048_bus_t *bus);
+
+bool fuel_gauge_alert_pending(void);                 // an alert not yet uploaded
+void fuel_gauge_write(struct body_writer *w);        // batt_alert=empty,low_v; nothing if none
+void fuel_gauge_reported(void);                      // the upload with the alert went out
+void fuel_gauge_arm_wake(void);                      // sleep_mgr_prepare(): ALRT as ext1 wake
+
+#endif // FUEL_GAUGE_H
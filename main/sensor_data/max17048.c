@@ -0,0 +1,88 @@
+#include "max17048.h"
+
+#define CONFIG_SLEEP      0x0080
+#define CONFIG_ALSC       0x0040
+#define CONFIG_ALRT       0x0020
+#define CONFIG_ATHD_MASK  0x001F
+#define MODE_HIBSTAT      0x1000
+#define VALRT_LSB_MV      20
+#define VALRT_MAX_OFF     0xFF     // 5.1 V: no high-voltage alert
+
+uint16_t max17048_config_value(uint16_t config, const max17048_alert_cfg_t *cfg) {
+    uint8_t empty = cfg->empty_pct < 1 ? 1 : cfg->empty_pct > 32 ? 32 : cfg->empty_pct;
+    config &= (uint16_t)~(CONFIG_SLEEP | CONFIG_ALSC | CONFIG_ATHD_MASK);
+    return config | (uint16_t)(32 - empty);
+}
+
+uint16_t max17048_valrt_value(const max17048_alert_cfg_t *cfg, uint16_t vcell_mv) {
+    // VL is level-triggered: left armed below the threshold it would latch again right
+    // after every clear and keep ALRT low. Off until the cell has recovered.
+    uint32_t min = 0;
+    if (cfg->low_mv > 0 && vcell_mv >= cfg->rearm_mv) {
+        min = cfg->low_mv / VALRT_LSB_MV;
+        min = min > 0xFF ? 0xFF : min;
+    }
+    return (uint16_t)(min << 8 | VALRT_MAX_OFF);
+}
+
+uint16_t max17048_hibrt_value(const max17048_alert_cfg_t *cfg) {
+    return (uint16_t)(cfg->hib_thr << 8 | cfg->act_thr);
+}
+
+static int sync_reg(const max17048_bus_t *bus, uint8_t reg, uint16_t current, uint16_t want,
+                    int *writes) {
+    if (current == want) {
+        return 0;
+    }
+    if (bus->write(bus->ctx, reg, want) != 0) {
+        return -1;
+    }
+    (*writes)++;
+    return 0;
+}
+
+int max17048_configure(const max17048_bus_t *bus, const max17048_alert_cfg_t *cfg) {
+    uint16_t vcell, config, valrt, hibrt;
+    if (bus->read(bus->ctx, MAX17048_REG_VCELL, &vcell) != 0 ||
+        bus->read(bus->ctx, MAX17048_REG_CONFIG, &config) != 0 ||
+        bus->read(bus->ctx, MAX17048_REG_VALRT, &valrt) != 0 ||
+        bus->read(bus->ctx, MAX17048_REG_HIBRT, &hibrt) != 0) {
+        return -1;
+    }
+    uint16_t vcell_mv = (uint16_t)((vcell >> 4) * 5 / 4);   // 1.25 mV per 16 LSBs
+    int writes = 0;
+    if (sync_reg(bus, MAX17048_REG_CONFIG, config, max17048_config_value(config, cfg), &writes) ||
+        sync_reg(bus, MAX17048_REG_VALRT, valrt, max17048_valrt_value(cfg, vcell_mv), &writes) ||
+        sync_reg(bus, MAX17048_REG_HIBRT, hibrt, max17048_hibrt_value(cfg), &writes)) {
+        return -1;
+    }
+    return writes;
+}
+
+int max17048_take_alerts(const max17048_bus_t *bus, uint8_t *alerts) {
+    uint16_t status, config;
+    *alerts = 0;
+    if (bus->read(bus->ctx, MAX17048_REG_STATUS, &status) != 0) {
+        return -1;
+    }
+    uint8_t flags = (uint8_t)(status >> 8) & 0x3F;
+    if (flags == 0) {
+        return 0;
+    }
+    // Status bits first: clearing CONFIG.ALRT while one is still set re-asserts the pin.
+    if (bus->write(bus->ctx, MAX17048_REG_STATUS, (uint16_t)(status & ~((uint16_t)flags << 8))) != 0 ||
+        bus->read(bus->ctx, MAX17048_REG_CONFIG, &config) != 0) {
+        return -1;
+    }
+    if ((config & CONFIG_ALRT) &&
+        bus->write(bus->ctx, MAX17048_REG_CONFIG, (uint16_t)(config & ~CONFIG_ALRT)) != 0) {
+        return -1;
+    }
+    *alerts = flags;
+    return 0;
+}
+
+bool max17048_hibernating(const max17048_bus_t *bus) {
+    uint16_t mode;
+    return bus->read(bus->ctx, MAX17048_REG_MODE, &mode) == 0 && (mode & MODE_HIBSTAT);
+}
@@ -0,0 +1,69 @@
+#ifndef MAX17048_H
+#define MAX17048_H
+
+// MAX17048 alert and hibernate registers: what to program and how to clear a latched
+// alert. Pure C behind a two-function bus, no ESP-IDF headers, so tools/data_bench runs
+// it against a register-array mock. On the device data.c supplies the I2C bus and
+// fuel_gauge.c decides when to call it.
+//
+// Register layout (16-bit, MSB first):
+//   CONFIG 0x0C  RCOMP(15:8) SLEEP(7) ALSC(6) ALRT(5) ATHD(4:0); empty alert below 32-ATHD %
+//   VALRT  0x14  MIN(15:8) MAX(7:0), 20 mV per LSB; VL/VH alert outside MIN..MAX
+//   HIBRT  0x0A  HibThr(15:8) 0.208 %/hr per LSB, ActThr(7:0) 1.25 mV per LSB;
+//                power-on 0x8030 = 26.6 %/hr, 60 mV
+//   STATUS 0x1A  RI(8) VH(9) VL(10) VR(11) HD(12) SC(13); write 0 to a bit to clear it
+//   MODE   0x06  HibStat(12), read-only
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX17048_REG_VCELL   0x02
+#define MAX17048_REG_MODE    0x06
+#define MAX17048_REG_HIBRT   0x0A
+#define MAX17048_REG_CONFIG  0x0C
+#define MAX17048_REG_VALRT   0x14
+#define MAX17048_REG_STATUS  0x1A
+
+// STATUS high byte, as reported by max17048_take_alerts().
+#define MAX17048_ALERT_RESET    0x01   // RI: gauge powered up with default registers
+#define MAX17048_ALERT_VHIGH    0x02   // VH
+#define MAX17048_ALERT_VLOW     0x04   // VL
+#define MAX17048_ALERT_VRESET   0x08   // VR
+#define MAX17048_ALERT_EMPTY    0x10   // HD: SoC fell below the CONFIG.ATHD threshold
+#define MAX17048_ALERT_CHANGE   0x20   // SC: 1 % SoC step (ALSC; left off here)
+
+// Both return 0 on success, anything else on a bus error.
+typedef struct {
+    int (*read)(void *ctx, uint8_t reg, uint16_t *value);
+    int (*write)(void *ctx, uint8_t reg, uint16_t value);
+    void *ctx;
+} max17048_bus_t;
+
+typedef struct {
+    uint8_t  empty_pct;      // HD alert when SoC drops below this, 1..32 %
+    uint16_t low_mv;         // VL alert below this cell voltage; 0 = off
+    uint16_t rearm_mv;       // after VL, stays off until VCELL is back above this
+    uint8_t  hib_thr;        // HIBRT.HibThr: hibernate once |CRATE| stays below this for 6 min
+    uint8_t  act_thr;        // HIBRT.ActThr: leave hibernate on an OCV-VCELL step above this
+} max17048_alert_cfg_t;
+
+// Register values for cfg at the given cell voltage. config is the current CONFIG
+// register: RCOMP and the ALRT latch are kept, SLEEP and ALSC cleared.
+uint16_t max17048_config_value(uint16_t config, const max17048_alert_cfg_t *cfg);
+uint16_t max17048_valrt_value(const max17048_alert_cfg_t *cfg, uint16_t vcell_mv);
+uint16_t max17048_hibrt_value(const max17048_alert_cfg_t *cfg);
+
+// Brings CONFIG, VALRT and HIBRT to the values above, writing only the ones that differ
+// (all of them after a gauge power-on reset). Returns the number of registers written,
+// or -1 on a bus error.
+int max17048_configure(const max17048_bus_t *bus, const max17048_alert_cfg_t *cfg);
+
+// Reads STATUS and, if anything is latched, clears those bits and then CONFIG.ALRT so
+// the ALRT pin is released. *alerts gets STATUS' high byte (MAX17048_ALERT_*).
+// Returns 0, or -1 on a bus error.
+int max17048_take_alerts(const max17048_bus_t *bus, uint8_t *alerts);
+
+// MODE.HibStat. False on a bus error.
+bool max17048_hibernating(const max17048_bus_t *bus);
+
+#endif // MAX17048_H
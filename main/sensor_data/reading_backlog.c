@@ -0,0 +1,129 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "reading_backlog.h"
+
+#define BACKLOG_MAGIC 0x424B4C32u   // "BKL2": first_seq added
+
+typedef struct {
+    uint32_t magic;
+    uint32_t head;
+    uint32_t count;
+    uint32_t overwritten;
+    uint32_t first_seq;       // sequence number of entries[head]
+    BacklogEntry entries[READING_BACKLOG_CAPACITY];
+} backlog_store_t;
+
+// RTC_NOINIT: not zeroed by a watchdog/panic reset (RTC_DATA_ATTR would be), garbage
+// after power-on — hence the magic and bounds check before first use.
+static RTC_NOINIT_ATTR backlog_store_t store;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void validate(void) {
+    if (store.magic != BACKLOG_MAGIC || store.head >= READING_BACKLOG_CAPACITY ||
+        store.count > READING_BACKLOG_CAPACITY) {
+        memset(&store, 0, sizeof(store));
+        store.magic = BACKLOG_MAGIC;
+    }
+}
+
+void backlog_push(const PackedReading *reading, uint32_t taken_at) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    if (store.count == READING_BACKLOG_CAPACITY) {
+        store.head = (store.head + 1) % READING_BACKLOG_CAPACITY;
+        store.count--;
+        store.overwritten++;
+        store.first_seq++;
+    }
+    BacklogEntry *e = &store.entries[(store.head + store.count) % READING_BACKLOG_CAPACITY];
+    e->reading = *reading;
+    e->taken_at = taken_at;
+    store.count++;
+    taskEXIT_CRITICAL(&lock);
+}
+
+size_t backlog_count(void) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    size_t n = store.count;
+    taskEXIT_CRITICAL(&lock);
+    return n;
+}
+
+bool backlog_peek(BacklogEntry *out) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    bool any = store.count > 0;
+    if (any) {
+        *out = store.entries[store.head];
+    }
+    taskEXIT_CRITICAL(&lock);
+    return any;
+}
+
+size_t backlog_peek_many(BacklogEntry *out, size_t max) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    size_t n = store.count < max ? store.count : max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = store.entries[(store.head + i) % READING_BACKLOG_CAPACITY];
+    }
+    taskEXIT_CRITICAL(&lock);
+    return n;
+}
+
+static void drop_locked(void) {
+    if (store.count > 0) {
+        store.head = (store.head + 1) % READING_BACKLOG_CAPACITY;
+        store.count--;
+        store.first_seq++;
+    }
+}
+
+void backlog_drop(void) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    drop_locked();
+    taskEXIT_CRITICAL(&lock);
+}
+
+uint32_t backlog_overwritten(void) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    uint32_t n = store.overwritten;
+    taskEXIT_CRITICAL(&lock);
+    return n;
+}
+
+uint32_t backlog_first_seq(void) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    uint32_t seq = store.first_seq;
+    taskEXIT_CRITICAL(&lock);
+    return seq;
+}
+
+size_t backlog_peek_seq(uint32_t seq, BacklogEntry *out, size_t max) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    size_t n = 0;
+    if (seq >= store.first_seq && seq - store.first_seq < store.count) {
+        size_t skip = seq - store.first_seq;
+        n = store.count - skip < max ? store.count - skip : max;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = store.entries[(store.head + skip + i) % READING_BACKLOG_CAPACITY];
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+    return n;
+}
+
+void backlog_drop_before(uint32_t seq) {
+    taskENTER_CRITICAL(&lock);
+    validate();
+    while (store.count > 0 && store.first_seq < seq) {
+        drop_locked();
+    }
+    taskEXIT_CRITICAL(&lock);
+}
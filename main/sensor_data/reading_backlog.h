@@ -0,0 +1,33 @@
+#ifndef READING_BACKLOG_H
+#define READING_BACKLOG_H
+
+// Readings that were taken but not delivered (upload failed, or the wake governor cut
+// the wake short). Kept in RTC_NOINIT memory so they survive deep sleep AND a watchdog
+// reset; only a power cycle loses them. Oldest entries are overwritten when full.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "data.h"
+
+#define READING_BACKLOG_CAPACITY 32
+
+typedef struct {
+    PackedReading reading;
+    uint32_t taken_at;        // unix seconds, 0 if the clock wasn't set yet
+} BacklogEntry;
+
+void   backlog_push(const PackedReading *reading, uint32_t taken_at);
+size_t backlog_count(void);
+bool   backlog_peek(BacklogEntry *out);   // oldest entry, false if empty
+size_t backlog_peek_many(BacklogEntry *out, size_t max);   // oldest first, returns count copied
+void   backlog_drop(void);                // remove the oldest entry
+uint32_t backlog_overwritten(void);       // entries lost to overflow since power-on
+
+// Every entry gets the next sequence number when pushed, and keeps it while older ones
+// are dropped or overwritten, so a number names one reading (BLE bulk transfer resume).
+uint32_t backlog_first_seq(void);         // seq of the oldest entry; the next one if empty
+size_t   backlog_peek_seq(uint32_t seq, BacklogEntry *out, size_t max);  // from seq on, 0 if gone
+void     backlog_drop_before(uint32_t seq);
+
+#endif // READING_BACKLOG_H
@@ -0,0 +1,92 @@
+#include <math.h>
+#include "body_writer.h"
+#include "reading_logic.h"
+
+int map(int x, int in_min, int in_max, int out_min, int out_max) {
+    if (in_min == in_max) return out_min; // Avoid division by zero
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+int moisture_percent(int adc_raw) {
+    return map(adc_raw, MOISTURE_ADC_DRY, MOISTURE_ADC_WET, 0, 100);
+}
+
+float max17048_vcell_volts(uint16_t raw) {
+    return (raw >> 4) * 1.25f / 1000;   // 1.25 mV per 16 LSBs
+}
+
+float max17048_soc_percent(uint16_t raw) {
+    return raw / 256.0f;
+}
+
+// CRATE is SIGNED two's-complement: positive = charging, negative = discharging.
+// (Reading it as unsigned/256 made discharge show as garbage like "13620 %/hr".)
+float max17048_crate_percent(uint16_t raw) {
+    return (int16_t)raw * 0.208f;
+}
+
+// charge_status keys off the charger STAT line (reliable), with charge rate as the
+// discharge/idle tiebreaker. power_source is inferred (no solar-sense line on V5).
+const char *charge_status_name(const SensorReading *reading) {
+    return reading->charging               ? "charging"
+         : (reading->battery.crate < -0.5f) ? "discharging"
+         : "idle";
+}
+
+const char *power_source_name(const SensorReading *reading) {
+    return reading->usb_present ? "USB" : (reading->charging ? "Solar" : "Battery");
+}
+
+void pack_reading(const SensorReading *r, PackedReading *p) {
+    int moisture = r->moisture;
+    if (moisture < 0)   moisture = 0;
+    if (moisture > 100) moisture = 100;
+    p->moisture = (uint8_t)moisture;
+
+    // Back to register units: exact for SOC (read as raw/256), within one LSB for CRATE.
+    // (Clamp after rounding: the old "soc >= 255.99" test also caught 0xFFFE.)
+    float soc = r->battery.soc < 0 ? 0 : r->battery.soc;
+    long soc_raw = lroundf(soc * 256.0f);
+    p->soc_raw = soc_raw > 0xFFFF ? 0xFFFF : (uint16_t)soc_raw;
+    p->crate_raw = (int16_t)lroundf(r->battery.crate / 0.208f);
+
+    p->power = (r->usb_present    ? READING_PWR_USB         : 0) |
+               (r->charging       ? READING_PWR_CHARGING    : 0) |
+               (r->battery.status ? READING_PWR_BATT_STATUS : 0);
+}
+
+void unpack_reading(const PackedReading *p, SensorReading *r) {
+    r->moisture = p->moisture;
+    r->battery.soc = p->soc_raw / 256.0f;
+    r->battery.crate = p->crate_raw * 0.208f;
+    r->battery.status = (p->power & READING_PWR_BATT_STATUS) != 0;
+    r->usb_present = (p->power & READING_PWR_USB) != 0;
+    r->charging = (p->power & READING_PWR_CHARGING) != 0;
+}
+
+void write_reading_form(body_writer_t *w, const SensorReading *reading,
+                        const char *hostname, const char *sensorName,
+                        const char *sensorLocation, const char *apiToken)
+{
+    // Clamp the moisture and battery value to the range [0, 100]
+    int moisture = reading->moisture > 100 ? 100 : reading->moisture;
+    float battery = reading->battery.soc > 100 ? 100 : reading->battery.soc;
+
+    // Name, location and token are user text: bw_form() escapes them, so "Basil & Mint"
+    // arrives as one field instead of splitting the body. CoAP over DTLS passes NULL
+    // token and hostname: the PSK identity already says who is sending.
+    if (apiToken) {
+        bw_form(w, "api_token", apiToken);
+    }
+    if (hostname) {
+        bw_form(w, "hostname", hostname);
+    }
+    bw_form(w, "sensor", sensorName);
+    bw_form(w, "location", sensorLocation);
+    bw_form_fmt(w, "moisture", "%d", moisture);
+    bw_form_fmt(w, "batt", "%.2f", battery);
+    bw_form_fmt(w, "battery_status", "%d", reading->battery.status);
+    bw_form(w, "charge_status", charge_status_name(reading));
+    bw_form(w, "power_source", power_source_name(reading));
+}
+
@@ -0,0 +1,29 @@
+#ifndef READING_LOGIC_H
+#define READING_LOGIC_H
+
+// The arithmetic and text between the sensor registers and the upload body: probe
+// calibration, MAX17048 register scaling, the charge/power labels the backend shows,
+// and the form fields themselves. No driver calls, so tools/data_bench builds this file
+// natively (with body_writer.c and a stubbed esp_http_client) to check and time it.
+// pack_reading(), unpack_reading() and write_reading_form() are declared in data.h.
+
+#include <stdint.h>
+#include "data.h"
+
+// Capacitive probe calibration: raw ADC in air (dry) and in water (wet).
+#define MOISTURE_ADC_DRY  3600
+#define MOISTURE_ADC_WET  2130
+
+// Arduino-style linear map, integer arithmetic (truncates toward zero).
+int map(int x, int in_min, int in_max, int out_min, int out_max);
+
+int   moisture_percent(int adc_raw);          // not clamped; the form clamps to 0-100
+float max17048_vcell_volts(uint16_t raw);     // 78.125 uV per LSB
+float max17048_soc_percent(uint16_t raw);     // 1/256 % per LSB
+float max17048_crate_percent(uint16_t raw);   // signed, 0.208 %/hr per LSB
+
+// "charging" / "discharging" / "idle", and "USB" / "Solar" / "Battery".
+const char *charge_status_name(const SensorReading *reading);
+const char *power_source_name(const SensorReading *reading);
+
+#endif // READING_LOGIC_H
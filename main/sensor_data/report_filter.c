@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "main.h"
+#include "nvs_drv.h"
+#include "body_writer.h"
+#include "fuel_gauge.h"
+#include "reading_backlog.h"
+#include "report_filter.h"
+
+static const char *TAG = "REPORT";
+
+// RTC_DATA_ATTR: survives deep sleep, cleared on power-on and on a software restart
+// (OTA, re-provisioning). Either way the next reading simply goes out.
+typedef struct {
+    bool valid;
+    PackedReading last;       // as uploaded, in register units
+    uint32_t skipped;         // readings not sent since then
+} report_rtc_t;
+
+static RTC_DATA_ATTR report_rtc_t rtc;
+
+static bool transport_filtered(void) {
+    // MQTT's reading payload has a fixed field list (mqtt_msg.h) with no room for the
+    // skipped count, and the beacon/ESP-NOW paths never run the wake cycle.
+    return main_struct.transport == TRANSPORT_HTTPS || main_struct.transport == TRANSPORT_COAP;
+}
+
+bool report_filter_skip(const SensorReading *reading) {
+    report_config_t cfg;
+    nvs_get_report_config(&cfg);
+    if (cfg.heartbeat == 0 || !rtc.valid || !transport_filtered() ||
+        esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER ||
+        !main_struct.password[0] || reading->usb_present || backlog_count() > 0 ||
+        fuel_gauge_alert_pending()) {
+        return false;
+    }
+    if (rtc.skipped >= cfg.heartbeat) {
+        ESP_LOGI(TAG, "Heartbeat upload after %lu skipped wakes", (unsigned long)rtc.skipped);
+        return false;
+    }
+
+    PackedReading now;
+    pack_reading(reading, &now);
+    int d_moisture = abs((int)now.moisture - (int)rtc.last.moisture);
+    int d_soc = abs((int)now.soc_raw - (int)rtc.last.soc_raw);   // 1/256 %
+    if (d_moisture > cfg.moisture_pct || d_soc > cfg.soc_pct * 256 || now.power != rtc.last.power) {
+        ESP_LOGI(TAG, "Changed: moisture %+d %%, SoC %+.1f %%, power 0x%02x -> 0x%02x",
+                 (int)now.moisture - (int)rtc.last.moisture,
+                 ((int)now.soc_raw - (int)rtc.last.soc_raw) / 256.0f, rtc.last.power, now.power);
+        return false;
+    }
+    rtc.skipped++;
+    ESP_LOGI(TAG, "Within deadbands (%u %%, %u %%); upload skipped (%lu of %u)",
+             cfg.moisture_pct, cfg.soc_pct, (unsigned long)rtc.skipped, cfg.heartbeat);
+    return true;
+}
+
+void report_filter_write(body_writer_t *w) {
+    if (rtc.skipped > 0) {
+        bw_form_fmt(w, "skipped", "%lu", (unsigned long)rtc.skipped);
+    }
+}
+
+void report_filter_uploaded(const SensorReading *reading) {
+    pack_reading(reading, &rtc.last);
+    rtc.valid = true;
+    rtc.skipped = 0;
+}
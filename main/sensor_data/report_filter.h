@@ -0,0 +1,30 @@
+#ifndef REPORT_FILTER_H
+#define REPORT_FILTER_H
+
+// Report-by-exception for the form-body transports (HTTPS, CoAP). The last uploaded
+// moisture, SoC and power flags are kept in RTC memory. A timer wake whose reading is
+// within the deadbands of those values (nvs_get_report_config()) goes from SENSE
+// straight back to sleep, without starting Wi-Fi. After `heartbeat` such wakes in a row
+// the next one uploads whatever it reads, so the backend's last-seen check still sees
+// the device at least every (heartbeat + 1) * sleep_seconds.
+//
+// Server side: an upload that follows skipped wakes carries "skipped=<n>", the number of
+// readings taken since the previous upload and not sent because they were within the
+// deadbands of it. A gap of n sleep intervals before such a reading is therefore "value
+// unchanged", not "device offline"; plot it flat at the previous value. The
+// moist_agg/soc_agg aggregates (sampler.h) cover the whole gap. No field means
+// nothing was skipped, so an older backend sees the same body as before.
+
+#include <stdbool.h>
+#include "data.h"
+
+// The wake cycle's SENSE state. True if this reading needn't be sent; it is then
+// counted and the caller sleeps. False on anything that should go out or can't be
+// judged: first reading since power-on, backlog to drain, USB power, a non-timer wake,
+// a battery alert (fuel_gauge.h).
+bool report_filter_skip(const SensorReading *reading);
+
+void report_filter_write(struct body_writer *w);           // skipped=<n>, nothing if 0
+void report_filter_uploaded(const SensorReading *reading); // new reference, count reset
+
+#endif // REPORT_FILTER_H
@@ -0,0 +1,146 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "main.h"
+#include "nvs_drv.h"
+#include "body_writer.h"
+#include "fuel_gauge.h"
+#include "sampler.h"
+
+static const char *TAG = "SAMPLER";
+
+// Welford mean/variance plus least-squares sums for the slope. Time is hours since the
+// window opened; the sums stay small enough for doubles over any realistic window.
+typedef struct {
+    uint16_t n;
+    float min, max;
+    double mean, m2;
+    double st, stt, sy, sty;
+} stat_acc_t;
+
+// RTC_DATA_ATTR: survives deep sleep, cleared on power-on. A reset in between only loses
+// the current window.
+typedef struct {
+    uint32_t samples_left;    // micro-wakes still to run before the next full cycle
+    uint32_t sample_secs;     // interval the current plan was made with
+    uint32_t tail_secs;       // upload interval % sample_secs, added to the last slice
+    uint64_t clock_ms;        // window time at the start of this wake
+    stat_acc_t moisture;
+    stat_acc_t soc;
+} sampler_rtc_t;
+
+static RTC_DATA_ATTR sampler_rtc_t rtc;
+
+// Deep sleep stops esp_timer, so window time is kept by adding each wake's awake time
+// and the sleep it scheduled. A button press cuts a sleep short and skews this by at
+// most one interval; the slope is a trend, not a timestamp, so that's tolerated.
+static double window_hours(void) {
+    return (rtc.clock_ms + esp_timer_get_time() / 1000) / 3600000.0;
+}
+
+static void advance_clock(uint32_t sleep_seconds) {
+    rtc.clock_ms += esp_timer_get_time() / 1000 + (uint64_t)sleep_seconds * 1000;
+}
+
+static void acc_add(stat_acc_t *a, float y, double t) {
+    if (a->n == 0 || y < a->min) a->min = y;
+    if (a->n == 0 || y > a->max) a->max = y;
+    a->n++;
+    double delta = y - a->mean;
+    a->mean += delta / a->n;
+    a->m2 += delta * (y - a->mean);
+    a->st += t;
+    a->stt += t * t;
+    a->sy += y;
+    a->sty += t * y;
+}
+
+static double acc_slope(const stat_acc_t *a) {
+    double den = a->n * a->stt - a->st * a->st;
+    return den > 1e-9 ? (a->n * a->sty - a->st * a->sy) / den : 0.0;   // units per hour
+}
+
+static void acc_write(body_writer_t *w, const char *key, const stat_acc_t *a) {
+    bw_form_fmt(w, key, "%u,%.1f,%.1f,%.2f,%.2f,%.3f", a->n, a->min, a->max,
+                a->mean, sqrt(a->m2 / (a->n - 1)), acc_slope(a));
+}
+
+static bool enabled(uint32_t upload_seconds, uint32_t *sample_seconds) {
+    // The form-body transports: both emit the aggregates with the reading.
+    if (main_struct.transport != TRANSPORT_HTTPS && main_struct.transport != TRANSPORT_COAP) {
+        return false;
+    }
+    uint32_t s = nvs_get_sample_seconds();
+    if (s < SAMPLER_MIN_SECONDS || s >= upload_seconds) {
+        return false;
+    }
+    *sample_seconds = s;
+    return true;
+}
+
+void sampler_add(const SensorReading *reading) {
+    double t = window_hours();
+    acc_add(&rtc.moisture, (float)reading->moisture, t);
+    acc_add(&rtc.soc, reading->battery.soc, t);
+}
+
+bool sampler_micro_wake(void) {
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER || rtc.samples_left == 0) {
+        return false;   // power-on, button, or the upload is due
+    }
+    rtc.samples_left--;
+
+    SensorReading reading;
+    take_reading(&reading);
+    sampler_add(&reading);
+    if (fuel_gauge_alert_pending()) {
+        // The gauge latched an alert since the last wake: report it now, not at the end
+        // of the window. The full cycle takes its own reading.
+        ESP_LOGW(TAG, "micro-wake: battery alert, running the full cycle");
+        return false;
+    }
+    ESP_LOGI(TAG, "micro-wake: moisture %d%%, %u samples, %lu to go",
+             reading.moisture, rtc.moisture.n, (unsigned long)rtc.samples_left);
+
+    uint32_t secs = rtc.sample_secs + (rtc.samples_left == 0 ? rtc.tail_secs : 0);
+    advance_clock(secs);
+    enter_micro_sleep(secs);
+    return true;   // not reached
+}
+
+uint32_t sampler_plan_sleep(uint32_t upload_seconds) {
+    uint32_t sample_seconds;
+    if (!enabled(upload_seconds, &sample_seconds)) {
+        rtc.samples_left = 0;
+        return upload_seconds;
+    }
+    // The full cycle comes back on the last slice, which also carries what doesn't divide
+    // evenly, so the slices add up to the upload interval exactly.
+    rtc.samples_left = upload_seconds / sample_seconds - 1;
+    rtc.sample_secs = sample_seconds;
+    rtc.tail_secs = upload_seconds % sample_seconds;
+    uint32_t first = sample_seconds + (rtc.samples_left == 0 ? rtc.tail_secs : 0);
+    advance_clock(first);
+    ESP_LOGI(TAG, "%lu micro-wakes every %lu s (+%lu s on the last) before the next upload",
+             (unsigned long)rtc.samples_left, (unsigned long)sample_seconds,
+             (unsigned long)rtc.tail_secs);
+    return first;
+}
+
+void sampler_write(body_writer_t *w) {
+    if (rtc.moisture.n < 2) {
+        return;
+    }
+    acc_write(w, "moist_agg", &rtc.moisture);
+    acc_write(w, "soc_agg", &rtc.soc);
+}
+
+void sampler_reset(void) {
+    memset(&rtc.moisture, 0, sizeof(rtc.moisture));
+    memset(&rtc.soc, 0, sizeof(rtc.soc));
+    rtc.clock_ms = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+// Radio-free micro-wakes between uploads. With a sample interval set (NVS "sample_secs",
+// optional "sample_seconds" provisioning key), the sleep before each upload is split
+// into sample-interval slices. Each slice ends in a micro-wake that reads probe and fuel
+// gauge, folds the values into running statistics in RTC memory and sleeps again
+// without ever starting Wi-Fi. The full cycle still runs once per sleep_seconds and
+// sends the window's min/max/mean/stddev/slope alongside its own reading.
+//
+// HTTPS and CoAP transports only (the form bodies); beacon and ESP-NOW frames have no
+// room for the aggregates, and the MQTT payload does not carry them.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "data.h"
+
+#define SAMPLER_MIN_SECONDS 60u
+
+// app_main, before any radio is touched: if this timer wake is a micro-wake, sample and
+// sleep (does not return). Returns false when the full cycle is due.
+bool sampler_micro_wake(void);
+
+// enter_deep_sleep(): turns "sleep until the next upload" into the first sample slice.
+// Returns the number of seconds to actually sleep.
+uint32_t sampler_plan_sleep(uint32_t upload_seconds);
+
+void sampler_add(const SensorReading *reading);   // the full cycle's own reading
+void sampler_write(struct body_writer *w);        // moist_agg=...&soc_agg=..., nothing if < 2 samples
+void sampler_reset(void);                         // aggregates delivered: start a new window
+
+#endif // SAMPLER_H
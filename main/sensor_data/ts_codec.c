@@ -0,0 +1,270 @@
+#include <stdbool.h>
+#include "ts_codec.h"
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t bit;
+    bool overflow;
+} bit_writer_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t bit;
+    bool underflow;
+} bit_reader_t;
+
+static void put_bits(bit_writer_t *w, uint32_t v, int nbits) {
+    for (int i = nbits - 1; i >= 0; i--) {
+        size_t byte = w->bit >> 3;
+        if (byte >= w->cap) {
+            w->overflow = true;
+            return;
+        }
+        uint8_t mask = (uint8_t)(0x80 >> (w->bit & 7));
+        if ((v >> i) & 1) {
+            w->buf[byte] |= mask;
+        } else {
+            w->buf[byte] &= (uint8_t)~mask;
+        }
+        w->bit++;
+    }
+}
+
+static uint32_t get_bits(bit_reader_t *r, int nbits) {
+    uint32_t v = 0;
+    for (int i = 0; i < nbits; i++) {
+        size_t byte = r->bit >> 3;
+        if (byte >= r->len) {
+            r->underflow = true;
+            return 0;
+        }
+        v = (v << 1) | ((r->buf[byte] >> (7 - (r->bit & 7))) & 1);
+        r->bit++;
+    }
+    return v;
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static void put_nibble_varint(bit_writer_t *w, uint32_t v) {
+    do {
+        uint32_t group = v & 7;
+        v >>= 3;
+        put_bits(w, v ? 1 : 0, 1);
+        put_bits(w, group, 3);
+    } while (v);
+}
+
+static uint32_t get_nibble_varint(bit_reader_t *r) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 33; shift += 3) {
+        uint32_t more = get_bits(r, 1);
+        v |= get_bits(r, 3) << shift;
+        if (!more || r->underflow) {
+            return v;
+        }
+    }
+    r->underflow = true;   // longer than any 32-bit value
+    return 0;
+}
+
+// ---- Columns ------------------------------------------------------------------------
+
+static void put_dod(bit_writer_t *w, uint32_t zz) {
+    if (zz == 0) {
+        put_bits(w, 0, 1);
+    } else if (zz < (1u << 7)) {
+        put_bits(w, 0x2, 2);
+        put_bits(w, zz, 7);
+    } else if (zz < (1u << 9)) {
+        put_bits(w, 0x6, 3);
+        put_bits(w, zz, 9);
+    } else if (zz < (1u << 12)) {
+        put_bits(w, 0xE, 4);
+        put_bits(w, zz, 12);
+    } else {
+        put_bits(w, 0xF, 4);
+        put_bits(w, zz, 32);
+    }
+}
+
+static uint32_t get_dod(bit_reader_t *r) {
+    if (!get_bits(r, 1)) return 0;
+    if (!get_bits(r, 1)) return get_bits(r, 7);
+    if (!get_bits(r, 1)) return get_bits(r, 9);
+    if (!get_bits(r, 1)) return get_bits(r, 12);
+    return get_bits(r, 32);
+}
+
+static int leading_zeros16(uint16_t v) {
+    int n = 0;
+    for (uint16_t m = 0x8000; m && !(v & m); m >>= 1) n++;
+    return n;
+}
+
+static int trailing_zeros16(uint16_t v) {
+    int n = 0;
+    for (uint16_t m = 1; m && !(v & m); m <<= 1) n++;
+    return n;
+}
+
+// Gorilla's XOR scheme on 16-bit words. lead/trail carry the previous window.
+static void put_xor16(bit_writer_t *w, uint16_t x, int *lead, int *trail) {
+    if (x == 0) {
+        put_bits(w, 0, 1);
+        return;
+    }
+    int l = leading_zeros16(x), t = trailing_zeros16(x);
+    if (*lead >= 0 && l >= *lead && t >= *trail) {
+        put_bits(w, 0x2, 2);
+        put_bits(w, (uint32_t)x >> *trail, 16 - *lead - *trail);
+        return;
+    }
+    put_bits(w, 0x3, 2);
+    put_bits(w, (uint32_t)l, 4);
+    put_bits(w, (uint32_t)(16 - l - t - 1), 4);
+    put_bits(w, (uint32_t)x >> t, 16 - l - t);
+    *lead = l;
+    *trail = t;
+}
+
+static uint16_t get_xor16(bit_reader_t *r, int *lead, int *trail) {
+    if (!get_bits(r, 1)) {
+        return 0;
+    }
+    if (get_bits(r, 1)) {
+        *lead = (int)get_bits(r, 4);
+        int len = (int)get_bits(r, 4) + 1;
+        *trail = 16 - *lead - len;
+        if (*trail < 0) {
+            r->underflow = true;   // not something the encoder writes
+            return 0;
+        }
+    } else if (*lead < 0) {
+        r->underflow = true;       // window reuse before any window was set
+        return 0;
+    }
+    return (uint16_t)(get_bits(r, 16 - *lead - *trail) << *trail);
+}
+
+// ---- Public -------------------------------------------------------------------------
+
+int ts_encode(const ts_sample_t *s, size_t n, uint8_t *out, size_t cap) {
+    if (cap < 1) {
+        return -1;
+    }
+    out[0] = TS_CODEC_VERSION;
+    size_t pos = 1;
+    size_t count = n;
+    do {
+        if (pos >= cap) {
+            return -1;
+        }
+        out[pos++] = (uint8_t)((count & 0x7F) | (count > 0x7F ? 0x80 : 0));
+        count >>= 7;
+    } while (count);
+
+    bit_writer_t w = { .buf = out + pos, .cap = cap - pos };
+    if (n > 0) {
+        put_bits(&w, s[0].taken_at, 32);
+        uint32_t prev_delta = 0;
+        for (size_t i = 1; i < n; i++) {
+            uint32_t delta = s[i].taken_at - s[i - 1].taken_at;
+            put_dod(&w, zigzag((int32_t)(delta - prev_delta)));
+            prev_delta = delta;
+        }
+
+        put_bits(&w, s[0].moisture, 8);
+        for (size_t i = 1; i < n; i++) {
+            put_nibble_varint(&w, zigzag((int8_t)(uint8_t)(s[i].moisture - s[i - 1].moisture)));
+        }
+
+        put_bits(&w, s[0].power, 8);
+        for (size_t i = 1; i < n; i++) {
+            uint8_t x = s[i].power ^ s[i - 1].power;
+            put_bits(&w, x ? 1 : 0, 1);
+            if (x) {
+                put_bits(&w, x, 8);
+            }
+        }
+
+        put_bits(&w, s[0].soc_raw, 16);
+        for (size_t i = 1; i < n; i++) {
+            put_nibble_varint(&w, zigzag((int16_t)(uint16_t)(s[i].soc_raw - s[i - 1].soc_raw)));
+        }
+
+        put_bits(&w, (uint16_t)s[0].crate_raw, 16);
+        int lead = -1, trail = 0;
+        for (size_t i = 1; i < n; i++) {
+            put_xor16(&w, (uint16_t)(s[i].crate_raw ^ s[i - 1].crate_raw), &lead, &trail);
+        }
+    }
+    if (w.overflow) {
+        return -1;
+    }
+    return (int)(pos + (w.bit + 7) / 8);
+}
+
+int ts_decode(const uint8_t *in, size_t len, ts_sample_t *out, size_t max) {
+    if (len < 2 || in[0] != TS_CODEC_VERSION) {
+        return -1;
+    }
+    size_t pos = 1, n = 0;
+    for (int shift = 0;; shift += 7) {
+        if (pos >= len || shift > 28) {
+            return -1;
+        }
+        uint8_t b = in[pos++];
+        n |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+    if (n > max) {
+        return -1;
+    }
+
+    bit_reader_t r = { .buf = in + pos, .len = len - pos };
+    if (n > 0) {
+        out[0].taken_at = get_bits(&r, 32);
+        uint32_t prev_delta = 0;
+        for (size_t i = 1; i < n; i++) {
+            uint32_t delta = prev_delta + (uint32_t)unzigzag(get_dod(&r));
+            out[i].taken_at = out[i - 1].taken_at + delta;
+            prev_delta = delta;
+        }
+
+        out[0].moisture = (uint8_t)get_bits(&r, 8);
+        for (size_t i = 1; i < n; i++) {
+            out[i].moisture = (uint8_t)(out[i - 1].moisture + unzigzag(get_nibble_varint(&r)));
+        }
+
+        out[0].power = (uint8_t)get_bits(&r, 8);
+        for (size_t i = 1; i < n; i++) {
+            out[i].power = out[i - 1].power;
+            if (get_bits(&r, 1)) {
+                out[i].power ^= (uint8_t)get_bits(&r, 8);
+            }
+        }
+
+        out[0].soc_raw = (uint16_t)get_bits(&r, 16);
+        for (size_t i = 1; i < n; i++) {
+            out[i].soc_raw = (uint16_t)(out[i - 1].soc_raw + unzigzag(get_nibble_varint(&r)));
+        }
+
+        out[0].crate_raw = (int16_t)get_bits(&r, 16);
+        int lead = -1, trail = 0;
+        for (size_t i = 1; i < n; i++) {
+            out[i].crate_raw = (int16_t)((uint16_t)out[i - 1].crate_raw ^ get_xor16(&r, &lead, &trail));
+        }
+    }
+    return r.underflow ? -1 : (int)n;
+}
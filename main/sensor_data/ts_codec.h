@@ -0,0 +1,50 @@
+#ifndef TS_CODEC_H
+#define TS_CODEC_H
+
+// Columnar bit-packed encoding of a run of readings for multi-reading uploads, in the
+// style of Gorilla (Pelkonen et al., VLDB 2015).
+//
+// Pure C, no ESP-IDF headers: the firmware encodes with it and tools/ts_codec decodes,
+// round-trips and benchmarks with the very same file.
+//
+// Layout: version byte, sample count as a LEB128 varint, then one bit stream (MSB
+// first, zero-padded to a byte) holding each column in turn:
+//
+//   taken_at   32-bit first value, then delta-of-delta (mod 2^32), zig-zag, bucketed:
+//              '0' = 0 | '10'+7 bits | '110'+9 | '1110'+12 | '1111'+32
+//   moisture   8-bit first value, then zig-zag 8-bit delta as a nibble varint
+//   power      8-bit first value, then '0' = unchanged | '1'+8-bit XOR
+//   soc_raw    16-bit first value, then zig-zag 16-bit delta as a nibble varint
+//   crate_raw  16-bit first value, then XOR with the previous value:
+//              '0' = same | '10' + bits inside the previous window |
+//              '11' + 4-bit leading zeros + 4-bit (length-1) + meaningful bits
+//
+// A nibble varint is groups of 3 payload bits (low first), each preceded by a
+// continuation bit, so the common small delta costs 4 bits.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TS_CODEC_VERSION 1
+
+// Worst case per sample: 36 + 12 + 9 + 24 + 26 bits; plus version and count.
+#define TS_CODEC_MAX_BYTES(n) ((((size_t)(n)) * 107 + 7) / 8 + 6)
+
+// Field-for-field the same as a BacklogEntry (taken_at + PackedReading).
+typedef struct {
+    uint32_t taken_at;       // unix seconds, 0 if the clock wasn't set
+    uint8_t  moisture;
+    uint8_t  power;
+    uint16_t soc_raw;
+    int16_t  crate_raw;
+} ts_sample_t;
+
+// Encodes n samples into out (cap bytes). Returns the encoded length, or -1 if it
+// doesn't fit (cap >= TS_CODEC_MAX_BYTES(n) always does). No heap, O(1) stack.
+int ts_encode(const ts_sample_t *samples, size_t n, uint8_t *out, size_t cap);
+
+// Decodes into out (room for max samples). Returns the sample count, or -1 on a bad
+// version, truncated input, or more than max samples.
+int ts_decode(const uint8_t *in, size_t len, ts_sample_t *out, size_t max);
+
+#endif // TS_CODEC_H
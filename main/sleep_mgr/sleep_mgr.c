@@ -0,0 +1,144 @@
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_private/esp_clk.h"   // esp_clk_rtc_time()
+#include "driver/rtc_io.h"
+#include "main.h"
+#include "data.h"
+#include "body_writer.h"
+#include "fuel_gauge.h"
+#include "wake_stub.h"
+#include "sleep_mgr.h"
+
+static const char *TAG = "SLEEP_MGR";
+
+#define SLEEP_RECORD_MAGIC 0x534C5031u   // "SLP1"
+
+// RTC_NOINIT like the governor's record: a software reset mid-wake must not lose the
+// totals not yet uploaded. Validated by the magic on every boot.
+typedef struct {
+    uint32_t magic;
+    uint64_t sleep_us;                      // RTC time when the last sleep began; 0 = none
+    uint8_t  head;                          // log[head] is the current wake
+    uint8_t  count;
+    sleep_cycle_t log[SLEEP_LOG_DEPTH];
+    sleep_totals_t totals;                  // since the last upload that carried them
+} sleep_rtc_t;
+
+static RTC_NOINIT_ATTR sleep_rtc_t rec;
+
+static const char *const wake_names[SLEEP_WAKE_COUNT] = {
+    "reset", "timer", "button", "alert", "usb", "other",
+};
+
+const char *sleep_wake_name(sleep_wake_t cause) {
+    return cause < SLEEP_WAKE_COUNT ? wake_names[cause] : "?";
+}
+
+static sleep_wake_t wake_cause(void) {
+    switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_UNDEFINED: return SLEEP_WAKE_RESET;
+    case ESP_SLEEP_WAKEUP_TIMER:     return wake_stub_usb_boot() ? SLEEP_WAKE_USB : SLEEP_WAKE_TIMER;
+    case ESP_SLEEP_WAKEUP_EXT0:      return SLEEP_WAKE_BUTTON;
+    case ESP_SLEEP_WAKEUP_EXT1:      return SLEEP_WAKE_ALERT;   // only ALRT is on ext1
+    default:                         return SLEEP_WAKE_OTHER;
+    }
+}
+
+void sleep_mgr_boot(void) {
+    // The button is read while awake; its hold only matters during sleep. The soil gate
+    // keeps its hold (OFF) until readMoisture() next drives it.
+    rtc_gpio_hold_dis(BUTTON_GPIO);
+
+    if (rec.magic != SLEEP_RECORD_MAGIC || rec.head >= SLEEP_LOG_DEPTH ||
+        rec.count > SLEEP_LOG_DEPTH) {
+        memset(&rec, 0, sizeof(rec));   // power-on: RTC_NOINIT holds garbage
+        rec.magic = SLEEP_RECORD_MAGIC;
+    }
+
+    sleep_wake_t cause = wake_cause();
+    uint32_t slept_s = 0;
+    if (cause != SLEEP_WAKE_RESET && rec.sleep_us != 0) {
+        // The RTC timer runs through deep sleep and the stub's slices alike.
+        uint64_t now = esp_clk_rtc_time();
+        if (now > rec.sleep_us) {
+            slept_s = (uint32_t)((now - rec.sleep_us) / 1000000);
+        }
+    }
+    rec.sleep_us = 0;
+
+    rec.head = (rec.head + 1) % SLEEP_LOG_DEPTH;
+    if (rec.count < SLEEP_LOG_DEPTH) {
+        rec.count++;
+    }
+    rec.log[rec.head] = (sleep_cycle_t){ .cause = cause, .slept_s = slept_s };
+    rec.totals.wakes[cause]++;
+    rec.totals.asleep_s += slept_s;
+    ESP_LOGI(TAG, "Wake by %s after %lu s asleep", wake_names[cause], (unsigned long)slept_s);
+}
+
+void sleep_mgr_note_soc(uint16_t soc_raw) {
+    rec.log[rec.head].soc_raw = soc_raw;
+}
+
+static void hold_pins(void) {
+    // Wake on button press (SW1 on IO3, active low). IO3 has only a 100nF debounce cap
+    // and no external pull-up, so enable the RTC pull-up and hold it across deep sleep so
+    // the pin doesn't float low and wake us spuriously.
+    rtc_gpio_pullup_en(BUTTON_GPIO);
+    rtc_gpio_pulldown_dis(BUTTON_GPIO);
+    rtc_gpio_hold_en(BUTTON_GPIO);
+    esp_sleep_enable_ext0_wakeup(BUTTON_GPIO, 0);  // 0 = wake on active-low (button pressed)
+
+    // V6: the fuel gauge's ALRT line on ext1, so a failing battery gets its upload now.
+    fuel_gauge_arm_wake();
+
+    // V6: drive the probe's load-switch gate OFF and latch it, instead of leaving it to
+    // the gate pull-up against a tristated pad. No-op on V5 (no gate).
+    soil_power_hold_off();
+}
+
+static void request_domains(void) {
+    // Only ON requests: esp_sleep_pd_config() counts references, and an OFF that no ON
+    // preceded would underflow it. Everything not listed stays AUTO, i.e. OFF.
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_SLOW_MEM, ESP_PD_OPTION_ON);   // RTC_DATA/NOINIT state
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_FAST_MEM, ESP_PD_OPTION_ON);   // wake stub
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);     // ext0, RTC pull-up, RTC IO reads
+}
+
+void sleep_mgr_prepare(uint32_t seconds) {
+    hold_pins();
+    request_domains();
+
+    // Awake time counts from app start; the bootloader's share is in the slept time.
+    uint32_t awake_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    rec.log[rec.head].awake_ms = awake_ms ? awake_ms : 1;
+    rec.totals.awake_ms += awake_ms;
+    rec.sleep_us = esp_clk_rtc_time();
+    ESP_LOGI(TAG, "Sleep %lu s (%s) after %lu ms awake", (unsigned long)seconds,
+             seconds ? "timer + button" : "button only", (unsigned long)awake_ms);
+}
+
+int sleep_mgr_get_log(sleep_cycle_t *out, int max) {
+    if (rec.magic != SLEEP_RECORD_MAGIC) {
+        return 0;
+    }
+    int n = rec.count < max ? rec.count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = rec.log[(rec.head + SLEEP_LOG_DEPTH - i) % SLEEP_LOG_DEPTH];
+    }
+    return n;
+}
+
+void sleep_mgr_write(body_writer_t *w) {
+    // This wake is still running: its awake time goes out with the next upload.
+    if (rec.magic == SLEEP_RECORD_MAGIC) {
+        sleep_totals_write(w, &rec.totals);
+    }
+}
+
+void sleep_mgr_reported(void) {
+    memset(&rec.totals, 0, sizeof(rec.totals));
+}
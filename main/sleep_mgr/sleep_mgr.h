@@ -0,0 +1,78 @@
+#ifndef SLEEP_MGR_H
+#define SLEEP_MGR_H
+
+// Deep-sleep power domains, pin holds and wake-source accounting.
+//
+// sleep_now() hands every sleep to sleep_mgr_prepare() after the timer is set. It
+// arms the button (ext0) and the fuel gauge's ALRT line (ext1), and holds the
+// pins whose level matters while the chip sleeps: the button's RTC pull-up, and the
+// soil probe's load switch OFF (V6). It then requests the power domains the next wake
+// needs explicitly, rather than relying on what ESP_PD_OPTION_AUTO infers:
+//
+//   RTC slow memory   ON    backlog, sampler, governor, report filter: RTC_DATA/NOINIT
+//   RTC fast memory   ON    the wake stub's code (wake_stub.h)
+//   RTC peripherals   ON    ext0 + the button's internal pull-up, the stub's USB_DETECT read
+//   XTAL, RC_FAST,    AUTO  which is OFF in deep sleep; esp_sleep_pd_config() is
+//   VDD_SDIO (flash)        reference counted, so a forced OFF would only unbalance it
+//
+// The ULP is not used, so nothing is kept on for it. None of the memory domains can be
+// cut even on an unprovisioned, button-only sleep: the bootloader doesn't reload RTC
+// segments after a deep-sleep wake, so the stub's code and every RTC_DATA_ATTR variable
+// would come back as garbage rather than as their initial values.
+//
+// Accounting: every boot records why it woke and how long it slept (RTC timer, so the
+// stub's slices are included), and every sleep how long the wake was awake and the last
+// SoC read. RTC_NOINIT with a magic, so the record also survives software resets. The
+// last SLEEP_LOG_DEPTH cycles are listed by the console's "sleep-log" command. The
+// totals since the last upload that carried them (HTTPS or CoAP; MQTT's payload has no
+// room, so an MQTT device keeps accumulating them) go out as
+//   sleep=n:12,timer:11,button:0,alert:0,usb:1,reset:0,other:0,awake_ms:14321,asleep_s:28790
+// so the backend can set the SoC drop between two uploads against the time spent awake
+// and asleep, and against the wakes that weren't scheduled.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SLEEP_LOG_DEPTH 16
+
+typedef enum {
+    SLEEP_WAKE_RESET = 0,   // power-on, software or watchdog reset: no sleep before it
+    SLEEP_WAKE_TIMER,
+    SLEEP_WAKE_BUTTON,      // ext0
+    SLEEP_WAKE_ALERT,       // ext1, fuel-gauge ALRT
+    SLEEP_WAKE_USB,         // the wake stub cut a sliced sleep short for USB power
+    SLEEP_WAKE_OTHER,
+    SLEEP_WAKE_COUNT
+} sleep_wake_t;
+
+typedef struct {
+    uint8_t  cause;           // sleep_wake_t
+    uint16_t soc_raw;         // last SoC read this wake, 1/256 %; 0 = none read
+    uint32_t slept_s;         // the sleep before this wake (0 after a reset)
+    uint32_t awake_ms;        // boot to sleep; 0 while the wake is still running
+} sleep_cycle_t;
+
+void sleep_mgr_boot(void);                     // first thing in app_main: cause, holds off
+void sleep_mgr_prepare(uint32_t seconds);      // sleep_now(), after the timer; 0 = no timer
+void sleep_mgr_note_soc(uint16_t soc_raw);     // take_reading()
+
+const char *sleep_wake_name(sleep_wake_t cause);
+int sleep_mgr_get_log(sleep_cycle_t *out, int max);   // newest first; returns the count
+
+struct body_writer;
+void sleep_mgr_write(struct body_writer *w);   // sleep=...; nothing before the first cycle
+void sleep_mgr_reported(void);                 // an upload carrying sleep_mgr_write() went out
+
+// The sleep= value itself, in sleep_totals.c: no driver calls, so tools/data_bench
+// checks it. Writes nothing while no wake has been counted.
+typedef struct {
+    uint32_t wakes[SLEEP_WAKE_COUNT];
+    uint32_t awake_ms;
+    uint32_t asleep_s;
+} sleep_totals_t;
+
+#define SLEEP_TOTALS_MAX 160   // nine 10-digit numbers and 63 bytes of labels, + NUL
+
+void sleep_totals_write(struct body_writer *w, const sleep_totals_t *totals);
+
+#endif // SLEEP_MGR_H
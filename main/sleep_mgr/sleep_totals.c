@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include "body_writer.h"
+#include "sleep_mgr.h"
+
+void sleep_totals_write(body_writer_t *w, const sleep_totals_t *t) {
+    uint32_t n = 0;
+    for (int i = 0; i < SLEEP_WAKE_COUNT; i++) {
+        n += t->wakes[i];
+    }
+    if (n == 0) {
+        return;
+    }
+    // e.g. "n:12,timer:11,button:0,alert:0,usb:1,reset:0,other:0,awake_ms:14321,asleep_s:28790";
+    // the per-cause counts add up to n. Too long for bw_form_fmt()'s buffer even at its
+    // shortest, so it is formatted here at its worst-case length.
+    char value[SLEEP_TOTALS_MAX];
+    snprintf(value, sizeof(value),
+             "n:%lu,timer:%lu,button:%lu,alert:%lu,usb:%lu,reset:%lu,other:%lu,awake_ms:%lu,asleep_s:%lu",
+             (unsigned long)n, (unsigned long)t->wakes[SLEEP_WAKE_TIMER],
+             (unsigned long)t->wakes[SLEEP_WAKE_BUTTON], (unsigned long)t->wakes[SLEEP_WAKE_ALERT],
+             (unsigned long)t->wakes[SLEEP_WAKE_USB], (unsigned long)t->wakes[SLEEP_WAKE_RESET],
+             (unsigned long)t->wakes[SLEEP_WAKE_OTHER], (unsigned long)t->awake_ms,
+             (unsigned long)t->asleep_s);
+    bw_form(w, "sleep", value);
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_tls.h"
+#include "esp_crt_bundle.h"
+#include "mbedtls/ssl.h"
+#include "tls_profile.h"
+
+static const char *TAG = "TLS";
+
+// Embedded by main/CMakeLists.txt (EMBED_TXTFILES), NUL-terminated.
+extern const char athome_roots_pem_start[] asm("_binary_athome_roots_pem_start");
+extern const char athome_roots_pem_end[]   asm("_binary_athome_roots_pem_end");
+
+// Wakes left on the bundle after a verify failure. RTC so it spans deep sleep; a power
+// cycle retries the trimmed store straight away.
+static RTC_DATA_ATTR uint8_t fallback_wakes_left = 0;
+static bool resolved = false;
+static tls_profile_t active = TLS_PROFILE_ATHOME;
+
+tls_profile_t tls_profile_active(void) {
+    if (!resolved) {
+        resolved = true;   // decide once per wake
+        if (fallback_wakes_left > 0) {
+            fallback_wakes_left--;
+            active = TLS_PROFILE_BUNDLE;
+            ESP_LOGW(TAG, "Using CA bundle fallback (%u more wakes)", fallback_wakes_left);
+        }
+    }
+    return active;
+}
+
+void tls_profile_apply(esp_http_client_config_t *config) {
+    if (tls_profile_active() == TLS_PROFILE_ATHOME) {
+        config->cert_pem = athome_roots_pem_start;
+        config->crt_bundle_attach = NULL;
+    } else {
+        config->cert_pem = NULL;
+        config->crt_bundle_attach = esp_crt_bundle_attach;
+    }
+}
+
+const char *tls_profile_ca_pem(void) {
+    return tls_profile_active() == TLS_PROFILE_ATHOME ? athome_roots_pem_start : NULL;
+}
+
+void tls_profile_note_verify_failure(int verify_flags) {
+    if (verify_flags == 0 || tls_profile_active() != TLS_PROFILE_ATHOME) {
+        return;
+    }
+    ESP_LOGE(TAG, "Server chain not anchored in athome roots (flags 0x%x); "
+             "falling back to CA bundle for %d wakes", verify_flags, TLS_FALLBACK_WAKES);
+    fallback_wakes_left = TLS_FALLBACK_WAKES;
+    active = TLS_PROFILE_BUNDLE;   // the retry in this wake already uses the bundle
+}
+
+void tls_profile_check_result(esp_http_client_handle_t client, esp_err_t err) {
+    if (err == ESP_OK || tls_profile_active() != TLS_PROFILE_ATHOME) {
+        return;
+    }
+    int tls_code = 0, verify_flags = 0;
+    esp_http_client_get_and_clear_last_tls_error(client, &tls_code, &verify_flags);
+    tls_profile_note_verify_failure(verify_flags);
+}
+
+// ---- Benchmark ---------------------------------------------------------------------
+
+typedef struct {
+    const char *name;
+    bool bundle;
+    const int *suites;        // NULL = mbedTLS default order
+} bench_profile_t;
+
+static const int ecdsa_only_suites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    0
+};
+
+static const bench_profile_t bench_profiles[] = {
+    { "bundle",       true,  NULL },                // what every wake did before
+    { "athome",       false, NULL },                // production profile
+    { "athome_ecdsa", false, ecdsa_only_suites },   // only succeeds if the server has an ECDSA cert
+};
+
+void tls_profile_benchmark(const char *host, int rounds) {
+    for (size_t p = 0; p < sizeof(bench_profiles) / sizeof(bench_profiles[0]); p++) {
+        const bench_profile_t *bp = &bench_profiles[p];
+        esp_tls_cfg_t cfg = {
+            .timeout_ms = 10000,
+            .ciphersuites_list = bp->suites,
+        };
+        if (bp->bundle) {
+            cfg.crt_bundle_attach = esp_crt_bundle_attach;
+        } else {
+            cfg.cacert_buf = (const unsigned char *)athome_roots_pem_start;
+            cfg.cacert_bytes = athome_roots_pem_end - athome_roots_pem_start;
+        }
+
+        int ok = 0;
+        uint32_t min_ms = UINT32_MAX, max_ms = 0;
+        uint64_t sum_ms = 0;
+        uint32_t heap_held = 0;
+        const char *suite = "none";
+        for (int r = 0; r < rounds; r++) {
+            uint32_t free_before = esp_get_free_heap_size();
+            int64_t t0 = esp_timer_get_time();
+            esp_tls_t *tls = esp_tls_init();
+            if (tls == NULL) {
+                break;
+            }
+            int ret = esp_tls_conn_new_sync(host, strlen(host), 443, &cfg, tls);
+            uint32_t ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+            if (ret == 1) {
+                ok++;
+                sum_ms += ms;
+                min_ms = ms < min_ms ? ms : min_ms;
+                max_ms = ms > max_ms ? ms : max_ms;
+                uint32_t held = free_before - esp_get_free_heap_size();
+                heap_held = held > heap_held ? held : heap_held;
+                mbedtls_ssl_context *ssl = esp_tls_get_ssl_context(tls);
+                if (ssl) {
+                    suite = mbedtls_ssl_get_ciphersuite(ssl);
+                }
+            }
+            esp_tls_conn_destroy(tls);
+        }
+        // Stable key=value format so a serial log can be grepped/diffed between builds.
+        printf("TLS_BENCH profile=%s rounds=%d ok=%d mean_ms=%lu min_ms=%lu max_ms=%lu heap_held=%lu suite=%s\n",
+               bp->name, rounds, ok, ok ? (unsigned long)(sum_ms / ok) : 0UL,
+               ok ? (unsigned long)min_ms : 0UL, (unsigned long)max_ms, (unsigned long)heap_held, suite);
+    }
+}
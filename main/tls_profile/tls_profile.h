@@ -0,0 +1,51 @@
+#ifndef TLS_PROFILE_H
+#define TLS_PROFILE_H
+
+// TLS settings for the athome.rodlandfarms.com endpoints (upload, firmware.json, OTA,
+// MQTT broker).
+//
+// The "athome" profile verifies against just the two Let's Encrypt roots the server
+// chains to (athome_roots.pem) instead of the whole esp_crt_bundle: fewer certs to
+// parse and hold per handshake. Suite and curve preferences (ECDHE only, P-256 first)
+// and the TLS buffer sizes live in sdkconfig.defaults, since esp_http_client has no
+// per-connection knobs for them.
+//
+// If the server ever moves to a CA outside that list, the first verify failure flips
+// the device to the bundle for TLS_FALLBACK_WAKES wakes, so uploads and OTA keep
+// working while a firmware with updated roots ships.
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+#define TLS_ATHOME_HOST     "athome.rodlandfarms.com"
+#define TLS_FALLBACK_WAKES  24
+
+// Uncomment to run the handshake benchmark before the update check of each wake.
+//#define TLS_BENCHMARK_ROUNDS 10
+
+typedef enum {
+    TLS_PROFILE_ATHOME = 0,   // trimmed trust store (default)
+    TLS_PROFILE_BUNDLE,       // full esp_crt_bundle (fallback)
+} tls_profile_t;
+
+tls_profile_t tls_profile_active(void);
+
+// Fills cert_pem / crt_bundle_attach for the active profile.
+void tls_profile_apply(esp_http_client_config_t *config);
+
+// Call after esp_http_client_perform()/open() on a client set up by tls_profile_apply().
+// A certificate verification failure under the athome profile engages the fallback.
+void tls_profile_check_result(esp_http_client_handle_t client, esp_err_t err);
+
+// For clients that aren't esp_http_client (MQTT): the PEM to verify against, or NULL
+// when the bundle is active (attach esp_crt_bundle_attach instead). Report a failed
+// handshake's mbedTLS verify flags so the same fallback engages.
+const char *tls_profile_ca_pem(void);
+void tls_profile_note_verify_failure(int verify_flags);
+
+// Handshake-only timing of each profile against host:443, `rounds` times each. Prints
+// one "TLS_BENCH ..." key=value line per profile.
+void tls_profile_benchmark(const char *host, int rounds);
+
+#endif // TLS_PROFILE_H
@@ -0,0 +1,47 @@
+#include "reading_ring.h"
+
+_Static_assert((READING_RING_CAPACITY & (READING_RING_CAPACITY - 1)) == 0,
+               "READING_RING_CAPACITY must be a power of two");
+
+// Indices run freely and wrap at UINT_MAX; head - tail is the fill level either way.
+#define SLOT(i) ((i) & (READING_RING_CAPACITY - 1))
+
+void ring_init(reading_ring_t *ring) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+}
+
+bool ring_push(reading_ring_t *ring, const BacklogEntry *entry) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail == READING_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    ring->slots[SLOT(head)] = *entry;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool ring_peek(reading_ring_t *ring, BacklogEntry *out) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    *out = ring->slots[SLOT(tail)];
+    return true;
+}
+
+void ring_pop(reading_ring_t *ring) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (atomic_load_explicit(&ring->head, memory_order_acquire) != tail) {
+        atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    }
+}
+
+size_t ring_count(reading_ring_t *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
@@ -0,0 +1,32 @@
+#ifndef READING_RING_H
+#define READING_RING_H
+
+// Fixed-size queue of readings between exactly one producer task and one consumer task
+// (USB streaming: the sampler pushes, the uploader peeks and pops). No lock and no
+// FreeRTOS call: each side owns one index, and the release/acquire pair on it is what
+// publishes a slot. Entries are copied in and out, 12 bytes each. When full, push()
+// refuses the new reading and counts it, since only the consumer may move the tail.
+// Pure C.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "reading_backlog.h"
+
+#define READING_RING_CAPACITY 128   // power of two; ~10 min of backlog at 5 s
+
+typedef struct {
+    BacklogEntry slots[READING_RING_CAPACITY];
+    atomic_uint head;        // next slot to fill; written by the producer only
+    atomic_uint tail;        // next slot to read; written by the consumer only
+    atomic_uint dropped;     // pushes refused because the ring was full
+} reading_ring_t;
+
+void   ring_init(reading_ring_t *ring);       // neither side running
+bool   ring_push(reading_ring_t *ring, const BacklogEntry *entry);   // producer
+bool   ring_peek(reading_ring_t *ring, BacklogEntry *out);           // consumer: oldest
+void   ring_pop(reading_ring_t *ring);                               // consumer: drop oldest
+size_t ring_count(reading_ring_t *ring);
+
+#endif // READING_RING_H
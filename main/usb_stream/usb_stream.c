@@ -0,0 +1,132 @@
+#include <stdatomic.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "main.h"
+#include "data.h"
+#include "nvs_drv.h"
+#include "rest_methods.h"
+#include "reading_backlog.h"
+#include "mem_diag.h"
+#include "wake_governor.h"
+#include "reading_ring.h"
+#include "usb_stream.h"
+
+static const char *TAG = "STREAM";
+
+#define USB_POLL_MS         250     // how soon a USB unplug is noticed
+#define RETRY_MIN_MS        1000    // upload backoff after a failed request...
+#define RETRY_MAX_MS        30000   // ...doubling up to this
+#define STATS_EVERY_S       600
+
+STATIC_TASK_DEFINE(stream_sampler, 4096);
+
+static reading_ring_t ring;
+static TaskHandle_t uploader;
+static atomic_bool usb_lost;
+static atomic_bool active;
+
+bool usb_stream_active(void) {
+    return atomic_load(&active);
+}
+
+bool usb_stream_wanted(void) {
+    return nvs_get_stream_seconds() > 0 && usb_power_present();
+}
+
+// Producer. Reads USB_DETECT every USB_POLL_MS and takes a full reading every period;
+// only ring_push() and a task notification connect it to the uploader.
+static void sampler_task(void *arg) {
+    const int64_t period_us = (int64_t)(uintptr_t)arg * 1000000;
+    int64_t next_us = esp_timer_get_time();
+    while (usb_power_present()) {
+        if (esp_timer_get_time() >= next_us) {
+            next_us += period_us;
+            SensorReading reading;
+            take_reading(&reading);
+            BacklogEntry entry;
+            pack_reading(&reading, &entry.reading);
+            time_t now = time(NULL);
+            entry.taken_at = now > 1600000000 ? (uint32_t)now : 0;
+            ring_push(&ring, &entry);
+            xTaskNotifyGive(uploader);
+        }
+        vTaskDelay(pdMS_TO_TICKS(USB_POLL_MS));
+    }
+    atomic_store(&usb_lost, true);
+    xTaskNotifyGive(uploader);
+    vTaskDelete(NULL);
+}
+
+void usb_stream_run(void) {
+    uint32_t period_s = nvs_get_stream_seconds();
+    if (period_s < STREAM_MIN_SECONDS) {
+        period_s = STREAM_MIN_SECONDS;
+    }
+    governor_stop();
+    ring_init(&ring);
+    atomic_store(&usb_lost, false);
+    atomic_store(&active, true);
+    uploader = xTaskGetCurrentTaskHandle();
+    if (static_task_start(&stream_sampler, sampler_task, "stream_sampler",
+                          (void *)(uintptr_t)period_s, 5) == NULL) {
+        ESP_LOGE(TAG, "Sampler slot busy; not streaming");
+        atomic_store(&active, false);
+        return;
+    }
+    ESP_LOGI(TAG, "USB power: streaming a reading every %lu s", (unsigned long)period_s);
+
+    post_session_t session = { 0 };
+    uint32_t retry_ms = 0;
+    uint32_t sent = 0, failed = 0;
+    int64_t next_stats_us = esp_timer_get_time() + STATS_EVERY_S * 1000000LL;
+    while (!atomic_load(&usb_lost)) {
+        ulTaskNotifyTake(pdTRUE, retry_ms ? pdMS_TO_TICKS(retry_ms) : portMAX_DELAY);
+
+        BacklogEntry entry;
+        while (!atomic_load(&usb_lost) && ring_peek(&ring, &entry)) {
+            int code = -1;
+            if (session.client != NULL || upload_session_open(&session)) {
+                code = upload_session_send(&session, &entry.reading, entry.taken_at);
+            }
+            if (code != 200) {
+                // Keep the reading and the order; back off so a dead link isn't hammered.
+                failed++;
+                POST_session_close(&session);
+                retry_ms = retry_ms ? retry_ms * 2 : RETRY_MIN_MS;
+                if (retry_ms > RETRY_MAX_MS) {
+                    retry_ms = RETRY_MAX_MS;
+                }
+                ESP_LOGW(TAG, "Upload failed (%d), %u queued, retry in %lu ms", code,
+                         (unsigned)ring_count(&ring), (unsigned long)retry_ms);
+                break;
+            }
+            ring_pop(&ring);
+            sent++;
+            retry_ms = 0;
+        }
+
+        if (esp_timer_get_time() >= next_stats_us) {
+            next_stats_us += STATS_EVERY_S * 1000000LL;
+            ESP_LOGI(TAG, "sent %lu, failed %lu, queued %u, dropped %u", (unsigned long)sent,
+                     (unsigned long)failed, (unsigned)ring_count(&ring),
+                     (unsigned)atomic_load(&ring.dropped));
+        }
+    }
+
+    // USB gone: the sampler has exited, so the ring is ours alone. Whatever didn't go
+    // out is kept for the battery cycle's next upload.
+    POST_session_close(&session);
+    size_t parked = 0;
+    BacklogEntry entry;
+    while (ring_peek(&ring, &entry)) {
+        backlog_push(&entry.reading, entry.taken_at);
+        ring_pop(&ring);
+        parked++;
+    }
+    atomic_store(&active, false);
+    ESP_LOGI(TAG, "USB removed: sent %lu, %u parked in the backlog, %u dropped; back to deep sleep",
+             (unsigned long)sent, (unsigned)parked, (unsigned)atomic_load(&ring.dropped));
+}
@@ -0,0 +1,30 @@
+#ifndef USB_STREAM_H
+#define USB_STREAM_H
+
+// Mains mode for a node that finds USB power at the end of a connected wake: instead of
+// deep-sleeping, it stays on Wi-Fi and uploads a reading every "stream_seconds" over one
+// kept-alive HTTPS connection, until USB_DETECT drops. The device then goes back to the
+// battery cycle, and anything still queued goes into the RTC backlog. Off when
+// stream_seconds is 0 (the default).
+//
+// Two tasks share a reading_ring_t. A small sampler task times the readings and watches
+// USB_DETECT between them. The wake task, which already has the TLS-sized stack, does
+// the uploads. A slow or unreachable server therefore never delays a sample, and a
+// Wi-Fi drop costs readings only once the ring is full.
+
+#include <stdbool.h>
+
+#define STREAM_MIN_SECONDS 2u
+
+// True if this wake should stream: streaming configured and USB present right now.
+bool usb_stream_wanted(void);
+
+// Runs streaming mode on the calling (wake) task and returns once USB is gone. Stops
+// the wake governor: a mains-powered device has no wake budget to enforce.
+void usb_stream_run(void);
+
+// True while usb_stream_run() is active. The Wi-Fi driver then keeps reconnecting, as
+// it does on the ESP-NOW gateway, instead of giving up.
+bool usb_stream_active(void);
+
+#endif // USB_STREAM_H
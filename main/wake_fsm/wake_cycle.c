@@ -0,0 +1,193 @@
+#include <sys/time.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "main.h"
+#include "data.h"
+#include "nvs_drv.h"
+#include "wifi_drv.h"
+#include "link_policy.h"
+#include "wake_governor.h"
+#include "sampler.h"
+#include "report_filter.h"
+#include "tls_profile.h"
+#include "coap_link.h"
+#include "mqtt_link.h"
+#include "usb_stream.h"
+#include "wake_cycle.h"
+
+static const char *TAG = "WAKE";
+
+#define WAKE_QUEUE_LEN          8
+#define OFFLINE_RESERVE_MS      2000    // connect gives up this early so sleep-with-backlog still fits
+#define UNGOVERNED_CONNECT_MS   30000   // waits when no wake budget is running
+#define UNGOVERNED_SYNC_MS      10000
+
+static StaticQueue_t queue_storage;
+static uint8_t queue_buf[WAKE_QUEUE_LEN * sizeof(wake_event_t)];
+static QueueHandle_t events;
+
+// Owned by the wake task; nothing else touches it.
+static struct {
+    SensorReading reading;
+    bool reading_taken;
+    bool wifi_started;
+    bool uploaded;
+} ctx;
+
+void wake_post(wake_event_t event) {
+    if (events != NULL && xQueueSend(events, &event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Event queue full, dropped '%s'", wake_event_name(event));
+    }
+}
+
+static uint32_t budget_ms(uint32_t reserve_ms, uint32_t ungoverned_ms) {
+    uint32_t left = governor_remaining_ms();
+    if (left == UINT32_MAX) {
+        return ungoverned_ms;
+    }
+    return left > reserve_ms ? left - reserve_ms : 0;
+}
+
+static void log_time(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    struct tm timeinfo;
+    localtime_r(&tv.tv_sec, &timeinfo);
+    char time_str[64];
+    strftime(time_str, sizeof(time_str), "%c", &timeinfo);
+    ESP_LOGI("NTP", "Current time: %s", time_str);
+}
+
+// Runs the state's entry action. Returns the event it produced by itself, or
+// WAKE_EV_COUNT if the state waits (then *wait_ms is its timeout).
+static wake_event_t enter_state(wake_state_t state, uint32_t *wait_ms) {
+    switch (state) {
+    case WAKE_ST_BOOT:
+        return WAKE_EV_DONE;
+
+    case WAKE_ST_SENSE:
+        // Before the radio comes up: no Wi-Fi current on the rail, and the reading exists
+        // even if this wake never gets online.
+        governor_enter(WAKE_PHASE_SENSE);
+        take_reading(&ctx.reading);
+        governor_hold_reading(&ctx.reading);   // from here an abort parks it in the backlog
+        sampler_add(&ctx.reading);             // closes the micro-wake window
+        ctx.reading_taken = true;
+        if (report_filter_skip(&ctx.reading)) {
+            governor_release_reading();        // counted in skipped=, not a backlog entry
+            return WAKE_EV_UNCHANGED;
+        }
+        return WAKE_EV_DONE;
+
+    case WAKE_ST_CONNECT:
+        governor_enter(WAKE_PHASE_CONNECT);
+        link_policy_wake_begin();
+        ctx.wifi_started = true;
+        if (wifi_init() != ESP_OK) {
+            return WAKE_EV_WIFI_FAILED;
+        }
+        *wait_ms = budget_ms(OFFLINE_RESERVE_MS, UNGOVERNED_CONNECT_MS);
+        return WAKE_EV_COUNT;
+
+    case WAKE_ST_SYNC:
+        governor_enter(WAKE_PHASE_TIME);
+        initialize_sntp();
+        *wait_ms = budget_ms(0, UNGOVERNED_SYNC_MS);
+        return WAKE_EV_COUNT;
+
+    case WAKE_ST_UPDATE_CHECK:
+#ifdef TLS_BENCHMARK_ROUNDS
+        governor_grant_ms(TLS_BENCHMARK_ROUNDS * 3 * 10000);   // 3 profiles, 10 s timeout each
+        tls_profile_benchmark(TLS_ATHOME_HOST, TLS_BENCHMARK_ROUNDS);
+#endif
+        governor_enter(WAKE_PHASE_OTA);
+        check_update();
+        return WAKE_EV_DONE;
+
+    case WAKE_ST_UPLOAD:
+        governor_enter(WAKE_PHASE_UPLOAD);
+        if (main_struct.transport == TRANSPORT_MQTT) {
+            ctx.uploaded = mqtt_deliver_reading(&ctx.reading);
+        } else if (main_struct.transport == TRANSPORT_COAP) {
+            ctx.uploaded = coap_deliver_reading(&ctx.reading);
+        } else {
+            ctx.uploaded = deliver_reading(&ctx.reading);
+        }
+        return ctx.uploaded ? WAKE_EV_UPLOAD_OK : WAKE_EV_UPLOAD_FAILED;
+
+    case WAKE_ST_PROVISION:
+        ESP_LOGW(TAG, "Opening BLE re-provisioning after %lu failed wakes",
+                 (unsigned long)link_policy_failed_wakes());
+        if (ctx.wifi_started) {
+            esp_wifi_stop();
+        }
+        governor_defer_reading();   // kept for the first wake back online
+        main_struct.isProvisioned = false;
+        governor_stop();            // the provisioning window has its own limit
+        ble_advert();               // BT memory released at boot: restarts into provisioning
+        return WAKE_EV_COUNT;
+
+    case WAKE_ST_SLEEP:
+    default:
+        // On USB power with the link known good, stay up and stream until unplugged.
+        if (ctx.uploaded && usb_stream_wanted()) {
+            usb_stream_run();
+        }
+        // A reading still held (connect failed, upload cut short) is parked by
+        // governor_finish() inside enter_deep_sleep().
+        enter_deep_sleep(nvs_get_sleep_seconds());   // backoff/micro-wakes applied inside
+        return WAKE_EV_COUNT;
+    }
+}
+
+void wake_cycle_task(void *arg) {
+    events = xQueueCreateStatic(WAKE_QUEUE_LEN, sizeof(wake_event_t), queue_buf, &queue_storage);
+
+    wake_fsm_inputs_t in = { .provision = false, .update_check = true };
+    wake_state_t state = WAKE_ST_BOOT;
+    uint32_t wait_ms = 0;
+    wake_event_t ev = enter_state(state, &wait_ms);
+    int64_t wait_until_us = esp_timer_get_time() + (int64_t)wait_ms * 1000;
+
+    while (!wake_fsm_is_terminal(state)) {
+        if (ev == WAKE_EV_COUNT) {
+            int64_t left_us = wait_until_us - esp_timer_get_time();
+            TickType_t ticks = left_us > 0 ? pdMS_TO_TICKS((uint32_t)(left_us / 1000)) : 0;
+            if (xQueueReceive(events, &ev, ticks) != pdTRUE) {
+                ev = WAKE_EV_TIMEOUT;
+            }
+        }
+        if (state == WAKE_ST_CONNECT && ev == WAKE_EV_WIFI_FAILED && !main_struct.password[0]) {
+            in.provision = true;    // nothing to connect with: only the user can fix this
+        } else if (state == WAKE_ST_CONNECT && (ev == WAKE_EV_WIFI_FAILED || ev == WAKE_EV_TIMEOUT)) {
+            in.provision = link_policy_should_provision();
+        }
+
+        wake_state_t next = wake_fsm_next(state, ev, &in);
+        if (next == state) {
+            ESP_LOGD(TAG, "'%s' ignored in '%s'", wake_event_name(ev), wake_state_name(state));
+            ev = WAKE_EV_COUNT;   // keep waiting out the same deadline
+            continue;
+        }
+        ESP_LOGI(TAG, "%s --%s--> %s (%lu ms)", wake_state_name(state), wake_event_name(ev),
+                 wake_state_name(next), (unsigned long)(esp_timer_get_time() / 1000));
+        if (state == WAKE_ST_SYNC) {
+            if (ev == WAKE_EV_TIMEOUT) {
+                ESP_LOGW("NTP", "SNTP not answered within budget; continuing unsynchronised");
+            }
+            log_time();
+        }
+        state = next;
+        wait_ms = 0;
+        ev = enter_state(state, &wait_ms);
+        wait_until_us = esp_timer_get_time() + (int64_t)wait_ms * 1000;
+    }
+
+    // Only PROVISION gets here (SLEEP doesn't return); BLE runs on its own tasks now.
+    // The wake slot reports this task's stack to mem_diag itself.
+    vTaskDelete(NULL);
+}
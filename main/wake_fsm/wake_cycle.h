@@ -0,0 +1,13 @@
+#ifndef WAKE_CYCLE_H
+#define WAKE_CYCLE_H
+
+// Device side of wake_fsm: runs the HTTPS wake cycle in the wake task. Entry actions do
+// the work; anything asynchronous (Wi-Fi, SNTP) reports back through wake_post(), and
+// the task blocks on its event queue with the state's timeout. No polling.
+
+#include "wake_fsm.h"
+
+void wake_cycle_task(void *arg);     // start_wake_task(wake_cycle_task, "wake", WAKE_STACK_CYCLE)
+void wake_post(wake_event_t event);  // any task context; dropped if no cycle is running
+
+#endif // WAKE_CYCLE_H
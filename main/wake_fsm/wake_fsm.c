@@ -0,0 +1,65 @@
+#include "wake_fsm.h"
+
+static const char *const state_names[WAKE_ST_COUNT] = {
+    "boot", "sense", "connect", "sync", "update_check", "upload", "provision", "sleep",
+};
+
+static const char *const event_names[WAKE_EV_COUNT] = {
+    "done", "wifi_up", "wifi_failed", "time_synced", "timeout", "upload_ok", "upload_failed",
+    "unchanged",
+};
+
+const char *wake_state_name(wake_state_t state) {
+    return state < WAKE_ST_COUNT ? state_names[state] : "?";
+}
+
+const char *wake_event_name(wake_event_t event) {
+    return event < WAKE_EV_COUNT ? event_names[event] : "?";
+}
+
+bool wake_fsm_is_terminal(wake_state_t state) {
+    return state == WAKE_ST_PROVISION || state == WAKE_ST_SLEEP || state >= WAKE_ST_COUNT;
+}
+
+wake_state_t wake_fsm_next(wake_state_t state, wake_event_t event, const wake_fsm_inputs_t *in) {
+    switch (state) {
+    case WAKE_ST_BOOT:
+        return event == WAKE_EV_DONE ? WAKE_ST_SENSE : state;
+
+    case WAKE_ST_SENSE:
+        // A sensor that doesn't answer in time still lets the wake go on.
+        if (event == WAKE_EV_UNCHANGED) {
+            return WAKE_ST_SLEEP;
+        }
+        return event == WAKE_EV_DONE || event == WAKE_EV_TIMEOUT ? WAKE_ST_CONNECT : state;
+
+    case WAKE_ST_CONNECT:
+        if (event == WAKE_EV_WIFI_UP) {
+            return WAKE_ST_SYNC;
+        }
+        if (event == WAKE_EV_WIFI_FAILED || event == WAKE_EV_TIMEOUT) {
+            return in->provision ? WAKE_ST_PROVISION : WAKE_ST_SLEEP;
+        }
+        return state;
+
+    case WAKE_ST_SYNC:
+        // Unsynchronised is fine: a reading without a fresh clock beats no reading.
+        if (event == WAKE_EV_TIME_SYNCED || event == WAKE_EV_TIMEOUT) {
+            return in->update_check ? WAKE_ST_UPDATE_CHECK : WAKE_ST_UPLOAD;
+        }
+        return state;
+
+    case WAKE_ST_UPDATE_CHECK:
+        // A successful update restarts the chip from inside this state.
+        return event == WAKE_EV_DONE || event == WAKE_EV_TIMEOUT ? WAKE_ST_UPLOAD : state;
+
+    case WAKE_ST_UPLOAD:
+        if (event == WAKE_EV_UPLOAD_OK || event == WAKE_EV_UPLOAD_FAILED || event == WAKE_EV_TIMEOUT) {
+            return WAKE_ST_SLEEP;
+        }
+        return state;
+
+    default:
+        return state;   // terminal
+    }
+}
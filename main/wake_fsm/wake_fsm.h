@@ -0,0 +1,57 @@
+#ifndef WAKE_FSM_H
+#define WAKE_FSM_H
+
+// The HTTPS wake cycle as an explicit state machine. This file is only the transition
+// table. It is pure C with no ESP-IDF headers, so it can be built and driven on the host.
+// wake_cycle.c runs it on the device: state entry actions, one event queue, and one
+// timeout per waiting state.
+//
+//   BOOT --done--> SENSE --done--> CONNECT --wifi_up--> SYNC --synced/timeout--> UPDATE_CHECK
+//                    |                |                                              |
+//                unchanged  wifi_failed/timeout                                    done
+//                    |                v                                              v
+//                    +--> PROVISION or SLEEP <--------- upload_ok/failed/timeout -- UPLOAD
+//
+// SENSE goes straight to SLEEP when the reading is within the report-by-exception
+// deadbands (report_filter.h); nothing else about the wake changes.
+// SYNC goes straight to UPLOAD when the update check is off for this wake. Events a
+// state doesn't handle leave it where it is (e.g. a late TIME_SYNCED during UPLOAD).
+
+#include <stdbool.h>
+
+typedef enum {
+    WAKE_ST_BOOT = 0,
+    WAKE_ST_SENSE,
+    WAKE_ST_CONNECT,
+    WAKE_ST_SYNC,
+    WAKE_ST_UPDATE_CHECK,
+    WAKE_ST_UPLOAD,
+    WAKE_ST_PROVISION,        // terminal: BLE re-provisioning window takes over
+    WAKE_ST_SLEEP,            // terminal: deep sleep
+    WAKE_ST_COUNT
+} wake_state_t;
+
+typedef enum {
+    WAKE_EV_DONE = 0,         // a synchronous state finished its work
+    WAKE_EV_WIFI_UP,          // IP_EVENT_STA_GOT_IP
+    WAKE_EV_WIFI_FAILED,      // retries exhausted, or no usable credentials
+    WAKE_EV_TIME_SYNCED,      // SNTP callback
+    WAKE_EV_TIMEOUT,          // the state's wait ran out
+    WAKE_EV_UPLOAD_OK,
+    WAKE_EV_UPLOAD_FAILED,
+    WAKE_EV_UNCHANGED,        // SENSE: reading within the deadbands, no upload due
+    WAKE_EV_COUNT
+} wake_event_t;
+
+// Decisions the table needs from outside, sampled by the runner when it feeds an event.
+typedef struct {
+    bool provision;           // on a failed connect: open BLE re-provisioning instead of sleeping
+    bool update_check;        // fetch firmware.json this wake
+} wake_fsm_inputs_t;
+
+wake_state_t wake_fsm_next(wake_state_t state, wake_event_t event, const wake_fsm_inputs_t *in);
+bool wake_fsm_is_terminal(wake_state_t state);
+const char *wake_state_name(wake_state_t state);
+const char *wake_event_name(wake_event_t event);
+
+#endif // WAKE_FSM_H
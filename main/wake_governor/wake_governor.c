@@ -0,0 +1,314 @@
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_task_wdt.h"
+#include "sdkconfig.h"
+#include "main.h"
+#include "nvs_drv.h"
+#include "reading_backlog.h"
+#include "mem_diag.h"
+#include "wake_governor.h"
+
+static const char *TAG = "GOVERNOR";
+
+#define GOVERNOR_SLACK_MS       250     // cooperative waits end this far ahead of the hard cut
+#define GOVERNOR_WDT_MARGIN_MS  5000    // watchdog fires only if the abort path itself hangs
+#define GOVERNOR_RECORD_MAGIC   0x474F5632u   // "GOV2"
+
+// Share of the total budget per phase, in percent. Deadlines are cumulative.
+static const uint8_t phase_share_pct[WAKE_PHASE_COUNT] = {
+    [WAKE_PHASE_BOOT]    = 0,
+    [WAKE_PHASE_CONNECT] = 30,
+    [WAKE_PHASE_TIME]    = 10,
+    [WAKE_PHASE_OTA]     = 15,
+    [WAKE_PHASE_SENSE]   = 10,
+    [WAKE_PHASE_UPLOAD]  = 35,
+};
+
+static const char *const phase_names[WAKE_PHASE_COUNT] = {
+    "boot", "connect", "time", "ota", "sense", "upload",
+};
+
+// Survives a watchdog/panic reset (unlike RTC_DATA_ATTR), so the next boot can tell
+// that a wake died mid-flight and still recover the reading it was holding.
+typedef struct {
+    uint32_t magic;
+    uint8_t  active;          // set from governor_start() until governor_finish()
+    uint8_t  phase;
+    uint8_t  pending_valid;
+    PackedReading pending;
+    uint32_t pending_taken_at;
+    wake_overrun_record_t overrun;
+    uint8_t  profile_count;
+    uint8_t  profile_head;    // slot the next finished wake goes into
+    wake_profile_t profiles[WAKE_PROFILE_DEPTH];
+} governor_rtc_t;
+
+static RTC_NOINIT_ATTR governor_rtc_t rec;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool started = false;
+static bool finishing = false;
+static uint32_t total_ms;
+static uint32_t granted_ms;
+static int64_t deadline_us;
+static esp_timer_handle_t abort_timer;
+static TaskHandle_t abort_task_handle;
+STATIC_TASK_DEFINE(governor_task, 3 * 1024);
+static esp_task_wdt_user_handle_t wdt_user;
+static int64_t phase_start_us;
+static wake_profile_t profile;   // this wake, kept in RTC by governor_finish()
+
+const char *wake_phase_name(wake_phase_t phase) {
+    return phase < WAKE_PHASE_COUNT ? phase_names[phase] : "?";
+}
+
+static uint32_t elapsed_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);   // wake starts at boot
+}
+
+static int64_t phase_deadline_us(wake_phase_t phase) {
+    uint32_t pct = 0;
+    for (int p = WAKE_PHASE_CONNECT; p <= phase && p < WAKE_PHASE_COUNT; p++) {
+        pct += phase_share_pct[p];
+    }
+    if (phase == WAKE_PHASE_BOOT || pct > 100) {
+        pct = 100;
+    }
+    return ((int64_t)total_ms * pct / 100 + granted_ms) * 1000;
+}
+
+static void profile_close_phase(void) {
+    int64_t now = esp_timer_get_time();
+    profile.phase_ms[rec.phase] += (uint32_t)((now - phase_start_us) / 1000);
+    phase_start_us = now;
+}
+
+static void arm_deadline(void) {
+    esp_timer_stop(abort_timer);
+    int64_t wait = deadline_us - esp_timer_get_time();
+    esp_timer_start_once(abort_timer, wait > 0 ? (uint64_t)wait : 1);
+}
+
+static void defer_pending_locked(void) {
+    if (rec.pending_valid) {
+        backlog_push(&rec.pending, rec.pending_taken_at);
+        rec.pending_valid = 0;
+    }
+}
+
+// The timer callback runs in the esp_timer task, which must not block; the abort itself
+// (backlog write, Wi-Fi stop, sleep) happens here.
+static void abort_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!started || finishing) {
+            continue;
+        }
+        wake_phase_t phase = (wake_phase_t)rec.phase;
+        uint32_t now = elapsed_ms();
+        taskENTER_CRITICAL(&lock);
+        rec.overrun.last_phase = phase;
+        rec.overrun.last_cause = WAKE_OVERRUN_BUDGET;
+        rec.overrun.last_elapsed_ms = now;
+        rec.overrun.overruns[phase]++;
+        defer_pending_locked();
+        taskEXIT_CRITICAL(&lock);
+        ESP_LOGE(TAG, "Phase '%s' overran its budget at %lu ms; aborting wake", wake_phase_name(phase),
+                 (unsigned long)now);
+        enter_deep_sleep(nvs_get_sleep_seconds());
+    }
+}
+
+static void on_deadline(void *arg) {
+    xTaskNotifyGive(abort_task_handle);
+}
+
+static void watchdog_arm(uint32_t timeout_ms) {
+    esp_task_wdt_config_t twdt = {
+        .timeout_ms = timeout_ms,
+        .idle_core_mask = 0
+#if CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU0
+                          | BIT(0)
+#endif
+#if CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU1
+                          | BIT(1)
+#endif
+        ,
+        .trigger_panic = true,   // reset, don't just log: a hung wake must end
+    };
+    if (esp_task_wdt_reconfigure(&twdt) == ESP_ERR_INVALID_STATE) {
+        esp_task_wdt_init(&twdt);   // TWDT disabled in sdkconfig: bring it up ourselves
+    }
+    if (wdt_user == NULL) {
+        esp_task_wdt_add_user("wake", &wdt_user);
+    } else {
+        esp_task_wdt_reset_user(wdt_user);
+    }
+}
+
+void governor_start(void) {
+    if (rec.magic != GOVERNOR_RECORD_MAGIC || rec.phase >= WAKE_PHASE_COUNT ||
+        rec.profile_head >= WAKE_PROFILE_DEPTH) {
+        memset(&rec, 0, sizeof(rec));   // power-on: RTC_NOINIT holds garbage
+        rec.magic = GOVERNOR_RECORD_MAGIC;
+    }
+
+    if (rec.active) {
+        // The previous wake never reached enter_deep_sleep(). Keep whatever it was holding.
+        taskENTER_CRITICAL(&lock);
+        defer_pending_locked();
+        rec.active = 0;
+        taskEXIT_CRITICAL(&lock);
+        if (esp_reset_reason() == ESP_RST_TASK_WDT) {
+            rec.overrun.last_phase = rec.phase;
+            rec.overrun.last_cause = WAKE_OVERRUN_WATCHDOG;
+            rec.overrun.last_elapsed_ms = 0;
+            rec.overrun.overruns[rec.phase]++;
+            rec.overrun.watchdog_resets++;
+            // Going straight back to sleep is what protects the battery if something
+            // hangs on every wake; the next timer wake tries again from scratch.
+            ESP_LOGE(TAG, "Watchdog ended the last wake in phase '%s'; sleeping",
+                     wake_phase_name((wake_phase_t)rec.phase));
+            enter_deep_sleep(nvs_get_sleep_seconds());
+        }
+    } else if (rec.overrun.last_cause != WAKE_OVERRUN_NONE) {
+        ESP_LOGW(TAG, "Last overrun: phase '%s' (%s) at %lu ms; watchdog resets: %lu",
+                 wake_phase_name((wake_phase_t)rec.overrun.last_phase),
+                 rec.overrun.last_cause == WAKE_OVERRUN_WATCHDOG ? "watchdog" : "budget",
+                 (unsigned long)rec.overrun.last_elapsed_ms, (unsigned long)rec.overrun.watchdog_resets);
+    }
+
+    total_ms = nvs_get_wake_budget_ms();
+    granted_ms = 0;
+    finishing = false;
+    rec.active = 1;
+    rec.phase = WAKE_PHASE_BOOT;
+    memset(&profile, 0, sizeof(profile));
+    phase_start_us = 0;       // boot counts from reset
+
+    abort_task_handle = static_task_start(&governor_task, abort_task, "governor", NULL,
+                                          configMAX_PRIORITIES - 2);
+    const esp_timer_create_args_t args = { .callback = on_deadline, .name = "wake_budget" };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &abort_timer));
+    watchdog_arm(total_ms + GOVERNOR_WDT_MARGIN_MS);
+
+    started = true;
+    deadline_us = phase_deadline_us(WAKE_PHASE_BOOT);
+    arm_deadline();
+    ESP_LOGI(TAG, "Wake budget %lu ms (backlog: %u readings)", (unsigned long)total_ms,
+             (unsigned)backlog_count());
+}
+
+void governor_enter(wake_phase_t phase) {
+    if (!started || phase >= WAKE_PHASE_COUNT) {
+        return;
+    }
+    profile_close_phase();
+    rec.phase = phase;
+    deadline_us = phase_deadline_us(phase);
+    arm_deadline();
+    ESP_LOGI(TAG, "Phase '%s' at %lu ms, %lu ms left", wake_phase_name(phase),
+             (unsigned long)elapsed_ms(), (unsigned long)governor_remaining_ms());
+}
+
+uint32_t governor_remaining_ms(void) {
+    if (!started) {
+        return UINT32_MAX;
+    }
+    int64_t left = (deadline_us - esp_timer_get_time()) / 1000 - GOVERNOR_SLACK_MS;
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+void governor_grant_ms(uint32_t extra_ms) {
+    if (!started) {
+        return;
+    }
+    granted_ms += extra_ms;
+    deadline_us += (int64_t)extra_ms * 1000;
+    arm_deadline();
+    int64_t total_left = phase_deadline_us(WAKE_PHASE_BOOT) - esp_timer_get_time();
+    watchdog_arm((uint32_t)(total_left / 1000) + GOVERNOR_WDT_MARGIN_MS);
+    ESP_LOGI(TAG, "Granted %lu ms in phase '%s'", (unsigned long)extra_ms,
+             wake_phase_name((wake_phase_t)rec.phase));
+}
+
+void governor_stop(void) {
+    if (!started) {
+        return;
+    }
+    started = false;
+    esp_timer_stop(abort_timer);
+    esp_task_wdt_delete_user(wdt_user);
+    wdt_user = NULL;
+    rec.active = 0;
+    ESP_LOGW(TAG, "Governor stopped in phase '%s' (unbounded mode)", wake_phase_name((wake_phase_t)rec.phase));
+}
+
+void governor_finish(void) {
+    if (!started) {
+        return;
+    }
+    finishing = true;
+    esp_timer_stop(abort_timer);
+    profile_close_phase();
+    profile.total_ms = elapsed_ms();
+    taskENTER_CRITICAL(&lock);
+    defer_pending_locked();   // taken but neither delivered nor deferred: keep it
+    rec.active = 0;
+    rec.profiles[rec.profile_head] = profile;
+    rec.profile_head = (rec.profile_head + 1) % WAKE_PROFILE_DEPTH;
+    if (rec.profile_count < WAKE_PROFILE_DEPTH) {
+        rec.profile_count++;
+    }
+    taskEXIT_CRITICAL(&lock);
+    ESP_LOGI(TAG, "Wake took %lu ms of %lu ms budget", (unsigned long)elapsed_ms(),
+             (unsigned long)(total_ms + granted_ms));
+}
+
+void governor_hold_reading(const SensorReading *reading) {
+    PackedReading packed;
+    pack_reading(reading, &packed);
+    time_t now = time(NULL);
+    taskENTER_CRITICAL(&lock);
+    rec.pending = packed;
+    rec.pending_taken_at = now > 1600000000 ? (uint32_t)now : 0;   // 0 = clock never set
+    rec.pending_valid = 1;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void governor_release_reading(void) {
+    taskENTER_CRITICAL(&lock);
+    rec.pending_valid = 0;
+    taskEXIT_CRITICAL(&lock);
+}
+
+void governor_defer_reading(void) {
+    taskENTER_CRITICAL(&lock);
+    defer_pending_locked();
+    taskEXIT_CRITICAL(&lock);
+}
+
+void governor_get_record(wake_overrun_record_t *out) {
+    taskENTER_CRITICAL(&lock);
+    *out = rec.overrun;
+    taskEXIT_CRITICAL(&lock);
+}
+
+int governor_get_profiles(wake_profile_t *out, int max) {
+    if (rec.magic != GOVERNOR_RECORD_MAGIC) {
+        return 0;             // governor never ran since power-on
+    }
+    taskENTER_CRITICAL(&lock);
+    int n = rec.profile_count < max ? rec.profile_count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = rec.profiles[(rec.profile_head + WAKE_PROFILE_DEPTH - 1 - i) % WAKE_PROFILE_DEPTH];
+    }
+    taskEXIT_CRITICAL(&lock);
+    return n;
+}
@@ -0,0 +1,67 @@
+#ifndef WAKE_GOVERNOR_H
+#define WAKE_GOVERNOR_H
+
+// Per-wake awake-time budget. The total (NVS "wake_budget", default 45 s) is split into
+// cumulative phase deadlines, so time a phase doesn't use carries over to the next one.
+// Phases that can, size their own waits from governor_remaining_ms(); anything that
+// still runs past its deadline is cut short: the held reading goes to the RTC backlog,
+// the overrun is recorded, and the device sleeps anyway. The task watchdog is armed
+// for the whole wake as the hardware backstop if even that path hangs.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "data.h"
+
+typedef enum {
+    WAKE_PHASE_BOOT = 0,      // before the first phase; bounded only by the total
+    WAKE_PHASE_CONNECT,       // Wi-Fi association + DHCP
+    WAKE_PHASE_TIME,          // SNTP
+    WAKE_PHASE_OTA,           // firmware.json check (download gets its own grant)
+    WAKE_PHASE_SENSE,
+    WAKE_PHASE_UPLOAD,
+    WAKE_PHASE_COUNT
+} wake_phase_t;
+
+typedef enum {
+    WAKE_OVERRUN_NONE = 0,
+    WAKE_OVERRUN_BUDGET,      // governor timer cut the phase short
+    WAKE_OVERRUN_WATCHDOG,    // task watchdog reset the chip mid-wake
+} wake_overrun_cause_t;
+
+typedef struct {
+    uint8_t  last_phase;      // wake_phase_t of the most recent overrun
+    uint8_t  last_cause;      // wake_overrun_cause_t
+    uint32_t last_elapsed_ms; // time since boot when it was cut
+    uint32_t overruns[WAKE_PHASE_COUNT];
+    uint32_t watchdog_resets;
+} wake_overrun_record_t;
+
+// Where the time went in the last few finished wakes: ms spent in each phase (from
+// governor_enter() to the next one, or to governor_finish()), newest first.
+#define WAKE_PROFILE_DEPTH 8
+
+typedef struct {
+    uint32_t phase_ms[WAKE_PHASE_COUNT];
+    uint32_t total_ms;
+} wake_profile_t;
+
+#define WAKE_OTA_GRANT_MS 180000u   // extra time for an actual firmware download
+
+void governor_start(void);                 // app_main, once per battery wake
+void governor_enter(wake_phase_t phase);   // re-arms the abort timer for this phase
+uint32_t governor_remaining_ms(void);      // until the current phase deadline, minus slack
+void governor_grant_ms(uint32_t extra_ms); // push every deadline (and the watchdog) back
+void governor_stop(void);                  // hand over to an unbounded mode (BLE provisioning)
+void governor_finish(void);                // enter_deep_sleep(): normal end of the wake
+
+// The reading taken this wake, until it is either delivered (release) or parked in the
+// RTC backlog for the next wake (defer). An abort defers it automatically.
+void governor_hold_reading(const SensorReading *reading);
+void governor_release_reading(void);
+void governor_defer_reading(void);
+
+void governor_get_record(wake_overrun_record_t *out);
+int governor_get_profiles(wake_profile_t *out, int max);   // returns how many were copied
+const char *wake_phase_name(wake_phase_t phase);
+
+#endif // WAKE_GOVERNOR_H
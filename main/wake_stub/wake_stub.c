@@ -0,0 +1,120 @@
+#include <stdbool.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_wake_stub.h"
+#include "esp_private/esp_clk.h"
+#include "driver/rtc_io.h"
+#include "soc/rtc.h"
+#include "soc/rtc_cntl_reg.h"
+#include "soc/rtc_io_reg.h"
+#include "main.h"
+#include "data.h"
+#include "nvs_drv.h"
+#include "wake_stub.h"
+
+static const char *TAG = "WAKE_STUB";
+
+#define STUB_USB_DETECT_GPIO 13   // data.c USB_DETECT_GPIO; RTC IO n is GPIO n on the S3
+
+// RTC_DATA_ATTR: read and written by the stub, which runs before the app's .data is
+// set up. Cleared on power-on, so the first wake after one is simply not measured.
+typedef struct {
+    uint32_t slices_left;     // stub wakes still to absorb before the app runs again
+    uint32_t slice_s;
+    uint8_t  usb_at_sleep;    // only a USB plug-in since then is worth a boot
+    uint8_t  stub_ran;        // this boot came through the stub (wake_tick is valid)
+    uint8_t  usb_boot;        // ...and it booted because USB appeared mid-sleep
+    uint64_t wake_tick;       // RTC slow-clock ticks when the stub started this wake
+    uint32_t stub_wakes;      // stub-only wakes since the app last ran...
+    uint64_t stub_ticks;      // ...and their summed entry-to-sleep time
+} stub_rtc_t;
+
+static RTC_DATA_ATTR stub_rtc_t sched;
+
+// Same read as rtc_time_get(), which lives in flash and can't be called from here.
+static inline __attribute__((always_inline)) uint64_t stub_rtc_ticks(void) {
+    SET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_UPDATE);
+    uint64_t t = READ_PERI_REG(RTC_CNTL_TIME0_REG);
+    return t | ((uint64_t)READ_PERI_REG(RTC_CNTL_TIME1_REG) << 32);
+}
+
+static inline __attribute__((always_inline)) bool stub_usb_present(void) {
+    return (READ_PERI_REG(RTC_GPIO_IN_REG) >> (RTC_GPIO_IN_NEXT_S + STUB_USB_DETECT_GPIO)) & 1;
+}
+
+// Runs from RTC fast memory with flash and the app not loaded: registers, RTC memory
+// and the esp_wake_stub_* helpers only. No logging, so the entry-to-sleep figure is
+// the stub's own work.
+static void RTC_IRAM_ATTR wake_stub(void) {
+    uint64_t entry = stub_rtc_ticks();
+    sched.wake_tick = entry;
+    sched.stub_ran = 1;
+    if (sched.slices_left > 0 && (esp_wake_stub_get_wakeup_cause() & RTC_TIMER_TRIG_EN)) {
+        if (stub_usb_present() && !sched.usb_at_sleep) {
+            sched.usb_boot = 1;
+            esp_default_wake_deep_sleep();
+            return;
+        }
+        sched.slices_left--;
+        sched.stub_wakes++;
+        esp_wake_stub_set_wakeup_time((uint64_t)sched.slice_s * 1000000);
+        sched.stub_ticks += stub_rtc_ticks() - entry;
+        esp_wake_stub_sleep(&wake_stub);   // does not return
+    }
+    esp_default_wake_deep_sleep();         // boot the app as usual
+}
+
+// Slice length, or 0 when this sleep isn't sliced. Opt-in: usb_check_seconds is 0
+// unless provisioned.
+static uint32_t slice_seconds(uint32_t seconds) {
+    uint8_t t = main_struct.transport;
+    uint32_t slice = nvs_get_usb_check_seconds();
+    bool wanted = slice >= WAKE_STUB_MIN_SLICE_S && seconds > slice && nvs_get_stream_seconds() > 0 &&
+                  (t == TRANSPORT_HTTPS || t == TRANSPORT_MQTT || t == TRANSPORT_COAP);  // wake_cycle streams
+    return wanted ? slice : 0;
+}
+
+static uint32_t ticks_to_ms(uint64_t ticks) {
+    return (uint32_t)(rtc_time_slowclk_to_us(ticks, esp_clk_slowclk_cal_get()) / 1000);
+}
+
+bool wake_stub_usb_boot(void) {
+    return sched.stub_ran && sched.usb_boot;
+}
+
+uint64_t wake_stub_arm(uint32_t seconds) {
+    if (sched.stub_ran) {
+        // Both figures start at stub entry, so bootloader and app init are in the first.
+        uint32_t stub_us = sched.stub_wakes ?
+            (uint32_t)(rtc_time_slowclk_to_us(sched.stub_ticks / sched.stub_wakes,
+                                              esp_clk_slowclk_cal_get())) : 0;
+        ESP_LOGI(TAG, "App wake: %lu ms boot-to-sleep. Stub-only wakes before it: %lu, avg %lu us",
+                 (unsigned long)ticks_to_ms(stub_rtc_ticks() - sched.wake_tick),
+                 (unsigned long)sched.stub_wakes, (unsigned long)stub_us);
+    }
+    sched.stub_ran = 0;
+    sched.usb_boot = 0;
+    sched.stub_wakes = 0;
+    sched.stub_ticks = 0;
+    sched.slices_left = 0;
+    esp_set_deep_sleep_wake_stub(&wake_stub);
+
+    uint32_t slice = slice_seconds(seconds);
+    if (slice == 0) {
+        return (uint64_t)seconds * 1000000;
+    }
+    // The odd remainder goes first, so the app's own wake still lands on `seconds`.
+    uint32_t slices = (seconds + slice - 1) / slice;
+    sched.slices_left = slices - 1;
+    sched.slice_s = slice;
+    sched.usb_at_sleep = usb_power_present();
+    // usb_power_present() left the pin on the digital mux; the stub reads the RTC side.
+    rtc_gpio_init(STUB_USB_DETECT_GPIO);
+    rtc_gpio_set_direction(STUB_USB_DETECT_GPIO, RTC_GPIO_MODE_INPUT_ONLY);
+    rtc_gpio_pullup_dis(STUB_USB_DETECT_GPIO);
+    rtc_gpio_pulldown_dis(STUB_USB_DETECT_GPIO);
+    ESP_LOGI(TAG, "Sleep split into %lu slices of %lu s for USB checks", (unsigned long)slices,
+             (unsigned long)slice);
+    return (uint64_t)(seconds - sched.slices_left * slice) * 1000000;
+}
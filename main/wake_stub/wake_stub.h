@@ -0,0 +1,36 @@
+#ifndef WAKE_STUB_H
+#define WAKE_STUB_H
+
+// Deep-sleep wake stub (RTC fast memory). It runs before the bootloader on every
+// deep-sleep wake and decides from an RTC schedule whether the wake needs the app.
+//
+// Every timer wake the app takes today needs the full boot: micro-wakes read the ADC
+// and the fuel gauge, full wakes upload, and neither driver runs from RTC memory. So
+// the stub can't skip any of them; it only adds wakes, and only when asked to. With
+// the "usb_check_seconds" provisioning key set (nvs_get_usb_check_seconds(), default 0
+// = off) and USB streaming configured (stream_seconds > 0), each sleep is cut into
+// slices of that length. On the in-between wakes the stub reads USB_DETECT and, if
+// nothing was plugged in, re-arms the timer and sleeps again without booting. Plugging
+// in USB therefore starts streaming within one slice instead of at the next upload.
+// Button and other non-timer wakes always boot.
+//
+// The stub also timestamps every wake (RTC slow clock), and the app logs
+//   App wake: <ms> boot-to-sleep. Stub-only wakes before it: <n>, avg <us> us
+// before each sleep. No such figures have been taken on these boards yet, so nothing
+// here claims the slices are cheap: the option stays off by default, and whether a
+// slice length is worth its wakes is for those lines (and a current probe) to show.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WAKE_STUB_MIN_SLICE_S 30u   // shortest usb_check_seconds accepted
+
+// sleep_now(): installs the stub and plans the slices. Returns the first timer interval
+// in microseconds (all of `seconds` when no slicing applies).
+uint64_t wake_stub_arm(uint32_t seconds);
+
+// This boot cut a sliced sleep short because USB power appeared: run the full wake
+// (it will start streaming), not a sampler micro-wake.
+bool wake_stub_usb_boot(void);
+
+#endif // WAKE_STUB_H
@@ -0,0 +1,71 @@
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "nvs_drv.h"
+#include "link_policy.h"
+
+static const char *TAG = "LINK";
+
+#define LINK_RECORD_MAGIC 0x4C4E4B31u   // "LNK1"
+
+// RTC_NOINIT like the backlog: a wake that the governor or watchdog cuts short while
+// still connecting must count as a failure too.
+typedef struct {
+    uint32_t magic;
+    uint32_t failed_wakes;
+} link_rtc_t;
+
+static RTC_NOINIT_ATTR link_rtc_t rec;
+
+static void validate(void) {
+    if (rec.magic != LINK_RECORD_MAGIC) {
+        rec.magic = LINK_RECORD_MAGIC;
+        rec.failed_wakes = 0;
+    }
+}
+
+void link_policy_wake_begin(void) {
+    validate();
+    if (rec.failed_wakes > 0) {
+        ESP_LOGW(TAG, "%lu consecutive wakes without Wi-Fi", (unsigned long)rec.failed_wakes);
+    }
+    rec.failed_wakes++;
+}
+
+void link_policy_connected(void) {
+    validate();
+    rec.failed_wakes = 0;
+}
+
+uint32_t link_policy_failed_wakes(void) {
+    validate();
+    return rec.failed_wakes;
+}
+
+bool link_policy_should_provision(void) {
+    validate();
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0) {
+        return true;   // someone pressed the button: they're here to fix it
+    }
+    // Every Nth failure rather than every failure from N on, so a network that's gone
+    // for good costs one provisioning window per N wakes, not one per wake.
+    uint32_t after = nvs_get_reprovision_after();
+    return after > 0 && rec.failed_wakes > 0 && rec.failed_wakes % after == 0;
+}
+
+uint32_t link_policy_sleep_seconds(uint32_t seconds) {
+    validate();
+    if (rec.failed_wakes == 0 || seconds == 0) {
+        return seconds;
+    }
+    uint32_t shift = rec.failed_wakes - 1;
+    shift = shift > LINK_BACKOFF_MAX_SHIFT ? LINK_BACKOFF_MAX_SHIFT : shift;
+    uint64_t backoff = (uint64_t)seconds << shift;
+    uint64_t cap = seconds > LINK_BACKOFF_CAP_S ? seconds : LINK_BACKOFF_CAP_S;
+    backoff = backoff > cap ? cap : backoff;
+    if (backoff != seconds) {
+        ESP_LOGI(TAG, "Backoff after %lu failed wakes: %lu s instead of %lu s",
+                 (unsigned long)rec.failed_wakes, (unsigned long)backoff, (unsigned long)seconds);
+    }
+    return (uint32_t)backoff;
+}
@@ -0,0 +1,25 @@
+#ifndef LINK_POLICY_H
+#define LINK_POLICY_H
+
+// What a battery node does when it can't reach Wi-Fi. It used to drop into BLE
+// provisioning with endless advertising on the first bad wake, so one router reboot
+// kept the sensor awake until the cell was flat. Now a failed wake parks its reading
+// in the RTC backlog and sleeps. The sleep doubles with each consecutive failed wake,
+// capped at LINK_BACKOFF_CAP_S. BLE re-provisioning only starts on a button wake, or
+// every "reprovision_after" consecutive failures (NVS, default 12, 0 = button only).
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LINK_BACKOFF_MAX_SHIFT 3         // at most 8x the configured interval...
+#define LINK_BACKOFF_CAP_S     86400u    // ...and no more than a day (unless the interval is longer)
+
+void link_policy_wake_begin(void);       // wifi_init(): the wake counts as failed until connected
+void link_policy_connected(void);        // GOT_IP: clears the failure streak
+uint32_t link_policy_failed_wakes(void);
+bool link_policy_should_provision(void); // after a failed connect: button wake or threshold hit
+
+// enter_deep_sleep(): stretches the interval while the failure streak lasts.
+uint32_t link_policy_sleep_seconds(uint32_t seconds);
+
+#endif // LINK_POLICY_H
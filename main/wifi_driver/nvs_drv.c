@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string.h>
 #include <esp_err.h>
 #include "esp_log.h"
 #include "nvs_drv.h"
@@ -123,6 +124,354 @@ esp_err_t nvs_set_sleep_seconds(uint32_t seconds) {
     return err;
 }
 
+uint32_t nvs_get_wake_budget_ms(void) {
+    nvs_handle_t nvs_handle;
+    uint32_t ms = DEFAULT_WAKE_BUDGET_MS;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return ms;
+    }
+    uint32_t stored = 0;
+    if (nvs_get_u32(nvs_handle, "wake_budget", &stored) == ESP_OK && stored > 0) {
+        ms = stored;
+    }
+    nvs_close(nvs_handle);
+    return ms;
+}
+
+esp_err_t nvs_set_wake_budget_ms(uint32_t ms) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for wake_budget!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_u32(nvs_handle, "wake_budget", ms);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+uint32_t nvs_get_sample_seconds(void) {
+    nvs_handle_t nvs_handle;
+    uint32_t secs = 0;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return secs;
+    }
+    nvs_get_u32(nvs_handle, "sample_secs", &secs);
+    nvs_close(nvs_handle);
+    return secs;
+}
+
+esp_err_t nvs_set_sample_seconds(uint32_t seconds) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for sample_secs!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_u32(nvs_handle, "sample_secs", seconds);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+uint32_t nvs_get_stream_seconds(void) {
+    nvs_handle_t nvs_handle;
+    uint32_t secs = 0;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return secs;
+    }
+    nvs_get_u32(nvs_handle, "stream_secs", &secs);
+    nvs_close(nvs_handle);
+    return secs;
+}
+
+esp_err_t nvs_set_stream_seconds(uint32_t seconds) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for stream_secs!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_u32(nvs_handle, "stream_secs", seconds);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+uint32_t nvs_get_usb_check_seconds(void) {
+    nvs_handle_t nvs_handle;
+    uint32_t secs = 0;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return secs;
+    }
+    nvs_get_u32(nvs_handle, "usb_check_s", &secs);
+    nvs_close(nvs_handle);
+    return secs;
+}
+
+esp_err_t nvs_set_usb_check_seconds(uint32_t seconds) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for usb_check_s!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_u32(nvs_handle, "usb_check_s", seconds);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+void nvs_get_report_config(report_config_t *config) {
+    *config = (report_config_t){
+        .moisture_pct = DEFAULT_RBE_MOISTURE_PCT,
+        .soc_pct = DEFAULT_RBE_SOC_PCT,
+        .heartbeat = DEFAULT_RBE_HEARTBEAT,
+    };
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    report_config_t stored;
+    size_t len = sizeof(stored);
+    if (nvs_get_blob(nvs_handle, "report_cfg", &stored, &len) == ESP_OK && len == sizeof(stored)) {
+        *config = stored;
+    }
+    nvs_close(nvs_handle);
+}
+
+esp_err_t nvs_set_report_config(const report_config_t *config) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for report_cfg!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, "report_cfg", config, sizeof(*config));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+        printf("NVS stored report_cfg (%u %%, %u %%, heartbeat %u)\n", config->moisture_pct,
+               config->soc_pct, config->heartbeat);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+uint32_t nvs_get_reprovision_after(void) {
+    nvs_handle_t nvs_handle;
+    uint32_t wakes = DEFAULT_REPROVISION_AFTER;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return wakes;
+    }
+    nvs_get_u32(nvs_handle, "reprov_after", &wakes);   // 0 is a valid stored value
+    nvs_close(nvs_handle);
+    return wakes;
+}
+
+esp_err_t nvs_set_reprovision_after(uint32_t wakes) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for reprov_after!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_u32(nvs_handle, "reprov_after", wakes);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+uplink_transport_t nvs_get_transport(void) {
+    nvs_handle_t nvs_handle;
+    uint8_t stored = TRANSPORT_HTTPS;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return TRANSPORT_HTTPS;  // not provisioned yet -> default
+    }
+    nvs_get_u8(nvs_handle, "transport", &stored);  // missing key leaves the default
+    nvs_close(nvs_handle);
+    return (uplink_transport_t)stored;
+}
+
+esp_err_t nvs_set_transport(uplink_transport_t transport) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for transport!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_u8(nvs_handle, "transport", (uint8_t)transport);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+        printf("NVS stored transport %d\n", (int)transport);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+int transport_from_name(const char *name) {
+    if (strcmp(name, "https") == 0)          return TRANSPORT_HTTPS;
+    if (strcmp(name, "ble_beacon") == 0)     return TRANSPORT_BLE_BEACON;
+    if (strcmp(name, "espnow") == 0)         return TRANSPORT_ESPNOW;
+    if (strcmp(name, "espnow_gateway") == 0) return TRANSPORT_ESPNOW_GATEWAY;
+    if (strcmp(name, "mqtt") == 0)           return TRANSPORT_MQTT;
+    if (strcmp(name, "coap") == 0)           return TRANSPORT_COAP;
+    return -1;
+}
+
+void nvs_get_mqtt_uri(char *uri, size_t len) {
+    nvs_handle_t nvs_handle;
+    size_t stored_len = len;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) == ESP_OK) {
+        esp_err_t err = nvs_get_str(nvs_handle, "mqtt_uri", uri, &stored_len);
+        nvs_close(nvs_handle);
+        if (err == ESP_OK && uri[0] != '\0') {
+            return;
+        }
+    }
+    strncpy(uri, DEFAULT_MQTT_URI, len - 1);
+    uri[len - 1] = '\0';
+}
+
+esp_err_t nvs_set_mqtt_uri(const char *uri) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for mqtt_uri!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_str(nvs_handle, "mqtt_uri", uri);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+        printf("NVS stored mqtt_uri %s\n", uri);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+void nvs_get_coap_uri(char *uri, size_t len) {
+    nvs_handle_t nvs_handle;
+    size_t stored_len = len;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) == ESP_OK) {
+        esp_err_t err = nvs_get_str(nvs_handle, "coap_uri", uri, &stored_len);
+        nvs_close(nvs_handle);
+        if (err == ESP_OK && uri[0] != '\0') {
+            return;
+        }
+    }
+    strncpy(uri, DEFAULT_COAP_URI, len - 1);
+    uri[len - 1] = '\0';
+}
+
+esp_err_t nvs_set_coap_uri(const char *uri) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for coap_uri!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_str(nvs_handle, "coap_uri", uri);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+        printf("NVS stored coap_uri %s\n", uri);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_get_espnow_config(espnow_config_t *config) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t len = sizeof(*config);
+    err = nvs_get_blob(nvs_handle, "espnow_cfg", config, &len);
+    if (err == ESP_OK && len != sizeof(*config)) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t nvs_set_espnow_config(const espnow_config_t *config) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error (%s) opening NVS for espnow_cfg!", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, "espnow_cfg", config, sizeof(*config));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+        printf("NVS stored espnow_cfg (channel %u)\n", config->channel);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+#define SEQUENCE_RESERVE 256   // values reserved per NVS write (one flash write per 256 wakes)
+
+// Firmware before NVS_SEQUENCE_NAMESPACE kept the reservation in "storage"; 0 if none.
+static uint32_t legacy_sequence_mark(const char *nvs_key) {
+    nvs_handle_t nvs_handle;
+    uint32_t stored = 0;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) == ESP_OK) {
+        nvs_get_u32(nvs_handle, nvs_key, &stored);
+        nvs_close(nvs_handle);
+    }
+    return stored;
+}
+
+uint32_t sequence_next(rtc_sequence_t *seq, const char *nvs_key) {
+    if (seq->value >= seq->limit) {
+        // A block only counts once its end is committed: handing out values that a cold
+        // boot could issue again would reuse an AES-CCM nonce under the same key.
+        nvs_handle_t nvs_handle;
+        esp_err_t err = nvs_open(NVS_SEQUENCE_NAMESPACE, NVS_READWRITE, &nvs_handle);
+        if (err == ESP_OK) {
+            uint32_t value = seq->value;
+            uint32_t stored = 0;
+            err = nvs_get_u32(nvs_handle, nvs_key, &stored);
+            if (err == ESP_ERR_NVS_NOT_FOUND) {
+                stored = legacy_sequence_mark(nvs_key);   // first block since the move, or ever
+                err = ESP_OK;
+            }
+            if (err == ESP_OK && stored > value) {
+                value = stored;        // cold boot: continue above the last reserved block
+            }
+            uint32_t limit = value + SEQUENCE_RESERVE;
+            if (err == ESP_OK) {
+                err = nvs_set_u32(nvs_handle, nvs_key, limit);
+            }
+            if (err == ESP_OK) {
+                err = nvs_commit(nvs_handle);
+            }
+            nvs_close(nvs_handle);
+            if (err == ESP_OK) {
+                seq->value = value;
+                seq->limit = limit;
+            }
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE("NVS", "Error (%s) reserving %s; no sequence number issued",
+                     esp_err_to_name(err), nvs_key);
+            return 0;
+        }
+    }
+    return ++seq->value;
+}
+
 esp_err_t read_from_nvs(char *ssid, char *password, char *name, char *location, char *apiToken, uint8_t *value)
 {
     nvs_handle_t nvs_handle;
@@ -2,6 +2,7 @@
 #define NVS_DRV_
 
 #include <esp_err.h>
+#include <stddef.h>
 #include <stdint.h>
 esp_err_t read_from_nvs(char *ssid, char *password, char *name, char *location, char *apiToken, uint8_t *value);
 esp_err_t save_to_nvs(const char *ssid, const char *password, char *name, char *location, char *apiToken, uint8_t value);
@@ -12,4 +13,103 @@ esp_err_t save_to_nvs(const char *ssid, const char *password, char *name, char *
 uint32_t nvs_get_sleep_seconds(void);
 esp_err_t nvs_set_sleep_seconds(uint32_t seconds);
 
+// Total awake-time budget per wake (ms) that the wake governor splits across phases.
+// Optional "wake_budget_ms" provisioning key; defaults to 45 s.
+#define DEFAULT_WAKE_BUDGET_MS 45000u
+uint32_t nvs_get_wake_budget_ms(void);
+esp_err_t nvs_set_wake_budget_ms(uint32_t ms);
+
+// Radio-free micro-wake interval between uploads (sampler.c). Optional "sample_seconds"
+// provisioning key; 0 (default) keeps one wake per sleep_seconds.
+uint32_t nvs_get_sample_seconds(void);
+esp_err_t nvs_set_sample_seconds(uint32_t seconds);
+
+// Reading interval while on USB power (usb_stream.c). Optional "stream_seconds"
+// provisioning key; 0 (default) deep-sleeps on USB like on battery.
+uint32_t nvs_get_stream_seconds(void);
+esp_err_t nvs_set_stream_seconds(uint32_t seconds);
+
+// Wake-stub USB check interval while streaming is configured (wake_stub.h). Optional
+// "usb_check_seconds" provisioning key; 0 (default) sleeps each interval in one piece.
+uint32_t nvs_get_usb_check_seconds(void);
+esp_err_t nvs_set_usb_check_seconds(uint32_t seconds);
+
+// Report-by-exception (report_filter.c). A wake whose reading is within these deadbands
+// of the last uploaded one sleeps again without starting Wi-Fi, at most heartbeat times
+// in a row. Optional "rbe_moisture", "rbe_soc" and "rbe_heartbeat" provisioning keys;
+// heartbeat 0 uploads every wake.
+typedef struct {
+    uint8_t  moisture_pct;     // |moisture - last uploaded| <= this counts as unchanged
+    uint8_t  soc_pct;          // same for the fuel gauge SoC, whole percent
+    uint16_t heartbeat;        // skipped wakes before an upload is forced
+} report_config_t;
+
+#define DEFAULT_RBE_MOISTURE_PCT 2u
+#define DEFAULT_RBE_SOC_PCT      1u
+#define DEFAULT_RBE_HEARTBEAT    3u
+void nvs_get_report_config(report_config_t *config);   // defaults if never set
+esp_err_t nvs_set_report_config(const report_config_t *config);
+
+// Consecutive failed Wi-Fi wakes after which BLE re-provisioning opens on its own
+// (link_policy.c). Optional "reprovision_after" provisioning key; 0 = button only.
+#define DEFAULT_REPROVISION_AFTER 12u
+uint32_t nvs_get_reprovision_after(void);
+esp_err_t nvs_set_reprovision_after(uint32_t wakes);
+
+// Uplink a provisioned device uses on each wake. Stored in NVS so it can be picked per
+// device at provisioning time (optional "transport" JSON key). Defaults to HTTPS.
+typedef enum {
+    TRANSPORT_HTTPS = 0,        // Wi-Fi + TLS POST to /api/esp/data (the original path)
+    TRANSPORT_BLE_BEACON = 1,   // connectionless signed BLE advert, no Wi-Fi (ble_beacon.c)
+    TRANSPORT_ESPNOW = 2,       // encrypted ESP-NOW frame to a gateway unit (espnow_link.c)
+    TRANSPORT_ESPNOW_GATEWAY = 3, // USB-powered unit: stays on Wi-Fi, forwards ESP-NOW nodes
+    TRANSPORT_MQTT = 4,         // Wi-Fi + QoS 1 publish on a persistent MQTT session (mqtt_link.c)
+    TRANSPORT_COAP = 5,         // Wi-Fi + confirmable CoAP POST over DTLS-PSK (coap_link.c)
+} uplink_transport_t;
+
+uplink_transport_t nvs_get_transport(void);
+esp_err_t nvs_set_transport(uplink_transport_t transport);
+int transport_from_name(const char *name);  // "https"/"ble_beacon"/... -> enum, -1 if unknown
+
+// Broker for TRANSPORT_MQTT. Optional "mqtt_uri" provisioning key; defaults to the
+// athome broker. mqtt:// (no TLS) is accepted for a local test broker.
+#define DEFAULT_MQTT_URI "mqtts://athome.rodlandfarms.com:8883"
+#define MQTT_URI_MAX 96
+void nvs_get_mqtt_uri(char *uri, size_t len);
+esp_err_t nvs_set_mqtt_uri(const char *uri);
+
+// Server for TRANSPORT_COAP. Optional "coap_uri" provisioning key; defaults to the
+// athome endpoint. coap:// (no DTLS) is accepted for a local test server.
+#define DEFAULT_COAP_URI "coaps://athome.rodlandfarms.com:5684"
+#define COAP_URI_MAX 96
+void nvs_get_coap_uri(char *uri, size_t len);
+esp_err_t nvs_set_coap_uri(const char *uri);
+
+// ESP-NOW link settings, shared by a gateway and all of its nodes. The channel must be
+// the one the gateway's access point uses (ESP-NOW can't hop while the gateway is
+// associated). Set at provisioning via the optional "espnow_*" JSON keys.
+typedef struct {
+    uint8_t channel;
+    uint8_t gateway_mac[6];    // nodes only
+    uint8_t key[16];           // AES-128 network key for frame encryption
+} espnow_config_t;
+
+esp_err_t nvs_get_espnow_config(espnow_config_t *config);  // ESP_ERR_NVS_NOT_FOUND if never set
+esp_err_t nvs_set_espnow_config(const espnow_config_t *config);
+
+// Monotonic per-device counter for frame sequence numbers / nonces. Keep the struct in
+// RTC_DATA_ATTR so it survives deep sleep; on a power cycle it restarts above the last
+// block reserved under nvs_key, so a value is never reused. Returns 0 (never a valid
+// number) when a new block is due and can't be committed to NVS; don't send then.
+// The reservations live in their own namespace, which the long-press factory reset
+// (erase_nvs_data(), "storage" only) leaves alone: re-provisioned with the same fleet
+// key, a node must not start again at 1 and repeat its nonces.
+#define NVS_SEQUENCE_NAMESPACE "seq"
+typedef struct {
+    uint32_t value;
+    uint32_t limit;
+} rtc_sequence_t;
+
+uint32_t sequence_next(rtc_sequence_t *seq, const char *nvs_key);
+
 #endif
\ No newline at end of file
@@ -9,6 +9,11 @@
 #include "freertos/event_groups.h"
 #include "main.h"
 #include "data.h"
+#include "nvs_drv.h"
+#include "espnow_link.h"
+#include "link_policy.h"
+#include "wake_cycle.h"
+#include "usb_stream.h"
 #include <sys/time.h>  // For gettimeofday()
 
 
@@ -25,16 +30,6 @@ const int WIFI_FAIL_BIT = BIT1;
 
 esp_err_t wifi_connect();
 
-// ble_advert() initialises the NimBLE host stack, which is too heavy to run inside
-// the 2304 B system-event task — doing so overflows the stack and resets the chip in
-// a loop (same class of bug already fixed for monitor() by giving it its own task).
-// Spawn BLE init in a task with a real stack instead.
-static void ble_advert_task(void *arg)
-{
-    ble_advert();
-    vTaskDelete(NULL);
-}
-
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
 {
@@ -63,21 +58,15 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                 ESP_LOGI(TAG, "Wi-Fi disconnected, retrying... (%d retries left)", retries);
                 esp_wifi_connect();
                 retries--;
+            } else if (main_struct.transport == TRANSPORT_ESPNOW_GATEWAY || usb_stream_active()) {
+                // Mains-powered: nothing to save by sleeping, keep trying the AP.
+                ESP_LOGW(TAG, "Wi-Fi still down after %d retries; mains-powered, keep trying.", RETRIES_COUNT);
+                retries = RETRIES_COUNT;
+                esp_wifi_connect();
             } else {
                 ESP_LOGE(TAG, "Wi-Fi connection failed after maximum retries.");
                 xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
-                main_struct.isProvisioned = false;
-                esp_wifi_stop();  // Stop the Wi-Fi driver
-                ESP_LOGI(TAG, "Wi-Fi disabled.");
-                // Delay to allow time for error logging and BLE advertisement setup
-                //vTaskDelay(1000);
-
-                // Trigger BLE advertising for provisioning — in its own task so the
-                // heavy NimBLE init doesn't overflow this 2304 B system-event task.
-                xTaskCreate(ble_advert_task, "ble_advert", 8192, NULL, 5, NULL);
-
-                // Optionally restart the Wi-Fi or device to retry the configuration
-                // esp_restart();
+                wake_post(WAKE_EV_WIFI_FAILED);   // the wake cycle decides: sleep or re-provision
             }
         }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
@@ -85,33 +74,20 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
         main_struct.isProvisioned = true;
-        // Initialize SNTP to set time
-        initialize_sntp();
-
-        // Wait for time sync to complete
-        wait_for_time_sync();
-
-        ESP_LOGI("NTP", "Time successfully synchronized!");
-        struct timeval tv;
-        gettimeofday(&tv, NULL);  // Get current time
-
-        struct tm timeinfo;
-        localtime_r(&tv.tv_sec, &timeinfo);  // Convert to local time
-
-        char time_str[64];
-        strftime(time_str, sizeof(time_str), "%c", &timeinfo);  // Format time as a readable string
-
-        ESP_LOGI("NTP", "Current time: %s", time_str);  // Log current time
-
-        // Run monitor() in its own task with a large stack. Calling it directly
-        // here runs it in the event-loop task (2304 B), which overflows on the
-        // OTA cert-bundle TLS handshake → instant reset.
-        xTaskCreate(monitor_task, "monitor", 16384, NULL, 5, NULL);
-
+        link_policy_connected();
+
+        if (main_struct.transport == TRANSPORT_ESPNOW_GATEWAY) {
+            // Gateway stays up forwarding node readings instead of a read-and-sleep
+            // cycle; its clock syncs in the background.
+            initialize_sntp();
+            start_wake_task(espnow_gateway_task, "espnow_gw", WAKE_STACK_GATEWAY);
+        } else {
+            wake_post(WAKE_EV_WIFI_UP);   // a reconnect later in the wake is ignored
+        }
     }
 }
 
-void wifi_init(void)
+esp_err_t wifi_init(void)
 {
     // Create event group
     wifi_event_group = xEventGroupCreate();
@@ -140,9 +116,13 @@ void wifi_init(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 
     // Try to connect to Wi-Fi
-    wifi_connect();
+    esp_err_t err = wifi_connect();
+    if (err != ESP_OK) {
+        return err;
+    }
 
     ESP_ERROR_CHECK(esp_wifi_start());
+    return ESP_OK;
 }
 
 esp_err_t wifi_connect()
@@ -159,12 +139,9 @@ esp_err_t wifi_connect()
         ESP_LOGI(TAG, "Static PASSWORD not set. Checking NVS settings.");
         // If STATIC_PASSWORD is not defined, fall back to main_struct.password
         if (strlen(main_struct.password) == 0) {
-            // If password is not set, start BLE advertising for provisioning
-            ESP_LOGI(TAG, "NVS not set, starting BLE advertising for provisioning...");
+            // If password is not set, the wake cycle opens BLE provisioning
+            ESP_LOGI(TAG, "NVS not set, Wi-Fi can't be used for this wake.");
             main_struct.isProvisioned = false;
-            esp_wifi_stop();  // Stop the Wi-Fi driver
-            ESP_LOGI(TAG, "Wi-Fi disabled.");
-            xTaskCreate(ble_advert_task, "ble_advert", 8192, NULL, 5, NULL);  // BLE provisioning (own task)
             return ESP_ERR_WIFI_NOT_CONNECT;  // Return error code to indicate failure to connect
         }
         strncpy((char *)wifi_config.sta.password, main_struct.password, sizeof(wifi_config.sta.password) - 1);
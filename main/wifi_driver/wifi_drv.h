@@ -3,8 +3,9 @@
 
 #include "esp_err.h"
 
-// Function to initialize Wi-Fi
-void wifi_init(void);
+// Initializes Wi-Fi and starts connecting. GOT_IP / retries-exhausted are reported to
+// the wake cycle (wake_post) or, on the ESP-NOW gateway, start its forwarder.
+esp_err_t wifi_init(void);
 
 // Function to connect to Wi-Fi using stored credentials
 esp_err_t wifi_connect();
@@ -0,0 +1,123 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "beacon_gateway.h"
+
+void beacon_gateway_init(beacon_gateway_t *gw) {
+    memset(gw, 0, sizeof(*gw));
+}
+
+void beacon_gateway_free(beacon_gateway_t *gw) {
+    free(gw->devices);
+    memset(gw, 0, sizeof(*gw));
+}
+
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = (char)tolower((unsigned char)c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool beacon_gateway_add_device(beacon_gateway_t *gw, const char *hostname, const char *api_token) {
+    if (strlen(hostname) != 12) {
+        return false;
+    }
+    uint8_t mac[6];
+    for (int i = 0; i < 6; i++) {
+        int hi = hex_nibble(hostname[2 * i]);
+        int lo = hex_nibble(hostname[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        mac[i] = (uint8_t)((hi << 4) | lo);
+    }
+
+    beacon_device_t *dev = beacon_gateway_find(gw, hostname);
+    if (!dev) {
+        if (gw->count == gw->capacity) {
+            size_t cap = gw->capacity ? gw->capacity * 2 : 16;
+            beacon_device_t *grown = realloc(gw->devices, cap * sizeof(*grown));
+            if (!grown) {
+                return false;
+            }
+            gw->devices = grown;
+            gw->capacity = cap;
+        }
+        dev = &gw->devices[gw->count++];
+        memset(dev, 0, sizeof(*dev));
+    }
+
+    for (int i = 0; i < 12; i++) {
+        dev->hostname[i] = (char)toupper((unsigned char)hostname[i]);
+    }
+    dev->hostname[12] = '\0';
+    memcpy(dev->device_id, &mac[2], 4);
+    beacon_derive_key(api_token, dev->key);
+    return true;
+}
+
+beacon_device_t *beacon_gateway_find(beacon_gateway_t *gw, const char *hostname) {
+    for (size_t i = 0; i < gw->count; i++) {
+        if (strcasecmp(gw->devices[i].hostname, hostname) == 0) {
+            return &gw->devices[i];
+        }
+    }
+    return NULL;
+}
+
+gw_result_t beacon_gateway_ingest(beacon_gateway_t *gw, const uint8_t *adv, size_t adv_len,
+                                  beacon_reading_t *reading, const beacon_device_t **device) {
+    size_t mfg_len = 0;
+    const uint8_t *mfg = beacon_find_mfg_data(adv, adv_len, &mfg_len);
+    if (!mfg) {
+        return GW_NOT_BEACON;
+    }
+    beacon_reading_t parsed;
+    if (beacon_parse(mfg, mfg_len, &parsed) != BEACON_OK) {
+        return GW_BAD_FRAME;
+    }
+
+    // Several devices may share the 4-byte id only if their MACs collide in the low
+    // 32 bits; try every match and accept the one whose key verifies.
+    beacon_device_t *dev = NULL;
+    bool known = false;
+    for (size_t i = 0; i < gw->count; i++) {
+        if (memcmp(gw->devices[i].device_id, parsed.device_id, 4) != 0) {
+            continue;
+        }
+        known = true;
+        if (beacon_verify(mfg, mfg_len, gw->devices[i].key) == BEACON_OK) {
+            dev = &gw->devices[i];
+            break;
+        }
+    }
+    if (!known) {
+        return GW_UNKNOWN_DEVICE;
+    }
+    if (!dev) {
+        return GW_BAD_TAG;
+    }
+    if (dev->seen && parsed.seq <= dev->last_seq) {
+        return GW_REPLAY;   // also drops the duplicate copies of one burst
+    }
+
+    dev->last_seq = parsed.seq;
+    dev->seen = true;
+    *reading = parsed;
+    *device = dev;
+    return GW_ACCEPTED;
+}
+
+const char *gw_result_name(gw_result_t result) {
+    switch (result) {
+    case GW_ACCEPTED:       return "accepted";
+    case GW_NOT_BEACON:     return "not_beacon";
+    case GW_BAD_FRAME:      return "bad_frame";
+    case GW_UNKNOWN_DEVICE: return "unknown_device";
+    case GW_BAD_TAG:        return "bad_tag";
+    case GW_REPLAY:         return "replay";
+    }
+    return "?";
+}
@@ -0,0 +1,53 @@
+#ifndef BEACON_GATEWAY_H
+#define BEACON_GATEWAY_H
+
+// Gateway-side ingest for the PlantPulse BLE telemetry beacon: device/key table plus
+// replay rejection on top of the firmware's own frame codec (main/ble_beacon/beacon_frame.c).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "beacon_frame.h"
+
+typedef struct {
+    char     hostname[13];           // 12 hex digits of the Wi-Fi STA MAC, as the backend knows it
+    char     sensor[32];             // optional name/location for the form output (not on air)
+    char     location[64];
+    uint8_t  device_id[4];           // last 4 MAC bytes, as carried in the frame
+    uint8_t  key[BEACON_KEY_LEN];
+    uint32_t last_seq;
+    bool     seen;                   // last_seq is valid
+} beacon_device_t;
+
+typedef struct {
+    beacon_device_t *devices;
+    size_t count;
+    size_t capacity;
+} beacon_gateway_t;
+
+typedef enum {
+    GW_ACCEPTED = 0,
+    GW_NOT_BEACON,        // no PlantPulse manufacturer data in the advert
+    GW_BAD_FRAME,         // PlantPulse company id but wrong length/version
+    GW_UNKNOWN_DEVICE,    // device id not in the key table
+    GW_BAD_TAG,           // signature mismatch
+    GW_REPLAY,            // seq not newer than the last accepted one
+} gw_result_t;
+
+void beacon_gateway_init(beacon_gateway_t *gw);
+void beacon_gateway_free(beacon_gateway_t *gw);
+
+// hostname = 12 hex digits; api_token = the token the device was provisioned with.
+// Returns false on a malformed hostname or out of memory.
+bool beacon_gateway_add_device(beacon_gateway_t *gw, const char *hostname, const char *api_token);
+
+beacon_device_t *beacon_gateway_find(beacon_gateway_t *gw, const char *hostname);
+
+// Ingest one complete advertising payload. On GW_ACCEPTED, *reading and *device are set
+// and the device's last_seq advances.
+gw_result_t beacon_gateway_ingest(beacon_gateway_t *gw, const uint8_t *adv, size_t adv_len,
+                                  beacon_reading_t *reading, const beacon_device_t **device);
+
+const char *gw_result_name(gw_result_t result);
+
+#endif // BEACON_GATEWAY_H
@@ -0,0 +1,233 @@
+// beacon_ingest — decode PlantPulse BLE telemetry beacons on a Linux gateway.
+//
+// Reads one advert per line (live from a scanner on stdin, or replayed from capture
+// files), verifies the signature and sequence number, and prints each accepted reading
+// either as a JSON line or as the same form body the firmware POSTs to /api/esp/data.
+//
+// Line format: "[rx-label ...] <hex>". The last whitespace-separated token is the raw
+// advertising payload (all AD structures) in hex; anything before it is echoed back as
+// "rx" (e.g. a capture timestamp or the peer address). '#' starts a comment line.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "beacon_gateway.h"
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s -k KEYS [-s STATE] [-f json|form] [CAPTURE...]\n"
+            "  -k KEYS   device table, one per line: HOSTNAME<TAB>API_TOKEN[<TAB>SENSOR<TAB>LOCATION]\n"
+            "  -s STATE  last accepted seq per device; loaded at start, rewritten at exit\n"
+            "  -f FMT    json (default) or form (the firmware's POST body)\n"
+            "  CAPTURE   replay files; stdin when none are given\n", argv0);
+}
+
+static void chomp(char *s) {
+    size_t n = strlen(s);
+    while (n > 0 && (s[n - 1] == '\n' || s[n - 1] == '\r')) {
+        s[--n] = '\0';
+    }
+}
+
+static bool load_keys(beacon_gateway_t *gw, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    char line[512];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        chomp(line);
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        char *save = NULL;
+        char *host = strtok_r(line, "\t", &save);
+        char *token = strtok_r(NULL, "\t", &save);
+        char *sensor = strtok_r(NULL, "\t", &save);
+        char *location = strtok_r(NULL, "\t", &save);
+        if (!host || !token || !beacon_gateway_add_device(gw, host, token)) {
+            fprintf(stderr, "%s:%d: bad device line\n", path, lineno);
+            continue;
+        }
+        beacon_device_t *dev = beacon_gateway_find(gw, host);
+        snprintf(dev->sensor, sizeof(dev->sensor), "%s", sensor ? sensor : "");
+        snprintf(dev->location, sizeof(dev->location), "%s", location ? location : "");
+    }
+    fclose(f);
+    return true;
+}
+
+static void load_state(beacon_gateway_t *gw, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return;  // first run
+    }
+    char host[32];
+    unsigned long seq;
+    while (fscanf(f, "%31s %lu", host, &seq) == 2) {
+        beacon_device_t *dev = beacon_gateway_find(gw, host);
+        if (dev) {
+            dev->last_seq = (uint32_t)seq;
+            dev->seen = true;
+        }
+    }
+    fclose(f);
+}
+
+static void save_state(const beacon_gateway_t *gw, const char *path) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", tmp, strerror(errno));
+        return;
+    }
+    for (size_t i = 0; i < gw->count; i++) {
+        if (gw->devices[i].seen) {
+            fprintf(f, "%s %lu\n", gw->devices[i].hostname, (unsigned long)gw->devices[i].last_seq);
+        }
+    }
+    fclose(f);
+    rename(tmp, path);
+}
+
+static size_t parse_hex(const char *hex, uint8_t *out, size_t out_len) {
+    size_t n = 0;
+    while (hex[0] && hex[1] && n < out_len) {
+        unsigned int byte;
+        if (sscanf(hex, "%2x", &byte) != 1) {
+            return 0;
+        }
+        out[n++] = (uint8_t)byte;
+        hex += 2;
+    }
+    return hex[0] ? 0 : n;   // odd digit count or too long -> reject
+}
+
+static void print_form_value(const char *s) {
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == '~') {
+            putchar(c);
+        } else {
+            printf("%%%02X", c);
+        }
+    }
+}
+
+static void emit(const char *fmt, const char *rx, const beacon_device_t *dev, const beacon_reading_t *r) {
+    bool usb = r->power & BEACON_PWR_USB;
+    bool charging = r->power & BEACON_PWR_CHARGING;
+    double soc = r->soc_raw / 256.0;
+    double crate = r->crate_raw * 0.208;
+    if (soc > 100) soc = 100;
+
+    // Same derivation as charge_status_name()/power_source_name() in main/sensor_data/reading_logic.c.
+    const char *charge_status = charging ? "charging" : (crate < -0.5 ? "discharging" : "idle");
+    const char *power_source = usb ? "USB" : (charging ? "Solar" : "Battery");
+
+    if (strcmp(fmt, "form") == 0) {
+        printf("hostname=%s&sensor=", dev->hostname);
+        print_form_value(dev->sensor);
+        printf("&location=");
+        print_form_value(dev->location);
+        printf("&moisture=%u&batt=%.2f&battery_status=%d&charge_status=%s&power_source=%s\n",
+               r->moisture, soc, (r->power & BEACON_PWR_BATT_STATUS) ? 1 : 0,
+               charge_status, power_source);
+    } else {
+        printf("{\"rx\":\"%s\",\"hostname\":\"%s\",\"seq\":%lu,\"moisture\":%u,\"batt\":%.2f,"
+               "\"crate\":%.2f,\"battery_status\":%d,\"charge_status\":\"%s\",\"power_source\":\"%s\"}\n",
+               rx, dev->hostname, (unsigned long)r->seq, r->moisture, soc, crate,
+               (r->power & BEACON_PWR_BATT_STATUS) ? 1 : 0, charge_status, power_source);
+    }
+    fflush(stdout);
+}
+
+static void ingest_stream(beacon_gateway_t *gw, FILE *in, const char *fmt, unsigned long counts[]) {
+    char line[1024];
+    while (fgets(line, sizeof(line), in)) {
+        chomp(line);
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        char *hex = strrchr(line, ' ');
+        char *tab = strrchr(line, '\t');
+        if (tab > hex) hex = tab;
+        const char *rx = "";
+        if (hex) {
+            *hex++ = '\0';
+            rx = line;
+        } else {
+            hex = line;
+        }
+
+        uint8_t adv[64];
+        size_t adv_len = parse_hex(hex, adv, sizeof(adv));
+        beacon_reading_t reading;
+        const beacon_device_t *dev = NULL;
+        gw_result_t res = adv_len ? beacon_gateway_ingest(gw, adv, adv_len, &reading, &dev) : GW_NOT_BEACON;
+        counts[res]++;
+        if (res == GW_ACCEPTED) {
+            emit(fmt, rx, dev, &reading);
+        } else if (res != GW_NOT_BEACON && res != GW_REPLAY) {
+            fprintf(stderr, "rejected (%s): %s %s\n", gw_result_name(res), rx, hex);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *keys = NULL, *state = NULL, *fmt = "json";
+    int opt;
+    while ((opt = getopt(argc, argv, "k:s:f:h")) != -1) {
+        switch (opt) {
+        case 'k': keys = optarg; break;
+        case 's': state = optarg; break;
+        case 'f': fmt = optarg; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (!keys || (strcmp(fmt, "json") != 0 && strcmp(fmt, "form") != 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    beacon_gateway_t gw;
+    beacon_gateway_init(&gw);
+    if (!load_keys(&gw, keys)) {
+        return 1;
+    }
+    if (state) {
+        load_state(&gw, state);
+    }
+
+    unsigned long counts[GW_REPLAY + 1] = {0};
+    if (optind == argc) {
+        ingest_stream(&gw, stdin, fmt, counts);
+    }
+    for (int i = optind; i < argc; i++) {
+        FILE *f = fopen(argv[i], "r");
+        if (!f) {
+            fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+            continue;
+        }
+        ingest_stream(&gw, f, fmt, counts);
+        fclose(f);
+    }
+
+    if (state) {
+        save_state(&gw, state);
+    }
+    fprintf(stderr, "summary:");
+    for (int r = GW_ACCEPTED; r <= GW_REPLAY; r++) {
+        fprintf(stderr, " %s=%lu", gw_result_name((gw_result_t)r), counts[r]);
+    }
+    fprintf(stderr, "\n");
+    beacon_gateway_free(&gw);
+    return 0;
+}
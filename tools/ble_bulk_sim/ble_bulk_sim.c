@@ -0,0 +1,211 @@
+// Host check and airtime model for the BLE bulk backlog transfer.
+//
+// Runs the firmware's sender (main/ble_bulk/bulk_stream.c) against the reference
+// receiver over a simulated connection: connection events every CI, notifications cut
+// into LL PDUs of the negotiated length, the app's ACK write landing one event later.
+// Every run checks that each reading arrives once, in order and unchanged, including
+// across the disconnects requested with -d.
+//
+//   ./ble_bulk_sim [-n readings] [-c ci_ms] [-w window] [-p pdus_per_event] [-d frame]...
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bulk_stream.h"
+
+#define MAX_DISCONNECTS 8
+#define RECONNECT_MS    1500    // advertise + connect + re-encrypt with the bond
+#define T_IFS_US        150
+#define L2CAP_HDR       4
+#define ATT_NOTIFY_HDR  3
+
+typedef struct {
+    const char *name;
+    int phy_mbps;               // 1 or 2
+    uint16_t ll_octets;         // 27 without data length extension, 251 with
+    uint16_t mtu;
+} link_cfg_t;
+
+typedef struct {
+    uint32_t n;
+    uint32_t ci_ms;
+    uint8_t window;
+    uint32_t pdus_per_event;    // 0: as many as fit in the interval
+    uint32_t disconnect_at[MAX_DISCONNECTS];
+    int disconnects;
+} sim_opts_t;
+
+static bulk_record_t *source;   // the device's backlog, seq == index
+
+static bulk_record_t make_record(uint32_t i) {
+    return (bulk_record_t){
+        .taken_at = 1780000000u + i * 600,
+        .moisture = (uint8_t)(20 + i % 60),
+        .power = (uint8_t)(i % 8),
+        .soc_raw = (uint16_t)(0x6400 - i),
+        .crate_raw = (int16_t)(i % 200 - 100),
+    };
+}
+
+// One LL data PDU from the device plus the central's empty PDU back, with the IFS after
+// each. Encrypted link: 4-byte MIC on data PDUs.
+static uint32_t pdu_exchange_us(const link_cfg_t *l, uint32_t payload) {
+    uint32_t preamble = l->phy_mbps == 2 ? 2 : 1;
+    uint32_t data_bits = (preamble + 4 + 2 + payload + 4 + 3) * 8;
+    uint32_t empty_bits = (preamble + 4 + 2 + 3) * 8;
+    return data_bits / l->phy_mbps + T_IFS_US + empty_bits / l->phy_mbps + T_IFS_US;
+}
+
+typedef struct {
+    uint32_t us;
+    uint32_t frames;
+    uint32_t pdus;
+    bool ok;
+} sim_result_t;
+
+static sim_result_t run(const link_cfg_t *l, const sim_opts_t *o) {
+    sim_result_t r = { .ok = true };
+    bulk_tx_t tx;
+    bulk_rx_t rx = { 0 };
+    bulk_record_t got[255];
+    uint32_t received = 0;
+    int next_disconnect = 0;
+
+    bulk_ctrl_t start = { .op = BULK_OP_START, .seq = 0, .window = o->window };
+    bulk_tx_start(&tx, &start, 0, o->n, l->mtu);
+
+    bool pending_ack = false;
+    uint32_t ack_seq = 0;
+    uint64_t t = 0;
+    bool done = false;
+    while (!done) {
+        // The app's ACK written during the last event arrives with this one.
+        if (pending_ack) {
+            bulk_tx_ack(&tx, ack_seq);
+            pending_ack = false;
+        }
+        uint32_t budget = o->ci_ms * 1000, used = 0, pdus = 0;
+        uint32_t first;
+        size_t count;
+        bulk_tx_action_t action;
+        while ((action = bulk_tx_poll(&tx, &first, &count)) != BULK_TX_IDLE) {
+            uint8_t frame[512];
+            size_t len = action == BULK_TX_DATA
+                ? bulk_encode_data(first, &source[first], count, frame, sizeof(frame))
+                : bulk_encode_end(first, 0, frame, sizeof(frame));
+            uint32_t l2cap = (uint32_t)len + ATT_NOTIFY_HDR + L2CAP_HDR;
+            uint32_t frame_pdus = (l2cap + l->ll_octets - 1) / l->ll_octets;
+            uint32_t frame_us = 0;
+            for (uint32_t left = l2cap; left > 0;) {
+                uint32_t chunk = left < l->ll_octets ? left : l->ll_octets;
+                frame_us += pdu_exchange_us(l, chunk);
+                left -= chunk;
+            }
+            if (used + frame_us > budget ||
+                (o->pdus_per_event && pdus + frame_pdus > o->pdus_per_event)) {
+                break;                              // rest waits for the next event
+            }
+            used += frame_us;
+            pdus += frame_pdus;
+            bulk_tx_sent(&tx, action, count);
+            r.frames++;
+            r.pdus += frame_pdus;
+
+            if (next_disconnect < o->disconnects && r.frames == o->disconnect_at[next_disconnect]) {
+                // Link lost with this frame in the air: the device forgets the
+                // transfer; the app reconnects and resumes from what it has.
+                next_disconnect++;
+                t += RECONNECT_MS * 1000;
+                pending_ack = false;
+                start.seq = rx.synced ? rx.expected_seq : 0;
+                bulk_tx_start(&tx, &start, 0, o->n, l->mtu);
+                break;
+            }
+
+            size_t n;
+            bulk_rx_status_t st = bulk_rx_frame(&rx, frame, len, got, 255, &n);
+            if (st == BULK_RX_END) {
+                done = true;
+                break;
+            }
+            if (st != BULK_RX_OK) {
+                fprintf(stderr, "receiver: status %d at seq %u\n", st, rx.expected_seq);
+                r.ok = false;
+                return r;
+            }
+            for (size_t i = 0; i < n; i++, received++) {
+                const bulk_record_t *want = &source[received];
+                if (got[i].taken_at != want->taken_at || got[i].moisture != want->moisture ||
+                    got[i].power != want->power || got[i].soc_raw != want->soc_raw ||
+                    got[i].crate_raw != want->crate_raw) {
+                    fprintf(stderr, "reading %u differs\n", received);
+                    r.ok = false;
+                    return r;
+                }
+            }
+            pending_ack = true;
+            ack_seq = rx.expected_seq;
+        }
+        t += o->ci_ms * 1000;
+    }
+    if (received != o->n) {
+        fprintf(stderr, "received %u of %u readings\n", received, o->n);
+        r.ok = false;
+    }
+    r.us = (uint32_t)t;
+    return r;
+}
+
+int main(int argc, char **argv) {
+    sim_opts_t o = { .n = 5000, .ci_ms = 15, .window = 8 };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:w:p:d:")) != -1) {
+        switch (opt) {
+        case 'n': o.n = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': o.ci_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'w': o.window = (uint8_t)strtoul(optarg, NULL, 0); break;
+        case 'p': o.pdus_per_event = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'd':
+            if (o.disconnects < MAX_DISCONNECTS) {
+                o.disconnect_at[o.disconnects++] = (uint32_t)strtoul(optarg, NULL, 0);
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n readings] [-c ci_ms] [-w window] [-p pdus_per_event] "
+                            "[-d frame]...\n", argv[0]);
+            return 2;
+        }
+    }
+    if (o.n == 0 || o.ci_ms == 0) {
+        fprintf(stderr, "-n and -c must be positive\n");
+        return 2;
+    }
+
+    source = calloc(o.n, sizeof(*source));
+    if (source == NULL) {
+        return 1;
+    }
+    for (uint32_t i = 0; i < o.n; i++) {
+        source[i] = make_record(i);
+    }
+
+    static const link_cfg_t links[] = {
+        { "1M, 27 B PDUs, MTU 23 ", 1, 27, 23 },
+        { "1M, 251 B PDUs, MTU 256", 1, 251, 256 },
+        { "2M, 251 B PDUs, MTU 256", 2, 251, 256 },
+    };
+    printf("%u readings, CI %u ms, window %u frames%s\n", o.n, o.ci_ms, o.window,
+           o.disconnects ? ", with disconnects" : "");
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(links) / sizeof(links[0]); i++) {
+        sim_result_t r = run(&links[i], &o);
+        printf("  %s: %7.2f s  %6.0f readings/s  %5u frames  %6u LL PDUs  %s\n", links[i].name,
+               r.us / 1e6, r.us ? o.n / (r.us / 1e6) : 0.0, r.frames, r.pdus, r.ok ? "ok" : "FAILED");
+        failed |= !r.ok;
+    }
+    free(source);
+    return failed;
+}
@@ -0,0 +1,366 @@
+// Round trips, frames, bytes and an airtime estimate for one reading over CoAP (the
+// "coap" transport, main/coap_link) and over the default HTTPS POST, against local
+// stand-ins:
+//
+//   coap  - UDP to coap_standin. Each wake is one confirmable POST /api/esp/data with
+//           the form body write_reading_form() renders (no hostname/api_token: the DTLS
+//           PSK identity carries them), then, with -b, the backlog as a ts_codec series
+//           to /api/esp/series, split into Block1 transfers of -z bytes like libcoap does.
+//   http  - TCP to tools/fleet_sim's ingest_standin, one POST /api/esp/data with the full
+//           form body, streamed through body_writer.c in its 128-byte writes.
+//
+// The stand-ins don't run DTLS/TLS, so record overhead is added per datagram (DTLS 1.2,
+// AES-128-CCM-8: 13 + 8 + 8 bytes) and per write (TLS 1.2, AES-128-GCM: 5 + 8 + 16 bytes,
+// one record per esp_http_client_write()). Handshakes are left out of every number;
+// the README has their round trips.
+//
+// Airtime model, per 802.11 frame: -o us of fixed cost (preamble, DIFS, mean backoff,
+// SIFS, ACK) plus (IP packet + 36 bytes MAC/LLC/FCS) at -r Mbit/s.
+//
+//   ./coap_compare [-H host] [-c coap_port] [-p http_port] [-n wakes] [-b backlog] [-z block]
+//
+// Prints one "COAP_COMPARE ..." key=value line per transport.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <linux/tcp.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "body_writer.h"
+#include "coap_wire.h"
+#include "data.h"
+#include "ts_codec.h"
+
+#define MAX_WAKES        10000
+#define MAX_BACKLOG      32       // READING_BACKLOG_CAPACITY
+#define UDP_IP_BYTES     28
+#define TCP_IP_BYTES     52       // IPv4 + TCP with timestamps
+#define DTLS_REC_BYTES   29
+#define TLS_REC_BYTES    29
+#define MAC_BYTES        36
+#define ACK_TIMEOUT_MS   2000     // RFC 7252 ACK_TIMEOUT; libcoap's default
+#define MAX_RETRANSMIT   2        // coap_link.c
+
+static struct {
+    const char *host;
+    int coap_port;
+    int http_port;
+    int wakes;
+    int backlog;
+    int block;
+    double phy_mbps;
+    double frame_us;
+} cfg = { "127.0.0.1", 5683, 8080, 50, 0, 256, 6.5, 180.0 };
+
+typedef struct {
+    const char *name;
+    int ok, failed;
+    uint64_t frames, wire_bytes;     // IP packets and their bytes, record overhead included
+    uint64_t round_trips, retransmits;
+    double latency[MAX_WAKES];       // ms from the first packet to the final response
+} side_t;
+
+static const char *hostname = "PPCOMPARE01";
+static const char *token = "compare-token";
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void make_reading(int wake, SensorReading *r) {
+    memset(r, 0, sizeof(*r));
+    r->moisture = 30 + wake % 40;
+    r->battery.soc = 80.0f - (wake % 50) * 0.5f;
+    r->battery.crate = -1.25f;
+    r->battery.status = true;
+}
+
+typedef struct {
+    const SensorReading *reading;
+    bool secured;
+} form_ctx_t;
+
+static void emit_form(body_writer_t *w, void *ctx) {
+    const form_ctx_t *f = ctx;
+    write_reading_form(w, f->reading, f->secured ? NULL : hostname, "Compare Plant", "Bench",
+                       f->secured ? NULL : token);
+}
+
+static int dial(int type, int port) {
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = type }, *ai;
+    if (getaddrinfo(cfg.host, service, &hints, &ai) != 0) {
+        return -1;
+    }
+    int fd = socket(ai->ai_family, ai->ai_socktype, 0);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(ai);
+    return fd;
+}
+
+// ---- CoAP ------------------------------------------------------------------------------
+
+static unsigned szx_for(int block) {
+    unsigned szx = 0;
+    while ((16 << szx) < block && szx < 6) {
+        szx++;
+    }
+    return szx;
+}
+
+static void count_datagram(side_t *s, size_t len) {
+    s->frames++;
+    s->wire_bytes += len + UDP_IP_BYTES + DTLS_REC_BYTES;
+}
+
+// One CON exchange with retransmission; returns the response code or -1.
+static int coap_exchange(int fd, const cw_out_t *req, uint16_t mid, side_t *s) {
+    int timeout = ACK_TIMEOUT_MS;
+    for (int attempt = 0; attempt <= MAX_RETRANSMIT; attempt++, timeout *= 2) {
+        if (attempt > 0) {
+            s->retransmits++;
+        }
+        send(fd, req->buf, req->len, 0);
+        count_datagram(s, req->len);
+        s->round_trips++;
+        double until = now_ms() + timeout;
+        for (;;) {
+            int left = (int)(until - now_ms());
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            if (left <= 0 || poll(&pfd, 1, left) <= 0) {
+                break;
+            }
+            uint8_t buf[CW_MAX_DATAGRAM];
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            cw_msg_t m;
+            if (n <= 0) {
+                break;
+            }
+            count_datagram(s, (size_t)n);
+            if (cw_parse(buf, (size_t)n, &m) && m.type == CW_ACK && m.mid == mid) {
+                return m.code;
+            }
+        }
+    }
+    return -1;
+}
+
+// POST /api/esp/<leaf>, as Block1 transfers when longer than the block size.
+static bool coap_post(int fd, const char *leaf, const char *query, uint16_t format,
+                      const uint8_t *data, size_t len, uint16_t *mid, side_t *s) {
+    static const uint8_t tok[4] = { 0xC0, 0xA9, 0x00, 0x01 };
+    unsigned szx = szx_for(cfg.block);
+    size_t block = (size_t)16 << szx;
+    bool blockwise = len > block;
+    for (uint32_t num = 0; num == 0 || num * block < len; num++) {
+        size_t off = num * block;
+        size_t chunk = len - off < block ? len - off : block;
+        bool more = off + chunk < len;
+        cw_out_t req;
+        cw_begin(&req, CW_CON, CW_POST, ++*mid, tok, sizeof(tok));
+        cw_option(&req, CW_OPT_URI_PATH, "api", 3);
+        cw_option(&req, CW_OPT_URI_PATH, "esp", 3);
+        cw_option(&req, CW_OPT_URI_PATH, leaf, strlen(leaf));
+        cw_option_uint(&req, CW_OPT_CONTENT_FORMAT, format);
+        if (query) {
+            cw_option(&req, CW_OPT_URI_QUERY, query, strlen(query));
+        }
+        if (blockwise) {
+            cw_option_uint(&req, CW_OPT_BLOCK1, cw_block(num, more, szx));
+        }
+        cw_payload(&req, data + off, chunk);
+        int code = coap_exchange(fd, &req, *mid, s);
+        if (code != (more ? CW_CONTINUE : CW_CHANGED) && !(code == CW_CREATED && !more)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool coap_wake(int wake, side_t *s) {
+    static uint16_t mid = 0x1000;
+    SensorReading r;
+    make_reading(wake, &r);
+    form_ctx_t f = { &r, true };
+    char body[1024];
+    size_t blen = body_writer_render(emit_form, &f, body, sizeof(body));
+
+    double t0 = now_ms();
+    int fd = dial(SOCK_DGRAM, cfg.coap_port);
+    if (fd < 0 || blen == 0) {
+        return false;
+    }
+    bool ok = coap_post(fd, "data", NULL, CW_FORMAT_FORM, (const uint8_t *)body, blen, &mid, s);
+    if (ok && cfg.backlog > 0) {
+        ts_sample_t samples[MAX_BACKLOG];
+        uint8_t packed[TS_CODEC_MAX_BYTES(MAX_BACKLOG)];
+        for (int i = 0; i < cfg.backlog; i++) {
+            SensorReading old;
+            PackedReading p;
+            make_reading(wake + i, &old);
+            pack_reading(&old, &p);
+            samples[i] = (ts_sample_t){ .taken_at = 1790000000u + 900u * (uint32_t)i,
+                                        .moisture = p.moisture, .power = p.power,
+                                        .soc_raw = p.soc_raw, .crate_raw = p.crate_raw };
+        }
+        int len = ts_encode(samples, (size_t)cfg.backlog, packed, sizeof(packed));
+        ok = len > 0 && coap_post(fd, "series", NULL, CW_FORMAT_OCTETS, packed, (size_t)len, &mid, s);
+    }
+    s->latency[wake] = now_ms() - t0;
+    close(fd);
+    return ok;
+}
+
+// ---- HTTP ------------------------------------------------------------------------------
+
+struct esp_http_client {
+    int fd;
+    uint64_t records;
+};
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len) {
+    client->records++;
+    return send(client->fd, buffer, (size_t)len, MSG_NOSIGNAL) == len ? len : -1;
+}
+
+static bool http_wake(int wake, side_t *s) {
+    SensorReading r;
+    make_reading(wake, &r);
+    form_ctx_t f = { &r, false };
+
+    double t0 = now_ms();
+    int fd = dial(SOCK_STREAM, cfg.http_port);
+    if (fd < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    size_t blen = body_writer_measure(emit_form, &f);
+    char hdr[256];
+    int hlen = snprintf(hdr, sizeof(hdr),
+                        "POST /api/esp/data? HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n"
+                        "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %zu\r\n\r\n",
+                        cfg.host, blen);
+    struct esp_http_client client = { fd, 0 };
+    bool ok = esp_http_client_write(&client, hdr, hlen) == hlen &&
+              body_writer_send(&client, blen, emit_form, &f);
+    s->round_trips += 2;                 // SYN/SYN-ACK, then request/response
+
+    char resp[512];
+    size_t got = 0, rx = 0;
+    while (ok) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, 3000) <= 0) {
+            ok = false;
+            break;
+        }
+        ssize_t n = recv(fd, resp + got, sizeof(resp) - 1 - got, 0);
+        if (n <= 0) {
+            break;
+        }
+        rx += (size_t)n;
+        got = got + (size_t)n < sizeof(resp) - 1 ? got + (size_t)n : 0;
+    }
+    resp[got] = '\0';
+    s->latency[wake] = now_ms() - t0;
+
+    // Segments so far include the handshake and the server's FIN; our FIN and its ACK
+    // are still to come.
+    struct tcp_info ti;
+    socklen_t tlen = sizeof(ti);
+    memset(&ti, 0, sizeof(ti));
+    getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &tlen);
+    uint64_t segs = (uint64_t)ti.tcpi_segs_out + ti.tcpi_segs_in + 2;
+    s->frames += segs;
+    s->wire_bytes += (uint64_t)hlen + blen + rx + segs * TCP_IP_BYTES +
+                     (client.records + 1) * TLS_REC_BYTES;   // + the response record
+    close(fd);
+    return ok && strncmp(resp, "HTTP/1.1 200", 12) == 0;
+}
+
+// ---- Report ----------------------------------------------------------------------------
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct(double *v, int n, double p) {
+    qsort(v, (size_t)n, sizeof(*v), cmp_double);
+    return v[(int)(p * (n - 1) + 0.5)];
+}
+
+static void run(side_t *s, bool (*wake_fn)(int, side_t *)) {
+    for (int i = 0; i < cfg.wakes; i++) {
+        if (wake_fn(i, s)) {
+            s->ok++;
+        } else {
+            s->failed++;
+        }
+    }
+    double n = cfg.wakes;
+    double frames = s->frames / n, bytes = s->wire_bytes / n;
+    double airtime_us = frames * (cfg.frame_us + MAC_BYTES * 8 / cfg.phy_mbps) + bytes * 8 / cfg.phy_mbps;
+    printf("COAP_COMPARE transport=%s ok=%d failed=%d round_trips=%.2f frames=%.2f wire_bytes=%.1f "
+           "airtime_us=%.0f retransmits=%llu latency_p50_ms=%.2f latency_p99_ms=%.2f\n",
+           s->name, s->ok, s->failed, s->round_trips / n, frames, bytes, airtime_us,
+           (unsigned long long)s->retransmits, pct(s->latency, cfg.wakes, 0.5),
+           pct(s->latency, cfg.wakes, 0.99));
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-H host] [-c coap_port] [-p http_port] [-n wakes] [-b backlog] [-z block]\n"
+            "          [-r phy_mbps] [-o frame_us]\n"
+            "  -c  coap_standin port (default 5683); 0 skips CoAP\n"
+            "  -p  ingest_standin port (default 8080); 0 skips HTTP\n"
+            "  -n  wakes per transport (default 50, max %d)\n"
+            "  -b  backlog readings sent as a series after each CoAP reading (default 0, max %d)\n"
+            "  -z  Block1 size, 16..1024 (default 256, coap_link.c)\n"
+            "  -r  PHY rate for the airtime estimate, Mbit/s (default 6.5, HT MCS0)\n"
+            "  -o  fixed cost per frame, us (default 180)\n",
+            prog, MAX_WAKES, MAX_BACKLOG);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "H:c:p:n:b:z:r:o:h")) != -1) {
+        switch (opt) {
+        case 'H': cfg.host = optarg; break;
+        case 'c': cfg.coap_port = atoi(optarg); break;
+        case 'p': cfg.http_port = atoi(optarg); break;
+        case 'n': cfg.wakes = atoi(optarg); break;
+        case 'b': cfg.backlog = atoi(optarg); break;
+        case 'z': cfg.block = atoi(optarg); break;
+        case 'r': cfg.phy_mbps = atof(optarg); break;
+        case 'o': cfg.frame_us = atof(optarg); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (cfg.wakes <= 0 || cfg.wakes > MAX_WAKES || cfg.backlog < 0 || cfg.backlog > MAX_BACKLOG ||
+        cfg.block < 16 || cfg.block > 1024 || cfg.phy_mbps <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    static side_t coap = { .name = "coap" }, http = { .name = "http" };
+    if (cfg.coap_port > 0) {
+        run(&coap, coap_wake);
+    }
+    if (cfg.http_port > 0) {
+        run(&http, http_wake);
+    }
+    return coap.failed || http.failed ? 1 : 0;
+}
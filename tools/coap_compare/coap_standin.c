@@ -0,0 +1,181 @@
+// Local CoAP stand-in for the "coap" transport (main/coap_link): accepts the
+// confirmable POSTs to /api/esp/data and /api/esp/series, reassembles Block1
+// transfers, and answers with piggybacked ACKs (2.31 Continue per block, 2.04 at the
+// end). Series bodies are decoded with the firmware's ts_codec.c so a broken block
+// reassembly shows up as a failed decode. Duplicate CONs (lost ACKs) get the cached
+// response again, as RFC 7252 requires.
+//
+// Plain CoAP over UDP, like ingest_standin leaves out TLS. For DTLS-PSK interop with
+// the device itself, use libcoap's coap-server (see README). -l drops that percentage
+// of incoming datagrams to exercise retransmission.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "coap_wire.h"
+#include "ts_codec.h"
+
+#define BODY_MAX  4096
+
+static struct {
+    int port;
+    int loss_pct;
+} cfg = { 5683, 0 };
+
+static struct {
+    uint64_t in, out, dropped, duplicates, bad;
+    uint64_t readings, series, series_readings, blocks;
+} st;
+
+// One transfer at a time, from one peer: the stand-in serves a single test client.
+static struct {
+    struct sockaddr_in peer;
+    uint16_t last_mid;
+    bool have_last;
+    cw_out_t last_resp;
+    uint8_t body[BODY_MAX];
+    size_t body_len;
+    uint32_t next_block;
+} xfer;
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static uint8_t finish(const cw_msg_t *m) {
+    if (strcmp(m->path, "api/esp/data") == 0) {
+        xfer.body[xfer.body_len < BODY_MAX ? xfer.body_len : BODY_MAX - 1] = '\0';
+        if (!strstr((const char *)xfer.body, "moisture=")) {
+            return CW_BAD_REQUEST;
+        }
+        st.readings++;
+        return CW_CHANGED;
+    }
+    if (strcmp(m->path, "api/esp/series") == 0) {
+        ts_sample_t samples[512];
+        int n = ts_decode(xfer.body, xfer.body_len, samples, 512);
+        if (n < 0) {
+            return CW_BAD_REQUEST;
+        }
+        st.series++;
+        st.series_readings += (uint64_t)n;
+        return CW_CHANGED;
+    }
+    return CW_NOT_FOUND;
+}
+
+static void handle(int fd, const struct sockaddr_in *from, const uint8_t *in, size_t len) {
+    cw_msg_t m;
+    if (!cw_parse(in, len, &m) || m.type != CW_CON || m.code != CW_POST) {
+        st.bad++;
+        return;
+    }
+    bool same_peer = memcmp(&xfer.peer, from, sizeof(*from)) == 0;
+    if (same_peer && xfer.have_last && m.mid == xfer.last_mid) {
+        st.duplicates++;
+        sendto(fd, xfer.last_resp.buf, xfer.last_resp.len, 0, (const struct sockaddr *)from, sizeof(*from));
+        st.out++;
+        return;
+    }
+    if (!same_peer) {
+        xfer.peer = *from;
+        xfer.body_len = 0;
+        xfer.next_block = 0;
+    }
+
+    cw_out_t *r = &xfer.last_resp;
+    uint8_t code;
+    uint32_t num = 0, szx = 0;
+    bool more = false;
+    if (m.block1 >= 0) {
+        num = (uint32_t)m.block1 >> 4;
+        more = (m.block1 & 8) != 0;
+        szx = (uint32_t)m.block1 & 7;
+        st.blocks++;
+    }
+    if (num == 0) {
+        xfer.body_len = 0;
+        xfer.next_block = 0;
+    }
+    if (num != xfer.next_block || xfer.body_len + m.payload_len > BODY_MAX) {
+        code = CW_INCOMPLETE;
+        xfer.next_block = 0;
+    } else {
+        memcpy(xfer.body + xfer.body_len, m.payload, m.payload_len);
+        xfer.body_len += m.payload_len;
+        xfer.next_block++;
+        code = more ? CW_CONTINUE : finish(&m);
+    }
+    cw_begin(r, CW_ACK, code, m.mid, m.token, m.tkl);
+    if (m.block1 >= 0 && (code == CW_CONTINUE || code == CW_CHANGED)) {
+        cw_option_uint(r, CW_OPT_BLOCK1, cw_block(num, more, szx));
+    }
+    xfer.last_mid = m.mid;
+    xfer.have_last = true;
+    sendto(fd, r->buf, r->len, 0, (const struct sockaddr *)from, sizeof(*from));
+    st.out++;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-p port] [-l loss_pct]\n"
+            "  -p  UDP port on 127.0.0.1 (default 5683)\n"
+            "  -l  drop this %% of incoming datagrams (default 0)\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:l:h")) != -1) {
+        switch (opt) {
+        case 'p': cfg.port = atoi(optarg); break;
+        case 'l': cfg.loss_pct = atoi(optarg); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)cfg.port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("bind");
+        return 1;
+    }
+    struct sigaction sa = { .sa_handler = on_signal };   // no SA_RESTART: recvfrom returns
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    srand(1);
+    fprintf(stderr, "coap_standin: 127.0.0.1:%d loss=%d%%\n", cfg.port, cfg.loss_pct);
+
+    uint8_t buf[CW_MAX_DATAGRAM];
+    while (!stop) {
+        struct sockaddr_in from;
+        socklen_t flen = sizeof(from);
+        ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &flen);
+        if (n <= 0) {
+            continue;
+        }
+        st.in++;
+        if (rand() % 100 < cfg.loss_pct) {
+            st.dropped++;
+            continue;
+        }
+        handle(fd, &from, buf, (size_t)n);
+    }
+    printf("COAP_STANDIN in=%llu out=%llu dropped=%llu duplicates=%llu bad=%llu readings=%llu "
+           "series=%llu series_readings=%llu blocks=%llu\n",
+           (unsigned long long)st.in, (unsigned long long)st.out, (unsigned long long)st.dropped,
+           (unsigned long long)st.duplicates, (unsigned long long)st.bad,
+           (unsigned long long)st.readings, (unsigned long long)st.series,
+           (unsigned long long)st.series_readings, (unsigned long long)st.blocks);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <string.h>
+#include "coap_wire.h"
+
+void cw_begin(cw_out_t *o, uint8_t type, uint8_t code, uint16_t mid, const uint8_t *token, uint8_t tkl) {
+    o->buf[0] = (uint8_t)(1 << 6 | type << 4 | tkl);
+    o->buf[1] = code;
+    o->buf[2] = mid >> 8;
+    o->buf[3] = mid & 0xFF;
+    memcpy(o->buf + 4, token, tkl);
+    o->len = 4 + tkl;
+    o->last_opt = 0;
+}
+
+// Delta and length nibbles: < 13 inline, then one extra byte (13), then two (14).
+static uint8_t nibble(uint32_t v, uint8_t *ext, size_t *ext_len) {
+    if (v < 13) {
+        return (uint8_t)v;
+    }
+    if (v < 269) {
+        ext[(*ext_len)++] = (uint8_t)(v - 13);
+        return 13;
+    }
+    v -= 269;
+    ext[(*ext_len)++] = (uint8_t)(v >> 8);
+    ext[(*ext_len)++] = (uint8_t)v;
+    return 14;
+}
+
+void cw_option(cw_out_t *o, uint16_t num, const void *value, size_t len) {
+    uint8_t ext[4];
+    size_t ext_len = 0;
+    uint8_t d = nibble(num - o->last_opt, ext, &ext_len);
+    uint8_t l = nibble((uint32_t)len, ext, &ext_len);
+    o->buf[o->len++] = (uint8_t)(d << 4 | l);
+    memcpy(o->buf + o->len, ext, ext_len);
+    o->len += ext_len;
+    memcpy(o->buf + o->len, value, len);
+    o->len += len;
+    o->last_opt = num;
+}
+
+void cw_option_uint(cw_out_t *o, uint16_t num, uint32_t value) {
+    uint8_t b[4];
+    size_t n = 0;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        if (n > 0 || (value >> shift) != 0) {
+            b[n++] = (uint8_t)(value >> shift);
+        }
+    }
+    cw_option(o, num, b, n);   // zero is the empty value
+}
+
+void cw_payload(cw_out_t *o, const void *data, size_t len) {
+    if (len > 0) {
+        o->buf[o->len++] = 0xFF;
+        memcpy(o->buf + o->len, data, len);
+        o->len += len;
+    }
+}
+
+static bool read_ext(const uint8_t **p, const uint8_t *end, uint32_t *v) {
+    if (*v == 13) {
+        if (*p >= end) return false;
+        *v = 13 + *(*p)++;
+    } else if (*v == 14) {
+        if (end - *p < 2) return false;
+        *v = 269 + ((*p)[0] << 8 | (*p)[1]);
+        *p += 2;
+    } else if (*v == 15) {
+        return false;
+    }
+    return true;
+}
+
+static void append(char *dst, size_t cap, const uint8_t *s, size_t len, bool slash) {
+    size_t at = strlen(dst);
+    if (slash && at + 1 < cap) {
+        dst[at++] = '/';
+    }
+    for (size_t i = 0; i < len && at + 1 < cap; i++) {
+        dst[at++] = (char)s[i];
+    }
+    dst[at] = '\0';
+}
+
+bool cw_parse(const uint8_t *in, size_t len, cw_msg_t *m) {
+    memset(m, 0, sizeof(*m));
+    m->format = -1;
+    m->block1 = -1;
+    if (len < 4 || in[0] >> 6 != 1 || (in[0] & 0x0F) > 8 || len < 4u + (in[0] & 0x0F)) {
+        return false;
+    }
+    m->type = (in[0] >> 4) & 3;
+    m->tkl = in[0] & 0x0F;
+    m->code = in[1];
+    m->mid = (uint16_t)(in[2] << 8 | in[3]);
+    memcpy(m->token, in + 4, m->tkl);
+
+    const uint8_t *p = in + 4 + m->tkl, *end = in + len;
+    uint32_t num = 0;
+    while (p < end && *p != 0xFF) {
+        uint32_t delta = *p >> 4, olen = *p & 0x0F;
+        p++;
+        if (!read_ext(&p, end, &delta) || !read_ext(&p, end, &olen) || (size_t)(end - p) < olen) {
+            return false;
+        }
+        num += delta;
+        uint32_t v = 0;
+        for (uint32_t i = 0; i < olen && i < 4; i++) {
+            v = v << 8 | p[i];
+        }
+        if (num == CW_OPT_URI_PATH) {
+            append(m->path, sizeof(m->path), p, olen, m->path[0] != '\0');
+        } else if (num == CW_OPT_URI_QUERY && m->query[0] == '\0') {
+            append(m->query, sizeof(m->query), p, olen, false);
+        } else if (num == CW_OPT_CONTENT_FORMAT) {
+            m->format = (int32_t)v;
+        } else if (num == CW_OPT_BLOCK1) {
+            m->block1 = v;
+        }
+        p += olen;
+    }
+    if (p < end) {
+        if (++p == end) {
+            return false;      // marker without payload
+        }
+        m->payload = p;
+        m->payload_len = (size_t)(end - p);
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef COAP_WIRE_H
+#define COAP_WIRE_H
+
+// Just enough RFC 7252 / RFC 7959 framing for coap_compare and coap_standin: the
+// header, delta-encoded options, and Block1. The device itself uses libcoap.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CW_CON  0
+#define CW_NON  1
+#define CW_ACK  2
+#define CW_RST  3
+
+#define CW_POST          0x02
+#define CW_CREATED       0x41   // 2.01
+#define CW_CHANGED       0x44   // 2.04
+#define CW_CONTINUE      0x5F   // 2.31
+#define CW_BAD_REQUEST   0x80   // 4.00
+#define CW_NOT_FOUND     0x84   // 4.04
+#define CW_INCOMPLETE    0x88   // 4.08
+
+#define CW_OPT_URI_PATH        11
+#define CW_OPT_CONTENT_FORMAT  12
+#define CW_OPT_URI_QUERY       15
+#define CW_OPT_BLOCK1          27
+
+#define CW_FORMAT_OCTETS  42
+#define CW_FORMAT_FORM    65000   // coap_link.c: x-www-form-urlencoded
+
+#define CW_MAX_DATAGRAM  1152
+
+typedef struct {
+    uint8_t buf[CW_MAX_DATAGRAM];
+    size_t len;
+    uint16_t last_opt;
+} cw_out_t;
+
+void cw_begin(cw_out_t *o, uint8_t type, uint8_t code, uint16_t mid, const uint8_t *token, uint8_t tkl);
+void cw_option(cw_out_t *o, uint16_t num, const void *value, size_t len);   // ascending num only
+void cw_option_uint(cw_out_t *o, uint16_t num, uint32_t value);
+void cw_payload(cw_out_t *o, const void *data, size_t len);
+
+// Block1 option value: block number, more flag, size exponent (bytes = 16 << szx).
+static inline uint32_t cw_block(uint32_t num, bool more, unsigned szx) {
+    return num << 4 | (more ? 8u : 0u) | szx;
+}
+
+typedef struct {
+    uint8_t type, code, tkl;
+    uint16_t mid;
+    uint8_t token[8];
+    char path[64];            // Uri-Path segments joined with '/'
+    char query[64];           // first Uri-Query
+    int32_t format;           // -1 if absent
+    int64_t block1;           // -1 if absent
+    const uint8_t *payload;
+    size_t payload_len;
+} cw_msg_t;
+
+bool cw_parse(const uint8_t *in, size_t len, cw_msg_t *m);
+
+#endif // COAP_WIRE_H
@@ -0,0 +1,831 @@
+// Host checks and microbenchmarks for the device's data path: probe calibration,
+// MAX17048 register scaling, charge/power labels, reading pack/unpack, the upload form
+// body, NVS defaulting and sequence reservation, the fuel gauge's alert registers (over a
+// mock I2C bus), the ESP-NOW gateway queue, the wake state machine, the sleep= field,
+// (with libmbedcrypto) the ESP-NOW frame and (with cJSON) the provisioning JSON parse.
+// Built from the firmware's own reading_logic.c, body_writer.c, nvs_drv.c, max17048.c,
+// espnow_queue.c, wake_fsm.c, sleep_totals.c, espnow_frame.c and json_arena.c against
+// the stand-ins in mock/.
+//
+//   ./data_bench [iterations]
+//
+// Prints one "DATA_CHECK ..." line per group and one "DATA_BENCH ..." line per
+// operation; exits non-zero if any check fails.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "data.h"
+#include "reading_logic.h"
+#include "max17048.h"
+#include "body_writer.h"
+#include "nvs_drv.h"
+#include "nvs.h"   // mock/: nvs_mock_reset(), nvs_mock_fail_open(), nvs_mock_fail_commit()
+#include "espnow_queue.h"
+#include "wake_fsm.h"
+#include "sleep_mgr.h"
+#ifndef DATA_BENCH_NO_CCM
+#include "mbedtls/ccm.h"
+#endif
+#ifndef DATA_BENCH_NO_JSON
+#include "cJSON.h"
+#include "json_arena.h"
+#endif
+
+// ---- Allocation counting (GNU ld --wrap, see Makefile) -------------------------------
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+static unsigned long heap_allocs;
+
+void *__wrap_malloc(size_t size) { heap_allocs++; return __real_malloc(size); }
+void *__wrap_calloc(size_t n, size_t size) { heap_allocs++; return __real_calloc(n, size); }
+void *__wrap_realloc(void *ptr, size_t size) { heap_allocs++; return __real_realloc(ptr, size); }
+
+// ---- esp_http_client_write() sink ----------------------------------------------------
+
+static char captured[2048];
+static size_t captured_len;
+static int max_chunk = 1 << 30;   // short writes exercise body_writer's retry loop
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len) {
+    (void)client;
+    if (len > max_chunk) {
+        len = max_chunk;
+    }
+    if (captured_len + (size_t)len < sizeof(captured)) {
+        memcpy(captured + captured_len, buffer, len);
+    }
+    captured_len += len;
+    return len;
+}
+
+#define SINK ((esp_http_client_handle_t)1)
+
+// ---- Checks --------------------------------------------------------------------------
+
+static int failures;
+static int group_failures;
+
+#define CHECK(cond) do { if (!(cond)) { group_failures++; \
+    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+
+static void group_done(const char *name) {
+    printf("DATA_CHECK group=%s failures=%d\n", name, group_failures);
+    failures += group_failures;
+    group_failures = 0;
+}
+
+static bool near(float a, float b) {
+    return fabsf(a - b) < 1e-3f;
+}
+
+static void check_calibration(void) {
+    CHECK(map(5, 3, 3, 7, 9) == 7);                      // empty input range
+    CHECK(map(50, 0, 100, 0, 10) == 5);
+    CHECK(moisture_percent(MOISTURE_ADC_DRY) == 0);
+    CHECK(moisture_percent(MOISTURE_ADC_WET) == 100);
+    CHECK(moisture_percent(2865) == 50);
+    CHECK(moisture_percent(4000) == -27);                // drier than calibration: not clamped here
+    CHECK(moisture_percent(2000) == 108);
+    group_done("calibration");
+}
+
+static void check_registers(void) {
+    CHECK(near(max17048_soc_percent(0x6400), 100.0f));
+    CHECK(near(max17048_soc_percent(0x0080), 0.5f));
+    CHECK(near(max17048_soc_percent(0xFFFF), 255.99609f));
+    CHECK(near(max17048_crate_percent(0x0001), 0.208f));
+    CHECK(near(max17048_crate_percent(0xFFFF), -0.208f));        // sign bit honoured
+    CHECK(fabsf(max17048_crate_percent(0x8000) + 6815.744f) < 0.01f);
+    CHECK(fabsf(max17048_crate_percent(0x7FFF) - 6815.536f) < 0.01f);
+    CHECK(near(max17048_vcell_volts(0xD000), 4.16f));
+    CHECK(near(max17048_vcell_volts(0xD00F), 4.16f));            // low nibble ignored
+    group_done("registers");
+}
+
+static void check_labels(void) {
+    static const struct {
+        bool charging, usb;
+        float crate;
+        const char *status, *source;
+    } cases[] = {
+        { true,  false,  5.0f, "charging",    "Solar"   },
+        { true,  true,  -3.0f, "charging",    "USB"     },   // STAT wins over the rate
+        { false, true,  -0.6f, "discharging", "USB"     },
+        { false, false, -0.5f, "idle",        "Battery" },   // tiebreak is strictly < -0.5
+        { false, false,  0.0f, "idle",        "Battery" },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        SensorReading r = { .charging = cases[i].charging, .usb_present = cases[i].usb,
+                            .battery = { .crate = cases[i].crate } };
+        CHECK(strcmp(charge_status_name(&r), cases[i].status) == 0);
+        CHECK(strcmp(power_source_name(&r), cases[i].source) == 0);
+    }
+    group_done("labels");
+}
+
+// Every register value survives unpack -> pack, which is what the backlog relies on.
+static void check_pack(void) {
+    for (uint32_t raw = 0; raw <= 0xFFFF; raw++) {
+        PackedReading in = { .moisture = raw % 101, .power = raw & 0x07,
+                             .soc_raw = (uint16_t)raw, .crate_raw = (int16_t)raw };
+        PackedReading out;
+        SensorReading r;
+        unpack_reading(&in, &r);
+        pack_reading(&r, &out);
+        if (memcmp(&in, &out, sizeof(in)) != 0) {
+            fprintf(stderr, "pack: raw 0x%04X comes back as soc 0x%04X crate %d\n", (unsigned)raw,
+                    out.soc_raw, out.crate_raw);
+            CHECK(memcmp(&in, &out, sizeof(in)) == 0);
+            break;
+        }
+    }
+    SensorReading r = { .moisture = 140, .battery = { .soc = -1.0f } };
+    PackedReading p;
+    pack_reading(&r, &p);
+    CHECK(p.moisture == 100 && p.soc_raw == 0);
+    r.moisture = -5;
+    pack_reading(&r, &p);
+    CHECK(p.moisture == 0);
+    group_done("pack");
+}
+
+typedef struct {
+    SensorReading reading;
+    const char *hostname, *name, *location, *token;
+} form_ctx_t;
+
+static void emit_form(body_writer_t *w, void *ctx) {
+    const form_ctx_t *f = ctx;
+    write_reading_form(w, &f->reading, f->hostname, f->name, f->location, f->token);
+}
+
+static void emit_sleep(body_writer_t *w, void *ctx) {
+    sleep_totals_write(w, ctx);
+}
+
+static const form_ctx_t sample_form = {
+    .reading = { .moisture = 150, .battery = { .soc = 87.5f, .status = true, .crate = -1.2f } },
+    .hostname = "A0B1C2D3E4F5", .name = "Basil & Mint", .location = "Kitchen/Window ü",
+    .token = "t0k+n=1",
+};
+
+static void check_form(void) {
+    static const char expected[] =
+        "api_token=t0k%2Bn%3D1&hostname=A0B1C2D3E4F5&sensor=Basil%20%26%20Mint"
+        "&location=Kitchen%2FWindow%20%C3%BC&moisture=100&batt=87.50&battery_status=1"
+        "&charge_status=discharging&power_source=Battery";
+    for (int chunk = 1; chunk <= 64; chunk *= 4) {
+        size_t len = body_writer_measure(emit_form, (void *)&sample_form);
+        captured_len = 0;
+        max_chunk = chunk;
+        CHECK(body_writer_send(SINK, len, emit_form, (void *)&sample_form));
+        CHECK(len == strlen(expected) && captured_len == len);
+        CHECK(memcmp(captured, expected, strlen(expected)) == 0);
+    }
+    max_chunk = 1 << 30;
+
+    // A value far longer than the 128-byte write buffer still goes out whole.
+    char longname[1000];
+    memset(longname, '&', sizeof(longname) - 1);
+    longname[sizeof(longname) - 1] = '\0';
+    form_ctx_t big = sample_form;
+    big.name = longname;
+    size_t len = body_writer_measure(emit_form, &big);
+    captured_len = 0;
+    CHECK(body_writer_send(SINK, len, emit_form, &big));
+    CHECK(captured_len == len && len > 3 * (sizeof(longname) - 1));
+
+    // sleep=: even the shortest value is longer than bw_form_fmt()'s buffer, and the
+    // longest must still arrive whole, durations included.
+    static const struct {
+        sleep_totals_t totals;
+        const char *body;
+    } sleep_cases[] = {
+        { { .wakes = { [SLEEP_WAKE_TIMER] = 1 } },
+          "sleep=n%3A1%2Ctimer%3A1%2Cbutton%3A0%2Calert%3A0%2Cusb%3A0%2Creset%3A0%2Cother%3A0"
+          "%2Cawake_ms%3A0%2Casleep_s%3A0" },
+        { { .wakes = { 400000000, 400000000, 400000000, 400000000, 400000000, 400000000 },
+            .awake_ms = 4294967295u, .asleep_s = 4294967295u },
+          "sleep=n%3A2400000000%2Ctimer%3A400000000%2Cbutton%3A400000000%2Calert%3A400000000"
+          "%2Cusb%3A400000000%2Creset%3A400000000%2Cother%3A400000000"
+          "%2Cawake_ms%3A4294967295%2Casleep_s%3A4294967295" },
+        { { .awake_ms = 5 }, "" },            // no wake counted yet: no field
+    };
+    for (size_t i = 0; i < sizeof(sleep_cases) / sizeof(sleep_cases[0]); i++) {
+        len = body_writer_measure(emit_sleep, (void *)&sleep_cases[i].totals);
+        captured_len = 0;
+        CHECK(body_writer_send(SINK, len, emit_sleep, (void *)&sleep_cases[i].totals));
+        CHECK(len == strlen(sleep_cases[i].body) && captured_len == len);
+        CHECK(memcmp(captured, sleep_cases[i].body, len) == 0);
+    }
+    group_done("form");
+}
+
+static void check_nvs(void) {
+    espnow_config_t cfg;
+    nvs_mock_reset();
+    CHECK(nvs_get_sleep_seconds() == DEFAULT_SLEEP_SECONDS);
+    CHECK(nvs_get_wake_budget_ms() == DEFAULT_WAKE_BUDGET_MS);
+    CHECK(nvs_get_sample_seconds() == 0);
+    CHECK(nvs_get_usb_check_seconds() == 0);   // wake-stub slicing is opt-in
+    CHECK(nvs_get_reprovision_after() == DEFAULT_REPROVISION_AFTER);
+    CHECK(nvs_get_transport() == TRANSPORT_HTTPS);
+    CHECK(nvs_get_espnow_config(&cfg) == ESP_ERR_NVS_NOT_FOUND);
+
+    nvs_set_sleep_seconds(0);                  // 0 is "unset" for the interval...
+    CHECK(nvs_get_sleep_seconds() == DEFAULT_SLEEP_SECONDS);
+    nvs_set_reprovision_after(0);              // ...but a real value for reprovisioning
+    CHECK(nvs_get_reprovision_after() == 0);
+    nvs_set_sleep_seconds(3600);
+    nvs_set_transport(TRANSPORT_ESPNOW);
+    CHECK(nvs_get_sleep_seconds() == 3600);
+    CHECK(nvs_get_transport() == TRANSPORT_ESPNOW);
+
+    nvs_mock_fail_open(true);                  // erased partition: defaults, no crash
+    CHECK(nvs_get_sleep_seconds() == DEFAULT_SLEEP_SECONDS);
+    CHECK(nvs_get_transport() == TRANSPORT_HTTPS);
+    nvs_mock_fail_open(false);
+
+    CHECK(transport_from_name("https") == TRANSPORT_HTTPS);
+    CHECK(transport_from_name("espnow_gateway") == TRANSPORT_ESPNOW_GATEWAY);
+    CHECK(transport_from_name("HTTPS") == -1);
+
+    // A cold boot (RTC copy lost) continues above the last reserved block.
+    nvs_mock_reset();
+    rtc_sequence_t seq = { 0 };
+    CHECK(sequence_next(&seq, "seq") == 1);
+    rtc_sequence_t cold = { 0 };
+    CHECK(sequence_next(&cold, "seq") > seq.value);
+
+    // A block that can't be committed hands out nothing, and the RTC copy doesn't
+    // advance: a later cold boot must not be able to issue the same values again.
+    rtc_sequence_t used = cold;
+    used.value = used.limit;                   // block used up: the next call reserves
+    rtc_sequence_t before = used;
+    nvs_mock_fail_commit(true);
+    CHECK(sequence_next(&used, "seq") == 0);
+    CHECK(used.value == before.value && used.limit == before.limit);
+    nvs_mock_fail_commit(false);
+    nvs_mock_fail_open(true);
+    CHECK(sequence_next(&used, "seq") == 0);
+    nvs_mock_fail_open(false);
+    CHECK(sequence_next(&used, "seq") > before.value);
+    rtc_sequence_t after_loss = { 0 };         // RTC lost: above the whole reserved block
+    CHECK(sequence_next(&after_loss, "seq") > used.limit);
+
+    // Long-press factory reset: erase_nvs_data() wipes "storage", the restart loses the
+    // RTC copy. The counter must keep rising, or the same key sees old nonces again.
+    nvs_mock_reset();
+    rtc_sequence_t node = { 0 };
+    uint32_t last = 0;
+    for (int i = 0; i < 300; i++) {            // into the second reserved block
+        last = sequence_next(&node, "espnow_seq");
+    }
+    rtc_sequence_t beacon = { 0 };             // the beacon's counter, reserved alongside
+    uint32_t beacon_last = sequence_next(&beacon, "beacon_seq");
+    nvs_handle_t h;
+    CHECK(nvs_open("storage", NVS_READWRITE, &h) == ESP_OK);
+    nvs_set_u32(h, "sleep_secs", 60);
+    CHECK(nvs_erase_all(h) == ESP_OK);
+    nvs_commit(h);
+    nvs_close(h);
+    rtc_sequence_t reset = { 0 };
+    CHECK(sequence_next(&reset, "espnow_seq") > last);
+    CHECK(sequence_next(&reset, "espnow_seq") > last + 1);
+    rtc_sequence_t beacon_reset = { 0 };
+    CHECK(sequence_next(&beacon_reset, "beacon_seq") > beacon_last);
+
+    // A mark left in "storage" by firmware from before the move is still honoured.
+    nvs_mock_reset();
+    CHECK(nvs_open("storage", NVS_READWRITE, &h) == ESP_OK);
+    nvs_set_u32(h, "espnow_seq", 5000);
+    nvs_close(h);
+    rtc_sequence_t upgraded = { 0 };
+    CHECK(sequence_next(&upgraded, "espnow_seq") > 5000);
+    group_done("nvs");
+}
+
+// A MAX17048 as registers, with just enough behaviour for the alert logic: STATUS bits
+// and CONFIG.ALRT latch, and a VALRT.MIN above VCELL sets VL again on every "sample".
+typedef struct {
+    uint16_t reg[256];
+    int writes;
+    int fail_at;              // fail the n-th transaction (1-based), 0 = never
+    int transactions;
+} gauge_mock_t;
+
+static int gauge_read(void *ctx, uint8_t reg, uint16_t *value) {
+    gauge_mock_t *g = ctx;
+    if (++g->transactions == g->fail_at) {
+        return -1;
+    }
+    *value = g->reg[reg];
+    return 0;
+}
+
+static int gauge_write(void *ctx, uint8_t reg, uint16_t value) {
+    gauge_mock_t *g = ctx;
+    if (++g->transactions == g->fail_at) {
+        return -1;
+    }
+    g->reg[reg] = value;
+    g->writes++;
+    return 0;
+}
+
+static void gauge_power_on(gauge_mock_t *g, uint16_t vcell_mv) {
+    memset(g, 0, sizeof(*g));
+    g->reg[MAX17048_REG_VCELL] = (uint16_t)(vcell_mv * 4 / 5) << 4;
+    g->reg[MAX17048_REG_CONFIG] = 0x971C;    // datasheet defaults
+    g->reg[MAX17048_REG_VALRT] = 0x00FF;
+    g->reg[MAX17048_REG_HIBRT] = 0x8030;
+    g->reg[MAX17048_REG_STATUS] = 0x0100;    // RI
+}
+
+static void gauge_sample(gauge_mock_t *g) {
+    uint32_t vcell_mv = (g->reg[MAX17048_REG_VCELL] >> 4) * 5 / 4;
+    if ((g->reg[MAX17048_REG_VALRT] >> 8) * 20u > vcell_mv) {
+        g->reg[MAX17048_REG_STATUS] |= (uint16_t)MAX17048_ALERT_VLOW << 8;
+        g->reg[MAX17048_REG_CONFIG] |= 0x0020;
+    }
+}
+
+static void check_fuel_gauge(void) {
+    const max17048_alert_cfg_t cfg = {
+        .empty_pct = 10, .low_mv = 3400, .rearm_mv = 3600, .hib_thr = 0x30, .act_thr = 0xF0,
+    };
+    gauge_mock_t g;
+    max17048_bus_t bus = { gauge_read, gauge_write, &g };
+    uint8_t alerts;
+
+    CHECK(max17048_config_value(0x971C, &cfg) == 0x9716);            // ATHD = 32 - 10
+    CHECK(max17048_config_value(0x97FF, &cfg) == 0x9736);            // SLEEP, ALSC off; ALRT kept
+    max17048_alert_cfg_t edge = cfg;
+    edge.empty_pct = 0;
+    CHECK((max17048_config_value(0, &edge) & 0x1F) == 31);           // clamped to 1 %
+    edge.empty_pct = 40;
+    CHECK((max17048_config_value(0, &edge) & 0x1F) == 0);            // clamped to 32 %
+    CHECK(max17048_valrt_value(&cfg, 3900) == 0xAAFF);               // 3400 / 20 = 170
+    CHECK(max17048_valrt_value(&cfg, 3500) == 0x00FF);               // below re-arm: off
+    edge = cfg;
+    edge.low_mv = 0;
+    CHECK(max17048_valrt_value(&edge, 4200) == 0x00FF);
+    CHECK(max17048_hibrt_value(&cfg) == 0x30F0);   // HibThr high byte, ActThr low
+
+    // Fresh gauge: everything programmed once, then nothing to do.
+    gauge_power_on(&g, 3900);
+    CHECK(max17048_configure(&bus, &cfg) == 3);
+    CHECK(g.reg[MAX17048_REG_CONFIG] == 0x9716 && g.reg[MAX17048_REG_VALRT] == 0xAAFF &&
+          g.reg[MAX17048_REG_HIBRT] == 0x30F0);
+    CHECK(max17048_configure(&bus, &cfg) == 0);
+    CHECK(max17048_take_alerts(&bus, &alerts) == 0 && alerts == MAX17048_ALERT_RESET);
+    CHECK(g.reg[MAX17048_REG_STATUS] == 0);
+    g.writes = 0;
+    CHECK(max17048_take_alerts(&bus, &alerts) == 0 && alerts == 0 && g.writes == 0);
+
+    // Empty alert: status and the ALRT latch both cleared, RCOMP untouched.
+    g.reg[MAX17048_REG_STATUS] = (uint16_t)MAX17048_ALERT_EMPTY << 8;
+    g.reg[MAX17048_REG_CONFIG] |= 0x0020;
+    CHECK(max17048_take_alerts(&bus, &alerts) == 0 && alerts == MAX17048_ALERT_EMPTY);
+    CHECK(g.reg[MAX17048_REG_STATUS] == 0 && g.reg[MAX17048_REG_CONFIG] == 0x9716);
+
+    // Low voltage: VL would latch again on the next sample, so configure disarms it
+    // first and the clear sticks. It comes back once the cell has recovered.
+    g.reg[MAX17048_REG_VCELL] = (uint16_t)(3350 * 4 / 5) << 4;
+    gauge_sample(&g);
+    CHECK(max17048_configure(&bus, &cfg) == 1 && g.reg[MAX17048_REG_VALRT] == 0x00FF);
+    CHECK(max17048_take_alerts(&bus, &alerts) == 0 && alerts == MAX17048_ALERT_VLOW);
+    gauge_sample(&g);
+    CHECK(g.reg[MAX17048_REG_STATUS] == 0 && (g.reg[MAX17048_REG_CONFIG] & 0x0020) == 0);
+    g.reg[MAX17048_REG_VCELL] = (uint16_t)(3500 * 4 / 5) << 4;       // between low and re-arm
+    CHECK(max17048_configure(&bus, &cfg) == 0);
+    g.reg[MAX17048_REG_VCELL] = (uint16_t)(3700 * 4 / 5) << 4;
+    CHECK(max17048_configure(&bus, &cfg) == 1 && g.reg[MAX17048_REG_VALRT] == 0xAAFF);
+
+    // Bus errors surface as -1 at every step, never as a half-written success.
+    for (int fail = 1; fail <= 7; fail++) {
+        gauge_power_on(&g, 3900);
+        g.fail_at = fail;
+        CHECK(max17048_configure(&bus, &cfg) == -1);
+    }
+    gauge_power_on(&g, 3900);
+    g.reg[MAX17048_REG_CONFIG] |= 0x0020;
+    for (int fail = 1; fail <= 4; fail++) {
+        g.transactions = 0;
+        g.fail_at = fail;
+        g.reg[MAX17048_REG_STATUS] = 0x0100;
+        CHECK(max17048_take_alerts(&bus, &alerts) == -1);
+    }
+    g.fail_at = 0;
+    g.reg[MAX17048_REG_MODE] = 0x1000;
+    CHECK(max17048_hibernating(&bus));
+    g.transactions = 0;
+    g.fail_at = 1;
+    CHECK(!max17048_hibernating(&bus));
+    group_done("fuel_gauge");
+}
+
+// ESP-NOW gateway queue: per-node duplicate rejection, eviction of the oldest reading
+// and of the stalest node, and what a flush may drop after a partly rejected batch.
+static void queue_push_seq(espnow_queue_t *q, uint8_t node, uint32_t seq, bool *accepted) {
+    uint8_t mac[6] = { 0x24, 0x6F, 0x28, 0, 0, node };
+    espnow_reading_t r = { .seq = seq, .moisture = (uint8_t)seq };
+    *accepted = espnow_queue_push(q, mac, &r);
+}
+
+static void check_espnow_queue(void) {
+    static espnow_queue_t q;
+    bool ok;
+    espnow_queue_init(&q);
+
+    queue_push_seq(&q, 1, 10, &ok);
+    CHECK(ok);
+    queue_push_seq(&q, 1, 10, &ok);            // link-layer retry of the same frame
+    CHECK(!ok);
+    queue_push_seq(&q, 1, 9, &ok);             // replayed older frame
+    CHECK(!ok);
+    queue_push_seq(&q, 2, 1, &ok);             // another node's seq space
+    CHECK(ok);
+    queue_push_seq(&q, 1, 11, &ok);
+    CHECK(ok);
+    CHECK(espnow_queue_count(&q) == 3 && q.duplicates == 2);
+    CHECK(espnow_queue_peek(&q, 0)->reading.seq == 10 && espnow_queue_peek(&q, 2)->reading.seq == 11);
+    CHECK(espnow_queue_peek(&q, 3) == NULL);
+
+    // Full queue: the oldest reading goes, the freshest is kept.
+    espnow_queue_init(&q);
+    for (uint32_t s = 1; s <= ESPNOW_QUEUE_CAPACITY + 5; s++) {
+        queue_push_seq(&q, 1, s, &ok);
+    }
+    CHECK(espnow_queue_count(&q) == ESPNOW_QUEUE_CAPACITY && q.evicted == 5);
+    CHECK(espnow_queue_peek(&q, 0)->reading.seq == 6);
+    espnow_queue_drop(&q, 3);
+    CHECK(espnow_queue_peek(&q, 0)->reading.seq == 9);
+    espnow_queue_drop(&q, 1000);
+    CHECK(espnow_queue_count(&q) == 0);
+
+    // Node table full: the node heard from least recently is forgotten, the others keep
+    // rejecting their duplicates.
+    espnow_queue_init(&q);
+    for (int node = 0; node <= ESPNOW_MAX_NODES; node++) {
+        queue_push_seq(&q, (uint8_t)node, 5, &ok);
+    }
+    queue_push_seq(&q, 1, 5, &ok);
+    CHECK(!ok);
+    queue_push_seq(&q, 0, 5, &ok);             // evicted: its replay is taken once
+    CHECK(ok);
+
+    // Flush accounting. Only the leading run of 200s counts as delivered.
+    int all_ok[4] = { 200, 200, 200, 200 };
+    int mid_fail[4] = { 200, 500, 200, 200 };
+    int first_fail[4] = { 400, 200, 200, 200 };
+    CHECK(espnow_batch_delivered(all_ok, 4) == 4);
+    CHECK(espnow_batch_delivered(all_ok, 2) == 2);       // connection lost after two
+    CHECK(espnow_batch_delivered(mid_fail, 4) == 1);
+    CHECK(espnow_batch_delivered(first_fail, 4) == 0);
+    CHECK(espnow_batch_delivered(all_ok, 0) == 0);
+
+    espnow_queue_init(&q);
+    for (uint32_t s = 1; s <= 6; s++) {
+        queue_push_seq(&q, 1, s, &ok);
+    }
+    CHECK(espnow_queue_settle(&q, espnow_batch_delivered(mid_fail, 4), 0) == 1);
+    CHECK(espnow_queue_count(&q) == 5 && espnow_queue_peek(&q, 0)->reading.seq == 2);
+    CHECK(espnow_queue_settle(&q, espnow_batch_delivered(first_fail, 4), 0) == 0);
+    CHECK(espnow_queue_peek(&q, 0)->reading.seq == 2);
+    // Two of the batch were evicted from the front while it was in flight: of three
+    // delivered, only the one still queued is dropped.
+    CHECK(espnow_queue_settle(&q, 3, 2) == 1);
+    CHECK(espnow_queue_peek(&q, 0)->reading.seq == 3);
+    CHECK(espnow_queue_settle(&q, 2, 5) == 0);
+    CHECK(espnow_queue_settle(&q, 100, 0) == 4 && espnow_queue_count(&q) == 0);
+    group_done("espnow_queue");
+}
+
+// Wake state machine: every (state, event) pair under every input combination against
+// the edge list below, which is written out independently of wake_fsm.c. Anything not
+// listed must leave the state where it is.
+typedef enum { FSM_ANY, FSM_PROVISION, FSM_UPDATE } fsm_input_t;
+
+static const struct {
+    wake_state_t from;
+    wake_event_t event;
+    fsm_input_t input;
+    wake_state_t to, to_if_not;         // to_if_not: the input is false (FSM_ANY: unused)
+} fsm_edges[] = {
+    { WAKE_ST_BOOT,         WAKE_EV_DONE,          FSM_ANY,       WAKE_ST_SENSE,        0 },
+    { WAKE_ST_SENSE,        WAKE_EV_DONE,          FSM_ANY,       WAKE_ST_CONNECT,      0 },
+    { WAKE_ST_SENSE,        WAKE_EV_TIMEOUT,       FSM_ANY,       WAKE_ST_CONNECT,      0 },
+    { WAKE_ST_SENSE,        WAKE_EV_UNCHANGED,     FSM_ANY,       WAKE_ST_SLEEP,        0 },
+    { WAKE_ST_CONNECT,      WAKE_EV_WIFI_UP,       FSM_ANY,       WAKE_ST_SYNC,         0 },
+    { WAKE_ST_CONNECT,      WAKE_EV_WIFI_FAILED,   FSM_PROVISION, WAKE_ST_PROVISION,    WAKE_ST_SLEEP },
+    { WAKE_ST_CONNECT,      WAKE_EV_TIMEOUT,       FSM_PROVISION, WAKE_ST_PROVISION,    WAKE_ST_SLEEP },
+    { WAKE_ST_SYNC,         WAKE_EV_TIME_SYNCED,   FSM_UPDATE,    WAKE_ST_UPDATE_CHECK, WAKE_ST_UPLOAD },
+    { WAKE_ST_SYNC,         WAKE_EV_TIMEOUT,       FSM_UPDATE,    WAKE_ST_UPDATE_CHECK, WAKE_ST_UPLOAD },
+    { WAKE_ST_UPDATE_CHECK, WAKE_EV_DONE,          FSM_ANY,       WAKE_ST_UPLOAD,       0 },
+    { WAKE_ST_UPDATE_CHECK, WAKE_EV_TIMEOUT,       FSM_ANY,       WAKE_ST_UPLOAD,       0 },
+    { WAKE_ST_UPLOAD,       WAKE_EV_UPLOAD_OK,     FSM_ANY,       WAKE_ST_SLEEP,        0 },
+    { WAKE_ST_UPLOAD,       WAKE_EV_UPLOAD_FAILED, FSM_ANY,       WAKE_ST_SLEEP,        0 },
+    { WAKE_ST_UPLOAD,       WAKE_EV_TIMEOUT,       FSM_ANY,       WAKE_ST_SLEEP,        0 },
+};
+
+static wake_state_t fsm_expected(wake_state_t from, wake_event_t event, const wake_fsm_inputs_t *in) {
+    for (size_t i = 0; i < sizeof(fsm_edges) / sizeof(fsm_edges[0]); i++) {
+        if (fsm_edges[i].from != from || fsm_edges[i].event != event) {
+            continue;
+        }
+        bool taken = fsm_edges[i].input == FSM_ANY ||
+                     (fsm_edges[i].input == FSM_PROVISION ? in->provision : in->update_check);
+        return taken ? fsm_edges[i].to : fsm_edges[i].to_if_not;
+    }
+    return from;
+}
+
+// Feeds events from BOOT; returns the state reached.
+static wake_state_t fsm_walk(const wake_event_t *events, size_t n, wake_fsm_inputs_t in) {
+    wake_state_t st = WAKE_ST_BOOT;
+    for (size_t i = 0; i < n; i++) {
+        st = wake_fsm_next(st, events[i], &in);
+    }
+    return st;
+}
+
+static void check_wake_fsm(void) {
+    for (int bits = 0; bits < 4; bits++) {
+        wake_fsm_inputs_t in = { .provision = bits & 1, .update_check = bits & 2 };
+        for (wake_state_t st = 0; st < WAKE_ST_COUNT; st++) {
+            for (wake_event_t ev = 0; ev < WAKE_EV_COUNT; ev++) {
+                wake_state_t got = wake_fsm_next(st, ev, &in);
+                CHECK(got == fsm_expected(st, ev, &in));
+                // Terminal states absorb everything: a late WIFI_UP mustn't restart a wake
+                // that went to provisioning or sleep.
+                CHECK(!wake_fsm_is_terminal(st) || got == st);
+                // upload_ok only ever means something in UPLOAD, so the USB stream, which
+                // runs in SLEEP after an upload_ok, can't follow a skipped or failed upload.
+                CHECK(ev != WAKE_EV_UPLOAD_OK || st == WAKE_ST_UPLOAD || got == st);
+            }
+        }
+    }
+    CHECK(wake_fsm_is_terminal(WAKE_ST_PROVISION) && wake_fsm_is_terminal(WAKE_ST_SLEEP));
+    CHECK(wake_fsm_is_terminal(WAKE_ST_COUNT));
+    for (wake_state_t st = 0; st < WAKE_ST_PROVISION; st++) {
+        CHECK(!wake_fsm_is_terminal(st));
+        CHECK(strcmp(wake_state_name(st), "?") != 0);
+    }
+    for (wake_event_t ev = 0; ev < WAKE_EV_COUNT; ev++) {
+        CHECK(strcmp(wake_event_name(ev), "?") != 0);
+    }
+    CHECK(strcmp(wake_state_name(WAKE_ST_COUNT), "?") == 0);
+    CHECK(strcmp(wake_event_name(WAKE_EV_COUNT), "?") == 0);
+
+    // No waiting state can hang: its own timeout (BOOT: its done) reaches a terminal state.
+    for (int bits = 0; bits < 4; bits++) {
+        wake_fsm_inputs_t in = { .provision = bits & 1, .update_check = bits & 2 };
+        for (wake_state_t st = 0; st < WAKE_ST_COUNT; st++) {
+            wake_state_t s = st;
+            for (int step = 0; step < WAKE_ST_COUNT && !wake_fsm_is_terminal(s); step++) {
+                s = wake_fsm_next(s, s == WAKE_ST_BOOT ? WAKE_EV_DONE : WAKE_EV_TIMEOUT, &in);
+            }
+            CHECK(wake_fsm_is_terminal(s));
+        }
+    }
+
+    // Whole wakes.
+    const wake_fsm_inputs_t plain = { 0 }, provision = { .provision = true },
+                            update = { .update_check = true };
+    const wake_event_t full[] = { WAKE_EV_DONE, WAKE_EV_DONE, WAKE_EV_WIFI_UP, WAKE_EV_TIME_SYNCED,
+                                  WAKE_EV_DONE, WAKE_EV_UPLOAD_OK };
+    CHECK(fsm_walk(full, 5, update) == WAKE_ST_UPLOAD);
+    CHECK(fsm_walk(full, 6, update) == WAKE_ST_SLEEP);
+    CHECK(fsm_walk(full, 4, plain) == WAKE_ST_UPLOAD);   // no update check: SYNC -> UPLOAD
+    const wake_event_t unchanged[] = { WAKE_EV_DONE, WAKE_EV_UNCHANGED, WAKE_EV_WIFI_UP };
+    CHECK(fsm_walk(unchanged, 3, plain) == WAKE_ST_SLEEP);
+
+    // A failed connect opens provisioning only when the link policy asks for it;
+    // otherwise the wake sleeps and enter_deep_sleep() applies the backoff.
+    const wake_event_t no_wifi[] = { WAKE_EV_DONE, WAKE_EV_DONE, WAKE_EV_WIFI_FAILED,
+                                     WAKE_EV_WIFI_UP, WAKE_EV_TIME_SYNCED };
+    CHECK(fsm_walk(no_wifi, 5, provision) == WAKE_ST_PROVISION);
+    CHECK(fsm_walk(no_wifi, 5, plain) == WAKE_ST_SLEEP);
+    const wake_event_t connect_timeout[] = { WAKE_EV_DONE, WAKE_EV_TIMEOUT, WAKE_EV_TIMEOUT };
+    CHECK(fsm_walk(connect_timeout, 3, provision) == WAKE_ST_PROVISION);   // sensor slow too
+    CHECK(fsm_walk(connect_timeout, 3, plain) == WAKE_ST_SLEEP);
+
+    // A failed upload still sleeps, and a late Wi-Fi event during it doesn't provision.
+    const wake_event_t upload_fail[] = { WAKE_EV_DONE, WAKE_EV_DONE, WAKE_EV_WIFI_UP, WAKE_EV_TIMEOUT,
+                                         WAKE_EV_WIFI_FAILED, WAKE_EV_TIME_SYNCED, WAKE_EV_UPLOAD_FAILED };
+    CHECK(fsm_walk(upload_fail, 6, provision) == WAKE_ST_UPLOAD);
+    CHECK(fsm_walk(upload_fail, 7, provision) == WAKE_ST_SLEEP);
+    group_done("wake_fsm");
+}
+
+#ifndef DATA_BENCH_NO_CCM
+// ESP-NOW frame: header layout, AES-CCM under the documented nonce and AAD (checked
+// with the library directly, not through espnow_frame_open()), and every rejection.
+static void check_espnow_frame(void) {
+    const uint8_t key[ESPNOW_KEY_LEN] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                          0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+    const uint8_t mac[6] = { 0x24, 0x6F, 0x28, 0xAA, 0xBB, 0xCC };
+    espnow_reading_t in = {
+        .seq = 0x01020304, .power = 0x05, .moisture = 42, .soc_raw = 0x4B80, .crate_raw = -3,
+        .name = "Basil", .location = "Kitchen", .api_token = "tok-0001",
+    };
+    uint8_t frame[ESPNOW_FRAME_MAX_LEN];
+    size_t len = espnow_frame_seal(&in, mac, key, frame, sizeof(frame));
+    size_t body_len = 6 + (1 + 5) + (1 + 7) + (1 + 8);
+    CHECK(len == ESPNOW_FRAME_HDR_LEN + body_len + ESPNOW_FRAME_TAG_LEN);
+    CHECK(frame[0] == ESPNOW_FRAME_MAGIC && frame[1] == ESPNOW_FRAME_VERSION);
+    CHECK(frame[2] == 0x04 && frame[3] == 0x03 && frame[4] == 0x02 && frame[5] == 0x01);
+    CHECK(espnow_frame_seal(&in, mac, key, frame, len - 1) == 0);
+
+    // Nonce = MAC | seq LE | 0 0 0, AAD = the 6 header bytes, tag after the ciphertext.
+    uint8_t nonce[13] = { 0x24, 0x6F, 0x28, 0xAA, 0xBB, 0xCC, 0x04, 0x03, 0x02, 0x01, 0, 0, 0 };
+    uint8_t body[ESPNOW_FRAME_MAX_LEN];
+    mbedtls_ccm_context ccm;
+    mbedtls_ccm_init(&ccm);
+    int rc = mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, 128);
+    if (rc == 0) {
+        rc = mbedtls_ccm_auth_decrypt(&ccm, body_len, nonce, sizeof(nonce), frame,
+                                      ESPNOW_FRAME_HDR_LEN, frame + ESPNOW_FRAME_HDR_LEN, body,
+                                      frame + ESPNOW_FRAME_HDR_LEN + body_len, ESPNOW_FRAME_TAG_LEN);
+    }
+    mbedtls_ccm_free(&ccm);
+    CHECK(rc == 0);
+    CHECK(rc == 0 && body[0] == 0x05 && body[1] == 42 && body[2] == 0x80 && body[3] == 0x4B &&
+          body[4] == 0xFD && body[5] == 0xFF && body[6] == 5 && memcmp(&body[7], "Basil", 5) == 0);
+
+    espnow_reading_t out;
+    CHECK(espnow_frame_open(frame, len, mac, key, &out) == ESPNOW_FRAME_OK);
+    CHECK(out.seq == in.seq && out.power == in.power && out.moisture == in.moisture &&
+          out.soc_raw == in.soc_raw && out.crate_raw == in.crate_raw &&
+          strcmp(out.name, "Basil") == 0 && strcmp(out.location, "Kitchen") == 0 &&
+          strcmp(out.api_token, "tok-0001") == 0);
+
+    // Same reading, next seq: a fresh nonce, so nothing of the ciphertext repeats.
+    uint8_t next[ESPNOW_FRAME_MAX_LEN];
+    espnow_reading_t in2 = in;
+    in2.seq++;
+    CHECK(espnow_frame_seal(&in2, mac, key, next, sizeof(next)) == len);
+    CHECK(memcmp(next + ESPNOW_FRAME_HDR_LEN, frame + ESPNOW_FRAME_HDR_LEN, 16) != 0);
+
+    uint8_t other_key[ESPNOW_KEY_LEN] = { 0 };
+    uint8_t other_mac[6] = { 0x24, 0x6F, 0x28, 0xAA, 0xBB, 0xCD };
+    CHECK(espnow_frame_open(frame, len, mac, other_key, &out) == ESPNOW_FRAME_ERR_AUTH);
+    CHECK(espnow_frame_open(frame, len, other_mac, key, &out) == ESPNOW_FRAME_ERR_AUTH);
+    uint8_t bad[ESPNOW_FRAME_MAX_LEN];
+    size_t flip[] = { 2, ESPNOW_FRAME_HDR_LEN, len - 1 };    // seq (AAD), ciphertext, tag
+    for (size_t i = 0; i < sizeof(flip) / sizeof(flip[0]); i++) {
+        memcpy(bad, frame, len);
+        bad[flip[i]] ^= 0x01;
+        CHECK(espnow_frame_open(bad, len, mac, key, &out) == ESPNOW_FRAME_ERR_AUTH);
+    }
+    memcpy(bad, frame, len);
+    bad[0] ^= 0xFF;
+    CHECK(espnow_frame_open(bad, len, mac, key, &out) == ESPNOW_FRAME_ERR_HEADER);
+    bad[0] = ESPNOW_FRAME_MAGIC;
+    bad[1] = ESPNOW_FRAME_VERSION + 1;
+    CHECK(espnow_frame_open(bad, len, mac, key, &out) == ESPNOW_FRAME_ERR_HEADER);
+    CHECK(espnow_frame_open(frame, ESPNOW_FRAME_HDR_LEN + ESPNOW_FRAME_TAG_LEN - 1, mac, key, &out) ==
+          ESPNOW_FRAME_ERR_LEN);
+    CHECK(espnow_frame_open(frame, len - 1, mac, key, &out) == ESPNOW_FRAME_ERR_AUTH);
+
+    // Longest strings: cut to the field size, frame still within ESP-NOW's 250 bytes.
+    memset(in.name, 'n', sizeof(in.name));
+    memset(in.location, 'l', sizeof(in.location));
+    memset(in.api_token, 't', sizeof(in.api_token));
+    len = espnow_frame_seal(&in, mac, key, frame, sizeof(frame));
+    CHECK(len > 0 && len <= ESPNOW_FRAME_MAX_LEN);
+    CHECK(espnow_frame_open(frame, len, mac, key, &out) == ESPNOW_FRAME_OK &&
+          strlen(out.name) == sizeof(out.name) - 1 && strlen(out.api_token) == sizeof(out.api_token) - 1);
+    group_done("espnow_frame");
+}
+#endif
+
+// ---- Benchmarks ----------------------------------------------------------------------
+
+static volatile int sink_int;
+static volatile float sink_float;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *op, double t0, int iterations, unsigned long allocs0) {
+    printf("DATA_BENCH op=%s iterations=%d ns_per_op=%.1f allocs_per_op=%.2f\n", op, iterations,
+           (now_ns() - t0) / iterations, (double)(heap_allocs - allocs0) / iterations);
+}
+
+static void bench_form(int iterations) {
+    unsigned long a0 = heap_allocs;
+    double t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        size_t len = body_writer_measure(emit_form, (void *)&sample_form);
+        captured_len = 0;
+        body_writer_send(SINK, len, emit_form, (void *)&sample_form);
+    }
+    report("form_body", t0, iterations, a0);
+}
+
+static void bench_calibration(int iterations) {
+    unsigned long a0 = heap_allocs;
+    double t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        sink_int = moisture_percent(2000 + (i & 2047));
+    }
+    report("moisture_map", t0, iterations, a0);
+
+    a0 = heap_allocs;
+    t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        sink_float = max17048_soc_percent((uint16_t)i) + max17048_crate_percent((uint16_t)(i * 7));
+    }
+    report("fuel_gauge_scale", t0, iterations, a0);
+
+    a0 = heap_allocs;
+    t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        PackedReading in = { .moisture = i % 101, .soc_raw = (uint16_t)i, .crate_raw = (int16_t)i }, out;
+        SensorReading r;
+        unpack_reading(&in, &r);
+        pack_reading(&r, &out);
+        sink_int = out.soc_raw;
+    }
+    report("pack_unpack", t0, iterations, a0);
+}
+
+#ifndef DATA_BENCH_NO_JSON
+static const char provision_doc[] =
+    "{\"ssid\":\"Rodland Farms 2.4\",\"password\":\"correct horse battery staple\","
+    "\"sensor_name\":\"Basil & Mint\",\"sensor_location\":\"Kitchen window\","
+    "\"api_token\":\"0f3c9a1e5b7d4c2a8e6f0b1d3c5a7e9f0f3c9a1e5b7d4c2a8e6f0b1d3c5a7e9f\","
+    "\"sleep_seconds\":28800,\"transport\":\"https\"}";
+
+// The provisioning path's shape: parse, look the fields up, drop the tree.
+static int parse_provision(void) {
+    cJSON *root = cJSON_Parse(provision_doc);
+    if (root == NULL) {
+        return -1;
+    }
+    int found = 0;
+    static const char *const keys[] = { "ssid", "password", "sensor_name", "sensor_location",
+                                        "api_token", "sleep_seconds", "transport" };
+    for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+        found += cJSON_GetObjectItem(root, keys[k]) != NULL;
+    }
+    cJSON_Delete(root);
+    return found;
+}
+
+static void bench_json(int iterations) {
+    CHECK(parse_provision() == 7);
+    unsigned long a0 = heap_allocs;
+    double t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        sink_int = parse_provision();
+    }
+    report("json_provision_malloc", t0, iterations, a0);
+
+    a0 = heap_allocs;
+    t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        json_arena_begin();
+        sink_int = parse_provision();
+        json_arena_end(NULL);
+    }
+    report("json_provision_arena", t0, iterations, a0);
+    group_done("json");
+}
+#endif
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    if (iterations <= 0) {
+        iterations = 1;
+    }
+    check_calibration();
+    check_registers();
+    check_labels();
+    check_pack();
+    check_form();
+    check_nvs();
+    check_fuel_gauge();
+    check_espnow_queue();
+    check_wake_fsm();
+#ifndef DATA_BENCH_NO_CCM
+    check_espnow_frame();
+#endif
+
+    bench_form(iterations);
+    bench_calibration(iterations);
+#ifndef DATA_BENCH_NO_JSON
+    bench_json(iterations);
+#endif
+    return failures ? 1 : 0;
+}
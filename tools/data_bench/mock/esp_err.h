@@ -0,0 +1,19 @@
+// Host stand-in for ESP-IDF's esp_err.h: just what nvs_drv.c and body_writer.c use.
+#ifndef ESP_ERR_H_MOCK
+#define ESP_ERR_H_MOCK
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                      0
+#define ESP_FAIL                    -1
+#define ESP_ERR_NVS_BASE            0x1100
+#define ESP_ERR_NVS_NOT_FOUND       (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH  (ESP_ERR_NVS_BASE + 0x0c)
+
+static inline const char *esp_err_to_name(esp_err_t err) {
+    return err == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+#endif
@@ -0,0 +1,10 @@
+// Host stand-in: body_writer.c only needs the handle type and write(). data_bench.c
+// provides esp_http_client_write() as a capture/discard sink.
+#ifndef ESP_HTTP_CLIENT_H_MOCK
+#define ESP_HTTP_CLIENT_H_MOCK
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len);
+
+#endif
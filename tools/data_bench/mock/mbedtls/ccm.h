@@ -0,0 +1,33 @@
+// Host stand-in for mbedtls/ccm.h: declares only the AES-CCM calls espnow_frame.c makes,
+// so the checks run against the system's libmbedcrypto (2.28 or 3.x, same signatures)
+// without its development headers. The context is opaque here and deliberately larger
+// than either version's real struct; only pointers to it cross the library boundary.
+#ifndef MBEDTLS_CCM_H_MOCK
+#define MBEDTLS_CCM_H_MOCK
+
+#include <stddef.h>
+
+typedef enum {
+    MBEDTLS_CIPHER_ID_AES = 2,   // same value in mbedtls 2.x and 3.x
+} mbedtls_cipher_id_t;
+
+typedef struct {
+    _Alignas(16) unsigned char opaque[1024];
+} mbedtls_ccm_context;
+
+void mbedtls_ccm_init(mbedtls_ccm_context *ctx);
+void mbedtls_ccm_free(mbedtls_ccm_context *ctx);
+int mbedtls_ccm_setkey(mbedtls_ccm_context *ctx, mbedtls_cipher_id_t cipher,
+                       const unsigned char *key, unsigned int keybits);
+int mbedtls_ccm_encrypt_and_tag(mbedtls_ccm_context *ctx, size_t length,
+                                const unsigned char *iv, size_t iv_len,
+                                const unsigned char *add, size_t add_len,
+                                const unsigned char *input, unsigned char *output,
+                                unsigned char *tag, size_t tag_len);
+int mbedtls_ccm_auth_decrypt(mbedtls_ccm_context *ctx, size_t length,
+                             const unsigned char *iv, size_t iv_len,
+                             const unsigned char *add, size_t add_len,
+                             const unsigned char *input, unsigned char *output,
+                             const unsigned char *tag, size_t tag_len);
+
+#endif
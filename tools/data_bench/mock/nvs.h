@@ -0,0 +1,33 @@
+// Host stand-in for ESP-IDF NVS: an in-memory key store per namespace, enough for
+// nvs_drv.c and the factory reset's nvs_erase_all(). nvs_mock_reset() empties it; nvs_mock_fail_open() makes nvs_open() fail
+// the way it does on an erased/uninitialised partition; nvs_mock_fail_commit() makes
+// nvs_commit() fail the way it does on a full or worn-out partition.
+#ifndef NVS_H_MOCK
+#define NVS_H_MOCK
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out_handle);
+void      nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out);
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value);
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out, size_t *length);
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+
+void nvs_mock_reset(void);
+void nvs_mock_fail_open(bool fail);
+void nvs_mock_fail_commit(bool fail);
+
+#endif
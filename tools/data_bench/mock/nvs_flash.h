@@ -0,0 +1 @@
+#include "nvs.h"
@@ -0,0 +1,143 @@
+#include <string.h>
+#include "nvs.h"
+
+#define MOCK_KEYS       32
+#define MOCK_VALUE      128
+#define MOCK_NAMESPACES 4
+
+typedef struct {
+    nvs_handle_t ns;          // namespace, as the handle nvs_open() returned for it
+    char key[16];
+    size_t len;
+    uint8_t value[MOCK_VALUE];
+} entry_t;
+
+static entry_t entries[MOCK_KEYS];
+static size_t count;
+static char namespaces[MOCK_NAMESPACES][16];
+static size_t ns_count;
+static bool fail_open;
+static bool fail_commit;
+
+void nvs_mock_reset(void) {
+    count = 0;
+    ns_count = 0;
+    fail_open = false;
+    fail_commit = false;
+}
+
+void nvs_mock_fail_open(bool fail) {
+    fail_open = fail;
+}
+
+void nvs_mock_fail_commit(bool fail) {
+    fail_commit = fail;
+}
+
+static entry_t *find(nvs_handle_t ns, const char *key) {
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].ns == ns && strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t put(nvs_handle_t ns, const char *key, const void *value, size_t len) {
+    entry_t *e = find(ns, key);
+    if (e == NULL) {
+        if (count == MOCK_KEYS) {
+            return ESP_FAIL;
+        }
+        e = &entries[count++];
+        e->ns = ns;
+        strncpy(e->key, key, sizeof(e->key) - 1);
+        e->key[sizeof(e->key) - 1] = '\0';
+    }
+    if (len > MOCK_VALUE) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(e->value, value, len);
+    e->len = len;
+    return ESP_OK;
+}
+
+static esp_err_t get(nvs_handle_t ns, const char *key, void *out, size_t len) {
+    entry_t *e = find(ns, key);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (e->len != len) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out, e->value, len);
+    return ESP_OK;
+}
+
+// The handle is the namespace's 1-based index; namespaces are created on first open.
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out_handle) {
+    (void)mode;
+    if (fail_open) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    size_t i = 0;
+    while (i < ns_count && strcmp(namespaces[i], name) != 0) {
+        i++;
+    }
+    if (i == ns_count) {
+        if (ns_count == MOCK_NAMESPACES) {
+            return ESP_FAIL;
+        }
+        strncpy(namespaces[i], name, sizeof(namespaces[i]) - 1);
+        namespaces[i][sizeof(namespaces[i]) - 1] = '\0';
+        ns_count++;
+    }
+    *out_handle = (nvs_handle_t)(i + 1);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].ns != handle) {
+            entries[kept++] = entries[i];
+        }
+    }
+    count = kept;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) { (void)handle; }
+esp_err_t nvs_commit(nvs_handle_t handle) { (void)handle; return fail_commit ? ESP_FAIL : ESP_OK; }
+
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out) { return get(h, key, out, 1); }
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t v) { return put(h, key, &v, 1); }
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out) { return get(h, key, out, 4); }
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t v) { return put(h, key, &v, 4); }
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *length) {
+    entry_t *e = find(h, key);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out != NULL) {
+        if (*length < e->len) {
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        memcpy(out, e->value, e->len);
+    }
+    *length = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value) {
+    return put(h, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *length) {
+    return nvs_get_str(h, key, out, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t length) {
+    return put(h, key, value, length);
+}
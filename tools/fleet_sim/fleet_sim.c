@@ -0,0 +1,434 @@
+// Fleet traffic simulator: N virtual PlantPulse sensors, each replaying the request
+// sequence of one firmware wake against a local server (normally ingest_standin):
+//
+//   wake -> Wi-Fi/DHCP/SNTP (-b)  -> GET /firmware.json        (check_update, 3 s timeout)
+//        -> POST /api/esp/data     (uploadReadings: up to 3 attempts, 8 s timeout each,
+//                                   1.5 s then 3 s backoff, success only on HTTP 200)
+//        -> deep sleep for the interval +/- RTC jitter, repeat.
+//
+// One epoll loop drives every device, so thousands fit in one process. Reports request
+// rate (mean and peak 1 s window), latency percentiles per request type, and retry
+// amplification (POSTs on the wire per reading).
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "sim_common.h"
+
+// Firmware constants this simulator mirrors (keep in step with main.c / data.c).
+#define GET_TIMEOUT_MS      3000    // check_update(): http_config.timeout_ms
+#define POST_TIMEOUT_MS     8000    // POST(): config.timeout_ms
+#define POST_MAX_ATTEMPTS   3       // uploadReadings(): MAX_ATTEMPTS
+#define POST_BACKOFF_MS     1500    // uploadReadings(): 1500 * attempt
+
+#define RX_MAX 512
+
+typedef enum { DEV_ASLEEP, DEV_BOOTING, DEV_GET, DEV_POST, DEV_BACKOFF } dev_phase_t;
+
+typedef struct {
+    int fd;
+    uint32_t gen;            // bumped whenever the pending timer becomes irrelevant
+    dev_phase_t phase;
+    uint8_t attempt;
+    bool connected;
+    uint64_t req_start;
+    uint16_t tx_len, tx_off, rx_len;
+    char rx[RX_MAX];
+} device_t;
+
+typedef struct {
+    uint32_t *v;
+    size_t n, cap;
+} lat_vec_t;
+
+typedef struct {
+    uint64_t sent, ok, http_err, timeout, conn_err;
+    lat_vec_t lat_us;        // HTTP 200 only; fast 503s would otherwise hide the tail
+} req_stats_t;
+
+static struct {
+    const char *host;
+    int port;
+    int devices;
+    int duration_s;
+    int interval_s;
+    int window_s;
+    double jitter;
+    int boot_ms;
+    bool timeline;
+    uint64_t seed;
+} cfg = { "127.0.0.1", 8080, 5000, 120, 28800, 60, 0.02, 1500, false, 1 };
+
+static struct {
+    req_stats_t get, post;
+    uint64_t wakes, uploads_ok, uploads_lost;
+    uint64_t post_for_finished;  // POST attempts spent on uploads that completed (ok or lost)
+    uint32_t *started_per_s;     // requests put on the wire, per second of the run
+    int inflight, max_inflight;
+} st;
+
+static device_t *dev;
+static int epfd;
+static timer_heap_t timers;
+static struct sockaddr_in server;
+static uint64_t t0;
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void lat_push(lat_vec_t *l, uint64_t us) {
+    if (l->n == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 4096;
+        l->v = realloc(l->v, l->cap * sizeof(*l->v));
+        if (!l->v) {
+            abort();
+        }
+    }
+    l->v[l->n++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void arm(uint32_t id, uint64_t at) {
+    heap_push(&timers, (timer_ev_t){ at, id, dev[id].gen });
+}
+
+static uint64_t ms(double v) {
+    return v <= 0 ? 0 : (uint64_t)(v * 1000.0);
+}
+
+// Body is byte-for-byte what write_reading_form() produces for a plausible reading.
+static int build_request(uint32_t id, char *buf, size_t len) {
+    if (dev[id].phase == DEV_GET) {
+        return snprintf(buf, len,
+                        "GET /firmware.json HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n\r\n",
+                        cfg.host);
+    }
+    char body[384];
+    int blen = snprintf(body, sizeof(body),
+                        "api_token=sim-token-%05u&hostname=SIM%09u&sensor=Sim%%20Plant&location=Bench"
+                        "&moisture=%d&batt=%.2f&battery_status=%d&charge_status=%s&power_source=%s",
+                        id, id, 20 + (int)(rng_uniform() * 60), 40 + rng_uniform() * 60, 1,
+                        "discharging", "Battery");
+    return snprintf(buf, len,
+                    "POST /api/esp/data? HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n"
+                    "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %d\r\n\r\n%s",
+                    cfg.host, blen, body);
+}
+
+static void go_to_sleep(uint32_t id) {
+    device_t *d = &dev[id];
+    d->phase = DEV_ASLEEP;
+    d->gen++;
+    double interval = cfg.interval_s * (1.0 + cfg.jitter * (2.0 * rng_uniform() - 1.0));
+    arm(id, now_us() + ms(interval * 1000.0));
+}
+
+static void start_request(uint32_t id);
+
+// Common exit for a request: code > 0 is an HTTP status, 0 timeout, -1 connect/IO error.
+static void finish_request(uint32_t id, int code) {
+    device_t *d = &dev[id];
+    req_stats_t *rs = d->phase == DEV_GET ? &st.get : &st.post;
+    uint64_t elapsed = now_us() - d->req_start;
+
+    if (d->fd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, d->fd, NULL);
+        close(d->fd);
+        d->fd = -1;
+        st.inflight--;
+    }
+    d->gen++;
+
+    if (code > 0) {
+        if (code == 200) {
+            lat_push(&rs->lat_us, elapsed);
+            rs->ok++;
+        } else {
+            rs->http_err++;
+        }
+    } else if (code == 0) {
+        rs->timeout++;
+    } else {
+        rs->conn_err++;
+    }
+
+    if (d->phase == DEV_GET) {
+        // check_update() never retries; the upload goes ahead whatever happened.
+        d->phase = DEV_POST;
+        d->attempt = 1;
+        start_request(id);
+        return;
+    }
+    if (code == 200) {
+        st.uploads_ok++;
+        st.post_for_finished += d->attempt;
+        go_to_sleep(id);
+    } else if (d->attempt < POST_MAX_ATTEMPTS) {
+        d->phase = DEV_BACKOFF;
+        arm(id, now_us() + (uint64_t)POST_BACKOFF_MS * 1000u * d->attempt);
+    } else {
+        st.uploads_lost++;
+        st.post_for_finished += d->attempt;
+        go_to_sleep(id);
+    }
+}
+
+static void start_request(uint32_t id) {
+    device_t *d = &dev[id];
+    d->req_start = now_us();
+    d->connected = false;
+    d->tx_off = d->rx_len = 0;
+    d->gen++;
+
+    req_stats_t *rs = d->phase == DEV_GET ? &st.get : &st.post;
+    rs->sent++;
+    uint64_t sec = (d->req_start - t0) / 1000000u;
+    if (sec <= (uint64_t)cfg.duration_s) {
+        st.started_per_s[sec]++;
+    }
+
+    d->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (d->fd < 0) {
+        finish_request(id, -1);
+        return;
+    }
+    st.inflight++;
+    if (st.inflight > st.max_inflight) {
+        st.max_inflight = st.inflight;
+    }
+    set_nonblock(d->fd);
+    if (connect(d->fd, (struct sockaddr *)&server, sizeof(server)) != 0 && errno != EINPROGRESS) {
+        finish_request(id, -1);
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLOUT | EPOLLIN, .data.u32 = id };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, d->fd, &ev);
+    arm(id, d->req_start + (uint64_t)(d->phase == DEV_GET ? GET_TIMEOUT_MS : POST_TIMEOUT_MS) * 1000u);
+}
+
+static void on_io(uint32_t id, uint32_t events) {
+    device_t *d = &dev[id];
+    if (!d->connected && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(d->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            finish_request(id, -1);
+            return;
+        }
+        d->connected = true;
+        char tx[640];
+        d->tx_len = (uint16_t)build_request(id, tx, sizeof(tx));
+        // Requests are well under the socket send buffer, so one write suffices.
+        if (write(d->fd, tx, d->tx_len) != d->tx_len) {
+            finish_request(id, -1);
+            return;
+        }
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u32 = id };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, d->fd, &ev);
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        ssize_t r = read(d->fd, d->rx + d->rx_len, RX_MAX - 1 - d->rx_len);
+        if (r > 0) {
+            d->rx_len += (uint16_t)r;
+            if (d->rx_len < RX_MAX - 1) {
+                return;   // server closes after the response; wait for EOF
+            }
+        } else if (r < 0 && errno == EAGAIN) {
+            return;
+        }
+        d->rx[d->rx_len] = '\0';
+        int code = -1;
+        if (d->rx_len > 12 && strncmp(d->rx, "HTTP/1.", 7) == 0) {
+            code = atoi(d->rx + 9);
+        }
+        finish_request(id, code);
+    }
+}
+
+static void on_timer(uint32_t id) {
+    device_t *d = &dev[id];
+    switch (d->phase) {
+    case DEV_ASLEEP:
+        st.wakes++;
+        d->phase = DEV_BOOTING;
+        d->gen++;
+        arm(id, now_us() + ms(cfg.boot_ms * (0.75 + 0.5 * rng_uniform())));
+        break;
+    case DEV_BOOTING:
+        d->phase = DEV_GET;
+        start_request(id);
+        break;
+    case DEV_BACKOFF:
+        d->phase = DEV_POST;
+        d->attempt++;
+        start_request(id);
+        break;
+    case DEV_GET:
+    case DEV_POST:
+        finish_request(id, 0);   // request deadline hit
+        break;
+    }
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report_requests(const char *name, req_stats_t *rs) {
+    printf("%-5s sent=%llu ok=%llu http_err=%llu timeout=%llu conn_err=%llu",
+           name, (unsigned long long)rs->sent, (unsigned long long)rs->ok,
+           (unsigned long long)rs->http_err, (unsigned long long)rs->timeout,
+           (unsigned long long)rs->conn_err);
+    lat_vec_t *l = &rs->lat_us;
+    if (l->n == 0) {
+        printf("\n");
+        return;
+    }
+    qsort(l->v, l->n, sizeof(*l->v), cmp_u32);
+    const double pct[] = { 50, 90, 99, 99.9 };
+    const char *lbl[] = { "p50", "p90", "p99", "p99.9" };
+    for (int i = 0; i < 4; i++) {
+        size_t idx = (size_t)(pct[i] / 100.0 * (double)(l->n - 1));
+        printf(" %s_ms=%.1f", lbl[i], l->v[idx] / 1000.0);
+    }
+    printf(" max_ms=%.1f\n", l->v[l->n - 1] / 1000.0);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-H host] [-p port] [-n devices] [-d seconds] [-i interval_s] [-w window_s]\n"
+            "          [-j jitter] [-b boot_ms] [-S seed] [-v]\n"
+            "  -n  virtual devices (default 5000)\n"
+            "  -d  run length in seconds (default 120)\n"
+            "  -i  deep-sleep interval, s (default 28800 = firmware default)\n"
+            "  -w  first wakes spread uniformly over this many seconds (default 60)\n"
+            "  -j  sleep interval jitter, fraction (default 0.02 = +/-2%% RTC drift)\n"
+            "  -b  wake-to-first-request time, ms, +/-25%% (default 1500: Wi-Fi, DHCP, SNTP)\n"
+            "  -v  print one line per second while running\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:n:d:i:w:j:b:S:vh")) != -1) {
+        switch (opt) {
+        case 'H': cfg.host = optarg; break;
+        case 'p': cfg.port = atoi(optarg); break;
+        case 'n': cfg.devices = atoi(optarg); break;
+        case 'd': cfg.duration_s = atoi(optarg); break;
+        case 'i': cfg.interval_s = atoi(optarg); break;
+        case 'w': cfg.window_s = atoi(optarg); break;
+        case 'j': cfg.jitter = atof(optarg); break;
+        case 'b': cfg.boot_ms = atoi(optarg); break;
+        case 'S': cfg.seed = strtoull(optarg, NULL, 10); break;
+        case 'v': cfg.timeline = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (cfg.devices <= 0 || cfg.duration_s <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    server.sin_family = AF_INET;
+    server.sin_port = htons((uint16_t)cfg.port);
+    if (inet_pton(AF_INET, cfg.host, &server.sin_addr) != 1) {
+        fprintf(stderr, "host must be an IPv4 address\n");
+        return 2;
+    }
+
+    int fd_limit = raise_fd_limit();
+    if (cfg.devices + 64 > fd_limit) {
+        fprintf(stderr, "warning: fd limit %d < devices; some connects will fail (counted as conn_err)\n",
+                fd_limit);
+    }
+    rng_seed(cfg.seed);
+    dev = calloc((size_t)cfg.devices, sizeof(*dev));
+    st.started_per_s = calloc((size_t)cfg.duration_s + 1, sizeof(*st.started_per_s));
+    if (!dev || !st.started_per_s) {
+        perror("calloc");
+        return 1;
+    }
+
+    epfd = epoll_create1(0);
+    signal(SIGINT, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    t0 = now_us();
+    for (int i = 0; i < cfg.devices; i++) {
+        dev[i].fd = -1;
+        dev[i].phase = DEV_ASLEEP;
+        arm((uint32_t)i, t0 + ms(rng_uniform() * cfg.window_s * 1000.0));
+    }
+
+    struct epoll_event events[512];
+    uint64_t end = t0 + (uint64_t)cfg.duration_s * 1000000u;
+    uint64_t next_tick = t0 + 1000000u;
+    uint64_t last_ok = 0, last_err = 0;
+    while (!stop) {
+        uint64_t now = now_us();
+        if (now >= end) {
+            break;
+        }
+        int n = epoll_wait(epfd, events, 512, heap_wait_ms(&timers, now, 100));
+        for (int i = 0; i < n; i++) {
+            on_io(events[i].data.u32, events[i].events);
+        }
+        now = now_us();
+        timer_ev_t ev;
+        while (heap_pop_due(&timers, now, &ev)) {
+            if (ev.gen == dev[ev.id].gen) {
+                on_timer(ev.id);
+            }
+        }
+        if (cfg.timeline && now >= next_tick) {
+            uint64_t sec = (next_tick - t0) / 1000000u - 1;
+            uint64_t ok = st.get.ok + st.post.ok;
+            uint64_t err = st.get.http_err + st.post.http_err + st.get.timeout + st.post.timeout +
+                           st.get.conn_err + st.post.conn_err;
+            printf("t=%llus started=%u ok=%llu failed=%llu inflight=%d\n", (unsigned long long)sec,
+                   st.started_per_s[sec], (unsigned long long)(ok - last_ok),
+                   (unsigned long long)(err - last_err), st.inflight);
+            last_ok = ok;
+            last_err = err;
+            next_tick += 1000000u;
+        }
+    }
+
+    double elapsed_s = (now_us() - t0) / 1e6;
+    uint32_t peak = 0;
+    int peak_s = 0;
+    for (int s = 0; s <= cfg.duration_s; s++) {
+        if (st.started_per_s[s] > peak) {
+            peak = st.started_per_s[s];
+            peak_s = s;
+        }
+    }
+    uint64_t total_sent = st.get.sent + st.post.sent;
+    uint64_t uploads = st.uploads_ok + st.uploads_lost;
+
+    printf("devices=%d duration_s=%.1f wakes=%llu uploads_ok=%llu uploads_lost=%llu still_running=%llu\n",
+           cfg.devices, elapsed_s, (unsigned long long)st.wakes, (unsigned long long)st.uploads_ok,
+           (unsigned long long)st.uploads_lost, (unsigned long long)(st.wakes - uploads));
+    printf("rate  mean_req_s=%.1f peak_req_s=%u (at t=%ds) max_inflight=%d\n",
+           total_sent / elapsed_s, peak, peak_s, st.max_inflight);
+    report_requests("get", &st.get);
+    report_requests("post", &st.post);
+    // 1.00 = every reading took one POST; 3.00 = every reading burned all attempts.
+    printf("retry_amplification post_per_upload=%.3f requests_per_wake=%.3f\n",
+           uploads ? (double)st.post_for_finished / (double)uploads : 0.0,
+           st.wakes ? (double)total_sent / (double)st.wakes : 0.0);
+    return 0;
+}
@@ -0,0 +1,338 @@
+// Local stand-in for athome.rodlandfarms.com: serves GET /firmware.json and accepts the
+// form-encoded POST /api/esp/data that uploadReadings() sends. It is NOT a functional
+// backend — it models capacity: W workers each busy for a fixed service time, a bounded
+// wait queue, and an immediate 503 once that queue is full, so fleet_sim can show what
+// the device retry policy does to an overloaded server.
+//
+// Plain HTTP/1.1, one request per connection (the firmware opens a fresh client for every
+// request). TLS is deliberately left out; its CPU cost can be folded into -t.
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "sim_common.h"
+
+#define RX_MAX 2048
+#define TX_MAX 256
+
+typedef enum { C_FREE, C_READING, C_WAITING, C_SERVICE, C_WRITING } conn_state_t;
+
+typedef struct {
+    conn_state_t state;
+    uint32_t gen;
+    bool is_post;
+    bool peer_gone;          // client hung up (timed out) while we were still busy with it
+    uint16_t rx_len;
+    uint16_t tx_len, tx_off;
+    char rx[RX_MAX];
+    char tx[TX_MAX];
+} conn_t;
+
+static struct {
+    int port;
+    int workers;
+    int post_service_ms;
+    int get_service_ms;
+    int queue_max;
+    const char *version;
+} cfg = { 8080, 8, 25, 2, 256, "0" };
+
+static struct {
+    uint64_t accepted, get_ok, post_ok, rejected_503, bad_request, abandoned;
+    int busy, queued, max_queued;
+} st;
+
+static conn_t *conns;
+static int max_fd;
+static int epfd;
+static timer_heap_t timers;
+static int *waitq;           // FIFO of fds waiting for a worker
+static int waitq_head, waitq_len;
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void close_conn(int fd) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    conns[fd].state = C_FREE;
+    conns[fd].gen++;
+}
+
+static void send_response(int fd, int code, const char *body) {
+    conn_t *c = &conns[fd];
+    if (c->peer_gone) {
+        st.abandoned++;
+        close_conn(fd);
+        return;
+    }
+    const char *reason = code == 200 ? "OK" : code == 503 ? "Service Unavailable" : "Bad Request";
+    int n = snprintf(c->tx, TX_MAX,
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s",
+                     code, reason, code == 200 && !c->is_post ? "application/json" : "text/plain",
+                     strlen(body), body);
+    c->tx_len = (uint16_t)(n < TX_MAX ? n : TX_MAX - 1);
+    c->tx_off = 0;
+    c->state = C_WRITING;
+
+    ssize_t w = write(fd, c->tx, c->tx_len);
+    if (w == c->tx_len) {
+        close_conn(fd);
+        return;
+    }
+    if (w > 0) {
+        c->tx_off = (uint16_t)w;
+    }
+    struct epoll_event ev = { .events = EPOLLOUT, .data.fd = fd };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static void start_service(int fd) {
+    conn_t *c = &conns[fd];
+    c->state = C_SERVICE;
+    st.busy++;
+    int ms = c->is_post ? cfg.post_service_ms : cfg.get_service_ms;
+    heap_push(&timers, (timer_ev_t){ now_us() + (uint64_t)ms * 1000u, (uint32_t)fd, c->gen });
+}
+
+static void finish_service(int fd) {
+    conn_t *c = &conns[fd];
+    st.busy--;
+    if (c->is_post) {
+        st.post_ok++;
+        send_response(fd, 200, "OK");
+    } else {
+        char body[96];
+        snprintf(body, sizeof(body), "{\"version\":\"%s\"}", cfg.version);
+        st.get_ok++;
+        send_response(fd, 200, body);
+    }
+    // A worker freed up: hand it the oldest waiting request.
+    if (waitq_len > 0) {
+        int next = waitq[waitq_head];
+        waitq_head = (waitq_head + 1) % max_fd;
+        waitq_len--;
+        st.queued--;
+        start_service(next);
+    }
+}
+
+// Admission control: worker if free, else the wait queue, else shed with 503.
+static void admit(int fd) {
+    if (st.busy < cfg.workers) {
+        start_service(fd);
+    } else if (waitq_len < cfg.queue_max) {
+        waitq[(waitq_head + waitq_len) % max_fd] = fd;
+        waitq_len++;
+        conns[fd].state = C_WAITING;
+        if (++st.queued > st.max_queued) {
+            st.max_queued = st.queued;
+        }
+    } else {
+        st.rejected_503++;
+        send_response(fd, 503, "busy");
+    }
+}
+
+// Returns true once a whole request (headers + Content-Length body) is buffered.
+static bool request_complete(conn_t *c, bool *bad) {
+    c->rx[c->rx_len] = '\0';
+    char *hdr_end = strstr(c->rx, "\r\n\r\n");
+    if (!hdr_end) {
+        *bad = c->rx_len >= RX_MAX - 1;
+        return false;
+    }
+    size_t body_len = 0;
+    char *cl = strcasestr(c->rx, "\r\nContent-Length:");
+    if (cl && cl < hdr_end) {
+        body_len = strtoul(cl + 17, NULL, 10);
+    }
+    size_t have = c->rx_len - (size_t)(hdr_end + 4 - c->rx);
+    if (have < body_len) {
+        *bad = c->rx_len >= RX_MAX - 1;
+        return false;
+    }
+    if (strncmp(c->rx, "GET /firmware.json ", 19) == 0) {
+        c->is_post = false;
+    } else if (strncmp(c->rx, "POST /api/esp/data", 18) == 0 && strstr(hdr_end + 4, "api_token=")) {
+        c->is_post = true;
+    } else {
+        *bad = true;
+        return false;
+    }
+    return true;
+}
+
+static void on_readable(int fd) {
+    conn_t *c = &conns[fd];
+    if (c->state != C_READING) {
+        // Only EOF/RST is expected once the request is in: the device gave up on us.
+        char tmp[64];
+        ssize_t r = read(fd, tmp, sizeof(tmp));
+        if (r == 0 || (r < 0 && errno != EAGAIN)) {
+            c->peer_gone = true;
+            struct epoll_event ev = { .events = 0, .data.fd = fd };
+            epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+        }
+        return;
+    }
+    ssize_t r = read(fd, c->rx + c->rx_len, RX_MAX - 1 - c->rx_len);
+    if (r <= 0) {
+        if (r == 0 || errno != EAGAIN) {
+            close_conn(fd);
+        }
+        return;
+    }
+    c->rx_len += (uint16_t)r;
+    bool bad = false;
+    if (request_complete(c, &bad)) {
+        admit(fd);
+    } else if (bad) {
+        st.bad_request++;
+        c->is_post = true;   // plain-text body
+        send_response(fd, 400, "bad request");
+    }
+}
+
+static void on_writable(int fd) {
+    conn_t *c = &conns[fd];
+    ssize_t w = write(fd, c->tx + c->tx_off, c->tx_len - c->tx_off);
+    if (w < 0 && errno == EAGAIN) {
+        return;
+    }
+    if (w > 0 && (c->tx_off += (uint16_t)w) < c->tx_len) {
+        return;
+    }
+    close_conn(fd);
+}
+
+static void on_accept(int lfd) {
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        if (fd >= max_fd) {
+            close(fd);
+            continue;
+        }
+        set_nonblock(fd);
+        st.accepted++;
+        conn_t *c = &conns[fd];
+        c->state = C_READING;
+        c->rx_len = 0;
+        c->peer_gone = false;
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.fd = fd };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-p port] [-c workers] [-t post_ms] [-g get_ms] [-q queue] [-V version]\n"
+            "  -p  listen port on 127.0.0.1 (default 8080)\n"
+            "  -c  concurrent workers (default 8)\n"
+            "  -t  service time per POST /api/esp/data, ms (default 25)\n"
+            "  -g  service time per GET /firmware.json, ms (default 2)\n"
+            "  -q  requests allowed to wait for a worker before 503 (default 256)\n"
+            "  -V  version string served in firmware.json (default \"0\" = no OTA)\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:c:t:g:q:V:h")) != -1) {
+        switch (opt) {
+        case 'p': cfg.port = atoi(optarg); break;
+        case 'c': cfg.workers = atoi(optarg); break;
+        case 't': cfg.post_service_ms = atoi(optarg); break;
+        case 'g': cfg.get_service_ms = atoi(optarg); break;
+        case 'q': cfg.queue_max = atoi(optarg); break;
+        case 'V': cfg.version = optarg; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+
+    max_fd = raise_fd_limit();
+    conns = calloc((size_t)max_fd, sizeof(*conns));
+    waitq = calloc((size_t)max_fd, sizeof(*waitq));
+    if (!conns || !waitq) {
+        perror("calloc");
+        return 1;
+    }
+    if (cfg.queue_max > max_fd) {
+        cfg.queue_max = max_fd;
+    }
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)cfg.port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, SOMAXCONN) != 0) {
+        perror("bind/listen");
+        return 1;
+    }
+    set_nonblock(lfd);
+
+    epfd = epoll_create1(0);
+    struct epoll_event lev = { .events = EPOLLIN, .data.fd = lfd };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &lev);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "ingest_standin: 127.0.0.1:%d workers=%d post=%dms get=%dms queue=%d fd_limit=%d\n",
+            cfg.port, cfg.workers, cfg.post_service_ms, cfg.get_service_ms, cfg.queue_max, max_fd);
+
+    struct epoll_event events[256];
+    uint64_t next_report = now_us() + 1000000u;
+    uint64_t last_post = 0, last_503 = 0;
+    while (!stop) {
+        uint64_t now = now_us();
+        int n = epoll_wait(epfd, events, 256, heap_wait_ms(&timers, now, 100));
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == lfd) {
+                on_accept(lfd);
+            } else if (conns[fd].state == C_WRITING) {
+                on_writable(fd);
+            } else {
+                on_readable(fd);
+            }
+        }
+
+        now = now_us();
+        timer_ev_t ev;
+        while (heap_pop_due(&timers, now, &ev)) {
+            if (conns[ev.id].gen == ev.gen && conns[ev.id].state == C_SERVICE) {
+                finish_service((int)ev.id);
+            }
+        }
+
+        if (now >= next_report) {
+            fprintf(stderr, "post_ok/s=%llu 503/s=%llu busy=%d queued=%d\n",
+                    (unsigned long long)(st.post_ok - last_post),
+                    (unsigned long long)(st.rejected_503 - last_503), st.busy, st.queued);
+            last_post = st.post_ok;
+            last_503 = st.rejected_503;
+            next_report += 1000000u;
+        }
+    }
+
+    printf("accepted=%llu get_ok=%llu post_ok=%llu rejected_503=%llu abandoned=%llu bad_request=%llu max_queued=%d\n",
+           (unsigned long long)st.accepted, (unsigned long long)st.get_ok, (unsigned long long)st.post_ok,
+           (unsigned long long)st.rejected_503, (unsigned long long)st.abandoned,
+           (unsigned long long)st.bad_request, st.max_queued);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "sim_common.h"
+
+uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void heap_push(timer_heap_t *h, timer_ev_t ev) {
+    if (h->n == h->cap) {
+        h->cap = h->cap ? h->cap * 2 : 1024;
+        h->v = realloc(h->v, h->cap * sizeof(*h->v));
+        if (!h->v) {
+            abort();
+        }
+    }
+    size_t i = h->n++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (h->v[parent].at <= ev.at) {
+            break;
+        }
+        h->v[i] = h->v[parent];
+        i = parent;
+    }
+    h->v[i] = ev;
+}
+
+bool heap_pop_due(timer_heap_t *h, uint64_t now, timer_ev_t *out) {
+    if (h->n == 0 || h->v[0].at > now) {
+        return false;
+    }
+    *out = h->v[0];
+    timer_ev_t last = h->v[--h->n];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= h->n) {
+            break;
+        }
+        if (child + 1 < h->n && h->v[child + 1].at < h->v[child].at) {
+            child++;
+        }
+        if (last.at <= h->v[child].at) {
+            break;
+        }
+        h->v[i] = h->v[child];
+        i = child;
+    }
+    if (h->n > 0) {
+        h->v[i] = last;
+    }
+    return true;
+}
+
+int heap_wait_ms(const timer_heap_t *h, uint64_t now, int max_ms) {
+    if (h->n == 0) {
+        return max_ms;
+    }
+    if (h->v[0].at <= now) {
+        return 0;
+    }
+    uint64_t ms = (h->v[0].at - now + 999) / 1000;
+    return ms < (uint64_t)max_ms ? (int)ms : max_ms;
+}
+
+int set_nonblock(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+        return 1024;
+    }
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    getrlimit(RLIMIT_NOFILE, &rl);
+    return rl.rlim_cur > 1u << 20 ? 1 << 20 : (int)rl.rlim_cur;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+void rng_seed(uint64_t seed) {
+    rng_state = seed ? seed : 0x9E3779B97F4A7C15ull;
+}
+
+double rng_uniform(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
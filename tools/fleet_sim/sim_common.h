@@ -0,0 +1,35 @@
+#ifndef SIM_COMMON_H
+#define SIM_COMMON_H
+
+// Shared pieces of fleet_sim and ingest_standin: monotonic clock, a binary min-heap of
+// timers (lazy cancel via generation numbers), socket helpers.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t now_us(void);
+
+typedef struct {
+    uint64_t at;     // absolute now_us() deadline
+    uint32_t id;     // device index / fd
+    uint32_t gen;    // stale when it no longer matches the owner's generation
+} timer_ev_t;
+
+typedef struct {
+    timer_ev_t *v;
+    size_t n, cap;
+} timer_heap_t;
+
+void heap_push(timer_heap_t *h, timer_ev_t ev);
+bool heap_pop_due(timer_heap_t *h, uint64_t now, timer_ev_t *out);   // earliest ev with at <= now
+int  heap_wait_ms(const timer_heap_t *h, uint64_t now, int max_ms);  // epoll timeout until next ev
+
+int  set_nonblock(int fd);
+int  raise_fd_limit(void);   // lifts RLIMIT_NOFILE soft limit to the hard limit, returns it
+
+// Tiny xorshift PRNG so runs are reproducible with -S.
+void   rng_seed(uint64_t seed);
+double rng_uniform(void);    // [0, 1)
+
+#endif // SIM_COMMON_H
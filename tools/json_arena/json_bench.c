@@ -0,0 +1,172 @@
+// Host benchmark: cJSON on the default malloc/free vs the firmware's JSON arena
+// (main/json_arena), over the documents the device actually parses. Prints one
+// "JSON_BENCH ..." key=value line per document and allocator, then checks that a
+// document too big for the arena fails cleanly and is reported as exhaustion.
+//
+//   ./json_bench [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cJSON.h"
+#include "json_arena.h"
+
+// Shapes of what the app writes over BLE and what the server publishes as firmware.json.
+static const char provision_doc[] =
+    "{\"ssid\":\"Rodland Farms 2.4\",\"password\":\"correct horse battery staple\","
+    "\"sensor_name\":\"Basil & Mint\",\"sensor_location\":\"Kitchen window, left\","
+    "\"api_token\":\"0f3c9a1e5b7d4c2a8e6f0b1d3c5a7e9f0f3c9a1e5b7d4c2a8e6f0b1d3c5a7e9f\","
+    "\"sleep_seconds\":28800,\"wake_budget_ms\":45000,\"reprovision_after\":12,"
+    "\"sample_seconds\":600,\"transport\":\"https\",\"espnow_channel\":6,"
+    "\"espnow_gateway\":\"A0B1C2D3E4F5\",\"espnow_key\":\"00112233445566778899AABBCCDDEEFF\"}";
+
+static const char manifest_doc[] =
+    "{\"version\":\"20261019\",\"compression\":\"zlib\","
+    "\"url\":\"https://athome.rodlandfarms.com/firmware.bin.zz\",\"size\":1048576,"
+    "\"sha256\":\"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\","
+    "\"window_bits\":12}";
+
+// ---- Counting malloc -----------------------------------------------------------------
+
+typedef struct {
+    unsigned long allocs, frees;
+    size_t live, peak, total;
+} heap_count_t;
+
+static heap_count_t hc;
+
+// Size header in front of each block, so free() can account for it.
+static void *count_malloc(size_t size) {
+    size_t *p = malloc(sizeof(size_t) + size);
+    if (p == NULL) {
+        return NULL;
+    }
+    *p = size;
+    hc.allocs++;
+    hc.total += size;
+    hc.live += size;
+    if (hc.live > hc.peak) {
+        hc.peak = hc.live;
+    }
+    return p + 1;
+}
+
+static void count_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    size_t *p = (size_t *)ptr - 1;
+    hc.frees++;
+    hc.live -= *p;
+    free(p);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ---- Benchmark -----------------------------------------------------------------------
+
+static int bench_malloc(const char *name, const char *doc, int iterations) {
+    cJSON_Hooks hooks = { .malloc_fn = count_malloc, .free_fn = count_free };
+    cJSON_InitHooks(&hooks);
+    memset(&hc, 0, sizeof(hc));
+    cJSON_Delete(cJSON_Parse(doc));
+    heap_count_t one = hc;
+
+    // Timed with plain malloc/free: the counting wrapper isn't what the device runs.
+    cJSON_InitHooks(NULL);
+    double t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        cJSON *root = cJSON_Parse(doc);
+        if (root == NULL) {
+            return 1;
+        }
+        cJSON_Delete(root);
+    }
+    double ns = (now_ns() - t0) / iterations;
+    printf("JSON_BENCH doc=%s bytes=%zu alloc=malloc allocs=%lu frees=%lu heap_bytes=%zu peak_live=%zu ns_per_parse=%.0f\n",
+           name, strlen(doc), one.allocs, one.frees, one.total, one.peak, ns);
+    return 0;
+}
+
+static int bench_arena(const char *name, const char *doc, int iterations) {
+    json_arena_stats_t st = { 0 };
+    double t0 = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        if (!json_arena_begin()) {
+            return 1;
+        }
+        cJSON *root = cJSON_Parse(doc);
+        if (root == NULL) {
+            json_arena_end(NULL);
+            return 1;
+        }
+        cJSON_Delete(root);
+        json_arena_end(&st);
+    }
+    double ns = (now_ns() - t0) / iterations;
+    printf("JSON_BENCH doc=%s bytes=%zu alloc=arena allocs=%lu frees=%lu heap_bytes=0 arena_used=%zu/%d ns_per_parse=%.0f\n",
+           name, strlen(doc), (unsigned long)st.allocs, (unsigned long)st.frees, st.used,
+           JSON_ARENA_BYTES, ns);
+    return 0;
+}
+
+// A document with more nodes than the arena holds must come back NULL with the
+// exhaustion flag set, and the next scope must start from an empty block again.
+static int check_exhaustion(void) {
+    size_t cap = 2 * JSON_ARENA_BYTES;
+    char *doc = malloc(cap);
+    if (doc == NULL) {
+        return 1;
+    }
+    size_t n = 0;
+    doc[n++] = '[';
+    while (n < cap - 8) {
+        n += (size_t)snprintf(doc + n, cap - n, "%s1", n > 1 ? "," : "");
+    }
+    doc[n++] = ']';
+    doc[n] = '\0';
+
+    int failures = 0;
+    json_arena_stats_t st;
+    json_arena_begin();
+    cJSON *root = cJSON_Parse(doc);
+    bool exhausted = json_arena_exhausted();
+    json_arena_end(&st);
+    if (root != NULL || !exhausted || st.failed == 0 || st.used > JSON_ARENA_BYTES) {
+        failures++;
+    }
+    json_arena_begin();
+    root = cJSON_Parse(manifest_doc);
+    if (root == NULL || json_arena_exhausted()) {
+        failures++;
+    }
+    json_arena_end(NULL);
+    if (json_arena_begin() && !json_arena_begin()) {
+        json_arena_end(NULL);   // nested scope correctly refused
+    } else {
+        failures++;
+    }
+    printf("JSON_BENCH exhaustion doc_bytes=%zu refused=%lu used=%zu result=%s\n", n,
+           (unsigned long)st.failed, st.used, failures ? "FAIL" : "ok");
+    free(doc);
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    if (iterations <= 0) {
+        iterations = 1;
+    }
+    int failures = 0;
+    failures += bench_malloc("provision", provision_doc, iterations);
+    failures += bench_arena("provision", provision_doc, iterations);
+    failures += bench_malloc("manifest", manifest_doc, iterations);
+    failures += bench_arena("manifest", manifest_doc, iterations);
+    failures += check_exhaustion();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,422 @@
+// Side-by-side cost of one reading over the two transports, against local stand-ins:
+//
+//   mqtt  - TCP to a Mosquitto broker (mosquitto.conf here). Each wake does what
+//           mqtt_link.c does: CONNECT with clean session off, SUBSCRIBE to the command
+//           topic on the first wake only, PUBLISH the reading at QoS 1, wait for PUBACK,
+//           ack any queued commands, DISCONNECT. Payload and topics come from the
+//           firmware's mqtt_msg.c.
+//   http  - TCP to tools/fleet_sim's ingest_standin. One POST /api/esp/data per wake
+//           with the body write_reading_form() streams (reading_logic.c, body_writer.c).
+//
+// Both sides count bytes on the wire in each direction (TCP payload, no TLS) and time
+// connect -> CONNACK, publish -> PUBACK and connect -> ack (the whole wake up to the
+// point the reading is known to be delivered).
+//
+//   ./mqtt_compare [-H host] [-m mqtt_port] [-p http_port] [-n wakes] [-l linger_ms]
+//
+// Prints one "MQTT_COMPARE ..." key=value line per transport.
+
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "body_writer.h"
+#include "data.h"
+#include "mqtt_msg.h"
+
+#define IO_TIMEOUT_MS 3000
+#define MAX_WAKES     10000
+
+static struct {
+    const char *host;
+    int mqtt_port;
+    int http_port;
+    int wakes;
+    int linger_ms;
+    const char *hostname;
+    const char *token;
+} cfg = { "127.0.0.1", 1883, 8080, 50, 0, "PPCOMPARE01", "compare-token" };
+
+typedef struct {
+    const char *name;
+    int ok, failed;
+    uint64_t tx, rx;                 // bytes, all wakes
+    double connack[MAX_WAKES];       // ms; HTTP has no equivalent and leaves these at 0
+    double puback[MAX_WAKES];        // ms from request/publish to its ack
+    double total[MAX_WAKES];         // ms from connect() to the ack
+    int commands;
+} side_t;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// A plausible reading that changes a little from wake to wake.
+static void make_reading(int wake, SensorReading *r) {
+    memset(r, 0, sizeof(*r));
+    r->moisture = 30 + wake % 40;
+    r->battery.soc = 80.0f - (wake % 50) * 0.5f;
+    r->battery.crate = -1.25f;
+    r->battery.status = true;
+}
+
+// ---- Sockets ---------------------------------------------------------------------------
+
+static int dial(int port) {
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *ai;
+    if (getaddrinfo(cfg.host, service, &hints, &ai) != 0) {
+        return -1;
+    }
+    int fd = socket(ai->ai_family, ai->ai_socktype, 0);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(ai);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static bool send_all(int fd, const void *buf, size_t len, side_t *s) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        s->tx += n;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Exactly len bytes, or false on timeout/EOF.
+static bool recv_all(int fd, void *buf, size_t len, int timeout_ms, side_t *s) {
+    char *p = buf;
+    while (len > 0) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, timeout_ms) <= 0) {
+            return false;
+        }
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) {
+            return false;
+        }
+        s->rx += n;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// ---- MQTT 3.1.1, just the packets the device uses -----------------------------------
+
+typedef struct {
+    uint8_t buf[256];
+    size_t len;
+} pkt_t;
+
+static void put_u8(pkt_t *p, uint8_t v) { p->buf[p->len++] = v; }
+static void put_u16(pkt_t *p, uint16_t v) { put_u8(p, v >> 8); put_u8(p, v & 0xFF); }
+static void put_bytes(pkt_t *p, const void *d, size_t n) { memcpy(p->buf + p->len, d, n); p->len += n; }
+static void put_str(pkt_t *p, const char *s) { put_u16(p, strlen(s)); put_bytes(p, s, strlen(s)); }
+
+// Sends fixed header + body. Bodies here are < 16 KB, so the length fits two bytes.
+static bool mqtt_send(int fd, uint8_t type, const pkt_t *body, side_t *s) {
+    uint8_t hdr[3] = { type };
+    size_t n = 1, rem = body->len;
+    do {
+        hdr[n++] = (rem & 0x7F) | (rem > 0x7F ? 0x80 : 0);
+        rem >>= 7;
+    } while (rem > 0);
+    return send_all(fd, hdr, n, s) && send_all(fd, body->buf, body->len, s);
+}
+
+// Next packet from the broker: type byte and body (truncated to the buffer).
+static bool mqtt_recv(int fd, uint8_t *type, pkt_t *body, int timeout_ms, side_t *s) {
+    uint8_t b;
+    if (!recv_all(fd, type, 1, timeout_ms, s)) {
+        return false;
+    }
+    size_t rem = 0;
+    for (int shift = 0; shift < 28; shift += 7) {
+        if (!recv_all(fd, &b, 1, IO_TIMEOUT_MS, s)) {
+            return false;
+        }
+        rem |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+    if (rem > sizeof(body->buf)) {
+        return false;
+    }
+    body->len = rem;
+    return recv_all(fd, body->buf, rem, IO_TIMEOUT_MS, s);
+}
+
+// A command PUBLISH from the broker: count it, decode it, and PUBACK it (QoS 1).
+static void mqtt_on_publish(int fd, uint8_t type, const pkt_t *in, side_t *s) {
+    if (in->len < 2) {
+        return;
+    }
+    size_t tlen = (in->buf[0] << 8) | in->buf[1];
+    size_t off = 2 + tlen;
+    uint16_t id = 0;
+    if ((type & 0x06) && off + 2 <= in->len) {
+        id = (in->buf[off] << 8) | in->buf[off + 1];
+        off += 2;
+    }
+    if (off <= in->len) {
+        uint32_t value;
+        mqtt_cmd_t cmd = mqtt_msg_parse_cmd((const char *)in->buf + off, in->len - off, &value);
+        printf("command: %.*s (%s)\n", (int)(in->len - off), in->buf + off,
+               cmd == MQTT_CMD_UNKNOWN ? "rejected" : "accepted");
+        s->commands++;
+    }
+    if (type & 0x06) {
+        pkt_t ack = { .len = 0 };
+        put_u16(&ack, id);
+        mqtt_send(fd, 0x40, &ack, s);
+    }
+}
+
+// Waits for a packet of want_type with packet id id, handling command PUBLISHes meanwhile.
+static bool mqtt_wait(int fd, uint8_t want_type, uint16_t id, side_t *s) {
+    for (;;) {
+        uint8_t type;
+        pkt_t in;
+        if (!mqtt_recv(fd, &type, &in, IO_TIMEOUT_MS, s)) {
+            return false;
+        }
+        if ((type & 0xF0) == 0x30) {
+            mqtt_on_publish(fd, type, &in, s);
+        } else if ((type & 0xF0) == want_type &&
+                   (id == 0 || (in.len >= 2 && ((in.buf[0] << 8) | in.buf[1]) == id))) {
+            return want_type != 0x20 || (in.len >= 2 && in.buf[1] == 0);   // CONNACK rc 0
+        }
+    }
+}
+
+static bool mqtt_wake(int wake, side_t *s) {
+    double t0 = now_ms();
+    int fd = dial(cfg.mqtt_port);
+    if (fd < 0) {
+        return false;
+    }
+    char topic[MQTT_TOPIC_MAX];
+    pkt_t p = { .len = 0 };
+    put_str(&p, "MQTT");
+    put_u8(&p, 4);                  // protocol level 3.1.1
+    put_u8(&p, 0x80 | 0x40);        // username + password, clean session off
+    put_u16(&p, 60);
+    put_str(&p, cfg.hostname);
+    put_str(&p, cfg.hostname);
+    put_str(&p, cfg.token);
+    bool ok = mqtt_send(fd, 0x10, &p, s) && mqtt_wait(fd, 0x20, 0, s);
+    s->connack[wake] = now_ms() - t0;
+
+    if (ok && wake == 0) {          // later wakes rely on the broker's stored session
+        mqtt_topic(topic, sizeof(topic), cfg.hostname, "cmd");
+        p.len = 0;
+        put_u16(&p, 1);
+        put_str(&p, topic);
+        put_u8(&p, 1);
+        ok = mqtt_send(fd, 0x82, &p, s) && mqtt_wait(fd, 0x90, 1, s);
+    }
+
+    if (ok) {
+        SensorReading r;
+        PackedReading packed;
+        char payload[MQTT_READING_MAX];
+        make_reading(wake, &r);
+        pack_reading(&r, &packed);
+        int plen = mqtt_msg_reading(payload, sizeof(payload), &packed, (uint32_t)time(NULL));
+        mqtt_topic(topic, sizeof(topic), cfg.hostname, "reading");
+        uint16_t id = 2 + wake % 60000;
+        p.len = 0;
+        put_str(&p, topic);
+        put_u16(&p, id);
+        put_bytes(&p, payload, plen);
+        double t1 = now_ms();
+        ok = mqtt_send(fd, 0x32, &p, s) && mqtt_wait(fd, 0x40, id, s);
+        s->puback[wake] = now_ms() - t1;
+        s->total[wake] = now_ms() - t0;
+    }
+
+    // Queued commands that didn't beat the PUBACK still arrive during the linger.
+    double until = now_ms() + cfg.linger_ms;
+    while (ok && now_ms() < until) {
+        uint8_t type;
+        pkt_t in;
+        if (!mqtt_recv(fd, &type, &in, (int)(until - now_ms()) + 1, s)) {
+            break;
+        }
+        if ((type & 0xF0) == 0x30) {
+            mqtt_on_publish(fd, type, &in, s);
+        }
+    }
+    if (ok) {
+        p.len = 0;
+        mqtt_send(fd, 0xE0, &p, s);
+    }
+    close(fd);
+    return ok;
+}
+
+// ---- HTTP -------------------------------------------------------------------------------
+
+// body_writer.c writes through this; the "handle" is the socket plus the byte counters.
+struct esp_http_client {
+    int fd;
+    side_t *side;
+};
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len) {
+    return send_all(client->fd, buffer, len, client->side) ? len : -1;
+}
+
+typedef struct {
+    const SensorReading *reading;
+} form_ctx_t;
+
+static void emit_form(body_writer_t *w, void *ctx) {
+    const form_ctx_t *f = ctx;
+    write_reading_form(w, f->reading, cfg.hostname, "Compare Plant", "Bench", cfg.token);
+}
+
+static bool http_wake(int wake, side_t *s) {
+    SensorReading r;
+    make_reading(wake, &r);
+    form_ctx_t f = { &r };
+
+    double t0 = now_ms();
+    int fd = dial(cfg.http_port);
+    if (fd < 0) {
+        return false;
+    }
+    // Same request line and headers esp_http_client sends for POST().
+    size_t blen = body_writer_measure(emit_form, &f);
+    char hdr[256];
+    int hlen = snprintf(hdr, sizeof(hdr),
+                        "POST /api/esp/data? HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n"
+                        "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %zu\r\n\r\n",
+                        cfg.host, blen);
+    struct esp_http_client client = { fd, s };
+    double t1 = now_ms();
+    bool ok = send_all(fd, hdr, hlen, s) && body_writer_send(&client, blen, emit_form, &f);
+
+    // The stand-in closes after each response; read it all, then check the status.
+    char resp[512];
+    size_t got = 0;
+    while (ok) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, IO_TIMEOUT_MS) <= 0) {
+            ok = false;
+            break;
+        }
+        ssize_t n = recv(fd, resp + got, sizeof(resp) - 1 - got, 0);
+        if (n <= 0) {
+            break;
+        }
+        s->rx += n;
+        got += n;
+        if (got == sizeof(resp) - 1) {
+            got = 0;                // headers are all we need; keep counting the rest
+        }
+        if (s->puback[wake] == 0) {
+            s->puback[wake] = now_ms() - t1;
+            s->total[wake] = now_ms() - t0;
+        }
+    }
+    resp[got] = '\0';
+    close(fd);
+    return ok && strncmp(resp, "HTTP/1.1 200", 12) == 0;
+}
+
+// ---- Report -----------------------------------------------------------------------------
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct(double *v, int n, double p) {
+    if (n == 0) {
+        return 0;
+    }
+    qsort(v, n, sizeof(*v), cmp_double);
+    return v[(int)(p * (n - 1) + 0.5)];
+}
+
+static void run(side_t *s, bool (*wake_fn)(int, side_t *)) {
+    for (int i = 0; i < cfg.wakes; i++) {
+        if (wake_fn(i, s)) {
+            s->ok++;
+        } else {
+            s->failed++;
+        }
+    }
+    int n = cfg.wakes;
+    printf("MQTT_COMPARE transport=%s ok=%d failed=%d tx_per_reading=%.1f rx_per_reading=%.1f "
+           "connack_p50_ms=%.2f ack_p50_ms=%.2f ack_p99_ms=%.2f connect_to_ack_p50_ms=%.2f "
+           "connect_to_ack_p99_ms=%.2f commands=%d\n",
+           s->name, s->ok, s->failed, n ? (double)s->tx / n : 0, n ? (double)s->rx / n : 0,
+           pct(s->connack, n, 0.5), pct(s->puback, n, 0.5), pct(s->puback, n, 0.99),
+           pct(s->total, n, 0.5), pct(s->total, n, 0.99), s->commands);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-H host] [-m mqtt_port] [-p http_port] [-n wakes] [-l linger_ms]\n"
+            "          [-d hostname] [-t api_token]\n"
+            "  -m  Mosquitto port (default 1883); 0 skips MQTT\n"
+            "  -p  ingest_standin port (default 8080); 0 skips HTTP\n"
+            "  -n  wakes per transport (default 50, max %d)\n"
+            "  -l  MQTT linger after PUBACK for queued commands, ms (default 0)\n",
+            prog, MAX_WAKES);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "H:m:p:n:l:d:t:h")) != -1) {
+        switch (opt) {
+        case 'H': cfg.host = optarg; break;
+        case 'm': cfg.mqtt_port = atoi(optarg); break;
+        case 'p': cfg.http_port = atoi(optarg); break;
+        case 'n': cfg.wakes = atoi(optarg); break;
+        case 'l': cfg.linger_ms = atoi(optarg); break;
+        case 'd': cfg.hostname = optarg; break;
+        case 't': cfg.token = optarg; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (cfg.wakes <= 0 || cfg.wakes > MAX_WAKES) {
+        usage(argv[0]);
+        return 2;
+    }
+    static side_t mqtt = { .name = "mqtt" }, http = { .name = "http" };
+    if (cfg.mqtt_port > 0) {
+        run(&mqtt, mqtt_wake);
+    }
+    if (cfg.http_port > 0) {
+        run(&http, http_wake);
+    }
+    return mqtt.failed || http.failed ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Package an app image for OTA: firmware.bin, firmware.bin.zz and firmware.json.
+
+The compressed image is a zlib stream with a 4 KB window (wbits 12), which is what the
+device's ROM inflater keeps as its dictionary (main/ota/ota_inflate.h). firmware.json
+keeps "version" for older firmware, which downloads firmware.bin as before.
+"""
+import argparse
+import hashlib
+import json
+import os
+import shutil
+import sys
+import zlib
+
+WINDOW_BITS = 12   # must not exceed OTA_INFLATE_WINDOW_BITS on the device
+PLAIN_NAME = "firmware.bin"
+PACKED_NAME = "firmware.bin.zz"
+
+
+def compress(image):
+    c = zlib.compressobj(level=9, method=zlib.DEFLATED, wbits=WINDOW_BITS, memLevel=9)
+    return c.compress(image) + c.flush()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("image", help="app binary, e.g. build/PlantPulse.bin")
+    ap.add_argument("--version", required=True,
+                    help="unix timestamp; must match current_version_number in main.c")
+    ap.add_argument("--out-dir", default="dist")
+    ap.add_argument("--base-url", default="https://athome.rodlandfarms.com/",
+                    help="where the files will be served from")
+    args = ap.parse_args()
+
+    if not args.version.isdigit():
+        sys.exit("--version must be the numeric build timestamp")
+    with open(args.image, "rb") as f:
+        image = f.read()
+    if not image or image[0] != 0xE9:
+        sys.exit(f"{args.image}: not an ESP app image (no 0xE9 magic)")
+
+    packed = compress(image)
+    if zlib.decompress(packed, WINDOW_BITS) != image:
+        sys.exit("round-trip check failed")
+
+    os.makedirs(args.out_dir, exist_ok=True)
+    shutil.copyfile(args.image, os.path.join(args.out_dir, PLAIN_NAME))
+    manifest = {"version": args.version}
+    if len(packed) < len(image):
+        with open(os.path.join(args.out_dir, PACKED_NAME), "wb") as f:
+            f.write(packed)
+        manifest.update({
+            "compression": "zlib",
+            "window_bits": WINDOW_BITS,
+            "url": args.base_url.rstrip("/") + "/" + PACKED_NAME,
+            "size": len(image),
+            "sha256": hashlib.sha256(image).hexdigest(),
+        })
+    with open(os.path.join(args.out_dir, "firmware.json"), "w") as f:
+        json.dump(manifest, f, separators=(",", ":"))
+        f.write("\n")
+
+    print(f"image={len(image)} packed={len(packed)} "
+          f"saved={100.0 * (1 - len(packed) / len(image)):.1f}% out={args.out_dir}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,207 @@
+// Round-trip property checks and compression-ratio benchmark for ts_codec.
+//
+//   ./ts_bench [iterations] [seed]
+//
+// Exit status is non-zero if any round trip fails, so it can gate a release script.
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ts_codec.h"
+
+#define MAX_N 512
+
+static uint64_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+static int rng_range(int lo, int hi) {   // inclusive
+    return lo + (int)(rng() % (uint32_t)(hi - lo + 1));
+}
+
+static double rng_gauss(void) {
+    double u1 = (rng() + 1.0) / 4294967297.0, u2 = (rng() + 1.0) / 4294967297.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// ---- Series generators --------------------------------------------------------------
+
+// A sensor in a pot: readings every `interval` s (RTC jitter of a few s), moisture
+// drying slowly with a watering jump every few days, SoC sagging with a daily solar
+// top-up, CRATE noisy around the load current.
+static void gen_realistic(ts_sample_t *s, size_t n, uint32_t interval, bool solar) {
+    uint32_t t = 1781375990u;
+    double moisture = 80, soc = 92;
+    for (size_t i = 0; i < n; i++) {
+        t += interval + (uint32_t)rng_range(0, 4);
+        double hours = interval / 3600.0;
+        moisture -= hours * (0.4 + 0.1 * rng_gauss());
+        if (moisture < 25 || rng_range(0, 1000) < (int)(hours * 3)) {
+            moisture = 75 + rng_range(0, 15);   // watered
+        }
+        double hour_of_day = fmod(t / 3600.0, 24);
+        bool charging = solar && hour_of_day > 9 && hour_of_day < 16 && soc < 99;
+        double crate = charging ? 3.0 + rng_gauss() * 0.5 : -0.35 + rng_gauss() * 0.05;
+        soc += crate * hours;
+        soc = soc > 100 ? 100 : soc < 0 ? 0 : soc;
+
+        s[i].taken_at = t;
+        s[i].moisture = (uint8_t)lround(moisture);
+        s[i].power = (charging ? 0x02 : 0) | (soc < 15 ? 0x04 : 0);
+        s[i].soc_raw = (uint16_t)lround(soc * 256);
+        s[i].crate_raw = (int16_t)lround(crate / 0.208);
+    }
+}
+
+static void gen_random(ts_sample_t *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        s[i].taken_at = rng();
+        s[i].moisture = (uint8_t)rng();
+        s[i].power = (uint8_t)rng();
+        s[i].soc_raw = (uint16_t)rng();
+        s[i].crate_raw = (int16_t)rng();
+    }
+}
+
+// Extremes: clock unset (0) mixed with real times, wraparound, min/max field values.
+static void gen_edges(ts_sample_t *s, size_t n) {
+    static const uint32_t times[] = { 0, 1, 0xFFFFFFFFu, 0x80000000u, 1781375990u };
+    static const int16_t crates[] = { INT16_MIN, INT16_MAX, 0, -1, 1 };
+    for (size_t i = 0; i < n; i++) {
+        s[i].taken_at = times[rng() % 5];
+        s[i].moisture = rng() & 1 ? 0 : 255;
+        s[i].power = rng() & 1 ? 0 : 0xFF;
+        s[i].soc_raw = rng() & 1 ? 0 : 0xFFFF;
+        s[i].crate_raw = crates[rng() % 5];
+    }
+}
+
+// ---- Property checks ----------------------------------------------------------------
+
+static bool same(const ts_sample_t *a, const ts_sample_t *b) {
+    return a->taken_at == b->taken_at && a->moisture == b->moisture && a->power == b->power &&
+           a->soc_raw == b->soc_raw && a->crate_raw == b->crate_raw;
+}
+
+static bool round_trip(const ts_sample_t *s, size_t n, const char *kind) {
+    static uint8_t buf[TS_CODEC_MAX_BYTES(MAX_N)];
+    static ts_sample_t back[MAX_N];
+
+    int len = ts_encode(s, n, buf, TS_CODEC_MAX_BYTES(n));
+    if (len < 0) {
+        printf("FAIL %s n=%zu: encode overflowed TS_CODEC_MAX_BYTES\n", kind, n);
+        return false;
+    }
+    if (ts_decode(buf, (size_t)len, back, n) != (int)n) {
+        printf("FAIL %s n=%zu: decode count\n", kind, n);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!same(&s[i], &back[i])) {
+            printf("FAIL %s n=%zu: sample %zu differs\n", kind, n, i);
+            return false;
+        }
+    }
+    // A buffer one byte short must be refused, not written past.
+    if (ts_encode(s, n, buf, (size_t)len - 1) != -1) {
+        printf("FAIL %s n=%zu: short buffer accepted\n", kind, n);
+        return false;
+    }
+    // Truncated input must be rejected, not decoded into garbage.
+    if (n > 0 && ts_decode(buf, (size_t)len - 1, back, n) != -1) {
+        printf("FAIL %s n=%zu: truncated payload accepted\n", kind, n);
+        return false;
+    }
+    if (n > 0 && ts_decode(buf, (size_t)len, back, n - 1) != -1) {
+        printf("FAIL %s n=%zu: max not enforced\n", kind, n);
+        return false;
+    }
+    return true;
+}
+
+static int run_properties(int iterations) {
+    static ts_sample_t s[MAX_N];
+    int failures = 0;
+    for (int it = 0; it < iterations; it++) {
+        size_t n = (size_t)rng_range(0, MAX_N);
+        int kind = it % 4;
+        switch (kind) {
+        case 0: gen_random(s, n); break;
+        case 1: gen_edges(s, n); break;
+        case 2: gen_realistic(s, n, 28800, true); break;
+        default: gen_realistic(s, n, (uint32_t)rng_range(60, 3600), rng() & 1); break;
+        }
+        static const char *names[] = { "random", "edges", "realistic_8h", "realistic_var" };
+        failures += !round_trip(s, n, names[kind]);
+    }
+    printf("properties iterations=%d failures=%d\n", iterations, failures);
+    return failures;
+}
+
+// ---- Benchmark ----------------------------------------------------------------------
+
+// What the same readings cost today: one form body per reading (the fields
+// write_reading_form() sends, minus identity fields that a batch would send once).
+static size_t form_bytes(const ts_sample_t *s, size_t n) {
+    size_t total = 0;
+    char line[256];
+    for (size_t i = 0; i < n; i++) {
+        total += (size_t)snprintf(line, sizeof(line),
+                                  "&moisture=%u&batt=%.2f&battery_status=%d&charge_status=%s&power_source=%s&taken_at=%u",
+                                  s[i].moisture, s[i].soc_raw / 256.0, (s[i].power & 0x04) != 0,
+                                  s[i].power & 0x02 ? "charging" : "discharging", "Battery", s[i].taken_at);
+    }
+    return total;
+}
+
+static void bench(const char *name, const ts_sample_t *s, size_t n) {
+    static uint8_t buf[TS_CODEC_MAX_BYTES(MAX_N)];
+    int len = ts_encode(s, n, buf, sizeof(buf));
+
+    const int reps = 20000;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int r = 0; r < reps; r++) {
+        ts_encode(s, n, buf, sizeof(buf));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / reps / n;
+
+    size_t raw = n * 10;   // taken_at + PackedReading, packed
+    size_t form = form_bytes(s, n);
+    size_t b64 = ((size_t)len * 4 + 2) / 3;
+    printf("series=%s n=%zu form_bytes=%zu raw_bytes=%zu codec_bytes=%d codec_b64=%zu "
+           "bits_per_sample=%.1f ratio_vs_raw=%.2f ratio_vs_form=%.1f encode_ns_per_sample=%.0f\n",
+           name, n, form, raw, len, b64, len * 8.0 / n, (double)raw / len, (double)form / b64, ns);
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    rng_state = argc > 2 ? strtoull(argv[2], NULL, 0) : 0x9E3779B97F4A7C15ull;
+    if (rng_state == 0) {
+        rng_state = 1;
+    }
+
+    int failures = run_properties(iterations);
+
+    static ts_sample_t s[MAX_N];
+    gen_realistic(s, 32, 28800, true);
+    bench("backlog_32x8h", s, 32);
+    gen_realistic(s, 3, 28800, false);
+    bench("day_3x8h", s, 3);
+    gen_realistic(s, 144, 600, true);
+    bench("micro_144x10min", s, 144);
+    gen_realistic(s, 288, 300, false);
+    bench("micro_288x5min_indoor", s, 288);
+    gen_random(s, 128);
+    bench("random_128", s, 128);
+
+    return failures ? 1 : 0;
+}
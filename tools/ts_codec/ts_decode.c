@@ -0,0 +1,69 @@
+// Decodes one series payload (the "series" form field, base64url, or raw bytes with -b)
+// from stdin and prints it as CSV. Reference decoder for the backend.
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "ts_codec.h"
+
+#define MAX_SAMPLES 4096
+
+static int b64_value(int c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-' || c == '+') return 62;
+    if (c == '_' || c == '/') return 63;
+    return -1;
+}
+
+// base64url or standard alphabet, padding optional, whitespace ignored.
+static size_t b64_decode(const char *in, uint8_t *out, size_t cap) {
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t n = 0;
+    for (; *in; in++) {
+        int v = b64_value((unsigned char)*in);
+        if (v < 0) {
+            continue;
+        }
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n < cap) {
+                out[n++] = (uint8_t)(acc >> bits);
+            }
+        }
+    }
+    return n;
+}
+
+int main(int argc, char **argv) {
+    bool raw = argc > 1 && strcmp(argv[1], "-b") == 0;
+    static char text[TS_CODEC_MAX_BYTES(MAX_SAMPLES) * 2];
+    static uint8_t payload[TS_CODEC_MAX_BYTES(MAX_SAMPLES)];
+    static ts_sample_t samples[MAX_SAMPLES];
+
+    size_t len;
+    if (raw) {
+        len = fread(payload, 1, sizeof(payload), stdin);
+    } else {
+        size_t got = fread(text, 1, sizeof(text) - 1, stdin);
+        text[got] = '\0';
+        const char *field = strstr(text, "series=");
+        len = b64_decode(field ? field + 7 : text, payload, sizeof(payload));
+    }
+
+    int n = ts_decode(payload, len, samples, MAX_SAMPLES);
+    if (n < 0) {
+        fprintf(stderr, "ts_decode: invalid payload (%zu bytes)\n", len);
+        return 1;
+    }
+    printf("taken_at,moisture,power,soc_raw,crate_raw,soc_pct,crate_pct_h\n");
+    for (int i = 0; i < n; i++) {
+        const ts_sample_t *s = &samples[i];
+        printf("%u,%u,%u,%u,%d,%.2f,%.3f\n", s->taken_at, s->moisture, s->power, s->soc_raw,
+               s->crate_raw, s->soc_raw / 256.0, s->crate_raw * 0.208);
+    }
+    return 0;
+}